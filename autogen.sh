@@ -35,7 +35,8 @@ if [ "$1" = "clean" -a ! -e Makefile ]
 then
     echo "Vanishing the code"
     rm -rf aclocal.m4 autom4te.cache/ compile config.* configure depcomp \
-           INSTALL install-sh Makefile.in missing src/Makefile.in
+           INSTALL install-sh Makefile.in missing src/Makefile.in \
+           bench/Makefile.in
     exit 0
 fi
 
@@ -0,0 +1,820 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/* nbns-sim answers NetBIOS node status queries for every address of a
+   range, so nbtscan can be measured without a real network. It listens on
+   the wildcard address and replies from whatever local address the query
+   was sent to, which makes all of 127.0.0.0/8 (or the addresses of dummy
+   interfaces in a network namespace) look like a populated subnet. With
+   -D it is also the name server of the range, for reverse lookups. */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <math.h>
+#include <poll.h>
+#include <getopt.h>
+#if HAVE_STDINT_H
+#include <stdint.h>
+#endif
+
+#define NB_DGRAM 137
+#define QUERY_MIN_SIZE 50
+#define QUESTION_NAME_OFFSET 12
+#define QUESTION_NAME_SIZE 34
+#define NAME_ENTRY_SIZE 18
+#define STATISTICS_SIZE 46
+#define MAX_NAMES 255
+#define MAX_PACKET ( 57 + MAX_NAMES * NAME_ENTRY_SIZE + STATISTICS_SIZE )
+#define DNS_HEADER_SIZE 12
+#define DNS_TTL 3600
+#define DNS_NEGATIVE_TTL 300
+
+enum latency_kind
+{
+  LATENCY_CONST,
+  LATENCY_UNIFORM,
+  LATENCY_EXP
+};
+
+struct config
+{
+  struct in_addr net; /* answered range, network byte order */
+  unsigned long mask; /* host byte order */
+  int port;
+  int dns_port;      /* port to answer PTR queries on, 0 for none */
+  double population; /* fraction of addresses that answer */
+  double loss;       /* fraction of answers dropped */
+  double malformed;  /* fraction of answers truncated */
+  long rate;         /* answers per second, 0 for unlimited */
+  int names;         /* entries in each name table */
+  enum latency_kind latency;
+  double latency_a; /* milliseconds */
+  double latency_b;
+  unsigned int seed;
+};
+
+/* A delayed answer */
+struct pending
+{
+  int sock;
+  int dns; /* an answer to a reverse lookup */
+  struct timeval due;
+  struct sockaddr_in to;
+  struct in_addr from;
+  unsigned short size;
+  unsigned char packet[MAX_PACKET];
+};
+
+struct stats
+{
+  unsigned long queries;
+  unsigned long answers;
+  unsigned long not_alive;
+  unsigned long lost;
+  unsigned long rate_limited;
+  unsigned long malformed;
+  unsigned long dns_queries;
+  unsigned long dns_answers;
+  unsigned long dns_nxdomain;
+};
+
+static volatile sig_atomic_t stop;
+static struct stats stats;
+
+/* Min-heap of delayed answers ordered by due time */
+static struct pending **heap;
+static unsigned int heap_count, heap_size;
+
+static void
+usage ( void )
+{
+  puts ( "Usage:\nnbns-sim [-p port] [-a network/prefix] [-P population] "
+         "[-l loss]\n"
+         "         [-m malformed] [-r rate] [-n names] [-L latency] "
+         "[-s seed]\n"
+         "         [-D port]\n"
+         "\t-p port\t\tUDP port to listen on. Default 137.\n"
+         "\t-a network/prefix\tAnswer for these addresses only.\n"
+         "\t\t\tDefault 127.0.0.0/8.\n"
+         "\t-P population\tFraction of addresses that answer (0-1).\n"
+         "\t\t\tDefault 1.\n"
+         "\t-l loss\t\tFraction of answers silently dropped (0-1).\n"
+         "\t-m malformed\tFraction of answers truncated at a random\n"
+         "\t\t\toffset (0-1).\n"
+         "\t-r rate\t\tMaximum answers per second. Default unlimited.\n"
+         "\t-n names\tNames in each name table (1-255). Default 8.\n"
+         "\t-L latency\tLatency distribution in milliseconds, one of\n"
+         "\t\t\tconst:MS, uniform:MIN:MAX or exp:MEAN.\n"
+         "\t\t\tDefault const:0.\n"
+         "\t-s seed\t\tRandom seed. Default 1.\n"
+         "\t-D port\t\tAlso answer reverse DNS (PTR) queries for the\n"
+         "\t\t\taddresses on this UDP port, with the latency\n"
+         "\t\t\tof -L. Hosts that answer are host-XXXXXXXX.sim.\n"
+         "Statistics are printed to stderr on SIGINT or SIGTERM." );
+  exit ( 2 );
+}
+
+static void
+on_signal ( int sig )
+{
+  ( void ) sig;
+  stop = 1;
+}
+
+static double
+random_unit ( void )
+{
+  return ( double ) random () / ( ( double ) RAND_MAX + 1 );
+}
+
+/* Whether addr (host byte order) belongs to a host that answers. The
+   decision is a hash of the address so repeated runs see the same
+   population. */
+static int
+is_alive ( const struct config *conf, unsigned long addr )
+{
+  my_uint32_t h;
+
+  if ( conf->population >= 1.0 )
+    return 1;
+  /* MurmurHash3 finalizer */
+  h = addr ^ conf->seed;
+  h ^= h >> 16;
+  h *= 0x85ebca6b;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35;
+  h ^= h >> 16;
+  return ( h & 0xffff ) < conf->population * 65536;
+}
+
+static double
+latency_ms ( const struct config *conf )
+{
+  switch ( conf->latency )
+    {
+      case LATENCY_UNIFORM:
+        return conf->latency_a +
+               random_unit () * ( conf->latency_b - conf->latency_a );
+      case LATENCY_EXP:
+        return -conf->latency_a * log ( 1.0 - random_unit () );
+      default:
+        return conf->latency_a;
+    }
+}
+
+static int
+parse_latency ( const char *spec, struct config *conf )
+{
+  if ( sscanf ( spec, "const:%lf", &conf->latency_a ) == 1 )
+    conf->latency = LATENCY_CONST;
+  else if ( sscanf ( spec,
+                     "uniform:%lf:%lf",
+                     &conf->latency_a,
+                     &conf->latency_b ) == 2 &&
+            conf->latency_b >= conf->latency_a )
+    conf->latency = LATENCY_UNIFORM;
+  else if ( sscanf ( spec, "exp:%lf", &conf->latency_a ) == 1 )
+    conf->latency = LATENCY_EXP;
+  else
+    return 0;
+  return conf->latency_a >= 0;
+}
+
+static int
+parse_network ( const char *spec, struct config *conf )
+{
+  char buf[32];
+  char *slash;
+  int prefix;
+
+  if ( strlen ( spec ) >= sizeof buf )
+    return 0;
+  strcpy ( buf, spec );
+  if ( !( slash = strchr ( buf, '/' ) ) )
+    return 0;
+  *slash++ = 0;
+  prefix = atoi ( slash );
+  if ( prefix < 0 || prefix > 32 || !inet_aton ( buf, &conf->net ) )
+    return 0;
+  conf->mask = prefix ? 0xffffffffUL << ( 32 - prefix ) : 0;
+  conf->mask &= 0xffffffffUL;
+  return 1;
+}
+
+static void
+put16 ( unsigned char *p, unsigned int v )
+{
+  p[0] = v >> 8;
+  p[1] = v;
+}
+
+/* Build the node status response host addr would send to query. Returns
+   the packet size. */
+static int
+build_answer ( const struct config *conf,
+               unsigned long addr,
+               const unsigned char *query,
+               unsigned char *packet )
+{
+  unsigned char *p = packet;
+  char name[32];
+  int i, rdata_length;
+
+  rdata_length = 1 + conf->names * NAME_ENTRY_SIZE + STATISTICS_SIZE;
+
+  memcpy ( p, query, 2 ); /* transaction ID */
+  put16 ( p + 2, 0x8400 );
+  put16 ( p + 4, 0 );
+  put16 ( p + 6, 1 );
+  put16 ( p + 8, 0 );
+  put16 ( p + 10, 0 );
+  memcpy ( p + QUESTION_NAME_OFFSET,
+           query + QUESTION_NAME_OFFSET,
+           QUESTION_NAME_SIZE );
+  p += QUESTION_NAME_OFFSET + QUESTION_NAME_SIZE;
+  put16 ( p, 0x0021 );
+  put16 ( p + 2, 0x0001 );
+  memset ( p + 4, 0, 4 ); /* TTL */
+  put16 ( p + 8, rdata_length );
+  p[10] = conf->names;
+  p += 11;
+
+  for ( i = 0; i < conf->names; i++ )
+    {
+      int service, group = 0;
+
+      switch ( i )
+        {
+          case 0:
+            snprintf ( name, sizeof name, "HOST-%08lX", addr );
+            service = 0x00;
+            break;
+          case 1:
+            snprintf ( name, sizeof name, "WORKGROUP" );
+            service = 0x00;
+            group = 1;
+            break;
+          case 2:
+            snprintf ( name, sizeof name, "HOST-%08lX", addr );
+            service = 0x20;
+            break;
+          case 3:
+            snprintf ( name, sizeof name, "USER-%08lX", addr );
+            service = 0x03;
+            break;
+          case 4:
+            snprintf ( name, sizeof name, "WORKGROUP" );
+            service = 0x1e;
+            group = 1;
+            break;
+          default:
+            snprintf ( name, sizeof name, "SERVICE-%d", i );
+            service = 0x40 + i % 0x40;
+            break;
+        }
+      memset ( p, ' ', 15 );
+      memcpy ( p, name, strlen ( name ) < 15 ? strlen ( name ) : 15 );
+      p[15] = service;
+      put16 ( p + 16, group ? 0x8400 : 0x0400 );
+      p += NAME_ENTRY_SIZE;
+    }
+
+  /* Statistics: a made up MAC derived from the address, then zeroes */
+  memset ( p, 0, STATISTICS_SIZE );
+  p[0] = 0x02;
+  p[1] = 0x00;
+  p[2] = addr >> 24;
+  p[3] = addr >> 16;
+  p[4] = addr >> 8;
+  p[5] = addr;
+  p += STATISTICS_SIZE;
+
+  return p - packet;
+}
+
+static int
+send_answer ( int sock,
+              const struct sockaddr_in *to,
+              struct in_addr from,
+              const unsigned char *packet,
+              int size )
+{
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  struct in_pktinfo *info;
+  char control[CMSG_SPACE ( sizeof ( struct in_pktinfo ) )];
+
+  iov.iov_base = ( void * ) packet;
+  iov.iov_len = size;
+
+  memset ( &msg, 0, sizeof msg );
+  memset ( control, 0, sizeof control );
+  msg.msg_name = ( void * ) to;
+  msg.msg_namelen = sizeof *to;
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof control;
+
+  /* Answer from the address the query was sent to */
+  cmsg = CMSG_FIRSTHDR ( &msg );
+  cmsg->cmsg_level = IPPROTO_IP;
+  cmsg->cmsg_type = IP_PKTINFO;
+  cmsg->cmsg_len = CMSG_LEN ( sizeof ( struct in_pktinfo ) );
+  info = ( struct in_pktinfo * ) CMSG_DATA ( cmsg );
+  info->ipi_spec_dst = from;
+
+  return sendmsg ( sock, &msg, 0 );
+}
+
+static void
+heap_push ( struct pending *item )
+{
+  unsigned int i, parent;
+
+  if ( heap_count == heap_size )
+    {
+      heap_size = heap_size ? heap_size * 2 : 1024;
+      if ( !( heap = realloc ( heap, heap_size * sizeof *heap ) ) )
+        {
+          perror ( "Malloc failed" );
+          exit ( 1 );
+        }
+    }
+  for ( i = heap_count++; i > 0; i = parent )
+    {
+      parent = ( i - 1 ) / 2;
+      if ( !timercmp ( &item->due, &heap[parent]->due, < ) )
+        break;
+      heap[i] = heap[parent];
+    }
+  heap[i] = item;
+}
+
+static struct pending *
+heap_pop ( void )
+{
+  struct pending *top, *last;
+  unsigned int i, child;
+
+  top = heap[0];
+  last = heap[--heap_count];
+  for ( i = 0; ( child = 2 * i + 1 ) < heap_count; i = child )
+    {
+      if ( child + 1 < heap_count &&
+           timercmp ( &heap[child + 1]->due, &heap[child]->due, < ) )
+        child++;
+      if ( !timercmp ( &heap[child]->due, &last->due, < ) )
+        break;
+      heap[i] = heap[child];
+    }
+  if ( heap_count )
+    heap[i] = last;
+  return top;
+}
+
+/* Token bucket limiting answers per second. Returns 1 if one more answer
+   may go out now. */
+static int
+rate_allows ( const struct config *conf, const struct timeval *now )
+{
+  static double tokens;
+  static struct timeval last;
+  double elapsed;
+
+  if ( !conf->rate )
+    return 1;
+  if ( last.tv_sec == 0 )
+    {
+      last = *now;
+      tokens = conf->rate / 100.0 + 1;
+    }
+  elapsed = ( now->tv_sec - last.tv_sec ) +
+            ( now->tv_usec - last.tv_usec ) / 1000000.0;
+  last = *now;
+  tokens += elapsed * conf->rate;
+  if ( tokens > conf->rate / 100.0 + 1 )
+    tokens = conf->rate / 100.0 + 1; /* allow 10 ms worth of burst */
+  if ( tokens < 1 )
+    return 0;
+  tokens -= 1;
+  return 1;
+}
+
+static void
+send_item ( struct pending *item )
+{
+  if ( send_answer ( item->sock, &item->to, item->from, item->packet,
+                     item->size ) > 0 )
+    {
+      if ( item->dns )
+        stats.dns_answers++;
+      else
+        stats.answers++;
+    }
+  free ( item );
+}
+
+/* Send item now or, with a latency, when it is due */
+static void
+delay_answer ( const struct config *conf,
+               struct pending *item,
+               const struct timeval *now )
+{
+  struct timeval delay;
+  double ms;
+
+  ms = latency_ms ( conf );
+  if ( ms <= 0 )
+    {
+      send_item ( item );
+      return;
+    }
+  delay.tv_sec = ( long ) ms / 1000;
+  delay.tv_usec = ( long ) ( ms * 1000 ) % 1000000;
+  timeradd ( now, &delay, &item->due );
+  heap_push ( item );
+}
+
+static void
+handle_query ( int sock,
+               const struct config *conf,
+               const unsigned char *query,
+               int size,
+               const struct sockaddr_in *from,
+               struct in_addr local )
+{
+  struct pending *item;
+  struct timeval now;
+  unsigned long addr;
+
+  stats.queries++;
+  addr = ntohl ( local.s_addr );
+  if ( size < QUERY_MIN_SIZE ||
+       ( addr & conf->mask ) != ( ntohl ( conf->net.s_addr ) & conf->mask ) ||
+       !is_alive ( conf, addr ) )
+    {
+      stats.not_alive++;
+      return;
+    }
+  if ( conf->loss > 0 && random_unit () < conf->loss )
+    {
+      stats.lost++;
+      return;
+    }
+
+  gettimeofday ( &now, NULL );
+  if ( !rate_allows ( conf, &now ) )
+    {
+      stats.rate_limited++;
+      return;
+    }
+
+  if ( !( item = malloc ( sizeof *item ) ) )
+    {
+      perror ( "Malloc failed" );
+      exit ( 1 );
+    }
+  item->to = *from;
+  item->from = local;
+  item->size = build_answer ( conf, addr, query, item->packet );
+  if ( conf->malformed > 0 && random_unit () < conf->malformed )
+    {
+      item->size = 2 + random () % ( item->size - 2 );
+      stats.malformed++;
+    }
+
+  item->sock = sock;
+  item->dns = 0;
+  delay_answer ( conf, item, &now );
+}
+
+/* Build the answer to a reverse lookup of an address of the range: its
+   name, or NXDOMAIN with an SOA record for the negative TTL. Returns the
+   packet size, 0 for a query that is not a PTR query for an address. */
+static int
+build_dns_answer ( const struct config *conf,
+                   const unsigned char *query,
+                   int size,
+                   unsigned char *packet )
+{
+  static const unsigned char soa[] = {
+    2, 'n', 's', 3, 's', 'i', 'm', 0,
+    10, 'h', 'o', 's', 't', 'm', 'a', 's', 't', 'e', 'r', 3, 's', 'i', 'm', 0,
+    0, 0, 0, 1, 0, 0, 0x0e, 0x10, 0, 0, 0x02, 0x58,
+    0, 0x01, 0x51, 0x80, 0, 0, 0x01, 0x2c /* minimum: 300 s */
+  };
+  unsigned long addr = 0, octet;
+  int offset = DNS_HEADER_SIZE, label, i, question_end, alive;
+  unsigned char *p;
+  char name[32];
+
+  if ( size < DNS_HEADER_SIZE || ( query[2] & 0x80 ) ||
+       query[4] != 0 || query[5] != 1 )
+    return 0;
+
+  /* d.c.b.a.in-addr.arpa */
+  for ( i = 0; i < 4; i++ )
+    {
+      label = query[offset];
+      if ( label < 1 || label > 3 || offset + 1 + label > size )
+        return 0;
+      memcpy ( name, query + offset + 1, label );
+      name[label] = 0;
+      octet = strtoul ( name, NULL, 10 );
+      if ( octet > 255 )
+        return 0;
+      addr |= octet << ( i * 8 );
+      offset += 1 + label;
+    }
+  if ( offset + 14 + 4 > size ||
+       strncasecmp ( ( const char * ) query + offset,
+                     "\7in-addr\4arpa",
+                     13 ) != 0 ||
+       query[offset + 13] != 0 || query[offset + 14] != 0 ||
+       query[offset + 15] != 12 )
+    return 0;
+  question_end = offset + 18;
+
+  alive = ( addr & conf->mask ) ==
+                  ( ntohl ( conf->net.s_addr ) & conf->mask ) &&
+          is_alive ( conf, addr );
+  memcpy ( packet, query, question_end );
+  packet[2] = 0x84 | ( query[2] & 0x01 ); /* authoritative answer */
+  packet[3] = alive ? 0x80 : 0x83;        /* or NXDOMAIN */
+  put16 ( packet + 6, alive );
+  put16 ( packet + 8, !alive );
+  put16 ( packet + 10, 0 );
+  p = packet + question_end;
+  put16 ( p, 0xc000 | DNS_HEADER_SIZE ); /* the name of the question */
+  if ( alive )
+    {
+      put16 ( p + 2, 12 );
+      put16 ( p + 4, 1 );
+      put16 ( p + 6, DNS_TTL >> 16 );
+      put16 ( p + 8, DNS_TTL & 0xffff );
+      snprintf ( name, sizeof name, "host-%08lx", addr );
+      put16 ( p + 10, 1 + strlen ( name ) + 5 );
+      p += 12;
+      *p = strlen ( name );
+      memcpy ( p + 1, name, *p );
+      p += 1 + *p;
+      memcpy ( p, "\3sim", 5 );
+      p += 5;
+    }
+  else
+    {
+      put16 ( p + 2, 6 );
+      put16 ( p + 4, 1 );
+      put16 ( p + 6, 0 );
+      put16 ( p + 8, DNS_NEGATIVE_TTL );
+      put16 ( p + 10, sizeof soa );
+      memcpy ( p + 12, soa, sizeof soa );
+      p += 12 + sizeof soa;
+    }
+  return p - packet;
+}
+
+static void
+handle_dns_query ( int sock,
+                   const struct config *conf,
+                   const unsigned char *query,
+                   int size,
+                   const struct sockaddr_in *from,
+                   struct in_addr local )
+{
+  struct pending *item;
+  struct timeval now;
+
+  stats.dns_queries++;
+  if ( !( item = malloc ( sizeof *item ) ) )
+    {
+      perror ( "Malloc failed" );
+      exit ( 1 );
+    }
+  if ( !( item->size = build_dns_answer ( conf, query, size, item->packet ) ) )
+    {
+      free ( item );
+      return;
+    }
+  if ( item->packet[3] & 0x0f )
+    stats.dns_nxdomain++;
+  item->sock = sock;
+  item->dns = 1;
+  item->to = *from;
+  item->from = local;
+  gettimeofday ( &now, NULL );
+  delay_answer ( conf, item, &now );
+}
+
+/* Send answers that are due, returns the poll timeout until the next one */
+static int
+flush_due ( void )
+{
+  struct timeval now, wait;
+
+  gettimeofday ( &now, NULL );
+  while ( heap_count && !timercmp ( &heap[0]->due, &now, > ) )
+    send_item ( heap_pop () );
+  if ( !heap_count )
+    return 1000;
+  timersub ( &heap[0]->due, &now, &wait );
+  return wait.tv_sec * 1000 + wait.tv_usec / 1000 + 1;
+}
+
+/* open_socket binds a socket to port of the wildcard address, asking for
+   the local address of each datagram */
+static int
+open_socket ( int port )
+{
+  struct sockaddr_in addr;
+  int sock, on = 1, bufsize = 4 * 1024 * 1024;
+
+  if ( ( sock = socket ( AF_INET, SOCK_DGRAM, IPPROTO_UDP ) ) < 0 )
+    {
+      perror ( "Failed to create socket" );
+      exit ( 1 );
+    }
+  setsockopt ( sock, IPPROTO_IP, IP_PKTINFO, &on, sizeof on );
+  setsockopt ( sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on );
+  setsockopt ( sock, SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof bufsize );
+  setsockopt ( sock, SOL_SOCKET, SO_SNDBUF, &bufsize, sizeof bufsize );
+
+  memset ( &addr, 0, sizeof addr );
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons ( port );
+  if ( bind ( sock, ( struct sockaddr * ) &addr, sizeof addr ) == -1 )
+    {
+      perror ( "Failed to bind" );
+      exit ( 1 );
+    }
+  return sock;
+}
+
+/* receive reads a datagram from sock without blocking, with the address
+   it came from and the local address it was sent to. Returns its size, or
+   -1 if there is none. */
+static int
+receive ( int sock,
+          unsigned char *query,
+          int query_size,
+          struct sockaddr_in *from,
+          struct in_addr *local )
+{
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  char control[256];
+  int size;
+
+  iov.iov_base = query;
+  iov.iov_len = query_size;
+  memset ( &msg, 0, sizeof msg );
+  msg.msg_name = from;
+  msg.msg_namelen = sizeof *from;
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof control;
+
+  if ( ( size = recvmsg ( sock, &msg, MSG_DONTWAIT ) ) < 0 )
+    return -1;
+
+  local->s_addr = INADDR_ANY;
+  for ( cmsg = CMSG_FIRSTHDR ( &msg ); cmsg;
+        cmsg = CMSG_NXTHDR ( &msg, cmsg ) )
+    if ( cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_PKTINFO )
+      *local = ( ( struct in_pktinfo * ) CMSG_DATA ( cmsg ) )->ipi_addr;
+  return size;
+}
+
+int
+main ( int argc, char *argv[] )
+{
+  struct config conf;
+  struct sockaddr_in from;
+  struct pollfd pfd[2];
+  struct in_addr local;
+  unsigned char query[1024];
+  int sock, dns_sock = -1, ch, size;
+
+  memset ( &conf, 0, sizeof conf );
+  conf.port = NB_DGRAM;
+  conf.population = 1.0;
+  conf.names = 8;
+  conf.seed = 1;
+  parse_network ( "127.0.0.0/8", &conf );
+
+  while ( ( ch = getopt ( argc, argv, "p:a:P:l:m:r:n:L:s:D:" ) ) != -1 )
+    switch ( ch )
+      {
+        case 'p':
+          conf.port = atoi ( optarg );
+          break;
+        case 'a':
+          if ( !parse_network ( optarg, &conf ) )
+            usage ();
+          break;
+        case 'P':
+          conf.population = atof ( optarg );
+          break;
+        case 'l':
+          conf.loss = atof ( optarg );
+          break;
+        case 'm':
+          conf.malformed = atof ( optarg );
+          break;
+        case 'r':
+          conf.rate = atol ( optarg );
+          break;
+        case 'n':
+          conf.names = atoi ( optarg );
+          if ( conf.names < 1 || conf.names > MAX_NAMES )
+            usage ();
+          break;
+        case 'L':
+          if ( !parse_latency ( optarg, &conf ) )
+            usage ();
+          break;
+        case 's':
+          conf.seed = strtoul ( optarg, NULL, 0 );
+          break;
+        case 'D':
+          conf.dns_port = atoi ( optarg );
+          if ( conf.dns_port <= 0 || conf.dns_port > 65535 )
+            usage ();
+          break;
+        default:
+          usage ();
+      }
+  srandom ( conf.seed );
+
+  sock = open_socket ( conf.port );
+  if ( conf.dns_port )
+    dns_sock = open_socket ( conf.dns_port );
+
+  signal ( SIGINT, on_signal );
+  signal ( SIGTERM, on_signal );
+
+  pfd[0].fd = sock;
+  pfd[0].events = POLLIN;
+  pfd[1].fd = dns_sock; /* ignored by poll if negative */
+  pfd[1].events = POLLIN;
+
+  while ( !stop )
+    {
+      if ( poll ( pfd, 2, flush_due () ) <= 0 )
+        continue;
+      if ( ( pfd[0].revents & POLLIN ) &&
+           ( size = receive ( sock, query, sizeof query, &from, &local ) ) >=
+                   0 )
+        handle_query ( sock, &conf, query, size, &from, local );
+      if ( ( pfd[1].revents & POLLIN ) &&
+           ( size = receive (
+                     dns_sock, query, sizeof query, &from, &local ) ) >= 0 )
+        handle_dns_query ( dns_sock, &conf, query, size, &from, local );
+    }
+
+  fprintf ( stderr,
+            "queries=%lu answers=%lu not_alive=%lu lost=%lu "
+            "rate_limited=%lu malformed=%lu pending=%u\n",
+            stats.queries,
+            stats.answers,
+            stats.not_alive,
+            stats.lost,
+            stats.rate_limited,
+            stats.malformed,
+            heap_count );
+  if ( conf.dns_port )
+    fprintf ( stderr,
+              "dns_queries=%lu dns_answers=%lu dns_nxdomain=%lu\n",
+              stats.dns_queries,
+              stats.dns_answers,
+              stats.dns_nxdomain );
+  close ( sock );
+  return 0;
+}
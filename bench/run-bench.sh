@@ -0,0 +1,91 @@
+#!/bin/sh
+
+# run-bench.sh - scan simulated networks and record nbtscan throughput
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+# Environment:
+#   NBTSCAN           nbtscan binary (default ../src/nbtscan)
+#   SIM, RUNSTAT      helper binaries (default ./nbns-sim, ./runstat)
+#   BENCH_PROFILES    prefix lengths to run, from 24, 16 and 12
+#                     (default "24 16 12")
+#   BENCH_SIM_FLAGS   extra nbns-sim options (default "-P 0.05")
+#   BENCH_SCAN_FLAGS  extra nbtscan options
+#   BENCH_OUT         file the result table is appended to
+
+NBTSCAN=${NBTSCAN:-../src/nbtscan}
+SIM=${SIM:-./nbns-sim}
+RUNSTAT=${RUNSTAT:-./runstat}
+PROFILES=${BENCH_PROFILES:-"24 16 12"}
+SIM_FLAGS=${BENCH_SIM_FLAGS:-"-P 0.05"}
+SCAN_FLAGS=${BENCH_SCAN_FLAGS:-""}
+OUT=${BENCH_OUT:-bench_output.txt}
+
+if [ "$(id -u)" != 0 ]
+then
+    echo "The benchmark needs root: nbns-sim listens on port 137." >&2
+    exit 1
+fi
+
+TMP=$(mktemp -d) || exit 1
+trap 'rm -rf "$TMP"' EXIT
+
+range_of() {
+    case "$1" in
+        24) echo 127.1.1.0/24 ;;
+        16) echo 127.2.0.0/16 ;;
+        12) echo 127.16.0.0/12 ;;
+        *)  echo "Unknown profile /$1" >&2; exit 1 ;;
+    esac
+}
+
+# Pick key=value from a stats line
+field() {
+    tr ' ' '\n' < "$2" | sed -n "s/^$1=//p"
+}
+
+{
+    echo "# $(date '+%Y-%m-%d %H:%M:%S') $($NBTSCAN 2>&1 | sed -n 's/^NBTscan version //p')" \
+         "sim: $SIM_FLAGS scan: $SCAN_FLAGS"
+    printf '%-8s%-16s%12s%12s%12s%10s%12s\n' \
+           profile range probes probes/s responses wall_s maxrss_kb
+} | tee -a "$OUT"
+
+for profile in $PROFILES
+do
+    range=$(range_of "$profile") || exit 1
+
+    # shellcheck disable=SC2086
+    "$SIM" -a "$range" $SIM_FLAGS 2> "$TMP/sim" &
+    sim_pid=$!
+    sleep 1
+
+    # shellcheck disable=SC2086
+    "$RUNSTAT" -o "$TMP/stat" "$NBTSCAN" -q -s : $SCAN_FLAGS "$range" \
+        > "$TMP/out"
+
+    kill -INT "$sim_pid"
+    wait "$sim_pid"
+
+    probes=$(field queries "$TMP/sim")
+    wall=$(field wall "$TMP/stat")
+    rss=$(field maxrss_kb "$TMP/stat")
+    responses=$(cut -d: -f1 "$TMP/out" | sort -u | wc -l)
+
+    printf '%-8s%-16s%12s%12.0f%12s%10.2f%12s\n' \
+           "/$profile" "$range" "$probes" \
+           "$(echo "$probes $wall" | awk '{ print ( $2 > 0 ? $1 / $2 : 0 ) }')" \
+           "$responses" "$wall" "$rss" | tee -a "$OUT"
+done
@@ -0,0 +1,83 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/* runstat runs a command and reports its wall clock time and peak resident
+   set size, so the benchmark does not depend on GNU time being installed. */
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+int
+main ( int argc, char *argv[] )
+{
+  struct timeval start, end;
+  struct rusage usage;
+  pid_t pid;
+  int status;
+  FILE *report = stderr;
+
+  if ( argc > 2 && argv[1][0] == '-' && argv[1][1] == 'o' )
+    {
+      if ( !( report = fopen ( argv[2], "w" ) ) )
+        {
+          perror ( argv[2] );
+          exit ( 1 );
+        }
+      argc -= 2;
+      argv += 2;
+    }
+  if ( argc < 2 )
+    {
+      puts ( "Usage:\nrunstat [-o report] command [args...]" );
+      exit ( 2 );
+    }
+
+  gettimeofday ( &start, NULL );
+  if ( ( pid = fork () ) < 0 )
+    {
+      perror ( "Fork failed" );
+      exit ( 1 );
+    }
+  if ( pid == 0 )
+    {
+      execvp ( argv[1], argv + 1 );
+      perror ( argv[1] );
+      _exit ( 127 );
+    }
+  if ( wait4 ( pid, &status, 0, &usage ) < 0 )
+    {
+      perror ( "Wait failed" );
+      exit ( 1 );
+    }
+  gettimeofday ( &end, NULL );
+  timersub ( &end, &start, &end );
+
+  fprintf ( report,
+            "wall=%ld.%06ld user=%ld.%06ld sys=%ld.%06ld maxrss_kb=%ld\n",
+            ( long ) end.tv_sec,
+            ( long ) end.tv_usec,
+            ( long ) usage.ru_utime.tv_sec,
+            ( long ) usage.ru_utime.tv_usec,
+            ( long ) usage.ru_stime.tv_sec,
+            ( long ) usage.ru_stime.tv_usec,
+            usage.ru_maxrss );
+  return WIFEXITED ( status ) ? WEXITSTATUS ( status ) : 1;
+}
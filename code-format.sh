@@ -1 +1 @@
-clang-format -i src/*[ch]
+clang-format -i src/*[ch] tests/*[ch]
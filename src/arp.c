@@ -0,0 +1,313 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/* ARP sweep: find the live hosts of the directly attached subnets before
+   sending them NetBIOS queries. A UDP query to an address nobody has sits
+   in the kernel behind an ARP resolution that takes seconds to fail, and
+   holds up the queries queued after it; asking with our own ARP requests
+   costs one frame per address and nothing when nobody answers. */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#if defined HAVE_NETPACKET_PACKET_H
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <net/ethernet.h>
+#include <netinet/if_ether.h>
+#include <netpacket/packet.h>
+#define HAVE_ARP 1
+#endif
+#include "arp.h"
+#include "range.h"
+#include "list.h"
+
+#define ARP_BATCH 64 /* replies read by one arp_receive() call */
+
+#if HAVE_ARP
+
+/* A subnet on an interface we can send ARP requests on */
+struct arp_iface
+{
+  int ifindex;
+  unsigned char mac[ETH_ALEN];
+  unsigned long addr; /* our address, host byte order */
+  struct ip_range subnet;
+};
+
+struct arp_sweep
+{
+  int sock;
+  struct arp_iface *ifaces;
+  int count;
+};
+
+/* find_link looks up the index and hardware address of the interface
+   called name in the AF_PACKET entries of ifaddrs */
+static int
+find_link ( struct ifaddrs *ifaddrs, const char *name, struct arp_iface *iface )
+{
+  struct ifaddrs *ifa;
+  struct sockaddr_ll *sll;
+
+  for ( ifa = ifaddrs; ifa; ifa = ifa->ifa_next )
+    {
+      if ( !ifa->ifa_addr || ifa->ifa_addr->sa_family != AF_PACKET ||
+           strcmp ( ifa->ifa_name, name ) != 0 )
+        continue;
+      sll = ( struct sockaddr_ll * ) ifa->ifa_addr;
+      if ( sll->sll_halen != ETH_ALEN )
+        return 0;
+      iface->ifindex = sll->sll_ifindex;
+      memcpy ( iface->mac, sll->sll_addr, ETH_ALEN );
+      return 1;
+    }
+  return 0;
+}
+
+struct arp_sweep *
+new_arp_sweep ( void )
+{
+  struct arp_sweep *sweep;
+  struct ifaddrs *ifaddrs, *ifa;
+  struct arp_iface iface;
+  unsigned long mask;
+  int saved_errno;
+
+  sweep = malloc ( sizeof ( struct arp_sweep ) );
+  if ( !sweep )
+    return NULL;
+  memset ( sweep, 0, sizeof ( struct arp_sweep ) );
+
+  sweep->sock = socket ( AF_PACKET, SOCK_DGRAM, htons ( ETH_P_ARP ) );
+  if ( sweep->sock < 0 )
+    {
+      free ( sweep );
+      return NULL;
+    }
+
+  if ( getifaddrs ( &ifaddrs ) < 0 )
+    {
+      saved_errno = errno;
+      delete_arp_sweep ( sweep );
+      errno = saved_errno;
+      return NULL;
+    }
+
+  for ( ifa = ifaddrs; ifa; ifa = ifa->ifa_next )
+    {
+      if ( !ifa->ifa_addr || ifa->ifa_addr->sa_family != AF_INET ||
+           !ifa->ifa_netmask || !( ifa->ifa_flags & IFF_UP ) ||
+           !( ifa->ifa_flags & IFF_BROADCAST ) ||
+           ( ifa->ifa_flags & ( IFF_LOOPBACK | IFF_NOARP ) ) )
+        continue;
+      if ( !find_link ( ifaddrs, ifa->ifa_name, &iface ) )
+        continue;
+
+      iface.addr = ntohl (
+              ( ( struct sockaddr_in * ) ifa->ifa_addr )->sin_addr.s_addr );
+      mask = ntohl (
+              ( ( struct sockaddr_in * ) ifa->ifa_netmask )->sin_addr.s_addr );
+      iface.subnet.start_ip = iface.addr & mask;
+      iface.subnet.end_ip = iface.subnet.start_ip | ( ~mask & 0xffffffff );
+      if ( iface.subnet.start_ip == iface.subnet.end_ip )
+        continue;
+
+      sweep->ifaces = realloc ( sweep->ifaces,
+                                ( sweep->count + 1 ) *
+                                        sizeof ( struct arp_iface ) );
+      if ( !sweep->ifaces )
+        {
+          freeifaddrs ( ifaddrs );
+          close ( sweep->sock );
+          free ( sweep );
+          errno = ENOMEM;
+          return NULL;
+        }
+      sweep->ifaces[sweep->count++] = iface;
+    }
+  freeifaddrs ( ifaddrs );
+
+  return sweep;
+}
+
+void
+delete_arp_sweep ( struct arp_sweep *sweep )
+{
+  if ( !sweep )
+    return;
+  close ( sweep->sock );
+  free ( sweep->ifaces );
+  free ( sweep );
+}
+
+int
+arp_sweep_fd ( const struct arp_sweep *sweep )
+{
+  return sweep->sock;
+}
+
+static struct arp_iface *
+find_iface ( const struct arp_sweep *sweep, unsigned long addr )
+{
+  int i;
+
+  for ( i = 0; i < sweep->count; i++ )
+    if ( addr >= sweep->ifaces[i].subnet.start_ip &&
+         addr <= sweep->ifaces[i].subnet.end_ip )
+      return &sweep->ifaces[i];
+  return NULL;
+}
+
+int
+arp_covers ( const struct arp_sweep *sweep, unsigned long addr )
+{
+  return find_iface ( sweep, addr ) != NULL;
+}
+
+int
+arp_request ( struct arp_sweep *sweep, unsigned long addr, struct list *alive )
+{
+  struct arp_iface *iface;
+  struct ether_arp request;
+  struct sockaddr_ll sll;
+  struct in_addr ip;
+
+  if ( !( iface = find_iface ( sweep, addr ) ) )
+    return -1;
+  if ( addr == iface->addr )
+    return insert ( alive, addr ) < 0 ? -1 : 0;
+  /* The network and broadcast addresses are not hosts */
+  if ( addr == iface->subnet.start_ip || addr == iface->subnet.end_ip )
+    return 0;
+
+  memset ( &request, 0, sizeof request );
+  request.arp_hrd = htons ( ARPHRD_ETHER );
+  request.arp_pro = htons ( ETH_P_IP );
+  request.arp_hln = ETH_ALEN;
+  request.arp_pln = 4;
+  request.arp_op = htons ( ARPOP_REQUEST );
+  memcpy ( request.arp_sha, iface->mac, ETH_ALEN );
+  ip.s_addr = htonl ( iface->addr );
+  memcpy ( request.arp_spa, &ip, 4 );
+  ip.s_addr = htonl ( addr );
+  memcpy ( request.arp_tpa, &ip, 4 );
+
+  memset ( &sll, 0, sizeof sll );
+  sll.sll_family = AF_PACKET;
+  sll.sll_protocol = htons ( ETH_P_ARP );
+  sll.sll_ifindex = iface->ifindex;
+  sll.sll_halen = ETH_ALEN;
+  memset ( sll.sll_addr, 0xff, ETH_ALEN );
+
+  if ( sendto ( sweep->sock,
+                &request,
+                sizeof request,
+                0,
+                ( struct sockaddr * ) &sll,
+                sizeof sll ) < 0 )
+    return -1;
+  return 0;
+}
+
+int
+arp_receive ( struct arp_sweep *sweep, struct list *alive )
+{
+  struct ether_arp reply;
+  struct sockaddr_ll sll;
+  socklen_t sll_len;
+  struct in_addr ip;
+  int size, i;
+
+  for ( i = 0; i < ARP_BATCH; i++ )
+    {
+      sll_len = sizeof sll;
+      size = recvfrom ( sweep->sock,
+                        &reply,
+                        sizeof reply,
+                        MSG_DONTWAIT,
+                        ( struct sockaddr * ) &sll,
+                        &sll_len );
+      if ( size < 0 && ( errno == EAGAIN || errno == EWOULDBLOCK ) )
+        return 0;
+      if ( size < ( int ) sizeof reply )
+        continue;
+      if ( sll.sll_pkttype == PACKET_OUTGOING ||
+           ntohs ( reply.arp_op ) != ARPOP_REPLY ||
+           ntohs ( reply.arp_pro ) != ETH_P_IP || reply.arp_pln != 4 )
+        continue;
+      memcpy ( &ip, reply.arp_spa, 4 );
+      if ( arp_covers ( sweep, ntohl ( ip.s_addr ) ) &&
+           insert ( alive, ntohl ( ip.s_addr ) ) < 0 )
+        return -1;
+    }
+  return 0;
+}
+
+#else /* !HAVE_ARP */
+
+struct arp_sweep *
+new_arp_sweep ( void )
+{
+  errno = ENOSYS;
+  return NULL;
+}
+
+void
+delete_arp_sweep ( struct arp_sweep *sweep )
+{
+  ( void ) sweep;
+}
+
+int
+arp_sweep_fd ( const struct arp_sweep *sweep )
+{
+  ( void ) sweep;
+  return -1;
+}
+
+int
+arp_covers ( const struct arp_sweep *sweep, unsigned long addr )
+{
+  ( void ) sweep;
+  ( void ) addr;
+  return 0;
+}
+
+int
+arp_request ( struct arp_sweep *sweep, unsigned long addr, struct list *alive )
+{
+  ( void ) sweep;
+  ( void ) addr;
+  ( void ) alive;
+  errno = ENOSYS;
+  return -1;
+}
+
+int
+arp_receive ( struct arp_sweep *sweep, struct list *alive )
+{
+  ( void ) sweep;
+  ( void ) alive;
+  return 0;
+}
+
+#endif /* HAVE_ARP */
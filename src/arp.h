@@ -0,0 +1,60 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#if !defined ARP_H
+#define ARP_H
+
+struct list;
+
+/* Bytes an ARP request takes on the wire, the minimum Ethernet frame */
+#define ARP_FRAME_SIZE 64
+
+/* A packet socket for sweeping the directly attached Ethernet subnets with
+   ARP requests */
+struct arp_sweep;
+
+/* new_arp_sweep opens the packet socket and looks up the local subnets it
+   can reach. Needs root. Returns NULL with errno set on failure, ENOSYS if
+   packet sockets are not supported. */
+struct arp_sweep *
+new_arp_sweep ( void );
+
+void
+delete_arp_sweep ( struct arp_sweep *sweep );
+
+int
+arp_sweep_fd ( const struct arp_sweep *sweep );
+
+/* arp_covers tells if addr (host byte order) is on a subnet the sweep
+   reaches */
+int
+arp_covers ( const struct arp_sweep *sweep, unsigned long addr );
+
+/* arp_request broadcasts who-has addr on the subnet it is on. Our own
+   addresses are not asked for but inserted into alive right away, the
+   network and broadcast addresses of the subnet are not asked for at all.
+   Returns 0 on success and -1 with errno set if the request could not be
+   sent or memory ran out. */
+int
+arp_request ( struct arp_sweep *sweep, unsigned long addr, struct list *alive );
+
+/* arp_receive reads the ARP replies that have arrived, without blocking,
+   and inserts the addresses that answered into alive. Returns 0, or -1 if
+   memory ran out. */
+int
+arp_receive ( struct arp_sweep *sweep, struct list *alive );
+
+#endif /* ARP_H */
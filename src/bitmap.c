@@ -0,0 +1,77 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "bitmap.h"
+
+struct addr_bitmap *
+new_addr_bitmap ( void )
+{
+  struct addr_bitmap *bitmap;
+
+  bitmap = malloc ( sizeof ( struct addr_bitmap ) );
+  if ( !bitmap )
+    return NULL;
+  bitmap->pages = calloc ( BITMAP_PAGES, sizeof ( unsigned char * ) );
+  if ( !bitmap->pages )
+    {
+      free ( bitmap );
+      return NULL;
+    }
+  bitmap->count = 0;
+  return bitmap;
+}
+
+void
+delete_addr_bitmap ( struct addr_bitmap *bitmap )
+{
+  if ( !bitmap )
+    return;
+  bitmap_clear ( bitmap );
+  free ( bitmap->pages );
+  free ( bitmap );
+}
+
+int
+bitmap_add ( struct addr_bitmap *bitmap, unsigned long addr )
+{
+  unsigned char **page = &bitmap->pages[( addr >> 16 ) & 0xffff];
+  unsigned int bit = addr & 0xffff;
+
+  if ( !*page && !( *page = calloc ( BITMAP_PAGE_BYTES, 1 ) ) )
+    return -1;
+  if ( ( *page )[bit >> 3] & ( 1 << ( bit & 7 ) ) )
+    return 0;
+  ( *page )[bit >> 3] |= 1 << ( bit & 7 );
+  bitmap->count++;
+  return 1;
+}
+
+void
+bitmap_clear ( struct addr_bitmap *bitmap )
+{
+  unsigned long i;
+
+  if ( !bitmap->count )
+    return;
+  for ( i = 0; i < BITMAP_PAGES; i++ )
+    {
+      free ( bitmap->pages[i] );
+      bitmap->pages[i] = NULL;
+    }
+  bitmap->count = 0;
+}
@@ -0,0 +1,49 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#if !defined BITMAP_H
+#define BITMAP_H
+
+/* A set of IPv4 addresses as a bitmap, in pages of one /16 that are only
+   allocated once an address in them is added: 8 KB per /16 in use, never
+   more than 512 MB */
+
+#define BITMAP_PAGES 65536
+#define BITMAP_PAGE_BYTES ( 65536 / 8 )
+
+struct addr_bitmap
+{
+  unsigned char **pages; /* by the top 16 bits of an address */
+  unsigned long count;   /* addresses in the set */
+};
+
+/* new_addr_bitmap returns NULL if memory runs out */
+struct addr_bitmap *
+new_addr_bitmap ( void );
+
+void
+delete_addr_bitmap ( struct addr_bitmap *bitmap );
+
+/* bitmap_add adds addr (host byte order). Returns 1 if it was not in the
+   set yet, 0 if it was and -1 if memory ran out. */
+int
+bitmap_add ( struct addr_bitmap *bitmap, unsigned long addr );
+
+/* bitmap_clear empties the set and frees its pages */
+void
+bitmap_clear ( struct addr_bitmap *bitmap );
+
+#endif /* BITMAP_H */
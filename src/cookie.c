@@ -0,0 +1,87 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "cookie.h"
+
+#define ROTL( x, b ) ( ( ( x ) << ( b ) ) | ( ( x ) >> ( 64 - ( b ) ) ) )
+
+#define SIPROUND                                                               \
+  do                                                                           \
+    {                                                                          \
+      v0 += v1;                                                                \
+      v1 = ROTL ( v1, 13 );                                                    \
+      v1 ^= v0;                                                                \
+      v0 = ROTL ( v0, 32 );                                                    \
+      v2 += v3;                                                                \
+      v3 = ROTL ( v3, 16 );                                                    \
+      v3 ^= v2;                                                                \
+      v0 += v3;                                                                \
+      v3 = ROTL ( v3, 21 );                                                    \
+      v3 ^= v0;                                                                \
+      v2 += v1;                                                                \
+      v1 = ROTL ( v1, 17 );                                                    \
+      v1 ^= v2;                                                                \
+      v2 = ROTL ( v2, 32 );                                                    \
+    }                                                                          \
+  while ( 0 )
+
+void
+cookie_secret ( struct cookie_key *key )
+{
+  struct timeval now;
+  FILE *random;
+
+  random = fopen ( "/dev/urandom", "r" );
+  if ( random && fread ( key, sizeof *key, 1, random ) == 1 )
+    {
+      fclose ( random );
+      return;
+    }
+  if ( random )
+    fclose ( random );
+
+  /* Guessable, but still no two scans alike */
+  gettimeofday ( &now, NULL );
+  key->k0 = ( ( unsigned long long ) now.tv_sec << 32 ) ^ now.tv_usec;
+  key->k1 = ( ( unsigned long long ) getpid () << 32 ) ^ ( unsigned long ) key;
+}
+
+/* SipHash-2-4 of the four bytes of the address, folded to 16 bits */
+unsigned int
+cookie ( const struct cookie_key *key, unsigned long addr )
+{
+  unsigned long long v0 = key->k0 ^ 0x736f6d6570736575ULL;
+  unsigned long long v1 = key->k1 ^ 0x646f72616e646f6dULL;
+  unsigned long long v2 = key->k0 ^ 0x6c7967656e657261ULL;
+  unsigned long long v3 = key->k1 ^ 0x7465646279746573ULL;
+  unsigned long long m = ( addr & 0xffffffff ) | ( 4ULL << 56 ), h;
+
+  v3 ^= m;
+  SIPROUND;
+  SIPROUND;
+  v0 ^= m;
+  v2 ^= 0xff;
+  SIPROUND;
+  SIPROUND;
+  SIPROUND;
+  SIPROUND;
+  h = v0 ^ v1 ^ v2 ^ v3;
+  return ( h ^ ( h >> 16 ) ^ ( h >> 32 ) ^ ( h >> 48 ) ) & 0xffff;
+}
@@ -0,0 +1,37 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#if !defined COOKIE_H
+#define COOKIE_H
+
+/* Stateless scans put a keyed hash of the destination address in the
+   transaction ID of each query, so that answers can be told from stray or
+   spoofed packets without remembering what was sent */
+
+struct cookie_key
+{
+  unsigned long long k0, k1;
+};
+
+/* cookie_secret picks a new key, from /dev/urandom if it can be read */
+void
+cookie_secret ( struct cookie_key *key );
+
+/* cookie is the transaction ID for addr (host byte order) under key */
+unsigned int
+cookie ( const struct cookie_key *key, unsigned long addr );
+
+#endif /* COOKIE_H */
@@ -0,0 +1,751 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/* Daemon mode (--daemon): scan jobs are submitted over a Unix domain
+   socket and rerun on a schedule, each keeping its socket and round trip
+   time estimates between passes. Results are streamed to the clients that
+   subscribed.
+
+   The control protocol is line based. Commands:
+
+     scan TARGET... [every=SECONDS] [timeout=MS] [bandwidth=BPS]
+          [retransmits=N] [output=FILE]     -> ok JOB
+     rescan JOB                             -> ok
+     cancel JOB                             -> ok
+     jobs                                   -> job ... lines, then ok
+     subscribe                              -> ok, then events
+     quit
+
+   Failed commands are answered with "error MESSAGE". Subscribers receive
+
+     result JOB ADDRESS:NAME:SERVER:USER:MAC:RTT
+     done JOB sent=N responded=N unreachable=N
+
+   in the format of "nbtscan -s : -T". A subscriber that doesn't read
+   fast enough loses lines rather than stalling the scans. */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <sys/time.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include "nbtscan.h"
+#include "daemon.h"
+#include "output.h"
+#include "errors.h"
+#include "time.h"
+
+extern int quiet;
+
+#define LINESIZE 1024 /* longest command accepted */
+
+struct daemon;
+
+struct job
+{
+  struct job *next;
+  struct daemon *daemon;
+  int id;
+  struct nbt_scan *scan;
+  char *description;       /* targets and options as given */
+  int every;               /* seconds between passes, 0 for a single pass */
+  int running;             /* a pass is in progress */
+  struct timeval next_run; /* start of the next pass if not running */
+  unsigned long passes;
+  FILE *output; /* results are appended here as well, or NULL */
+};
+
+struct client
+{
+  struct client *next;
+  int fd;
+  int subscribed;
+  int closed;
+  size_t len;
+  char buff[LINESIZE];
+  char *rest;       /* what did not go out of a line sent in part */
+  size_t rest_len;
+};
+
+struct daemon
+{
+  int listen_fd;
+  struct job *jobs;
+  struct client *clients;
+  int next_id;
+  struct nbt_options defaults;
+  char *sf;
+};
+
+static volatile sig_atomic_t terminate = 0;
+
+static void
+on_signal ( int sig )
+{
+  ( void ) sig;
+  terminate = 1;
+}
+
+/* client_flush sends what is left of a line that went out in part.
+   Returns 1 once nothing is left. */
+static int
+client_flush ( struct client *client )
+{
+  ssize_t n;
+
+  if ( client->closed || !client->rest_len )
+    return !client->closed;
+  n = send ( client->fd,
+             client->rest,
+             client->rest_len,
+             MSG_DONTWAIT | MSG_NOSIGNAL );
+  if ( n < 0 )
+    {
+      if ( errno != EAGAIN && errno != EWOULDBLOCK )
+        client->closed = 1;
+      return 0;
+    }
+  client->rest_len -= n;
+  memmove ( client->rest, client->rest + n, client->rest_len );
+  return client->rest_len == 0;
+}
+
+/* Lines that don't fit in the socket buffer of a client that reads slowly
+   are dropped, whole: the rest of one that went out in part is kept and
+   sent before anything else */
+static void
+client_send ( struct client *client, const char *line, size_t len )
+{
+  ssize_t n;
+
+  if ( !client_flush ( client ) )
+    return;
+  n = send ( client->fd, line, len, MSG_DONTWAIT | MSG_NOSIGNAL );
+  if ( n < 0 )
+    {
+      if ( errno != EAGAIN && errno != EWOULDBLOCK )
+        client->closed = 1;
+      return;
+    }
+  if ( ( size_t ) n == len )
+    return;
+  free ( client->rest );
+  if ( !( client->rest = malloc ( len - n ) ) )
+    {
+      client->closed = 1;
+      return;
+    }
+  memcpy ( client->rest, line + n, len - n );
+  client->rest_len = len - n;
+}
+
+static void
+client_printf ( struct client *client, const char *format, ... )
+{
+  char line[LINESIZE];
+  va_list ap;
+  int len;
+
+  va_start ( ap, format );
+  len = vsnprintf ( line, sizeof line, format, ap );
+  va_end ( ap );
+  if ( len < 0 )
+    return;
+  if ( len >= ( int ) sizeof line )
+    len = sizeof line - 1;
+  client_send ( client, line, len );
+}
+
+/* Send line to every subscriber */
+static void
+publish ( struct daemon *daemon, const char *line, size_t len )
+{
+  struct client *client;
+
+  for ( client = daemon->clients; client; client = client->next )
+    if ( client->subscribed )
+      client_send ( client, line, len );
+}
+
+static void
+job_result ( struct in_addr addr,
+             const struct nb_host_info *hostinfo,
+             double rtt,
+             void *arg )
+{
+  struct job *job = arg;
+  char *line = NULL;
+  size_t len = 0;
+  FILE *out;
+
+  if ( job->output )
+    {
+      print_hostinfo ( job->output, addr, hostinfo, job->daemon->sf, rtt );
+      fflush ( job->output );
+    }
+
+  if ( !( out = open_memstream ( &line, &len ) ) )
+    return;
+  fprintf ( out, "result %d ", job->id );
+  print_hostinfo ( out, addr, hostinfo, job->daemon->sf, rtt );
+  fclose ( out );
+  publish ( job->daemon, line, len );
+  free ( line );
+}
+
+static struct job *
+find_job ( struct daemon *daemon, const char *id )
+{
+  struct job *job;
+  char *end;
+  long n;
+
+  n = strtol ( id, &end, 10 );
+  if ( *id == '\0' || *end != '\0' )
+    return NULL;
+  for ( job = daemon->jobs; job; job = job->next )
+    if ( job->id == n )
+      return job;
+  return NULL;
+}
+
+static void
+delete_job ( struct daemon *daemon, struct job *job )
+{
+  struct job **p;
+
+  for ( p = &daemon->jobs; *p; p = &( *p )->next )
+    if ( *p == job )
+      {
+        *p = job->next;
+        break;
+      }
+  nbt_scan_free ( job->scan );
+  if ( job->output )
+    fclose ( job->output );
+  free ( job->description );
+  free ( job );
+}
+
+/* Parse a number option value, returns -1 if it isn't one */
+static int
+option_value ( const char *value )
+{
+  char *end;
+  long n;
+
+  n = strtol ( value, &end, 10 );
+  if ( *value == '\0' || *end != '\0' || n < 0 || n > 1000000000 )
+    return -1;
+  return n;
+}
+
+/* new_job creates a job from the arguments of a scan command. Returns NULL
+   and stores a message in error if they are not valid. */
+static struct job *
+new_job ( struct daemon *daemon, char *args, char *error, size_t errsize )
+{
+  struct nbt_options options = daemon->defaults;
+  struct job *job;
+  char *description, *token, *value, *save;
+  char *output = NULL;
+  char *target[LINESIZE / 2];
+  int every = 0, n, targets = 0, i, added;
+
+  if ( !( description = strdup ( args ) ) )
+    {
+      snprintf ( error, errsize, "out of memory" );
+      return NULL;
+    }
+
+  /* Options first, the scan socket depends on them */
+  for ( token = strtok_r ( args, " \t", &save ); token;
+        token = strtok_r ( NULL, " \t", &save ) )
+    {
+      if ( !( value = strchr ( token, '=' ) ) )
+        {
+          target[targets++] = token;
+          continue;
+        }
+      *value++ = '\0';
+      if ( strcmp ( token, "output" ) == 0 )
+        {
+          output = value;
+          continue;
+        }
+      if ( ( n = option_value ( value ) ) < 0 )
+        {
+          snprintf ( error, errsize, "bad value for %s", token );
+          free ( description );
+          return NULL;
+        }
+      if ( strcmp ( token, "every" ) == 0 )
+        every = n;
+      else if ( strcmp ( token, "timeout" ) == 0 && n > 0 )
+        options.timeout = n;
+      else if ( strcmp ( token, "bandwidth" ) == 0 )
+        options.bandwidth = n;
+      else if ( strcmp ( token, "retransmits" ) == 0 )
+        options.retransmits = n;
+      else
+        {
+          snprintf ( error, errsize, "bad option %s", token );
+          free ( description );
+          return NULL;
+        }
+    }
+  if ( !targets )
+    {
+      snprintf ( error, errsize, "no targets" );
+      free ( description );
+      return NULL;
+    }
+
+  job = malloc ( sizeof ( struct job ) );
+  if ( !job )
+    err_die ( "Malloc failed", quiet );
+  memset ( job, 0, sizeof ( struct job ) );
+  job->daemon = daemon;
+  job->description = description;
+  job->every = every;
+
+  if ( !( job->scan = nbt_scan_new ( &options, job_result, job ) ) )
+    {
+      snprintf ( error, errsize, "cannot open socket: %s", strerror ( errno ) );
+      free ( description );
+      free ( job );
+      return NULL;
+    }
+  /* The loop waits on it with select() */
+  if ( nbt_scan_fd ( job->scan ) >= FD_SETSIZE )
+    {
+      snprintf ( error, errsize, "too many open descriptors" );
+      nbt_scan_free ( job->scan );
+      free ( description );
+      free ( job );
+      return NULL;
+    }
+
+  for ( i = 0; i < targets; i++ )
+    if ( ( added = nbt_scan_add_target ( job->scan, target[i] ) ) <= 0 )
+      {
+        if ( added < 0 )
+          snprintf ( error, errsize, "out of memory" );
+        else
+          snprintf ( error, errsize, "bad target %s", target[i] );
+        nbt_scan_free ( job->scan );
+        free ( description );
+        free ( job );
+        return NULL;
+      }
+
+  if ( output && !( job->output = fopen ( output, "a" ) ) )
+    {
+      snprintf ( error,
+                 errsize,
+                 "cannot open %s: %s",
+                 output,
+                 strerror ( errno ) );
+      nbt_scan_free ( job->scan );
+      free ( description );
+      free ( job );
+      return NULL;
+    }
+
+  job->id = ++daemon->next_id;
+  job->running = 1;
+  job->next = daemon->jobs;
+  daemon->jobs = job;
+  return job;
+}
+
+static void
+list_jobs ( struct daemon *daemon, struct client *client )
+{
+  const struct nbt_stats *stats;
+  struct job *job;
+
+  for ( job = daemon->jobs; job; job = job->next )
+    {
+      stats = nbt_scan_stats ( job->scan );
+      client_printf ( client,
+                      "job %d %s passes=%lu sent=%lu responded=%lu "
+                      "unreachable=%lu errors=%lu: %s\n",
+                      job->id,
+                      job->running ? "running" : "idle",
+                      job->passes,
+                      stats->sent,
+                      stats->responded,
+                      stats->unreachable,
+                      stats->errors,
+                      job->description );
+    }
+}
+
+static void
+command ( struct daemon *daemon, struct client *client, char *line )
+{
+  char error[160];
+  char *args;
+  struct job *job;
+
+  line[strcspn ( line, "\r" )] = '\0';
+  args = line + strcspn ( line, " \t" );
+  if ( *args )
+    *args++ = '\0';
+  args += strspn ( args, " \t" );
+
+  if ( strcmp ( line, "scan" ) == 0 )
+    {
+      if ( ( job = new_job ( daemon, args, error, sizeof error ) ) )
+        client_printf ( client, "ok %d\n", job->id );
+      else
+        client_printf ( client, "error %s\n", error );
+    }
+  else if ( strcmp ( line, "rescan" ) == 0 || strcmp ( line, "cancel" ) == 0 )
+    {
+      if ( !( job = find_job ( daemon, args ) ) )
+        {
+          client_printf ( client, "error no job %s\n", args );
+          return;
+        }
+      if ( line[0] == 'c' )
+        delete_job ( daemon, job );
+      else if ( nbt_scan_restart ( job->scan ) < 0 )
+        {
+          client_printf ( client, "error out of memory\n" );
+          return;
+        }
+      else
+        job->running = 1;
+      client_printf ( client, "ok\n" );
+    }
+  else if ( strcmp ( line, "jobs" ) == 0 )
+    {
+      list_jobs ( daemon, client );
+      client_printf ( client, "ok\n" );
+    }
+  else if ( strcmp ( line, "subscribe" ) == 0 )
+    {
+      client->subscribed = 1;
+      client_printf ( client, "ok\n" );
+    }
+  else if ( strcmp ( line, "quit" ) == 0 )
+    client->closed = 1;
+  else if ( *line )
+    client_printf ( client, "error unknown command %s\n", line );
+}
+
+static void
+client_read ( struct daemon *daemon, struct client *client )
+{
+  char *start, *end;
+  ssize_t n;
+
+  n = recv ( client->fd,
+             client->buff + client->len,
+             sizeof client->buff - client->len - 1,
+             MSG_DONTWAIT );
+  if ( n <= 0 )
+    {
+      if ( n == 0 || ( errno != EAGAIN && errno != EINTR ) )
+        client->closed = 1;
+      return;
+    }
+  client->len += n;
+  client->buff[client->len] = '\0';
+
+  for ( start = client->buff; !client->closed &&
+                              ( end = strchr ( start, '\n' ) );
+        start = end + 1 )
+    {
+      *end = '\0';
+      command ( daemon, client, start );
+    }
+
+  client->len -= start - client->buff;
+  memmove ( client->buff, start, client->len );
+  if ( client->len == sizeof client->buff - 1 )
+    {
+      client_printf ( client, "error line too long\n" );
+      client->len = 0;
+    }
+}
+
+static void
+accept_client ( struct daemon *daemon )
+{
+  struct client *client;
+  int fd;
+
+  if ( ( fd = accept ( daemon->listen_fd, NULL, NULL ) ) < 0 )
+    return;
+  if ( fd >= FD_SETSIZE )
+    {
+      close ( fd );
+      return;
+    }
+  client = malloc ( sizeof ( struct client ) );
+  if ( !client )
+    err_die ( "Malloc failed", quiet );
+  memset ( client, 0, sizeof ( struct client ) );
+  client->fd = fd;
+  client->next = daemon->clients;
+  daemon->clients = client;
+}
+
+static void
+reap_clients ( struct daemon *daemon )
+{
+  struct client **p, *client;
+
+  for ( p = &daemon->clients; ( client = *p ); )
+    if ( client->closed )
+      {
+        *p = client->next;
+        close ( client->fd );
+        free ( client->rest );
+        free ( client );
+      }
+    else
+      p = &client->next;
+}
+
+/* A pass of job is over: tell subscribers and schedule the next one */
+static void
+job_done ( struct daemon *daemon, struct job *job, struct timeval *now )
+{
+  const struct nbt_stats *stats = nbt_scan_stats ( job->scan );
+  char line[128];
+  int len;
+
+  job->running = 0;
+  job->passes++;
+  len = snprintf ( line,
+                   sizeof line,
+                   "done %d sent=%lu responded=%lu unreachable=%lu\n",
+                   job->id,
+                   stats->sent,
+                   stats->responded,
+                   stats->unreachable );
+  publish ( daemon, line, len );
+
+  if ( job->every )
+    {
+      job->next_run = *now;
+      job->next_run.tv_sec += job->every;
+    }
+  else
+    delete_job ( daemon, job );
+}
+
+/* Set *timeout to the time until the earliest job event, if sooner */
+static void
+min_timeout ( struct timeval *timeout, const struct timeval *tv )
+{
+  if ( timeout->tv_sec < 0 || timercmp ( tv, timeout, < ) )
+    *timeout = *tv;
+}
+
+static int
+open_control_socket ( const char *path )
+{
+  struct sockaddr_un addr;
+  struct stat st;
+  int fd;
+
+  if ( strlen ( path ) >= sizeof addr.sun_path )
+    {
+      errno = ENAMETOOLONG;
+      return -1;
+    }
+  memset ( &addr, 0, sizeof addr );
+  addr.sun_family = AF_UNIX;
+  strcpy ( addr.sun_path, path );
+
+  /* Remove a socket left over by a previous run, but nothing else */
+  if ( lstat ( path, &st ) == 0 && S_ISSOCK ( st.st_mode ) )
+    unlink ( path );
+
+  if ( ( fd = socket ( AF_UNIX, SOCK_STREAM, 0 ) ) < 0 )
+    return -1;
+  if ( fd >= FD_SETSIZE )
+    {
+      close ( fd );
+      errno = EMFILE;
+      return -1;
+    }
+  if ( bind ( fd, ( struct sockaddr * ) &addr, sizeof addr ) < 0 ||
+       listen ( fd, 16 ) < 0 )
+    {
+      close ( fd );
+      return -1;
+    }
+  return fd;
+}
+
+int
+run_daemon ( const char *path,
+             const struct nbt_options *defaults,
+             char *sf,
+             char **targets,
+             int interval )
+{
+  struct daemon daemon;
+  struct job *job, *next;
+  struct client *client;
+  struct timeval now, timeout, tv;
+  struct sigaction sa;
+  char args[LINESIZE], error[160], errmsg[80];
+  fd_set fdsr, fdsw;
+  int maxfd, running, len;
+
+  memset ( &daemon, 0, sizeof daemon );
+  daemon.defaults = *defaults;
+  daemon.sf = sf;
+
+  if ( ( daemon.listen_fd = open_control_socket ( path ) ) < 0 )
+    {
+      snprintf ( errmsg, sizeof errmsg, "Cannot listen on %s", path );
+      err_print ( errmsg, quiet );
+      return 1;
+    }
+
+  if ( *targets )
+    {
+      /* The job is made like one from a scan command, no longer */
+      len = snprintf ( args, sizeof args, "every=%d", interval );
+      for ( ; *targets && len < LINESIZE; targets++ )
+        len += snprintf ( args + len, LINESIZE - len, " %s", *targets );
+      if ( len >= LINESIZE )
+        snprintf ( error,
+                   sizeof error,
+                   "targets longer than %d characters",
+                   LINESIZE - 1 );
+      if ( len >= LINESIZE || !new_job ( &daemon, args, error, sizeof error ) )
+        {
+          if ( !quiet )
+            fprintf ( stderr, "%s\n", error );
+          close ( daemon.listen_fd );
+          unlink ( path );
+          return 1;
+        }
+    }
+
+  memset ( &sa, 0, sizeof sa );
+  sa.sa_handler = on_signal;
+  sigaction ( SIGINT, &sa, NULL );
+  sigaction ( SIGTERM, &sa, NULL );
+  sa.sa_handler = SIG_IGN;
+  sigaction ( SIGPIPE, &sa, NULL );
+
+  while ( !terminate )
+    {
+      gettimeofday ( &now, NULL );
+
+      /* Run the jobs and find out when they next need attention */
+      timeout.tv_sec = -1;
+      for ( job = daemon.jobs; job; job = next )
+        {
+          next = job->next;
+          if ( !job->running && !timercmp ( &now, &job->next_run, < ) )
+            {
+              if ( nbt_scan_restart ( job->scan ) < 0 )
+                {
+                  /* Skip this pass, there may be memory for the next */
+                  err_print ( "Malloc failed", quiet );
+                  job->next_run.tv_sec += job->every;
+                }
+              else
+                job->running = 1;
+            }
+          if ( job->running && ( running = nbt_scan_step ( job->scan ) ) <= 0 )
+            {
+              if ( running < 0 )
+                err_print ( "Malloc failed", quiet );
+              job_done ( &daemon, job, &now );
+            }
+        }
+
+      FD_ZERO ( &fdsr );
+      FD_SET ( daemon.listen_fd, &fdsr );
+      maxfd = daemon.listen_fd;
+      for ( job = daemon.jobs; job; job = job->next )
+        {
+          if ( job->running )
+            {
+              FD_SET ( nbt_scan_fd ( job->scan ), &fdsr );
+              if ( nbt_scan_fd ( job->scan ) > maxfd )
+                maxfd = nbt_scan_fd ( job->scan );
+              nbt_scan_timeout ( job->scan, &tv );
+            }
+          else if ( timercmp ( &now, &job->next_run, < ) )
+            timersub ( &job->next_run, &now, &tv );
+          else
+            timerclear ( &tv );
+          min_timeout ( &timeout, &tv );
+        }
+      FD_ZERO ( &fdsw );
+      for ( client = daemon.clients; client; client = client->next )
+        {
+          FD_SET ( client->fd, &fdsr );
+          if ( client->rest_len )
+            FD_SET ( client->fd, &fdsw );
+          if ( client->fd > maxfd )
+            maxfd = client->fd;
+        }
+
+      if ( select ( maxfd + 1,
+                    &fdsr,
+                    &fdsw,
+                    NULL,
+                    timeout.tv_sec < 0 ? NULL : &timeout ) < 0 )
+        {
+          if ( errno == EINTR )
+            continue;
+          err_print ( "Select failed", quiet );
+          break;
+        }
+
+      if ( FD_ISSET ( daemon.listen_fd, &fdsr ) )
+        accept_client ( &daemon );
+      for ( client = daemon.clients; client; client = client->next )
+        {
+          if ( FD_ISSET ( client->fd, &fdsw ) )
+            client_flush ( client );
+          if ( FD_ISSET ( client->fd, &fdsr ) )
+            client_read ( &daemon, client );
+        }
+      reap_clients ( &daemon );
+    }
+
+  while ( daemon.jobs )
+    delete_job ( &daemon, daemon.jobs );
+  for ( client = daemon.clients; client; client = client->next )
+    client->closed = 1;
+  reap_clients ( &daemon );
+  close ( daemon.listen_fd );
+  unlink ( path );
+  return 0;
+}
@@ -0,0 +1,34 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#if !defined DAEMON_H
+#define DAEMON_H
+
+#include "nbtscan.h"
+
+/* run_daemon listens for commands on the Unix domain socket at path and
+   runs the scan jobs it is given until SIGINT or SIGTERM. defaults are
+   the options of jobs that don't set their own, sf separates the fields
+   of result lines. If targets is not empty they become the first job,
+   repeated every interval seconds. Returns the exit status. */
+int
+run_daemon ( const char *path,
+             const struct nbt_options *defaults,
+             char *sf,
+             char **targets,
+             int interval );
+
+#endif /* DAEMON_H */
@@ -0,0 +1,136 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "exclude.h"
+
+struct exclude_list *
+new_exclude_list ( void )
+{
+  struct exclude_list *list;
+
+  list = calloc ( 1, sizeof ( struct exclude_list ) );
+  if ( !list )
+    return NULL;
+  list->sorted = 1;
+  return list;
+}
+
+void
+delete_exclude_list ( struct exclude_list *list )
+{
+  if ( !list )
+    return;
+  free ( list->ranges );
+  free ( list );
+}
+
+int
+exclude_add ( struct exclude_list *list,
+              unsigned long start,
+              unsigned long end )
+{
+  struct ip_range *ranges;
+
+  if ( list->count == list->allocated )
+    {
+      ranges = realloc ( list->ranges,
+                         ( list->allocated ? list->allocated * 2 : 64 ) *
+                                 sizeof ( struct ip_range ) );
+      if ( !ranges )
+        return -1;
+      list->ranges = ranges;
+      list->allocated = list->allocated ? list->allocated * 2 : 64;
+    }
+  list->ranges[list->count].start_ip = start;
+  list->ranges[list->count].end_ip = end;
+  list->count++;
+  list->sorted = 0;
+  return 0;
+}
+
+static int
+compare_ranges ( const void *a, const void *b )
+{
+  const struct ip_range *ra = a, *rb = b;
+
+  if ( ra->start_ip != rb->start_ip )
+    return ra->start_ip < rb->start_ip ? -1 : 1;
+  return 0;
+}
+
+/* Sort the ranges and merge the ones that overlap or touch */
+static void
+exclude_sort ( struct exclude_list *list )
+{
+  unsigned int i, merged = 0;
+
+  qsort ( list->ranges,
+          list->count,
+          sizeof ( struct ip_range ),
+          compare_ranges );
+  for ( i = 1; i < list->count; i++ )
+    if ( list->ranges[i].start_ip <= list->ranges[merged].end_ip + 1 )
+      {
+        if ( list->ranges[i].end_ip > list->ranges[merged].end_ip )
+          list->ranges[merged].end_ip = list->ranges[i].end_ip;
+      }
+    else
+      list->ranges[++merged] = list->ranges[i];
+  if ( list->count )
+    list->count = merged + 1;
+  list->sorted = 1;
+}
+
+/* The index of the last range starting at or before addr, -1 if none */
+static long
+range_before ( struct exclude_list *list, unsigned long addr )
+{
+  long low = 0, high = ( long ) list->count - 1, middle;
+
+  if ( !list->sorted )
+    exclude_sort ( list );
+  while ( low <= high )
+    {
+      middle = ( low + high ) / 2;
+      if ( list->ranges[middle].start_ip <= addr )
+        low = middle + 1;
+      else
+        high = middle - 1;
+    }
+  return high;
+}
+
+const struct ip_range *
+exclude_find ( struct exclude_list *list, unsigned long addr )
+{
+  long i = range_before ( list, addr );
+
+  if ( i >= 0 && addr <= list->ranges[i].end_ip )
+    return &list->ranges[i];
+  return NULL;
+}
+
+int
+exclude_overlaps ( struct exclude_list *list,
+                   unsigned long start,
+                   unsigned long end )
+{
+  long i = range_before ( list, end );
+
+  return i >= 0 && list->ranges[i].end_ip >= start;
+}
@@ -0,0 +1,57 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#if !defined EXCLUDE_H
+#define EXCLUDE_H
+
+#include "range.h"
+
+/* Addresses not to scan, as a sorted array of disjoint ranges. Ranges are
+   added in any order and sorted and merged before the first lookup. */
+struct exclude_list
+{
+  struct ip_range *ranges;
+  unsigned int count;
+  unsigned int allocated;
+  int sorted; /* ranges is sorted and merged */
+};
+
+/* new_exclude_list returns NULL if memory runs out */
+struct exclude_list *
+new_exclude_list ( void );
+
+void
+delete_exclude_list ( struct exclude_list *list );
+
+/* exclude_add adds the addresses from start to end, host byte order.
+   Returns 0, or -1 if memory ran out. */
+int
+exclude_add ( struct exclude_list *list,
+              unsigned long start,
+              unsigned long end );
+
+/* exclude_find returns the excluded range addr is in, NULL if it is not
+   excluded. A binary search, O(log n) in the number of ranges. */
+const struct ip_range *
+exclude_find ( struct exclude_list *list, unsigned long addr );
+
+/* exclude_overlaps tells if any address from start to end is excluded */
+int
+exclude_overlaps ( struct exclude_list *list,
+                   unsigned long start,
+                   unsigned long end );
+
+#endif /* EXCLUDE_H */
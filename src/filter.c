@@ -0,0 +1,554 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include "filter.h"
+#include "errors.h"
+
+extern int quiet;
+
+/* The most values the program may have on its stack at once */
+#define FILTER_STACK 64
+
+enum filter_field
+{
+  FILTER_FIELD_NAME,
+  FILTER_FIELD_SERVICE,
+  FILTER_FIELD_UNIQUE,
+  FILTER_FIELD_GROUP,
+  FILTER_FIELD_IP,
+  FILTER_FIELD_MAC,
+  FILTER_FIELD_MAC_PREFIX
+};
+
+enum filter_op
+{
+  FILTER_OP_TRUE, /* a flag on its own */
+  FILTER_OP_EQ,
+  FILTER_OP_NE,
+  FILTER_OP_MATCH,
+  FILTER_OP_NOMATCH
+};
+
+enum filter_type
+{
+  TYPE_FLAG,
+  TYPE_NUMBER,
+  TYPE_STRING,
+  TYPE_ADDRESS,
+  TYPE_MAC
+};
+
+static const struct
+{
+  const char *name;
+  enum filter_field field;
+  enum filter_type type;
+  int per_name; /* a property of a name table entry */
+  int parts;
+} fields[] = {
+        { "name", FILTER_FIELD_NAME, TYPE_STRING, 1, NB_PARSE_NAMES },
+        { "service", FILTER_FIELD_SERVICE, TYPE_NUMBER, 1, NB_PARSE_NAMES },
+        { "unique", FILTER_FIELD_UNIQUE, TYPE_FLAG, 1, NB_PARSE_NAMES },
+        { "group", FILTER_FIELD_GROUP, TYPE_STRING, 0, NB_PARSE_NAMES },
+        { "ip", FILTER_FIELD_IP, TYPE_ADDRESS, 0, 0 },
+        { "mac", FILTER_FIELD_MAC, TYPE_MAC, 0, NB_PARSE_MAC },
+        { "mac_prefix", FILTER_FIELD_MAC_PREFIX, TYPE_MAC, 0, NB_PARSE_MAC },
+};
+
+#define FIELD_COUNT ( int ) ( sizeof fields / sizeof fields[0] )
+
+/* Compiling */
+/*************/
+
+struct parser
+{
+  const char *p;
+  struct filter *filter;
+  int depth; /* of the stack at this point of the program */
+  char *errmsg;
+  size_t errlen;
+};
+
+static void
+skip_space ( struct parser *parser )
+{
+  while ( isspace ( ( unsigned char ) *parser->p ) )
+    parser->p++;
+}
+
+static int
+parse_error ( struct parser *parser, const char *message )
+{
+  snprintf ( parser->errmsg,
+             parser->errlen,
+             "%s at \"%.20s\"",
+             message,
+             parser->p );
+  return 0;
+}
+
+static struct filter_insn *
+emit ( struct parser *parser, enum filter_code code )
+{
+  struct filter *filter = parser->filter;
+  struct filter_insn *insn;
+
+  if ( filter->count == filter->allocated )
+    {
+      filter->allocated = filter->allocated ? filter->allocated * 2 : 16;
+      filter->program = realloc (
+              filter->program,
+              filter->allocated * sizeof ( struct filter_insn ) );
+      if ( !filter->program )
+        err_die ( "Malloc failed", quiet );
+    }
+  insn = &filter->program[filter->count++];
+  memset ( insn, 0, sizeof ( struct filter_insn ) );
+  insn->code = code;
+  if ( code == FILTER_TEST )
+    parser->depth++;
+  else if ( code != FILTER_NOT )
+    parser->depth--;
+  if ( parser->depth > filter->depth )
+    filter->depth = parser->depth;
+  return insn;
+}
+
+/* parse_mac reads up to 6 hex bytes separated by : or - */
+static int
+parse_mac ( const char *string, my_uint8_t *mac )
+{
+  unsigned long byte;
+  char *end;
+  int len = 0;
+
+  for ( ;; )
+    {
+      if ( !isxdigit ( ( unsigned char ) *string ) || len == 6 )
+        return 0;
+      byte = strtoul ( string, &end, 16 );
+      if ( byte > 255 || end - string > 2 )
+        return 0;
+      mac[len++] = byte;
+      if ( !*end )
+        return len;
+      if ( *end != ':' && *end != '-' )
+        return 0;
+      string = end + 1;
+    }
+}
+
+/* parse_value reads the value of a comparison into value: quoted, or up to
+   a blank or an operator */
+static int
+parse_value ( struct parser *parser, char *value, size_t size )
+{
+  const char *start;
+  char quote = 0;
+  size_t len;
+
+  skip_space ( parser );
+  if ( *parser->p == '"' || *parser->p == '\'' )
+    quote = *parser->p++;
+  start = parser->p;
+  if ( quote )
+    while ( *parser->p && *parser->p != quote )
+      parser->p++;
+  else
+    while ( *parser->p && !isspace ( ( unsigned char ) *parser->p ) &&
+            !strchr ( "()&|", *parser->p ) )
+      parser->p++;
+  len = parser->p - start;
+  if ( quote && !*parser->p )
+    return parse_error ( parser, "Unterminated string" );
+  if ( quote )
+    parser->p++;
+  if ( len == 0 && !quote )
+    return parse_error ( parser, "Missing value" );
+  if ( len >= size )
+    return parse_error ( parser, "Value too long" );
+  memcpy ( value, start, len );
+  value[len] = 0;
+  return 1;
+}
+
+static int
+parse_term ( struct parser *parser )
+{
+  struct filter_term *term;
+  char name[16], value[256], *end;
+  const char *start;
+  int i, len = 0;
+  enum filter_op op;
+
+  while ( ( isalnum ( ( unsigned char ) parser->p[len] ) ||
+            parser->p[len] == '_' ) &&
+          len < ( int ) sizeof name - 1 )
+    len++;
+  memcpy ( name, parser->p, len );
+  name[len] = 0;
+  for ( i = 0; i < FIELD_COUNT; i++ )
+    if ( strcmp ( fields[i].name, name ) == 0 )
+      break;
+  if ( i == FIELD_COUNT )
+    return parse_error ( parser, "Unknown field" );
+  parser->p += len;
+  skip_space ( parser );
+
+  if ( strncmp ( parser->p, "==", 2 ) == 0 )
+    op = FILTER_OP_EQ;
+  else if ( strncmp ( parser->p, "!=", 2 ) == 0 )
+    op = FILTER_OP_NE;
+  else if ( strncmp ( parser->p, "!~", 2 ) == 0 )
+    op = FILTER_OP_NOMATCH;
+  else if ( *parser->p == '~' )
+    op = FILTER_OP_MATCH;
+  else
+    op = FILTER_OP_TRUE;
+  if ( ( op == FILTER_OP_TRUE ) != ( fields[i].type == TYPE_FLAG ) )
+    return parse_error ( parser,
+                         op == FILTER_OP_TRUE ? "Missing comparison"
+                                              : "Flag compared" );
+  if ( ( op == FILTER_OP_MATCH || op == FILTER_OP_NOMATCH ) &&
+       fields[i].type != TYPE_STRING )
+    return parse_error ( parser, "Only names can be matched" );
+  parser->p += op == FILTER_OP_MATCH ? 1 : op == FILTER_OP_TRUE ? 0 : 2;
+
+  term = &emit ( parser, FILTER_TEST )->term;
+  term->field = fields[i].field;
+  term->op = op;
+  parser->filter->parts |= fields[i].parts;
+  parser->filter->per_name |= fields[i].per_name;
+  if ( op == FILTER_OP_TRUE )
+    return 1;
+
+  skip_space ( parser );
+  start = parser->p;
+  if ( !parse_value ( parser, value, sizeof value ) )
+    return 0;
+  /* Errors in the value are shown from its start */
+  switch ( fields[i].type )
+    {
+      case TYPE_NUMBER:
+        term->number = strtoul ( value, &end, 0 );
+        if ( *end || term->number > 255 )
+          {
+            parser->p = start;
+            return parse_error ( parser, "Bad service number" );
+          }
+        break;
+      case TYPE_STRING:
+        if ( op == FILTER_OP_EQ || op == FILTER_OP_NE )
+          {
+            if ( !( term->string = strdup ( value ) ) )
+              err_die ( "Malloc failed", quiet );
+          }
+        else if ( regcomp ( &term->regex,
+                            value,
+                            REG_EXTENDED | REG_ICASE | REG_NOSUB ) != 0 )
+          {
+            parser->p = start;
+            return parse_error ( parser, "Bad regular expression" );
+          }
+        else
+          term->has_regex = 1;
+        break;
+      case TYPE_ADDRESS:
+        if ( !is_ip ( value, &term->range ) &&
+             !is_range1 ( value, &term->range ) &&
+             !is_range2 ( value, &term->range ) )
+          {
+            parser->p = start;
+            return parse_error ( parser, "Bad address" );
+          }
+        break;
+      case TYPE_MAC:
+        term->mac_len = parse_mac ( value, term->mac );
+        if ( !term->mac_len ||
+             ( term->field == FILTER_FIELD_MAC && term->mac_len != 6 ) )
+          {
+            parser->p = start;
+            return parse_error ( parser, "Bad MAC address" );
+          }
+        break;
+      default:
+        break;
+    }
+  return 1;
+}
+
+static int
+parse_or ( struct parser *parser );
+
+static int
+parse_unary ( struct parser *parser )
+{
+  skip_space ( parser );
+  if ( *parser->p == '!' && parser->p[1] != '=' && parser->p[1] != '~' )
+    {
+      parser->p++;
+      if ( !parse_unary ( parser ) )
+        return 0;
+      emit ( parser, FILTER_NOT );
+      return 1;
+    }
+  if ( *parser->p == '(' )
+    {
+      parser->p++;
+      if ( !parse_or ( parser ) )
+        return 0;
+      skip_space ( parser );
+      if ( *parser->p != ')' )
+        return parse_error ( parser, "Missing )" );
+      parser->p++;
+      return 1;
+    }
+  return parse_term ( parser );
+}
+
+static int
+parse_and ( struct parser *parser )
+{
+  if ( !parse_unary ( parser ) )
+    return 0;
+  for ( ;; )
+    {
+      skip_space ( parser );
+      if ( strncmp ( parser->p, "&&", 2 ) != 0 )
+        return 1;
+      parser->p += 2;
+      if ( !parse_unary ( parser ) )
+        return 0;
+      emit ( parser, FILTER_AND );
+    }
+}
+
+static int
+parse_or ( struct parser *parser )
+{
+  if ( !parse_and ( parser ) )
+    return 0;
+  for ( ;; )
+    {
+      skip_space ( parser );
+      if ( strncmp ( parser->p, "||", 2 ) != 0 )
+        return 1;
+      parser->p += 2;
+      if ( !parse_and ( parser ) )
+        return 0;
+      emit ( parser, FILTER_OR );
+    }
+}
+
+struct filter *
+new_filter ( const char *expression, char *errmsg, size_t errlen )
+{
+  struct parser parser;
+  struct filter *filter;
+
+  filter = calloc ( 1, sizeof ( struct filter ) );
+  if ( !filter )
+    err_die ( "Malloc failed", quiet );
+  parser.p = expression;
+  parser.filter = filter;
+  parser.depth = 0;
+  parser.errmsg = errmsg;
+  parser.errlen = errlen;
+  if ( parse_or ( &parser ) )
+    {
+      skip_space ( &parser );
+      if ( *parser.p )
+        parse_error ( &parser, "Unexpected text" );
+      else if ( filter->depth > FILTER_STACK )
+        parse_error ( &parser, "Expression too deep" );
+      else
+        return filter;
+    }
+  delete_filter ( filter );
+  return NULL;
+}
+
+void
+delete_filter ( struct filter *filter )
+{
+  int i;
+
+  if ( !filter )
+    return;
+  for ( i = 0; i < filter->count; i++ )
+    if ( filter->program[i].code == FILTER_TEST )
+      {
+        if ( filter->program[i].term.has_regex )
+          regfree ( &filter->program[i].term.regex );
+        free ( filter->program[i].term.string );
+      }
+  free ( filter->program );
+  free ( filter );
+}
+
+/* Matching */
+/************/
+
+struct context
+{
+  unsigned long addr;            /* host byte order */
+  const struct nb_host_info *hostinfo;
+  const struct nbname *entry;    /* of the name table, or NULL */
+  char group[16];                /* the workgroup or domain, or "" */
+  int group_found;               /* group has been looked for */
+};
+
+/* entry_name copies the name of a name table entry without the padding */
+static void
+entry_name ( const struct nbname *entry, char *name )
+{
+  int len = 15;
+
+  memcpy ( name, entry->ascii_name, 15 );
+  while ( len > 0 && ( name[len - 1] == ' ' || name[len - 1] == 0 ) )
+    len--;
+  name[len] = 0;
+}
+
+/* The workgroup is the first group name of the workstation service, as
+   -v shows it */
+static const char *
+host_group ( struct context *ctx )
+{
+  const struct nb_host_info *hostinfo = ctx->hostinfo;
+  int i;
+
+  if ( ctx->group_found )
+    return ctx->group;
+  ctx->group_found = 1;
+  ctx->group[0] = 0;
+  if ( hostinfo->header && hostinfo->names )
+    for ( i = 0; i < hostinfo->header->number_of_names; i++ )
+      if ( hostinfo->names[i].ascii_name[15] == 0 &&
+           ( hostinfo->names[i].rr_flags & 0x0080 ) )
+        {
+          entry_name ( &hostinfo->names[i], ctx->group );
+          break;
+        }
+  return ctx->group;
+}
+
+static int
+compare_string ( const struct filter_term *term, const char *string )
+{
+  int result;
+
+  if ( term->has_regex )
+    result = regexec ( &term->regex, string, 0, NULL, 0 ) == 0;
+  else
+    result = strcasecmp ( term->string, string ) == 0;
+  return term->op == FILTER_OP_NE || term->op == FILTER_OP_NOMATCH ? !result
+                                                                    : result;
+}
+
+/* test_term tells if term holds. A term on something the host didn't
+   send, a name table entry or a MAC address, never does. */
+static int
+test_term ( const struct filter_term *term, struct context *ctx )
+{
+  char name[16];
+  int result;
+
+  switch ( term->field )
+    {
+      case FILTER_FIELD_NAME:
+        if ( !ctx->entry )
+          return 0;
+        entry_name ( ctx->entry, name );
+        return compare_string ( term, name );
+      case FILTER_FIELD_SERVICE:
+        if ( !ctx->entry )
+          return 0;
+        result = ( unsigned char ) ctx->entry->ascii_name[15] == term->number;
+        break;
+      case FILTER_FIELD_UNIQUE:
+        return ctx->entry && !( ctx->entry->rr_flags & 0x0080 );
+      case FILTER_FIELD_GROUP:
+        return compare_string ( term, host_group ( ctx ) );
+      case FILTER_FIELD_IP:
+        result = ctx->addr >= term->range.start_ip &&
+                 ctx->addr <= term->range.end_ip;
+        break;
+      default:
+        if ( !ctx->hostinfo->footer )
+          return 0;
+        result = memcmp ( ctx->hostinfo->footer->adapter_address,
+                          term->mac,
+                          term->mac_len ) == 0;
+        break;
+    }
+  return term->op == FILTER_OP_NE ? !result : result;
+}
+
+static int
+run_program ( const struct filter *filter, struct context *ctx )
+{
+  int stack[FILTER_STACK], top = 0, i;
+
+  for ( i = 0; i < filter->count; i++ )
+    switch ( filter->program[i].code )
+      {
+        case FILTER_TEST:
+          stack[top++] = test_term ( &filter->program[i].term, ctx );
+          break;
+        case FILTER_AND:
+          top--;
+          stack[top - 1] = stack[top - 1] && stack[top];
+          break;
+        case FILTER_OR:
+          top--;
+          stack[top - 1] = stack[top - 1] || stack[top];
+          break;
+        case FILTER_NOT:
+          stack[top - 1] = !stack[top - 1];
+          break;
+      }
+  return stack[0];
+}
+
+int
+filter_match ( const struct filter *filter,
+               struct in_addr addr,
+               const struct nb_host_info *hostinfo )
+{
+  struct context ctx;
+  int i;
+
+  ctx.addr = ntohl ( addr.s_addr );
+  ctx.hostinfo = hostinfo;
+  ctx.entry = NULL;
+  ctx.group_found = 0;
+  if ( !filter->per_name || !hostinfo->header || !hostinfo->names ||
+       hostinfo->header->number_of_names == 0 )
+    return run_program ( filter, &ctx );
+  for ( i = 0; i < hostinfo->header->number_of_names; i++ )
+    {
+      ctx.entry = &hostinfo->names[i];
+      if ( run_program ( filter, &ctx ) )
+        return 1;
+    }
+  return 0;
+}
@@ -0,0 +1,84 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#if !defined FILTER_H
+#define FILTER_H
+
+#include <stddef.h>
+#include <regex.h>
+#include <netinet/in.h>
+#include "statusq.h"
+#include "range.h"
+
+/* Result filters (--where). An expression is compiled once into a program
+   for a small stack machine, in postfix order, which is run on each host
+   before it is formatted. Terms on names (name, service, unique) hold if
+   one entry of the name table satisfies them all; the others are the same
+   for every entry. */
+
+enum filter_code
+{
+  FILTER_TEST, /* push the value of term */
+  FILTER_AND,  /* pop two, push both */
+  FILTER_OR,   /* pop two, push either */
+  FILTER_NOT   /* pop one, push its negation */
+};
+
+struct filter_term
+{
+  int field;     /* FILTER_FIELD_* in filter.c */
+  int op;        /* FILTER_OP_* in filter.c */
+  unsigned long number;
+  char *string;
+  regex_t regex;
+  int has_regex; /* regex is compiled */
+  struct ip_range range;
+  my_uint8_t mac[6];
+  int mac_len;
+};
+
+struct filter_insn
+{
+  enum filter_code code;
+  struct filter_term term; /* of FILTER_TEST */
+};
+
+struct filter
+{
+  struct filter_insn *program;
+  int count;
+  int allocated;
+  int depth;    /* of the stack the program needs */
+  int per_name; /* the program looks at name table entries */
+  int parts;    /* NB_PARSE_* parts of a response it needs */
+};
+
+/* new_filter compiles expression. Returns NULL, with the reason in
+   errmsg, if it is not a valid one. */
+struct filter *
+new_filter ( const char *expression, char *errmsg, size_t errlen );
+
+void
+delete_filter ( struct filter *filter );
+
+/* filter_match tells if the host at addr that answered hostinfo satisfies
+   filter */
+int
+filter_match ( const struct filter *filter,
+               struct in_addr addr,
+               const struct nb_host_info *hostinfo );
+
+#endif /* FILTER_H */
@@ -20,9 +20,6 @@
 #include <stdio.h>
 #include "list.h"
 #include <stdlib.h>
-#include "errors.h"
-
-extern int quiet;
 
 struct list *
 new_list ()
@@ -30,7 +27,7 @@ new_list ()
   struct list *lst;
 
   if ( ( lst = malloc ( sizeof ( struct list ) ) ) == NULL )
-    err_die ( "Malloc failed", quiet );
+    return NULL;
   lst->head = NULL;
   return lst;
 }
@@ -41,7 +38,7 @@ new_list_item ( unsigned long content )
   struct list_item *lst_item;
 
   if ( ( lst_item = malloc ( sizeof ( struct list_item ) ) ) == NULL )
-    err_die ( "Malloc failed", quiet );
+    return NULL;
 
   lst_item->next = NULL;
   lst_item->prev = NULL;
@@ -54,6 +51,8 @@ delete_list ( struct list *list )
 {
   struct list_item *pointer;
 
+  if ( !list )
+    return;
   pointer = list->head;
 
   if ( pointer )
@@ -93,7 +92,8 @@ insert ( struct list *lst, unsigned long content )
   struct list_item *temp_item, *item;
   int cmp;
 
-  item = new_list_item ( content );
+  if ( !( item = new_list_item ( content ) ) )
+    return -1;
 
   cmp = compare ( lst->head, item );
   if ( lst->head == NULL )
@@ -104,6 +104,7 @@ insert ( struct list *lst, unsigned long content )
   else if ( cmp == 1 )
     {
       item->next = lst->head;
+      lst->head->prev = item;
       lst->head = item;
       item->prev = NULL;
       return 1;
@@ -30,6 +30,7 @@ struct list
   struct list_item *head;
 };
 
+/* new_list and new_list_item return NULL if memory runs out */
 struct list *
 new_list ();
 
@@ -42,6 +43,8 @@ delete_list ( struct list *list );
 int
 compare ( struct list_item *item1, struct list_item *item2 );
 
+/* insert adds content to the list. Returns 1 if it was not there yet, 0 if
+   it was and -1 if memory ran out. */
 int
 insert ( struct list *lst, unsigned long content );
 
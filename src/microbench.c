@@ -0,0 +1,616 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/* microbench times the parts of nbtscan that run once per response: the
+   packet parser, name encoding, the list of scanned hosts, service name
+   lookup and the output formatters. Heap allocations are counted by
+   wrapping malloc(), calloc() and realloc() at link time (GNU ld
+   --wrap), see Makefile.am. */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <getopt.h>
+#if HAVE_STDINT_H
+#include <stdint.h>
+#endif
+#include "statusq.h"
+#include "list.h"
+#include "output.h"
+#include "pcapfile.h"
+
+/* Allocation counting */
+/***********************/
+
+static unsigned long allocations;
+
+void *
+__real_malloc ( size_t size );
+void *
+__real_calloc ( size_t nmemb, size_t size );
+void *
+__real_realloc ( void *ptr, size_t size );
+
+void *
+__wrap_malloc ( size_t size )
+{
+  allocations++;
+  return __real_malloc ( size );
+}
+
+void *
+__wrap_calloc ( size_t nmemb, size_t size )
+{
+  allocations++;
+  return __real_calloc ( nmemb, size );
+}
+
+void *
+__wrap_realloc ( void *ptr, size_t size )
+{
+  allocations++;
+  return __real_realloc ( ptr, size );
+}
+
+/* Harness */
+/***********/
+
+typedef void ( *bench_fn ) ( void *arg );
+
+static FILE *report;
+static long min_time_ns = 200000000;
+static const char *filter;
+
+static long
+now_ns ( void )
+{
+  struct timeval tv;
+
+  gettimeofday ( &tv, NULL );
+  return tv.tv_sec * 1000000000L + tv.tv_usec * 1000L;
+}
+
+/* Call fn(arg) until at least min_time_ns have passed, each call doing
+   ops_per_call operations, and report the cost of one operation */
+static void
+run ( const char *name, bench_fn fn, void *arg, unsigned long ops_per_call )
+{
+  unsigned long iterations, i, allocated;
+  long start, elapsed;
+
+  if ( filter && !strstr ( name, filter ) )
+    return;
+
+  for ( iterations = 1;; iterations *= 2 )
+    {
+      allocations = 0;
+      start = now_ns ();
+      for ( i = 0; i < iterations; i++ )
+        fn ( arg );
+      elapsed = now_ns () - start;
+      allocated = allocations;
+      if ( elapsed >= min_time_ns )
+        break;
+    }
+  fflush ( stdout );
+
+  fprintf ( report,
+            "%-40s%12.1f%12.2f%12lu\n",
+            name,
+            ( double ) elapsed / ( iterations * ops_per_call ),
+            ( double ) allocated / ( iterations * ops_per_call ),
+            iterations * ops_per_call );
+}
+
+/* Response corpus */
+/*******************/
+
+struct corpus_name
+{
+  const char *name;
+  unsigned char service;
+  int group;
+};
+
+struct packet
+{
+  char name[64];
+  unsigned char data[1024];
+  unsigned int size;
+};
+
+static void
+put16 ( unsigned char *p, unsigned int v )
+{
+  p[0] = v >> 8;
+  p[1] = v;
+}
+
+/* Build a node status response the way Windows sends it: 57 bytes of
+   header, 18 bytes per name and 46 bytes of statistics starting with the
+   MAC address */
+static void
+build_response ( struct packet *pkt,
+                 const char *label,
+                 const struct corpus_name *names,
+                 int count,
+                 const unsigned char *mac )
+{
+  unsigned char *p = pkt->data;
+  char question[40];
+  int i;
+
+  snprintf ( pkt->name, sizeof pkt->name, "%s", label );
+  memset ( p, 0, sizeof pkt->data );
+  put16 ( p, 0x1234 );
+  put16 ( p + 2, 0x8400 );
+  put16 ( p + 6, 1 );
+  name_mangle ( "*", question, 0 );
+  memcpy ( p + 12, question, 34 );
+  put16 ( p + 46, QT_NODE_STATUS_REQUEST );
+  put16 ( p + 48, QC_INTERNET );
+  put16 ( p + 54, 1 + count * 18 + 46 );
+  p[56] = count;
+  p += NBNAME_RESPONSE_HEADER_SIZE;
+
+  for ( i = 0; i < count; i++ )
+    {
+      memset ( p, ' ', 15 );
+      memcpy ( p,
+               names[i].name,
+               strlen ( names[i].name ) < 15 ? strlen ( names[i].name ) : 15 );
+      p[15] = names[i].service;
+      put16 ( p + 16, names[i].group ? 0x8400 : 0x0400 );
+      p += 18;
+    }
+  memcpy ( p, mac, 6 );
+  p += 46;
+  pkt->size = p - pkt->data;
+}
+
+static const struct corpus_name workstation[] = {
+        { "DESKTOP-4TQ2K1", 0x00, 0 },
+        { "WORKGROUP", 0x00, 1 },
+        { "DESKTOP-4TQ2K1", 0x20, 0 },
+        { "JDOE", 0x03, 0 } };
+
+static const struct corpus_name controller[] = {
+        { "DC01", 0x00, 0 },
+        { "CORP", 0x00, 1 },
+        { "CORP", 0x1c, 1 },
+        { "DC01", 0x20, 0 },
+        { "CORP", 0x1b, 0 },
+        { "CORP", 0x1e, 1 },
+        { "CORP", 0x1d, 0 },
+        { "\x01\x02__MSBROWSE__\x02", 0x01, 1 },
+        { "ADMINISTRATOR", 0x03, 0 },
+        { "INet~Services", 0x1c, 1 },
+        { "IS~DC01", 0x00, 0 } };
+
+static const struct corpus_name samba[] = { { "FILESRV", 0x00, 0 },
+                                            { "FILESRV", 0x03, 0 },
+                                            { "FILESRV", 0x20, 0 },
+                                            { "WORKGROUP", 0x00, 1 },
+                                            { "WORKGROUP", 0x1e, 1 } };
+
+static const struct corpus_name printer[] = { { "NPI3A9F21", 0x00, 0 },
+                                              { "NPI3A9F21", 0x20, 0 } };
+
+#define COUNT( a ) ( sizeof a / sizeof a[0] )
+#define MAX_CORPUS 64
+
+static struct packet corpus[MAX_CORPUS];
+static int corpus_size;
+
+static struct packet *
+new_packet ( void )
+{
+  if ( corpus_size == MAX_CORPUS )
+    {
+      fprintf ( stderr, "Too many corpus packets\n" );
+      exit ( 1 );
+    }
+  return &corpus[corpus_size++];
+}
+
+static void
+build_corpus ( void )
+{
+  static const unsigned char mac[6] = { 0x00, 0x50, 0x56, 0x12, 0x34, 0x56 };
+  static const unsigned char zero_mac[6];
+  struct corpus_name synthetic[255];
+  struct packet *full, *pkt;
+  int i, count;
+  static const int synthetic_sizes[] = { 1, 16, 64, 255 };
+  static const struct
+  {
+    const char *label;
+    unsigned int size;
+  } cuts[] = {
+          { "truncated-header", 20 },
+          { "truncated-names", NBNAME_RESPONSE_HEADER_SIZE + 30 },
+          { "truncated-footer", NBNAME_RESPONSE_HEADER_SIZE + 4 * 18 + 10 } };
+
+  build_response ( new_packet (),
+                   "workstation",
+                   workstation,
+                   COUNT ( workstation ),
+                   mac );
+  build_response (
+          new_packet (), "controller", controller, COUNT ( controller ), mac );
+  build_response ( new_packet (), "samba", samba, COUNT ( samba ), zero_mac );
+  build_response ( new_packet (), "printer", printer, COUNT ( printer ), mac );
+
+  full = &corpus[0];
+  for ( i = 0; i < ( int ) COUNT ( cuts ); i++ )
+    {
+      pkt = new_packet ();
+      *pkt = *full;
+      snprintf ( pkt->name, sizeof pkt->name, "%s", cuts[i].label );
+      pkt->size = cuts[i].size;
+    }
+
+  for ( i = 0; i < 255; i++ )
+    {
+      synthetic[i].name = i % 2 ? "SYNTHETIC" : "SYNTHETIC-GROUP";
+      synthetic[i].service = i;
+      synthetic[i].group = i % 2;
+    }
+  for ( i = 0; i < ( int ) COUNT ( synthetic_sizes ); i++ )
+    {
+      char label[32];
+
+      count = synthetic_sizes[i];
+      snprintf ( label, sizeof label, "synthetic-%d", count );
+      build_response ( new_packet (), label, synthetic, count, mac );
+    }
+}
+
+/* Add the node status responses of a pcap file, as many as fit */
+static void
+load_corpus_pcap ( struct pcap_reader *reader, const char *base )
+{
+  struct sockaddr_in src, dst;
+  struct timeval ts;
+  const unsigned char *data;
+  struct packet *pkt;
+  int size, n = 0;
+
+  while ( ( size = pcap_next_udp ( reader, &src, &dst, &data, &ts ) ) > 0 )
+    {
+      if ( size < 4 || !( ( data[2] << 8 ) & FL_REQUEST ) ||
+           ( size >= NBNAME_REQUEST_SIZE &&
+             ( ( data[46] << 8 ) | data[47] ) == QT_NAME_QUERY ) )
+        continue;
+      if ( corpus_size == MAX_CORPUS )
+        {
+          fprintf ( stderr, "Corpus full, rest of %s left out\n", base );
+          break;
+        }
+      pkt = new_packet ();
+      snprintf ( pkt->name, sizeof pkt->name, "pcap:%s#%d", base, ++n );
+      pkt->size =
+              size < ( int ) sizeof pkt->data ? size : ( int ) sizeof pkt->data;
+      memcpy ( pkt->data, data, pkt->size );
+    }
+  pcap_close ( reader );
+}
+
+/* Add raw datagrams, one per file, e.g. responses saved from a capture,
+   or the responses recorded in pcap files */
+static void
+load_corpus_file ( const char *filename )
+{
+  struct pcap_reader *reader;
+  struct packet *pkt;
+  const char *base;
+  FILE *f;
+
+  base = strrchr ( filename, '/' ) ? strrchr ( filename, '/' ) + 1 : filename;
+  if ( ( reader = pcap_open ( filename ) ) )
+    {
+      load_corpus_pcap ( reader, base );
+      return;
+    }
+  if ( !( f = fopen ( filename, "rb" ) ) )
+    {
+      perror ( filename );
+      exit ( 1 );
+    }
+  pkt = new_packet ();
+  snprintf ( pkt->name, sizeof pkt->name, "file:%s", base );
+  pkt->size = fread ( pkt->data, 1, sizeof pkt->data, f );
+  fclose ( f );
+}
+
+/* Benchmarks */
+/**************/
+
+static void
+free_hostinfo ( struct nb_host_info *hostinfo )
+{
+  free ( hostinfo->header );
+  free ( hostinfo->footer );
+  free ( hostinfo->names );
+  free ( hostinfo );
+}
+
+static void
+bench_parse ( void *arg )
+{
+  struct packet *pkt = arg;
+  struct nb_host_info *hostinfo;
+
+  if ( ( hostinfo = parse_response ( ( char * ) pkt->data, pkt->size ) ) )
+    free_hostinfo ( hostinfo );
+}
+
+/* What --fields ip,name,mac parses */
+static void
+bench_parse_projected ( void *arg )
+{
+  struct packet *pkt = arg;
+  struct nb_host_info *hostinfo;
+
+  if ( ( hostinfo = parse_response_parts ( ( char * ) pkt->data,
+                                           pkt->size,
+                                           NB_PARSE_NAMES | NB_PARSE_MAC ) ) )
+    free_hostinfo ( hostinfo );
+}
+
+static void
+bench_mangle_wildcard ( void *arg )
+{
+  char out[40];
+
+  ( void ) arg;
+  name_mangle ( "*", out, 0 );
+}
+
+static void
+bench_mangle_name ( void *arg )
+{
+  char out[40];
+
+  ( void ) arg;
+  name_mangle ( "DESKTOP-4TQ2K1", out, 0x20 );
+}
+
+struct list_bench
+{
+  unsigned long *addrs; /* size elements to insert, then size to look up */
+  int size;
+  struct list *list;
+};
+
+static void
+bench_list_insert ( void *arg )
+{
+  struct list_bench *lb = arg;
+  struct list *list;
+  int i;
+
+  list = new_list ();
+  for ( i = 0; i < lb->size; i++ )
+    insert ( list, lb->addrs[i] );
+  delete_list ( list );
+}
+
+static void
+bench_list_lookup ( void *arg )
+{
+  struct list_bench *lb = arg;
+  int i;
+
+  for ( i = 0; i < lb->size; i++ )
+    in_list ( lb->list, lb->addrs[lb->size + i] );
+}
+
+static void
+run_list_benchmarks ( int size )
+{
+  struct list_bench lb;
+  char name[64];
+  int i;
+
+  lb.size = size;
+  if ( !( lb.addrs = malloc ( 2 * size * sizeof ( unsigned long ) ) ) )
+    {
+      perror ( "Malloc failed" );
+      exit ( 1 );
+    }
+  /* Addresses from a /16 in random order; the lookups hit half of the
+     time */
+  srandom ( size );
+  for ( i = 0; i < size; i++ )
+    lb.addrs[i] = 0x0a000000 + ( random () & 0xffff );
+  for ( i = 0; i < size; i++ )
+    lb.addrs[size + i] =
+            i % 2 ? lb.addrs[random () % size]
+                  : 0x0a000000 + ( unsigned long ) ( random () & 0xffff );
+
+  snprintf ( name, sizeof name, "insert/%d", size );
+  run ( name, bench_list_insert, &lb, size );
+
+  lb.list = new_list ();
+  for ( i = 0; i < size; i++ )
+    insert ( lb.list, lb.addrs[i] );
+  snprintf ( name, sizeof name, "in_list/%d", size );
+  run ( name, bench_list_lookup, &lb, size );
+
+  delete_list ( lb.list );
+  free ( lb.addrs );
+}
+
+static void
+bench_service_known ( void *arg )
+{
+  ( void ) arg;
+  getnbservicename ( 0x20, 1, "DESKTOP-4TQ2K1" );
+}
+
+static void
+bench_service_unknown ( void *arg )
+{
+  ( void ) arg;
+  getnbservicename ( 0x7f, 1, "DESKTOP-4TQ2K1" );
+}
+
+static struct in_addr print_addr;
+
+static void
+bench_print ( void *arg )
+{
+  print_hostinfo ( stdout, print_addr, arg, NULL, -1 );
+}
+
+static void
+bench_print_sf ( void *arg )
+{
+  print_hostinfo ( stdout, print_addr, arg, ":", -1 );
+}
+
+static struct field_plan print_fields;
+
+static void
+bench_f_print ( void *arg )
+{
+  f_print_hostinfo (
+          stdout, print_addr, arg, &print_fields, ":", -1, NULL );
+}
+
+static void
+bench_v_print ( void *arg )
+{
+  v_print_hostinfo ( stdout, print_addr, arg, NULL, 0 );
+}
+
+static void
+bench_v_print_hr ( void *arg )
+{
+  v_print_hostinfo ( stdout, print_addr, arg, NULL, 1 );
+}
+
+static void
+bench_d_print ( void *arg )
+{
+  d_print_hostinfo ( stdout, print_addr, arg, 0.0005 );
+}
+
+static void
+bench_l_print ( void *arg )
+{
+  l_print_hostinfo ( stdout, print_addr, arg, 1 );
+}
+
+static void
+usage ( void )
+{
+  puts ( "Usage:\nmicrobench [-t milliseconds] [-f filter] [datagram...]\n"
+         "\t-t milliseconds\tMinimum run time of each benchmark.\n"
+         "\t\t\tDefault 200.\n"
+         "\t-f filter\tRun only benchmarks whose name contains filter.\n"
+         "\tdatagram\tFile holding one raw response, or a pcap file of\n"
+         "\t\t\tresponses, added to the parse_response corpus." );
+  exit ( 2 );
+}
+
+int
+main ( int argc, char *argv[] )
+{
+  struct nb_host_info *hostinfo;
+  char name[96];
+  int ch, i;
+
+  while ( ( ch = getopt ( argc, argv, "t:f:" ) ) != -1 )
+    switch ( ch )
+      {
+        case 't':
+          min_time_ns = atol ( optarg ) * 1000000L;
+          if ( min_time_ns <= 0 )
+            usage ();
+          break;
+        case 'f':
+          filter = optarg;
+          break;
+        default:
+          usage ();
+      }
+
+  build_corpus ();
+  for ( i = optind; i < argc; i++ )
+    load_corpus_file ( argv[i] );
+
+  /* Results go to the original stdout, formatter output to /dev/null */
+  if ( !( report = fdopen ( dup ( STDOUT_FILENO ), "w" ) ) ||
+       !freopen ( "/dev/null", "w", stdout ) )
+    {
+      perror ( "Cannot redirect output" );
+      exit ( 1 );
+    }
+  setvbuf ( report, NULL, _IOLBF, 0 );
+
+  fprintf ( report,
+            "%-40s%12s%12s%12s\n",
+            "benchmark",
+            "ns/op",
+            "allocs/op",
+            "ops" );
+
+  for ( i = 0; i < corpus_size; i++ )
+    {
+      snprintf ( name, sizeof name, "parse_response/%.63s", corpus[i].name );
+      run ( name, bench_parse, &corpus[i], 1 );
+    }
+  for ( i = 0; i < corpus_size; i++ )
+    {
+      snprintf ( name,
+                 sizeof name,
+                 "parse_response_parts/%.63s",
+                 corpus[i].name );
+      run ( name, bench_parse_projected, &corpus[i], 1 );
+    }
+
+  run ( "name_mangle/wildcard", bench_mangle_wildcard, NULL, 1 );
+  run ( "name_mangle/name", bench_mangle_name, NULL, 1 );
+
+  run_list_benchmarks ( 100 );
+  run_list_benchmarks ( 1000 );
+  run_list_benchmarks ( 10000 );
+
+  run ( "getnbservicename/known", bench_service_known, NULL, 1 );
+  run ( "getnbservicename/unknown", bench_service_unknown, NULL, 1 );
+
+  inet_aton ( "192.168.1.23", &print_addr );
+  hostinfo = parse_response ( ( char * ) corpus[1].data, corpus[1].size );
+  run ( "print_hostinfo", bench_print, hostinfo, 1 );
+  run ( "print_hostinfo/script", bench_print_sf, hostinfo, 1 );
+  compile_fields ( "ip,name,mac", &print_fields );
+  run ( "f_print_hostinfo/ip,name,mac", bench_f_print, hostinfo, 1 );
+  run ( "v_print_hostinfo", bench_v_print, hostinfo, 1 );
+  run ( "v_print_hostinfo/human", bench_v_print_hr, hostinfo, 1 );
+  run ( "d_print_hostinfo", bench_d_print, hostinfo, 1 );
+  run ( "l_print_hostinfo", bench_l_print, hostinfo, 1 );
+  free_hostinfo ( hostinfo );
+
+  return 0;
+}
@@ -20,25 +20,91 @@
 */
 
 #include <sys/types.h>
-#include <sys/socket.h>
 #include <netinet/in.h>
-#include <arpa/inet.h>
+#include <stdio.h>
 #include <stdlib.h>
-#include <sys/time.h>
 #include <string.h>
 #include <unistd.h>
 #include <getopt.h>
+#include <ctype.h>
+#include <errno.h>
+#include <sys/time.h>
 #if HAVE_STDINT_H
 #include <stdint.h>
 #endif
+#include "nbtscan.h"
 #include "statusq.h"
-#include "range.h"
-#include "list.h"
+#include "output.h"
+#include "filter.h"
+#include "resolve.h"
+#include "zfile.h"
 #include "errors.h"
+#include "daemon.h"
 #include "time.h"
 
 int quiet = 0;
 
+/* Options that have no short form */
+enum
+{
+  OPT_DAEMON = 256,
+  OPT_INTERVAL,
+  OPT_PASSIVE,
+  OPT_CAPTURE,
+  OPT_DISCOVER,
+  OPT_ARP,
+  OPT_SAMPLE,
+  OPT_SAMPLE_COUNT,
+  OPT_PRUNE,
+  OPT_PRUNE_BLOCK,
+  OPT_STATELESS,
+  OPT_PCAP_OUT,
+  OPT_REPLAY,
+  OPT_EXCLUDE,
+  OPT_EXCLUDE_FILE,
+  OPT_FAIR,
+  OPT_FAIR_PREFIX,
+  OPT_PREFIX_RATE,
+  OPT_SORTED,
+  OPT_FIELDS,
+  OPT_WHERE,
+  OPT_OUI,
+  OPT_RESOLVE,
+  OPT_DNS_SERVER,
+  OPT_DNS_CACHE,
+  OPT_OUTPUT
+};
+
+static const struct option long_options[] = {
+  { "daemon", required_argument, NULL, OPT_DAEMON },
+  { "interval", required_argument, NULL, OPT_INTERVAL },
+  { "passive", required_argument, NULL, OPT_PASSIVE },
+  { "capture", required_argument, NULL, OPT_CAPTURE },
+  { "discover", no_argument, NULL, OPT_DISCOVER },
+  { "arp", no_argument, NULL, OPT_ARP },
+  { "sample", required_argument, NULL, OPT_SAMPLE },
+  { "sample-count", required_argument, NULL, OPT_SAMPLE_COUNT },
+  { "prune", required_argument, NULL, OPT_PRUNE },
+  { "prune-block", required_argument, NULL, OPT_PRUNE_BLOCK },
+  { "stateless", no_argument, NULL, OPT_STATELESS },
+  { "pcap-out", required_argument, NULL, OPT_PCAP_OUT },
+  { "replay", required_argument, NULL, OPT_REPLAY },
+  { "exclude", required_argument, NULL, OPT_EXCLUDE },
+  { "exclude-file", required_argument, NULL, OPT_EXCLUDE_FILE },
+  { "fair", no_argument, NULL, OPT_FAIR },
+  { "fair-prefix", required_argument, NULL, OPT_FAIR_PREFIX },
+  { "prefix-rate", required_argument, NULL, OPT_PREFIX_RATE },
+  { "sorted", no_argument, NULL, OPT_SORTED },
+  { "fields", required_argument, NULL, OPT_FIELDS },
+  { "where", required_argument, NULL, OPT_WHERE },
+  { "oui", required_argument, NULL, OPT_OUI },
+  { "resolve", no_argument, NULL, OPT_RESOLVE },
+  { "dns-server", required_argument, NULL, OPT_DNS_SERVER },
+  { "dns-cache", required_argument, NULL, OPT_DNS_CACHE },
+  { "output", required_argument, NULL, OPT_OUTPUT },
+  { NULL, 0, NULL, 0 }
+};
+
 static void
 print_banner ( void )
 {
@@ -53,8 +119,24 @@ static void
 usage ( void )
 {
   puts ( "Usage:\nnbtscan [-v] [-d] [-e] [-l] [-t timeout] [-b bandwidth] "
-         "[-r] [-q] [-s separator] [-m retransmits] (-f "
-         "filename)|(<scan_range>) \n"
+         "[-r] [-q] [-s separator] [-m retransmits] [-T]\n"
+         "        [--arp] [--discover] [--passive seconds [--capture "
+         "interface]]\n"
+         "        [--sample fraction | --sample-count count]\n"
+         "        [--prune probes [--prune-block bits]] [--stateless]\n"
+         "        [--pcap-out file] [--exclude range] [--exclude-file file]\n"
+         "        [--fair] [--fair-prefix bits] [--prefix-rate rate]\n"
+         "        [--sorted] [--fields list] [--where expression]\n"
+         "        [--oui file] [--resolve [--dns-server address] "
+         "[--dns-cache file]]\n"
+         "        [--output file]\n"
+         "        (-f filename)|(<scan_range>) \n"
+         "nbtscan [-v] [-d] [-e] [-l] [-q] [-s separator] [-h] [-T] "
+         "[--fields list]\n"
+         "        [--where expression] [--output file] --replay file\n"
+         "nbtscan --daemon socket [--interval seconds] [-t timeout] "
+         "[-b bandwidth]\n"
+         "        [-m retransmits] [-q] [-s separator] [<scan_range>...]\n"
          "\t-v\t\tverbose output. Print all names received\n"
          "\t\t\tfrom each host\n"
          "\t-d\t\tdump packets. Print whole packet contents.\n"
@@ -77,8 +159,86 @@ usage ( void )
          "\t-h\t\tPrint human-readable names for services.\n"
          "\t\t\tCan only be used with -v option.\n"
          "\t-m retransmits\tNumber of retransmits. Default 0.\n"
+         "\t-T\t\tPrint round trip time of each response.\n"
+         "\t\t\tCannot be used with -v, -e or -l options.\n"
+         "\t--arp\t\tSweep directly attached subnets in <scan_range>\n"
+         "\t\t\twith ARP first and only query the hosts that\n"
+         "\t\t\tanswer it there. Needs root.\n"
+         "\t--discover\tBroadcast a name query on each local subnet\n"
+         "\t\t\tin <scan_range> first and only query the hosts\n"
+         "\t\t\tthat answer it there.\n"
+         "\t--sample fraction\n"
+         "\t\t\tQuery only this fraction of the addresses, picked\n"
+         "\t\t\tat random, and estimate the responding hosts of\n"
+         "\t\t\teach /16 from them.\n"
+         "\t--sample-count count\n"
+         "\t\t\tLike --sample, but query count addresses.\n"
+         "\t--prune probes\tQuery probes addresses of each /24 first and\n"
+         "\t\t\tskip the blocks where none answered or refused.\n"
+         "\t--prune-block bits\n"
+         "\t\t\tWith --prune, use blocks of prefix length bits.\n"
+         "\t\t\tDefault 24.\n"
+         "\t--stateless\tKeep nothing per query. Answers are checked\n"
+         "\t\t\tagainst a keyed hash of their address instead.\n"
+         "\t\t\tCannot be used with -T.\n"
+         "\t--exclude range\tNever query the addresses of range, given\n"
+         "\t\t\tlike <scan_range>. May be repeated.\n"
+         "\t--exclude-file file\n"
+         "\t\t\tNever query the ranges listed in file, one per\n"
+         "\t\t\tline. Text after # is ignored.\n"
+         "\t--fair\t\tQuery the ranges one address from each /24 in\n"
+         "\t\t\tturn instead of in order.\n"
+         "\t--fair-prefix bits\n"
+         "\t\t\tWith --fair or --prefix-rate, use prefixes of\n"
+         "\t\t\tlength bits. Default 24.\n"
+         "\t--prefix-rate rate\n"
+         "\t\t\tSend no more than rate queries per second into\n"
+         "\t\t\tany one /24.\n"
+         "\t--sorted\tPrint the hosts in ascending address order.\n"
+         "\t--fields list\tPrint only these columns, separated by commas:\n"
+         "\t\t\tip, name, server, user, mac, rtt, vendor and dns.\n"
+         "\t\t\tCannot be used with -v, -d, -e, -l, -h or -T.\n"
+         "\t--where expression\n"
+         "\t\t\tPrint only the hosts that satisfy expression,\n"
+         "\t\t\tsuch as 'service==0x20 && unique' or\n"
+         "\t\t\t'name~^SRV-'. See the manual page.\n"
+         "\t--oui file\tAdd the vendor of each MAC address from file, a\n"
+         "\t\t\ttable made by nbtscan-oui. Cannot be used with\n"
+         "\t\t\t-v, -d, -e or -l.\n"
+         "\t--resolve\tAdd the DNS name of each host, looked up while\n"
+         "\t\t\tthe scan goes on. Cannot be used with -v, -d, -e\n"
+         "\t\t\tor -l.\n"
+         "\t--dns-server address\n"
+         "\t\t\tWith --resolve, ask the name server at address,\n"
+         "\t\t\twith an optional :port, instead of the ones in\n"
+         "\t\t\t/etc/resolv.conf.\n"
+         "\t--dns-cache file\n"
+         "\t\t\tWith --resolve, keep the names looked up in file\n"
+         "\t\t\tfor as long as their TTL, for later scans.\n"
+         "\t--output file\tWrite the results to file instead of stdout,\n"
+         "\t\t\tcompressed with gzip if its name ends in .gz or\n"
+         "\t\t\twith zstd if it ends in .zst.\n"
+         "\t--pcap-out file\tRecord the queries sent and the answers\n"
+         "\t\t\treceived to file, in pcap format.\n"
+         "\t--replay file\tPrint the answers recorded in the pcap file\n"
+         "\t\t\tfile instead of scanning.\n"
+         "\t--passive seconds\n"
+         "\t\t\tListen to NetBIOS name service traffic for seconds\n"
+         "\t\t\tseconds first and print the hosts heard of.\n"
+         "\t\t\tThey are not queried again. The scan range may be\n"
+         "\t\t\tleft out to only listen. Needs root.\n"
+         "\t--capture interface\n"
+         "\t\t\tWith --passive, capture all name service traffic\n"
+         "\t\t\ton interface instead of listening on port 137.\n"
+         "\t--daemon socket\tRun as a daemon taking scan jobs on the Unix\n"
+         "\t\t\tdomain socket socket. Results stream to\n"
+         "\t\t\tsubscribed clients. See the manual page.\n"
+         "\t--interval seconds\n"
+         "\t\t\tWith --daemon, rescan the <scan_range> arguments\n"
+         "\t\t\tevery seconds seconds. Default 300.\n"
          "\t-f filename\tTake IP addresses to scan from file filename.\n"
          "\t\t\t-f - makes nbtscan take IP addresses from stdin.\n"
+         "\t\t\tRepeated addresses are queried once.\n"
          "\t<scan_range>\twhat to scan. Can either be single IP\n"
          "\t\t\tlike 192.168.1.1 or\n"
          "\t\t\trange of addresses in one of two forms: \n"
@@ -102,354 +262,515 @@ usage ( void )
   exit ( 2 );
 }
 
-static int
-set_range ( char *range_str, struct ip_range *range_struct )
-{
-  if ( is_ip ( range_str, range_struct ) )
-    return 1;
-  if ( is_range1 ( range_str, range_struct ) )
-    return 1;
-  if ( is_range2 ( range_str, range_struct ) )
-    return 1;
-  return 0;
-}
-
+/* The library ran out of memory, there is no going on */
 static void
-print_header ( void )
+out_of_memory ( void )
 {
-  printf ( "%-17s%-17s%-10s%-17s%-17s\n",
-           "IP address",
-           "NetBIOS Name",
-           "Server",
-           "User",
-           "MAC address" );
-  puts ( "-------------------------------------------------------------------"
-         "-----------" );
+  err_print ( "Malloc failed", quiet );
+  exit ( 1 );
 }
 
-#define DUP( code ) code, code
+struct held_host;
+
+/* How results are printed, from the command line options */
+struct output_format
+{
+  FILE *out;                       /* stdout, or the --output file */
+  const char *out_path;
+  int verbose;
+  int dump;
+  int etc_hosts;
+  int lmhosts;
+  int hr;
+  int show_rtt;
+  char *sf;
+  const struct field_plan *fields; /* --fields, or NULL */
+  const struct filter *where;      /* --where, or NULL */
+  struct resolver *resolver;       /* --resolve, or NULL */
+  int sorted;                      /* print held hosts in the order they
+                                      came in, not as they are resolved */
+  struct held_host *held_first;    /* hosts waiting for their DNS name */
+  struct held_host *held_last;
+};
+
+/* A result held until the name of its host is looked up */
+struct held_host
+{
+  struct held_host *next;
+  struct output_format *format;
+  struct in_addr addr;
+  struct nb_host_info *hostinfo; /* a copy, the original is gone */
+  double rtt;
+  char *dns_name;
+  int resolved;
+};
 
 static void
-print_nb_host_info_header ( const nbname_response_header_t *header )
+print_host ( const struct output_format *format,
+             struct in_addr addr,
+             const struct nb_host_info *hostinfo,
+             double rtt,
+             const char *dns_name )
 {
-  printf ( "Transaction ID: 0x%04x (%d)\n", DUP ( header->transaction_id ) );
-  printf ( "Flags: 0x%04x (%d)\n", DUP ( header->flags ) );
-  printf ( "Question count: 0x%04x (%d)\n", DUP ( header->question_count ) );
-  printf ( "Answer count: 0x%04x (%d)\n", DUP ( header->answer_count ) );
-  printf ( "Name service count: 0x%04x (%d)\n",
-           DUP ( header->name_service_count ) );
-  printf ( "Additional record count: 0x%04x (%d)\n",
-           DUP ( header->additional_record_count ) );
-  printf ( "Question name: %s\n", header->question_name );
-  printf ( "Question type: 0x%04x (%d)\n", DUP ( header->question_type ) );
-  printf ( "Question class: 0x%04x (%d)\n", DUP ( header->question_class ) );
-  printf ( "Time to live: 0x%08x (%d)\n", DUP ( header->ttl ) );
-  printf ( "Rdata length: 0x%04x (%d)\n", DUP ( header->rdata_length ) );
-  printf ( "Number of names: 0x%02x (%d)\n", DUP ( header->number_of_names ) );
+  if ( format->fields )
+    f_print_hostinfo ( format->out,
+                       addr,
+                       hostinfo,
+                       format->fields,
+                       format->sf,
+                       rtt,
+                       dns_name );
+  else if ( format->verbose )
+    v_print_hostinfo ( format->out, addr, hostinfo, format->sf, format->hr );
+  else if ( format->dump )
+    d_print_hostinfo ( format->out, addr, hostinfo, rtt );
+  else if ( format->etc_hosts )
+    l_print_hostinfo ( format->out, addr, hostinfo, 0 );
+  else if ( format->lmhosts )
+    l_print_hostinfo ( format->out, addr, hostinfo, 1 );
+  else
+    print_hostinfo ( format->out,
+                     addr,
+                     hostinfo,
+                     format->sf,
+                     format->show_rtt ? rtt : -1 );
 }
 
-static void
-print_nb_host_info_footer ( const nbname_response_footer_t *footer )
+static void *
+copy_bytes ( const void *data, size_t size )
 {
-  printf ( "Adapter address: %02x:%02x:%02x:%02x:%02x:%02x\n",
-           footer->adapter_address[0],
-           footer->adapter_address[1],
-           footer->adapter_address[2],
-           footer->adapter_address[3],
-           footer->adapter_address[4],
-           footer->adapter_address[5] );
+  void *copy;
 
-  printf ( "Version major: 0x%02x (%d)\n", DUP ( footer->version_major ) );
-  printf ( "Version minor: 0x%02x (%d)\n", DUP ( footer->version_minor ) );
-  printf ( "Duration: 0x%04x (%d)\n", DUP ( footer->duration ) );
-  printf ( "FRMRs Received: 0x%04x (%d)\n", DUP ( footer->frmps_received ) );
+  if ( ( copy = malloc ( size ) ) == NULL )
+    err_die ( "Malloc failed", quiet );
+  memcpy ( copy, data, size );
+  return copy;
+}
 
-  printf ( "FRMRs Transmitted: 0x%04x (%d)\n",
-           DUP ( footer->frmps_transmitted ) );
+static struct nb_host_info *
+copy_hostinfo ( const struct nb_host_info *hostinfo )
+{
+  struct nb_host_info *copy;
 
-  printf ( "IFrame Receive errors: 0x%04x (%d)\n",
-           DUP ( footer->iframe_receive_errors ) );
+  copy = copy_bytes ( hostinfo, sizeof ( struct nb_host_info ) );
+  if ( hostinfo->header )
+    copy->header = copy_bytes ( hostinfo->header,
+                                sizeof ( nbname_response_header_t ) );
+  if ( hostinfo->names )
+    copy->names = copy_bytes ( hostinfo->names,
+                               hostinfo->header->number_of_names *
+                                       sizeof ( struct nbname ) );
+  if ( hostinfo->footer )
+    copy->footer = copy_bytes ( hostinfo->footer,
+                                sizeof ( nbname_response_footer_t ) );
+  return copy;
+}
 
-  printf ( "Transmit aborts: 0x%04x (%d)\n", DUP ( footer->transmit_aborts ) );
-  printf ( "Transmitted: 0x%08x (%d)\n", DUP ( footer->transmitted ) );
-  printf ( "Received: 0x%08x (%d)\n", DUP ( footer->received ) );
+static void
+free_hostinfo ( struct nb_host_info *hostinfo )
+{
+  free ( hostinfo->header );
+  free ( hostinfo->footer );
+  free ( hostinfo->names );
+  free ( hostinfo );
+}
 
-  printf ( "IFrame transmit errors: 0x%04x (%d)\n",
-           DUP ( footer->iframe_transmit_errors ) );
+/* Print the held hosts that have their name: all of them, or with
+   --sorted only those ahead of the first that is still looked up */
+static void
+flush_held ( struct output_format *format )
+{
+  struct held_host *held, *prev = NULL, *next;
 
-  printf ( "No receive buffers: 0x%04x (%d)\n",
-           DUP ( footer->no_receive_buffer ) );
+  for ( held = format->held_first; held; held = next )
+    {
+      next = held->next;
+      if ( !held->resolved )
+        {
+          if ( format->sorted )
+            break;
+          prev = held;
+          continue;
+        }
+      if ( prev )
+        prev->next = next;
+      else
+        format->held_first = next;
+      if ( format->held_last == held )
+        format->held_last = prev;
+      print_host ( format,
+                   held->addr,
+                   held->hostinfo,
+                   held->rtt,
+                   held->dns_name );
+      free_hostinfo ( held->hostinfo );
+      free ( held->dns_name );
+      free ( held );
+    }
+}
 
-  printf ( "tl timeouts: 0x%04x (%d)\n", DUP ( footer->tl_timeouts ) );
-  printf ( "ti timeouts: 0x%04x (%d)\n", DUP ( footer->ti_timeouts ) );
-  printf ( "Free NCBS: 0x%04x (%d)\n", DUP ( footer->free_ncbs ) );
-  printf ( "NCBS: 0x%04x (%d)\n", DUP ( footer->ncbs ) );
-  printf ( "Max NCBS: 0x%04x (%d)\n", DUP ( footer->max_ncbs ) );
+static void
+host_resolved ( struct in_addr addr, const char *name, void *arg )
+{
+  struct held_host *held = arg;
 
-  printf ( "No transmit buffers: 0x%04x (%d)\n",
-           DUP ( footer->no_transmit_buffers ) );
+  ( void ) addr;
+  held->resolved = 1;
+  if ( name && ( held->dns_name = strdup ( name ) ) == NULL )
+    err_die ( "Malloc failed", quiet );
+  flush_held ( held->format );
+}
 
-  printf ( "Max datagram: 0x%04x (%d)\n", DUP ( footer->max_datagram ) );
+static void
+print_result ( struct in_addr addr,
+               const struct nb_host_info *hostinfo,
+               double rtt,
+               void *arg )
+{
+  struct output_format *format = arg;
+  struct held_host *held;
 
-  printf ( "Pending sessions: 0x%04x (%d)\n",
-           DUP ( footer->pending_sessions ) );
+  if ( format->where && !filter_match ( format->where, addr, hostinfo ) )
+    return;
+  if ( !format->resolver )
+    {
+      print_host ( format, addr, hostinfo, rtt, NULL );
+      return;
+    }
 
-  printf ( "Max sessions: 0x%04x (%d)\n", DUP ( footer->max_sessions ) );
-  printf ( "Packet sessions: 0x%04x (%d)\n", DUP ( footer->packet_sessions ) );
+  /* Hold on to it until its name is known, the scan goes on meanwhile */
+  if ( ( held = calloc ( 1, sizeof ( struct held_host ) ) ) == NULL )
+    err_die ( "Malloc failed", quiet );
+  held->format = format;
+  held->addr = addr;
+  held->hostinfo = copy_hostinfo ( hostinfo );
+  held->rtt = rtt;
+  if ( format->held_last )
+    format->held_last->next = held;
+  else
+    format->held_first = held;
+  format->held_last = held;
+  resolve_addr ( format->resolver, addr, host_resolved, held );
 }
 
+/* run_scan drives the scan, if there is one, and the DNS lookups of the
+   hosts that answer together, until both are over */
 static void
-d_print_hostinfo ( struct in_addr addr, const struct nb_host_info *hostinfo )
+run_scan ( struct nbt_scan *scan, struct output_format *format )
 {
-  int i;
-  unsigned char service; /* 16th byte of NetBIOS name */
-  char name[16];
-
-  printf ( "\nPacket dump for Host %s:\n\n", inet_ntoa ( addr ) );
-  if ( hostinfo->is_broken )
-    printf ( "Incomplete packet, %d bytes long.\n", hostinfo->is_broken );
+  struct timeval tv, scan_tv;
+  int scanning = scan != NULL, maxfd;
+  fd_set fdsr;
 
-  if ( hostinfo->header )
-    print_nb_host_info_header ( hostinfo->header );
+  if ( !format->resolver )
+    {
+      if ( scan && nbt_scan_run ( scan ) < 0 && errno == ENOMEM )
+        out_of_memory ();
+      return;
+    }
 
-  if ( hostinfo->names )
+  for ( ;; )
     {
-      printf ( "Names received:\n" );
-      for ( i = 0; i < hostinfo->header->number_of_names; i++ )
+      if ( scanning && ( scanning = nbt_scan_step ( scan ) ) < 0 )
+        out_of_memory ();
+      resolver_step ( format->resolver );
+      if ( !scanning && !resolver_pending ( format->resolver ) )
+        break;
+
+      resolver_timeout ( format->resolver, &tv );
+      FD_ZERO ( &fdsr );
+      maxfd = resolver_fd ( format->resolver );
+      FD_SET ( maxfd, &fdsr );
+      if ( scanning )
         {
-          service = hostinfo->names[i].ascii_name[15];
-          strncpy ( name, hostinfo->names[i].ascii_name, 15 );
-          name[15] = 0;
-          printf ( "%-17s Service: 0x%02x Flags: 0x%04x\n",
-                   name,
-                   service,
-                   hostinfo->names[i].rr_flags );
+          nbt_scan_timeout ( scan, &scan_tv );
+          if ( timercmp ( &scan_tv, &tv, < ) )
+            tv = scan_tv;
+          FD_SET ( nbt_scan_fd ( scan ), &fdsr );
+          if ( nbt_scan_fd ( scan ) > maxfd )
+            maxfd = nbt_scan_fd ( scan );
+        }
+      if ( !timerisset ( &tv ) )
+        continue;
+      if ( select ( maxfd + 1, &fdsr, NULL, NULL, &tv ) < 0 &&
+           errno != EINTR )
+        {
+          err_print ( "Select failed", quiet );
+          break;
         }
     }
+}
 
-  if ( hostinfo->footer )
-    print_nb_host_info_footer ( hostinfo->footer );
+static void
+print_column_header ( const struct output_format *format )
+{
+  if ( format->fields )
+    print_fields_header ( format->out, format->fields );
+  else
+    print_header ( format->out, format->show_rtt );
 }
 
-static int
-v_print_hostinfo ( struct in_addr addr,
-                   const struct nb_host_info *hostinfo,
-                   char *sf,
-                   int hr )
+/* Hosts heard of passively are printed like scan results */
+struct passive_result
 {
-  int i, unique;
-  my_uint8_t service; /* 16th byte of NetBIOS name */
-  char name[16];
+  struct output_format *format;
+  struct nbt_scan *scan; /* hosts not to query again, or NULL */
+};
 
-  if ( !sf )
-    {
-      printf ( "\nNetBIOS Name Table for Host %s:\n\n", inet_ntoa ( addr ) );
-      if ( hostinfo->is_broken )
-        printf ( "Incomplete packet, %d bytes long.\n", hostinfo->is_broken );
+static void
+print_passive ( struct in_addr addr,
+                const struct nb_host_info *hostinfo,
+                double rtt,
+                void *arg )
+{
+  struct passive_result *result = arg;
+
+  print_result ( addr, hostinfo, rtt, result->format );
+  if ( result->scan && nbt_scan_skip ( result->scan, addr ) < 0 )
+    out_of_memory ();
+}
+
+/* Listen to name service traffic for seconds seconds, then print the hosts
+   heard of */
+static void
+run_passive ( const char *ifname,
+              int share137,
+              int seconds,
+              struct output_format *format,
+              struct nbt_scan *scan )
+{
+  struct nbt_passive *passive;
+  struct passive_result result;
+  struct timeval now, end, tv;
+  fd_set fdsr;
 
-      printf ( "%-17s%-17s%-17s\n", "Name", "Service", "Type" );
-      printf ( "----------------------------------------\n" );
+  passive = nbt_passive_new ( ifname, share137 );
+  if ( !passive )
+    {
+      err_print ( ifname ? "Cannot capture from interface"
+                         : "Cannot listen on port 137",
+                  quiet );
+      exit ( 1 );
     }
-  if ( hostinfo->header && hostinfo->names )
+
+  gettimeofday ( &end, NULL );
+  end.tv_sec += seconds;
+  for ( ;; )
     {
-      for ( i = 0; i < hostinfo->header->number_of_names; i++ )
+      gettimeofday ( &now, NULL );
+      if ( !timercmp ( &now, &end, < ) )
+        break;
+      timersub ( &end, &now, &tv );
+      FD_ZERO ( &fdsr );
+      FD_SET ( nbt_passive_fd ( passive ), &fdsr );
+      if ( select ( nbt_passive_fd ( passive ) + 1, &fdsr, NULL, NULL, &tv ) <
+                   0 &&
+           errno != EINTR )
         {
-          service = hostinfo->names[i].ascii_name[15];
-          strncpy ( name, hostinfo->names[i].ascii_name, 15 );
-          name[15] = 0;
-          unique = !( hostinfo->names[i].rr_flags & 0x0080 );
-          if ( sf )
-            {
-              printf ( "%s%s%s%s", inet_ntoa ( addr ), sf, name, sf );
-              if ( hr )
-                printf ( "%s\n", getnbservicename ( service, unique, name ) );
-              else
-                {
-                  printf ( "%02x", service );
-                  if ( unique )
-                    printf ( "U\n" );
-                  else
-                    printf ( "G\n" );
-                }
-            }
-          else
-            {
-              printf ( "%-17s", name );
-              if ( hr )
-                printf ( "%s\n", getnbservicename ( service, unique, name ) );
-              else
-                {
-                  printf ( "<%02x>", service );
-                  if ( unique )
-                    printf ( "             UNIQUE\n" );
-                  else
-                    printf ( "              GROUP\n" );
-                }
-            }
+          err_print ( "Select failed", quiet );
+          break;
+        }
+      if ( nbt_passive_step ( passive ) < 0 )
+        {
+          err_print ( "Passive collection failed", quiet );
+          break;
         }
     }
 
-  if ( hostinfo->footer )
-    {
-      if ( sf )
-        printf ( "%s%sMAC%s", inet_ntoa ( addr ), sf, sf );
-      else
-        printf ( "\nAdapter address: " );
-      printf ( "%02x:%02x:%02x:%02x:%02x:%02x\n",
-               hostinfo->footer->adapter_address[0],
-               hostinfo->footer->adapter_address[1],
-               hostinfo->footer->adapter_address[2],
-               hostinfo->footer->adapter_address[3],
-               hostinfo->footer->adapter_address[4],
-               hostinfo->footer->adapter_address[5] );
-    }
-  if ( !sf )
-    printf ( "----------------------------------------\n" );
-  return 1;
+  result.format = format;
+  result.scan = scan;
+  nbt_passive_report ( passive, print_passive, &result );
+  nbt_passive_free ( passive );
 }
 
-static int
-print_hostinfo ( struct in_addr addr, struct nb_host_info *hostinfo, char *sf )
+/* Sum up the queries that could not be sent, by reason, and those that
+   were put off or held back for their prefix, the hosts that turned out
+   unreachable, the targets that were left out as repeated or excluded
+   and the answers that were not ours */
+static void
+print_send_errors ( const struct nbt_stats *stats )
 {
   int i;
-  unsigned char service; /* 16th byte of NetBIOS name */
-  char comp_name[16], user_name[16];
-  int is_server = 0;
-  int unique;
-  int first_name = 1;
 
-  strncpy ( comp_name, "<unknown>", 15 );
-  strncpy ( user_name, "<unknown>", 15 );
-  if ( hostinfo->header && hostinfo->names )
-    {
-      for ( i = 0; i < hostinfo->header->number_of_names; i++ )
-        {
-          service = hostinfo->names[i].ascii_name[15];
-          unique = !( hostinfo->names[i].rr_flags & 0x0080 );
-          if ( service == 0 && unique && first_name )
-            {
-              /* Unique name, workstation service - this is computer name */
-              strncpy ( comp_name, hostinfo->names[i].ascii_name, 15 );
-              comp_name[15] = 0;
-              first_name = 0;
-            }
-          if ( service == 0x20 && unique )
-            {
-              is_server = 1;
-            }
-          if ( service == 0x03 && unique )
-            {
-              strncpy ( user_name, hostinfo->names[i].ascii_name, 15 );
-              user_name[15] = 0;
-            }
-        }
-    }
+  if ( quiet )
+    return;
+  for ( i = 0; i < NBT_ERRNO_SLOTS; i++ )
+    if ( stats->send_errno[i] )
+      fprintf ( stderr,
+                "%lu queries could not be sent: %s\n",
+                stats->send_errno[i],
+                strerror ( i ) );
+  if ( stats->deferred )
+    fprintf ( stderr,
+              "%lu queries put off because buffers were full\n",
+              stats->deferred );
+  if ( stats->unreachable )
+    fprintf ( stderr,
+              "%lu hosts sent back ICMP unreachable\n",
+              stats->unreachable );
+  if ( stats->repeated )
+    fprintf ( stderr,
+              "%lu repeated addresses in the target file skipped\n",
+              stats->repeated );
+  if ( stats->excluded )
+    fprintf ( stderr, "%lu target addresses excluded\n", stats->excluded );
+  if ( stats->held )
+    fprintf ( stderr,
+              "%lu queries held back by the per prefix rate\n",
+              stats->held );
+  if ( stats->late )
+    fprintf ( stderr,
+              "%lu answers came too late to be printed in order\n",
+              stats->late );
+  if ( stats->rejected )
+    fprintf ( stderr,
+              "%lu answers with a wrong transaction ID ignored\n",
+              stats->rejected );
+}
 
-  if ( sf )
-    {
-      printf ( "%s%s%s%s", inet_ntoa ( addr ), sf, comp_name, sf );
-      if ( is_server )
-        printf ( "<server>" );
-      printf ( "%s%s%s", sf, user_name, sf );
-    }
-  else
-    {
-      printf ( "%-17s%-17s", inet_ntoa ( addr ), comp_name );
-      if ( is_server )
-        printf ( "%-10s", "<server>" );
-      else
-        printf ( "%-10s", "" );
-      printf ( "%-17s", user_name );
-    }
-  if ( hostinfo->footer )
-    {
-      printf ( "%02x:%02x:%02x:%02x:%02x:%02x\n",
-               hostinfo->footer->adapter_address[0],
-               hostinfo->footer->adapter_address[1],
-               hostinfo->footer->adapter_address[2],
-               hostinfo->footer->adapter_address[3],
-               hostinfo->footer->adapter_address[4],
-               hostinfo->footer->adapter_address[5] );
-    }
-  else
+/* finish_resolving waits for the DNS names still looked up, prints the
+   hosts held for them and saves the cache */
+static void
+finish_resolving ( struct output_format *format )
+{
+  if ( !format->resolver )
+    return;
+  run_scan ( NULL, format );
+  if ( !quiet && format->resolver->stats.failed )
+    fprintf ( stderr,
+              "%lu DNS lookups failed\n",
+              format->resolver->stats.failed );
+  delete_resolver ( format->resolver );
+  format->resolver = NULL;
+}
+
+/* close_output closes the --output file, which for a compressed one
+   waits for the last of it to be written */
+static void
+close_output ( struct output_format *format )
+{
+  char errmsg[80];
+
+  if ( format->out == stdout )
+    return;
+  if ( fclose ( format->out ) )
     {
-      printf ( "\n" );
+      snprintf ( errmsg,
+                 sizeof errmsg,
+                 "Cannot write file %s",
+                 format->out_path );
+      err_print ( errmsg, quiet );
+      exit ( 1 );
     }
-  return 1;
+  format->out = stdout;
 }
 
-/* Print hostinfo in /etc/hosts or lmhosts format */
-/* If l is true adds #PRE to each line of output (for lmhosts) */
-
+/* read_exclusions excludes the ranges listed in filename from the scan.
+   A line that is not a range ends the program, a do-not-scan list is not
+   to be half applied. */
 static void
-l_print_hostinfo ( struct in_addr addr, struct nb_host_info *hostinfo, int l )
+read_exclusions ( struct nbt_scan *scan, const char *filename )
 {
-  int i;
-  unsigned char service; /* 16th byte of NetBIOS name */
-  char comp_name[16];
-  int unique;
-  int first_name = 1;
-
-  strncpy ( comp_name, "<unknown>", 15 );
+  char line[256], errmsg[80], *p, *end;
+  FILE *file;
+  int lineno = 0, added;
 
-  if ( hostinfo->header && hostinfo->names )
+  if ( !( file = fopen ( filename, "r" ) ) )
     {
-      for ( i = 0; i < hostinfo->header->number_of_names; i++ )
+      snprintf ( errmsg, sizeof errmsg, "Cannot open file %s", filename );
+      err_die ( errmsg, quiet );
+      return;
+    }
+  while ( fgets ( line, sizeof line, file ) )
+    {
+      lineno++;
+      if ( ( p = strchr ( line, '#' ) ) )
+        *p = 0;
+      for ( p = line; isspace ( *p ); p++ )
+        ;
+      for ( end = p + strlen ( p ); end > p && isspace ( end[-1] ); end-- )
+        ;
+      *end = 0;
+      if ( *p && ( added = nbt_scan_exclude ( scan, p ) ) < 0 )
+        out_of_memory ();
+      if ( *p && !added )
         {
-          service = hostinfo->names[i].ascii_name[15];
-          unique = !( hostinfo->names[i].rr_flags & 0x0080 );
-          if ( service == 0 && unique && first_name )
-            {
-              /* Unique name, workstation service - this is computer name */
-              strncpy ( comp_name, hostinfo->names[i].ascii_name, 15 );
-              comp_name[15] = 0;
-              first_name = 0;
-            }
+          printf ( "Error: line %d of %s is not an IP address or address "
+                   "range.\n",
+                   lineno,
+                   filename );
+          exit ( 2 );
         }
     }
-  printf ( "%s\t%s", inet_ntoa ( addr ), comp_name );
-  if ( l )
-    printf ( "\t#PRE" );
-  printf ( "\n" );
+  fclose ( file );
 }
 
-#define BUFFSIZE 1024
+/* Responding hosts of each /16, extrapolated from a sampling scan */
+static void
+print_estimate ( const struct nbt_block *block, void *arg )
+{
+  const struct output_format *format = arg;
+
+  print_block ( format->out, block, format->sf );
+}
+
+/* Blocks left out by pruning */
+static void
+print_pruned_blocks ( const struct nbt_block *block, void *arg )
+{
+  const struct output_format *format = arg;
+
+  print_pruned ( format->out, block, format->sf );
+}
 
 int
 main ( int argc, char *argv[] )
 {
   int timeout = 1000, verbose = 0, use137 = 0, ch, dump = 0, bandwidth = 0,
-      send_ok = 0, hr = 0, etc_hosts = 0, lmhosts = 0;
+      hr = 0, etc_hosts = 0, lmhosts = 0, show_rtt = 0, retransmits = 0, i,
+      added;
   extern char *optarg;
   extern int optind;
-  char *target_string, *temp_target_string = NULL;
+  char *target_string;
   char *sf = NULL;
   char *filename = NULL;
-  struct ip_range range;
-  void *buff;
-  int sock;
-  socklen_t addr_size;
-  struct sockaddr_in src_sockaddr, dest_sockaddr;
-  struct in_addr *prev_in_addr = NULL;
-  struct in_addr *next_in_addr;
-  struct timeval select_timeout, last_send_time, current_time, diff_time,
-          send_interval;
-  struct timeval transmit_started, now, recv_time;
-  struct nb_host_info *hostinfo;
-  fd_set fdsr;
-  fd_set fdsw;
-  int size;
-  struct list *scanned;
-  my_uint32_t
-          rtt_base; /* Base time (seconds) for round trip time calculations */
-  float rtt;        /* most recent measured RTT, seconds */
-  float srtt = 0;   /* smoothed rtt estimator, seconds */
-  float rttvar = 0.75; /* smoothed mean deviation, seconds */
-  double delta;        /* used in retransmit timeout calculations */
-  int rto, retransmits = 0, more_to_send = 1, i;
+  char *daemon_path = NULL;
+  int interval = 300;
+  int passive_time = 0;
+  int discover = 0;
+  int arp_sweep = 0;
+  double sample = 0;
+  unsigned long sample_count = 0;
+  int prune = 0;
+  int prune_bits = 24;
+  int stateless = 0;
+  int fair = 0;
+  int fair_bits = 24;
+  int prefix_rate = 0;
+  int sorted = 0;
+  char *field_list = NULL;
+  struct field_plan fields;
+  char *where = NULL;
+  struct filter *filter = NULL;
+  char filter_error[80];
+  char *oui_path = NULL;
+  int resolve = 0;
+  char *dns_server = NULL;
+  char *dns_cache = NULL;
+  char *output_path = NULL;
+  char default_fields[64];
+  char *pcap_out = NULL;
+  char *replay = NULL;
+  char **excludes;
+  int exclude_count = 0;
+  char **exclude_files;
+  int exclude_file_count = 0;
+  char *capture_iface = NULL;
   char errmsg[80];
-  char str[80];
   FILE *targetlist = NULL;
+  struct nbt_options options;
+  struct output_format format;
+  struct nbt_scan *scan;
 
   /* Parse supplied options */
   /**************************/
@@ -459,7 +780,15 @@ main ( int argc, char *argv[] )
       usage ();
     }
 
-  while ( ( ch = getopt ( argc, argv, "vrdelqhm:s:t:b:f:" ) ) != -1 )
+  /* Exclusions are applied once the scan is set up */
+  excludes = malloc ( argc * sizeof ( char * ) );
+  exclude_files = malloc ( argc * sizeof ( char * ) );
+  if ( !excludes || !exclude_files )
+    err_die ( "Malloc failed", quiet );
+
+  while ( ( ch = getopt_long (
+                    argc, argv, "vrdelqhTm:s:t:b:f:", long_options, NULL ) ) !=
+          -1 )
     switch ( ch )
       {
         case 'v':
@@ -515,6 +844,146 @@ main ( int argc, char *argv[] )
         case 'f':
           filename = optarg;
           break;
+        case 'T':
+          show_rtt = 1;
+          break;
+        case OPT_DAEMON:
+          daemon_path = optarg;
+          break;
+        case OPT_PASSIVE:
+          passive_time = atoi ( optarg );
+          if ( passive_time <= 0 )
+            {
+              printf ( "Bad passive collection time: %s\n", optarg );
+              usage ();
+            }
+          break;
+        case OPT_CAPTURE:
+          capture_iface = optarg;
+          break;
+        case OPT_DISCOVER:
+          discover = 1;
+          break;
+        case OPT_ARP:
+          arp_sweep = 1;
+          break;
+        case OPT_SAMPLE:
+          sample = atof ( optarg );
+          if ( sample <= 0 || sample > 1 )
+            {
+              printf ( "Bad sample fraction: %s\n", optarg );
+              usage ();
+            }
+          break;
+        case OPT_SAMPLE_COUNT:
+          sample_count = strtoul ( optarg, NULL, 10 );
+          if ( sample_count == 0 )
+            {
+              printf ( "Bad sample count: %s\n", optarg );
+              usage ();
+            }
+          break;
+        case OPT_PRUNE:
+          prune = atoi ( optarg );
+          if ( prune <= 0 )
+            {
+              printf ( "Bad number of probes: %s\n", optarg );
+              usage ();
+            }
+          break;
+        case OPT_PRUNE_BLOCK:
+          prune_bits = atoi ( optarg );
+          if ( prune_bits < 8 || prune_bits > 30 )
+            {
+              printf ( "Bad block prefix length: %s\n", optarg );
+              usage ();
+            }
+          break;
+        case OPT_EXCLUDE:
+          excludes[exclude_count++] = optarg;
+          break;
+        case OPT_EXCLUDE_FILE:
+          exclude_files[exclude_file_count++] = optarg;
+          break;
+        case OPT_FAIR:
+          fair = 1;
+          break;
+        case OPT_FAIR_PREFIX:
+          fair_bits = atoi ( optarg );
+          if ( fair_bits < 8 || fair_bits > 30 )
+            {
+              printf ( "Bad prefix length: %s\n", optarg );
+              usage ();
+            }
+          break;
+        case OPT_PREFIX_RATE:
+          prefix_rate = atoi ( optarg );
+          if ( prefix_rate <= 0 )
+            {
+              printf ( "Bad prefix rate: %s\n", optarg );
+              usage ();
+            }
+          break;
+        case OPT_FIELDS:
+          field_list = optarg;
+          if ( !compile_fields ( field_list, &fields ) )
+            {
+              printf ( "Bad field list: %s\n", optarg );
+              usage ();
+            }
+          break;
+        case OPT_WHERE:
+          /* Given more than once, all have to hold */
+          if ( !where )
+            where = strdup ( optarg );
+          else if ( ( where = realloc ( where,
+                                        strlen ( where ) +
+                                                strlen ( optarg ) + 9 ) ) )
+            {
+              memmove ( where + 1, where, strlen ( where ) + 1 );
+              where[0] = '(';
+              strcat ( where, ") && (" );
+              strcat ( where, optarg );
+              strcat ( where, ")" );
+            }
+          if ( !where )
+            err_die ( "Malloc failed", quiet );
+          break;
+        case OPT_OUI:
+          oui_path = optarg;
+          break;
+        case OPT_RESOLVE:
+          resolve = 1;
+          break;
+        case OPT_DNS_SERVER:
+          dns_server = optarg;
+          break;
+        case OPT_DNS_CACHE:
+          dns_cache = optarg;
+          break;
+        case OPT_OUTPUT:
+          output_path = optarg;
+          break;
+        case OPT_SORTED:
+          sorted = 1;
+          break;
+        case OPT_PCAP_OUT:
+          pcap_out = optarg;
+          break;
+        case OPT_REPLAY:
+          replay = optarg;
+          break;
+        case OPT_STATELESS:
+          stateless = 1;
+          break;
+        case OPT_INTERVAL:
+          interval = atoi ( optarg );
+          if ( interval <= 0 )
+            {
+              printf ( "Bad interval: %s\n", optarg );
+              usage ();
+            }
+          break;
         default:
           print_banner ();
           usage ();
@@ -583,273 +1052,342 @@ main ( int argc, char *argv[] )
       usage ();
     }
 
-  if ( filename )
+  if ( show_rtt && ( verbose || lmhosts || etc_hosts ) )
     {
-      if ( strcmp ( filename, "-" ) == 0 )
-        { /* Get IP addresses from stdin */
-          targetlist = stdin;
-          target_string = "STDIN";
-        }
-      else
-        {
-          targetlist = fopen ( filename, "r" );
-          target_string = filename;
-        }
-      if ( !targetlist )
-        {
-          snprintf ( errmsg, 80, "Cannot open file %s", filename );
-          err_die ( errmsg, quiet );
-        }
+      printf ( "Round trip time (-T) option cannot be used with verbose (-v), "
+               "lmhosts (-l) or /etc/hosts (-e) options.\n" );
+      usage ();
     }
-  else
+
+  if ( daemon_path && ( verbose || dump || etc_hosts || lmhosts || hr ||
+                        use137 || filename || passive_time || sample ||
+                        sample_count || prune || pcap_out || replay ||
+                        exclude_count || exclude_file_count || fair ||
+                        prefix_rate || sorted || field_list || where ||
+                        oui_path || resolve || output_path ) )
     {
-      argc -= optind;
-      argv += optind;
-      if ( argc != 1 )
-        usage ();
+      printf ( "Daemon mode (--daemon) cannot be used with -v, -d, -e, -l, "
+               "-h, -r, -f, --passive, --sample, --prune, --pcap-out, "
+               "--replay, --exclude, --fair, --prefix-rate, --sorted, "
+               "--fields, --where, --oui, --resolve or --output "
+               "options.\n" );
+      usage ();
+    }
 
-      if ( ( target_string = strdup ( argv[0] ) ) == NULL )
-        err_die ( "Malloc failed.\n", quiet );
+  if ( field_list &&
+       ( verbose || dump || etc_hosts || lmhosts || hr || show_rtt ) )
+    {
+      printf ( "Fields (--fields) option cannot be used with -v, -d, -e, "
+               "-l, -h or -T options.\n" );
+      usage ();
+    }
 
-      if ( !set_range ( target_string, &range ) )
-        {
-          printf ( "Error: %s is not an IP address or address range.\n",
-                   target_string );
-          free ( target_string );
-          usage ();
-        }
+  if ( where &&
+       !( filter = new_filter ( where, filter_error, sizeof filter_error ) ) )
+    {
+      printf ( "Bad filter expression: %s\n", filter_error );
+      usage ();
+    }
 
-      temp_target_string = target_string;
+  if ( oui_path && ( verbose || dump || etc_hosts || lmhosts ) )
+    {
+      printf ( "Vendor (--oui) option cannot be used with -v, -d, -e or -l "
+               "options.\n" );
+      usage ();
+    }
+  if ( resolve && ( verbose || dump || etc_hosts || lmhosts ) )
+    {
+      printf ( "Resolve (--resolve) option cannot be used with -v, -d, -e "
+               "or -l options.\n" );
+      usage ();
+    }
+  if ( ( dns_server || dns_cache ) && !resolve )
+    {
+      printf ( "DNS server (--dns-server) and cache (--dns-cache) options "
+               "cannot be used without resolve (--resolve) option.\n" );
+      usage ();
     }
 
-  if ( !( quiet || sf || lmhosts || etc_hosts ) )
-    printf ( "Doing NBT name scan for addresses from %s\n\n", target_string );
+  /* The default columns and the vendor and DNS name asked for */
+  if ( ( oui_path || resolve ) && !field_list )
+    {
+      snprintf ( default_fields,
+                 sizeof default_fields,
+                 "ip,name,server,user,mac%s%s%s",
+                 oui_path ? ",vendor" : "",
+                 resolve ? ",dns" : "",
+                 show_rtt ? ",rtt" : "" );
+      field_list = default_fields;
+      compile_fields ( field_list, &fields );
+    }
+  if ( oui_path && !( fields.oui = oui_open ( oui_path ) ) )
+    {
+      snprintf ( errmsg,
+                 sizeof errmsg,
+                 errno == EINVAL ? "%s is not a vendor table"
+                                 : "Cannot read file %s",
+                 oui_path );
+      err_die ( errmsg, quiet );
+    }
+  if ( field_list )
+    for ( i = 0; i < fields.count; i++ )
+      {
+        if ( fields.fields[i] == FIELD_VENDOR && !oui_path )
+          {
+            printf ( "The vendor field needs the --oui option.\n" );
+            usage ();
+          }
+        if ( fields.fields[i] == FIELD_DNS && !resolve )
+          {
+            printf ( "The dns field needs the --resolve option.\n" );
+            usage ();
+          }
+      }
 
-  /* Finished with options */
-  /*************************/
+  if ( sample && sample_count )
+    {
+      printf ( "Cannot be used with both --sample and --sample-count "
+               "options.\n" );
+      usage ();
+    }
 
-  /* Prepare socket and address structures */
-  /*****************************************/
-  sock = socket ( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
-  if ( sock < 0 )
-    err_die ( "Failed to create socket", quiet );
+  if ( replay && ( filename || passive_time || pcap_out ) )
+    {
+      printf ( "Replay (--replay) option cannot be used with -f, --passive "
+               "or --pcap-out options.\n" );
+      usage ();
+    }
 
-  memset ( &src_sockaddr, 0, sizeof src_sockaddr );
-  src_sockaddr.sin_family = AF_INET;
-  if ( use137 )
-    src_sockaddr.sin_port = htons ( NB_DGRAM );
-  if ( bind ( sock,
-              ( struct sockaddr * ) &src_sockaddr,
-              sizeof ( src_sockaddr ) ) == -1 )
-    err_die ( "Failed to bind", quiet );
+  if ( show_rtt && stateless )
+    {
+      printf ( "Round trip time (-T) option cannot be used with stateless "
+               "(--stateless) option.\n" );
+      usage ();
+    }
 
-  FD_ZERO ( &fdsr );
-  FD_SET ( sock, &fdsr );
+  if ( prune && ( sample || sample_count ) )
+    {
+      printf ( "Pruning (--prune) option cannot be used with sampling "
+               "(--sample) options.\n" );
+      usage ();
+    }
 
-  FD_ZERO ( &fdsw );
-  FD_SET ( sock, &fdsw );
+  if ( capture_iface && !passive_time )
+    {
+      printf ( "Capture (--capture) option cannot be used without passive "
+               "(--passive) option.\n" );
+      usage ();
+    }
 
-  /* timeout is in milliseconds */
-  select_timeout.tv_sec = 60; /* Default 1 min to survive ARP timeouts */
-  select_timeout.tv_usec = 0;
+  nbt_default_options ( &options );
+  options.quiet = quiet;
+  options.timeout = timeout;
+  options.bandwidth = bandwidth;
+  options.retransmits = retransmits;
+  options.use137 = use137;
+  options.share137 = use137 && passive_time && !capture_iface;
+  options.discover = discover;
+  options.arp_sweep = arp_sweep;
+  options.sample = sample;
+  options.sample_count = sample_count;
+  options.prune = prune;
+  options.prune_bits = prune_bits;
+  options.stateless = stateless;
+  options.fair = fair;
+  options.fair_bits = fair_bits;
+  options.prefix_rate = prefix_rate;
+  options.sorted = sorted;
+  if ( field_list )
+    options.parts = fields.parts | ( filter ? filter->parts : 0 );
+
+  if ( daemon_path )
+    exit ( run_daemon (
+            daemon_path, &options, sf ? sf : ":", argv + optind, interval ) );
+
+  format.out = stdout;
+  format.out_path = output_path;
+  if ( output_path && !( format.out = zfile_create ( output_path ) ) )
+    {
+      snprintf ( errmsg,
+                 sizeof errmsg,
+                 errno == ENOTSUP ? "No compression support for %s"
+                                  : "Cannot create file %s",
+                 output_path );
+      err_print ( errmsg, quiet );
+      exit ( 1 );
+    }
+  format.verbose = verbose;
+  format.dump = dump;
+  format.etc_hosts = etc_hosts;
+  format.lmhosts = lmhosts;
+  format.hr = hr;
+  format.show_rtt = show_rtt;
+  format.sf = sf;
+  format.fields = field_list ? &fields : NULL;
+  format.where = filter;
+  format.resolver = NULL;
+  format.sorted = sorted;
+  format.held_first = format.held_last = NULL;
+  if ( resolve &&
+       !( format.resolver = new_resolver ( dns_server, dns_cache ) ) )
+    {
+      if ( errno == EINVAL )
+        {
+          printf ( "Bad DNS server: %s\n", dns_server );
+          usage ();
+        }
+      err_die ( "Failed to open DNS socket", quiet );
+    }
 
-  addr_size = sizeof ( struct sockaddr_in );
+  argc -= optind;
+  argv += optind;
 
-  next_in_addr = malloc ( sizeof ( struct in_addr ) );
-  if ( !next_in_addr )
-    err_die ( "Malloc failed", quiet );
+  if ( replay )
+    {
+      if ( argc != 0 )
+        usage ();
+      if ( !( quiet || verbose || dump || sf || lmhosts || etc_hosts ) )
+        print_column_header ( &format );
+      if ( nbt_replay ( replay, print_result, &format ) < 0 )
+        {
+          snprintf ( errmsg,
+                     sizeof errmsg,
+                     errno == EINVAL ? "%s is not a capture nbtscan can read"
+                                     : "Cannot read file %s",
+                     replay );
+          err_die ( errmsg, quiet );
+        }
+      finish_resolving ( &format );
+      close_output ( &format );
+      exit ( 0 );
+    }
 
-  buff = malloc ( BUFFSIZE );
-  if ( !buff )
-    err_die ( "Malloc failed", quiet );
+  if ( passive_time && !filename && argc == 0 )
+    {
+      /* Only listen, with port 137 to ourselves */
+      options.share137 = 0;
+      scan = NULL;
+      target_string = NULL;
+    }
+  else
+    {
+      scan = nbt_scan_new ( &options, print_result, &format );
+      if ( !scan )
+        {
+          err_print ( "Failed to open scan socket", quiet );
+          exit ( 1 );
+        }
+      if ( pcap_out && nbt_scan_record ( scan, pcap_out ) < 0 )
+        {
+          snprintf ( errmsg, 80, "Cannot create file %s", pcap_out );
+          err_die ( errmsg, quiet );
+        }
+      for ( i = 0; i < exclude_count; i++ )
+        if ( ( added = nbt_scan_exclude ( scan, excludes[i] ) ) < 0 )
+          out_of_memory ();
+        else if ( !added )
+          {
+            printf ( "Error: %s is not an IP address or address range.\n",
+                     excludes[i] );
+            usage ();
+          }
+      for ( i = 0; i < exclude_file_count; i++ )
+        read_exclusions ( scan, exclude_files[i] );
+
+      if ( filename )
+        {
+          if ( strcmp ( filename, "-" ) == 0 )
+            { /* Get IP addresses from stdin */
+              targetlist = stdin;
+              target_string = "STDIN";
+            }
+          else
+            {
+              targetlist = fopen ( filename, "r" );
+              target_string = filename;
+            }
+          if ( !targetlist )
+            {
+              snprintf ( errmsg, 80, "Cannot open file %s", filename );
+              err_print ( errmsg, quiet );
+              exit ( 1 );
+            }
+          if ( nbt_scan_add_file ( scan, targetlist ) < 0 )
+            out_of_memory ();
+        }
+      else
+        {
+          if ( argc != 1 )
+            usage ();
 
-  /* Calculate interval between subsequent sends */
+          target_string = argv[0];
+          if ( ( added = nbt_scan_add_target ( scan, target_string ) ) < 0 )
+            out_of_memory ();
+          if ( !added )
+            {
+              printf ( "Error: %s is not an IP address or address range.\n",
+                       target_string );
+              usage ();
+            }
+        }
+    }
 
-  timerclear ( &send_interval );
-  if ( bandwidth )
-    send_interval.tv_usec =
-            ( NBNAME_REQUEST_SIZE + UDP_HEADER_SIZE + IP_HEADER_SIZE ) * 8 *
-            1000000 / bandwidth; /* Send interval in microseconds */
-  else                           /* Assuming 10baseT bandwidth */
-    send_interval.tv_usec = 1;   /* for 10baseT interval should be about 1 ms */
-  if ( send_interval.tv_usec >= 1000000 )
+  if ( !( quiet || sf || lmhosts || etc_hosts ) )
     {
-      send_interval.tv_sec = send_interval.tv_usec / 1000000;
-      send_interval.tv_usec = send_interval.tv_usec % 1000000;
+      if ( passive_time )
+        fprintf ( format.out,
+                  "Listening to NetBIOS name traffic for %d seconds\n",
+                  passive_time );
+      if ( target_string )
+        fprintf ( format.out,
+                  "Doing NBT name scan for addresses from %s\n",
+                  target_string );
+      fprintf ( format.out, "\n" );
     }
 
-  gettimeofday ( &last_send_time, NULL ); /* Get current time */
+  /* Finished with options */
+  /*************************/
+
+  if ( !( quiet || verbose || dump || sf || lmhosts || etc_hosts ) )
+    print_column_header ( &format );
 
-  rtt_base = last_send_time.tv_sec;
+  if ( passive_time )
+    run_passive (
+            capture_iface, options.share137, passive_time, &format, scan );
 
   /* Send queries, receive answers and print results */
   /***************************************************/
 
-  scanned = new_list ();
-
-  if ( !( quiet || verbose || dump || sf || lmhosts || etc_hosts ) )
-    print_header ();
-
-  for ( i = 0; i <= retransmits; i++ )
+  if ( scan )
     {
-      gettimeofday ( &transmit_started, NULL );
-      while ( ( select ( sock + 1, &fdsr, &fdsw, NULL, &select_timeout ) ) > 0 )
+      run_scan ( scan, &format );
+      print_send_errors ( nbt_scan_stats ( scan ) );
+      if ( ( sample || sample_count ) && !( lmhosts || etc_hosts ) )
         {
-          if ( FD_ISSET ( sock, &fdsr ) )
-            {
-              if ( ( size = recvfrom ( sock,
-                                       buff,
-                                       BUFFSIZE,
-                                       0,
-                                       ( struct sockaddr * ) &dest_sockaddr,
-                                       &addr_size ) ) <= 0 )
-                {
-                  snprintf ( errmsg,
-                             80,
-                             "%s\tRecvfrom failed",
-                             inet_ntoa ( dest_sockaddr.sin_addr ) );
-                  err_print ( errmsg, quiet );
-                  continue;
-                }
-              gettimeofday ( &recv_time, NULL );
-              hostinfo =
-                      ( struct nb_host_info * ) parse_response ( buff, size );
-              if ( !hostinfo )
-                {
-                  err_print ( "parse_response returned NULL", quiet );
-                  continue;
-                }
-              /* If this packet isn't a duplicate */
-              if ( insert ( scanned, ntohl ( dest_sockaddr.sin_addr.s_addr ) ) )
-                {
-                  rtt = recv_time.tv_sec + recv_time.tv_usec / 1000000 -
-                        rtt_base - hostinfo->header->transaction_id / 1000;
-                  /* Using algorithm described in Stevens'
-                     Unix Network Programming */
-                  delta = rtt - srtt;
-                  srtt += delta / 8;
-                  if ( delta < 0.0 )
-                    delta = -delta;
-                  rttvar += ( delta - rttvar ) / 4;
-
-                  if ( verbose )
-                    v_print_hostinfo (
-                            dest_sockaddr.sin_addr, hostinfo, sf, hr );
-                  else if ( dump )
-                    d_print_hostinfo ( dest_sockaddr.sin_addr, hostinfo );
-                  else if ( etc_hosts )
-                    l_print_hostinfo ( dest_sockaddr.sin_addr, hostinfo, 0 );
-                  else if ( lmhosts )
-                    l_print_hostinfo ( dest_sockaddr.sin_addr, hostinfo, 1 );
-                  else
-                    print_hostinfo ( dest_sockaddr.sin_addr, hostinfo, sf );
-                }
-
-              free ( hostinfo->header );
-              free ( hostinfo->footer );
-              free ( hostinfo->names );
-              free ( hostinfo );
-            }
-
-          FD_ZERO ( &fdsr );
-          FD_SET ( sock, &fdsr );
-
-          /* check if send_interval time passed since last send */
-          gettimeofday ( &current_time, NULL );
-          timersub ( &current_time, &last_send_time, &diff_time );
-          send_ok = timercmp ( &diff_time, &send_interval, >= );
-
-          if ( more_to_send && FD_ISSET ( sock, &fdsw ) && send_ok )
+          if ( !( quiet || sf ) )
             {
-              if ( targetlist )
-                {
-                  if ( fgets ( str, 80, targetlist ) )
-                    {
-                      if ( !inet_aton ( str, next_in_addr ) )
-                        {
-                          /* if(!inet_pton(AF_INET, str, next_in_addr)) { */
-                          fprintf ( stderr, "%s - bad IP address\n", str );
-                        }
-                      else
-                        {
-                          if ( !in_list ( scanned,
-                                          ntohl ( next_in_addr->s_addr ) ) )
-                            send_query ( sock, *next_in_addr, rtt_base );
-                        }
-                    }
-                  else
-                    {
-                      if ( feof ( targetlist ) )
-                        {
-                          more_to_send = 0;
-                          FD_ZERO ( &fdsw );
-                          /* timeout is in milliseconds */
-                          select_timeout.tv_sec = timeout / 1000;
-                          select_timeout.tv_usec =
-                                  ( timeout % 1000 ) * 1000; /* Microseconds */
-                          continue;
-                        }
-                      else
-                        {
-                          snprintf ( errmsg,
-                                     80,
-                                     "Read failed from file %s",
-                                     filename );
-                          err_die ( errmsg, quiet );
-                        }
-                    }
-                }
-              else if ( next_address ( &range, prev_in_addr, next_in_addr ) )
-                {
-                  if ( !in_list ( scanned, ntohl ( next_in_addr->s_addr ) ) )
-                    send_query ( sock, *next_in_addr, rtt_base );
-                  prev_in_addr = next_in_addr;
-                  /* Update last send time */
-                  gettimeofday ( &last_send_time, NULL );
-                }
-              else
-                { /* No more queries to send */
-                  more_to_send = 0;
-                  FD_ZERO ( &fdsw );
-                  /* timeout is in milliseconds */
-                  select_timeout.tv_sec = timeout / 1000;
-                  select_timeout.tv_usec =
-                          ( timeout % 1000 ) * 1000; /* Microseconds */
-                  continue;
-                }
+              fprintf ( format.out, "\n" );
+              print_block_header ( format.out );
             }
-          if ( more_to_send )
+          nbt_scan_blocks ( scan, print_estimate, &format );
+        }
+      if ( prune && !( lmhosts || etc_hosts ) )
+        {
+          if ( !( quiet || sf ) )
             {
-              FD_ZERO ( &fdsw );
-              FD_SET ( sock, &fdsw );
+              fprintf ( format.out,
+                        "\n%lu addresses pruned\n",
+                        nbt_scan_stats ( scan )->pruned );
+              if ( nbt_scan_stats ( scan )->pruned )
+                print_pruned_header ( format.out );
             }
+          nbt_scan_pruned ( scan, print_pruned_blocks, &format );
         }
-
-      if ( i >= retransmits )
-        break; /* If we are not going to retransmit
-             we can finish right now without waiting */
-
-      rto = ( srtt + 4 * rttvar ) * ( i + 1 );
-
-      if ( rto < 2.0 )
-        rto = 2.0;
-      if ( rto > 60.0 )
-        rto = 60.0;
-      gettimeofday ( &now, NULL );
-
-      if ( now.tv_sec < ( transmit_started.tv_sec + rto ) )
-        sleep ( ( transmit_started.tv_sec + rto ) - now.tv_sec );
-      prev_in_addr = NULL;
-      more_to_send = 1;
-      FD_ZERO ( &fdsw );
-      FD_SET ( sock, &fdsw );
-      FD_ZERO ( &fdsr );
-      FD_SET ( sock, &fdsr );
+      nbt_scan_free ( scan );
     }
-
-  delete_list ( scanned );
-  free ( next_in_addr );
-  free ( temp_target_string );
-  free ( buff );
+  finish_resolving ( &format );
+  close_output ( &format );
+  if ( targetlist && targetlist != stdin )
+    fclose ( targetlist );
   exit ( 0 );
 }
@@ -0,0 +1,276 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/* libnbtscan - the nbtscan engine as a library.
+
+   A scan is set up with nbt_scan_new(), given targets with the
+   nbt_scan_add_*() functions and then driven either by nbt_scan_run(),
+   which blocks until the scan is over, or from an existing event loop:
+   wait until nbt_scan_fd() is readable or nbt_scan_timeout() has passed,
+   then call nbt_scan_step(). Each host that answers is handed to the
+   result callback once, already parsed. */
+
+#if !defined NBTSCAN_H
+#define NBTSCAN_H
+
+#include <stdio.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include "statusq.h"
+
+struct nbt_options
+{
+  int timeout;     /* milliseconds to wait for responses, default 1000 */
+  int quiet;       /* don't report failures on stderr */
+  int bandwidth;   /* bits per second of queries, 0 for no limit */
+  int retransmits; /* extra rounds for hosts that did not answer */
+  int use137;      /* send queries from port 137 */
+  int share137;    /* with use137, let a passive listener of this process
+                      (nbt_passive_new) made after the scan have port 137
+                      as well. The port is never shared with anyone else,
+                      such as a name server running on the host. */
+  int discover;    /* broadcast a name query on each local subnet first
+                      and only query the hosts there that answer it */
+  int arp_sweep;   /* sweep the directly attached subnets with ARP first
+                      and only query the hosts that answer, needs root */
+  double sample;   /* query only this fraction of each range, picked at
+                      random, 0 to query all */
+  unsigned long sample_count; /* or this many addresses of all ranges */
+  int prune;       /* query this many addresses of each block of the ranges
+                      first and skip the blocks where none answered or
+                      refused, 0 to query all */
+  int prune_bits;  /* prefix length of those blocks, default 24 */
+  int stateless;   /* keep nothing per query: answers are told by a keyed
+                      hash of their address in the transaction ID, round
+                      trip times are not known and retransmit rounds go
+                      through all addresses again */
+  int fair;        /* go through ranges one address from each prefix in
+                      turn rather than in order */
+  int fair_bits;   /* prefix length of those prefixes, default 24 */
+  int prefix_rate; /* queries per second into any one prefix, 0 for no
+                      limit */
+  int sorted;      /* hand results on in ascending address order, each as
+                      soon as no lower address can answer any more */
+  int parts;       /* NB_PARSE_* parts of the answers the result callback
+                      looks at, the others are not parsed. Default
+                      NB_PARSE_ALL. */
+};
+
+/* Send errors are counted by errno, values past the end share the last
+   slot */
+#define NBT_ERRNO_SLOTS 256
+
+struct nbt_stats
+{
+  unsigned long sent;        /* queries sent */
+  unsigned long received;    /* datagrams received */
+  unsigned long responded;   /* hosts that answered */
+  unsigned long duplicates;  /* answers from hosts that already answered */
+  unsigned long errors;      /* failed sends and receives */
+  unsigned long unreachable; /* hosts that sent back ICMP port or host
+                                unreachable, not queried again */
+  unsigned long deferred;    /* sends put off because buffers were full */
+  unsigned long pruned;      /* addresses left out with their blocks */
+  unsigned long rejected;    /* answers with the wrong transaction ID in a
+                                stateless scan */
+  unsigned long repeated;    /* addresses read from a file again, not
+                                queried twice */
+  unsigned long excluded;    /* target addresses on the exclusion list */
+  unsigned long held;        /* queries that waited for the per prefix
+                                rate */
+  unsigned long late;        /* answers that came after their timeout, too
+                                late to be put in order */
+  unsigned long send_errno[NBT_ERRNO_SLOTS]; /* failed sends by errno */
+};
+
+/* Called once for each host that answers. rtt is in seconds, negative if
+   unknown. hostinfo is only valid during the call. */
+typedef void ( *nbt_result_cb ) ( struct in_addr addr,
+                                  const struct nb_host_info *hostinfo,
+                                  double rtt,
+                                  void *arg );
+
+/* What a sampling scan covered of one /16, to extrapolate from, or a run
+   of blocks pruning left out */
+struct nbt_block
+{
+  unsigned long start;     /* first address, host byte order */
+  unsigned long size;      /* target addresses in the block */
+  unsigned long probed;    /* of those, the ones queried */
+  unsigned long responded; /* of those, the ones that answered */
+};
+
+typedef void ( *nbt_block_cb ) ( const struct nbt_block *block, void *arg );
+
+struct nbt_scan;
+
+void
+nbt_default_options ( struct nbt_options *options );
+
+/* nbt_scan_new opens the scan socket. Returns NULL with errno set if that
+   fails. */
+struct nbt_scan *
+nbt_scan_new ( const struct nbt_options *options,
+               nbt_result_cb callback,
+               void *arg );
+
+void
+nbt_scan_free ( struct nbt_scan *scan );
+
+/* nbt_scan_add_target adds an address or range in any of the forms the
+   command line accepts: a.b.c.d, a.b.c.d/nn or a.b.c.d-e. Returns 1 on
+   success, 0 if the string is not a valid target and -1 with errno set if
+   memory ran out. */
+int
+nbt_scan_add_target ( struct nbt_scan *scan, const char *target );
+
+/* nbt_scan_add_range adds the addresses from start_ip to end_ip, both in
+   host byte order. Returns 0, or -1 with errno set if memory ran out. */
+int
+nbt_scan_add_range ( struct nbt_scan *scan,
+                     unsigned long start_ip,
+                     unsigned long end_ip );
+
+/* nbt_scan_add_file adds the addresses listed in file, one per line. The
+   file is read as the scan goes and is not closed by the library. Returns
+   0, or -1 with errno set if memory ran out. */
+int
+nbt_scan_add_file ( struct nbt_scan *scan, FILE *file );
+
+/* nbt_scan_exclude keeps the addresses of target, in any of the forms
+   nbt_scan_add_target() takes, from being queried, whichever target they
+   belong to. Same return values as nbt_scan_add_target(). */
+int
+nbt_scan_exclude ( struct nbt_scan *scan, const char *target );
+
+/* nbt_scan_exclude_range excludes the addresses from start_ip to end_ip,
+   both in host byte order. Returns 0, or -1 with errno set if memory ran
+   out. */
+int
+nbt_scan_exclude_range ( struct nbt_scan *scan,
+                         unsigned long start_ip,
+                         unsigned long end_ip );
+
+/* The descriptor to wait on for readability */
+int
+nbt_scan_fd ( const struct nbt_scan *scan );
+
+/* nbt_scan_timeout stores in *tv how long the caller may wait for the
+   descriptor before calling nbt_scan_step() anyway. During an ARP sweep
+   this is never more than a few milliseconds. */
+void
+nbt_scan_timeout ( const struct nbt_scan *scan, struct timeval *tv );
+
+/* nbt_scan_step receives whatever has arrived and sends the queries that
+   are due, without blocking. Returns 1 while the scan goes on, 0 once it
+   is over and -1 with errno ENOMEM if memory ran out, after which the scan
+   can only be restarted or freed. */
+int
+nbt_scan_step ( struct nbt_scan *scan );
+
+/* nbt_scan_restart starts the scan over, finished or not. All targets are
+   queried again, including hosts that already answered; the socket and
+   the round trip time estimates are kept. Returns 0, or -1 with errno set
+   if memory ran out, leaving the scan as it was. */
+int
+nbt_scan_restart ( struct nbt_scan *scan );
+
+/* nbt_scan_run drives the scan until it is over. Returns 0, or -1 with
+   errno set if it had to stop early. */
+int
+nbt_scan_run ( struct nbt_scan *scan );
+
+const struct nbt_stats *
+nbt_scan_stats ( const struct nbt_scan *scan );
+
+/* nbt_scan_record writes every query the scan sends from now on and every
+   datagram it receives, broken ones included, to a new pcap file at path.
+   Returns 0, or -1 with errno set if the file can't be created. */
+int
+nbt_scan_record ( struct nbt_scan *scan, const char *path );
+
+/* nbt_scan_blocks calls callback for every /16 the targets of a sampling
+   scan touch, lowest first. Does nothing if the scan is not sampling. */
+void
+nbt_scan_blocks ( const struct nbt_scan *scan,
+                  nbt_block_cb callback,
+                  void *arg );
+
+/* nbt_scan_pruned calls callback for every run of adjacent blocks that
+   were left out because none of the addresses probed first answered or
+   refused, lowest first within each range. Nothing answered in them. */
+void
+nbt_scan_pruned ( const struct nbt_scan *scan,
+                  nbt_block_cb callback,
+                  void *arg );
+
+/* nbt_scan_skip marks addr as already answered, so that it is not queried
+   until the scan is restarted. Returns 0, or -1 with errno set if memory
+   ran out. */
+int
+nbt_scan_skip ( struct nbt_scan *scan, struct in_addr addr );
+
+/* nbt_replay runs the node status responses in the pcap file at path,
+   recorded by nbt_scan_record() or captured otherwise, through the parser
+   as a scan would: callback is called once for each host that answered,
+   in the order of the capture, with the round trip time from the query
+   before it or a negative one. Returns the number of hosts, or -1 with
+   errno set if the file can't be read, EINVAL if it is no capture of IP or
+   Ethernet, ENOMEM if memory ran out. */
+long
+nbt_replay ( const char *path, nbt_result_cb callback, void *arg );
+
+/* Passive collection. Hosts are learned from name registrations, name
+   query responses and node status responses seen on UDP port 137, or on
+   all traffic of a network interface, and reported in the form of a node
+   status response. Hosts only heard registering names get those names,
+   and no MAC address unless the traffic was captured from an interface. */
+
+struct nbt_passive;
+
+/* nbt_passive_new listens on UDP port 137, or captures from the interface
+   ifname if it is not NULL. Both need root. With share137 the port is
+   shared with the scan socket of a scan made before with the share137
+   option, otherwise it must be free. Returns NULL with errno set on
+   failure, EADDRINUSE if the port is taken. */
+struct nbt_passive *
+nbt_passive_new ( const char *ifname, int share137 );
+
+void
+nbt_passive_free ( struct nbt_passive *passive );
+
+/* The descriptor to wait on for readability */
+int
+nbt_passive_fd ( const struct nbt_passive *passive );
+
+/* nbt_passive_step takes in the packets that have arrived, without
+   blocking. Returns how many were read, or -1 with errno set if memory
+   ran out; what was learned so far is kept. */
+int
+nbt_passive_step ( struct nbt_passive *passive );
+
+/* Number of hosts heard of so far */
+unsigned long
+nbt_passive_hosts ( const struct nbt_passive *passive );
+
+/* nbt_passive_report calls callback once for every host heard of, in the
+   order they were first heard of, with a negative rtt */
+void
+nbt_passive_report ( const struct nbt_passive *passive,
+                     nbt_result_cb callback,
+                     void *arg );
+
+#endif /* NBTSCAN_H */
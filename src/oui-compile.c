@@ -0,0 +1,206 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/* nbtscan-oui compiles a list of MAC address vendors into the table
+   nbtscan --oui maps. It reads the IEEE OUI list (oui.txt) or a Wireshark
+   manuf file; prefixes longer than 24 bits are left out. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "oui.h"
+
+struct vendor
+{
+  unsigned long prefix;
+  char *name;
+};
+
+static void
+usage ( void )
+{
+  puts ( "Usage:\nnbtscan-oui input output\n"
+         "\tinput\t\tThe IEEE OUI list (oui.txt) or a Wireshark manuf\n"
+         "\t\t\tfile, - for stdin.\n"
+         "\toutput\t\tThe table to write, for nbtscan --oui." );
+  exit ( 2 );
+}
+
+static void
+die ( const char *message, const char *what )
+{
+  fprintf ( stderr, "nbtscan-oui: %s%s\n", message, what );
+  exit ( 1 );
+}
+
+static void
+put32 ( unsigned char *p, unsigned long value )
+{
+  p[0] = value >> 24;
+  p[1] = value >> 16;
+  p[2] = value >> 8;
+  p[3] = value;
+}
+
+/* parse_prefix reads the 24 bit prefix at the start of line, as 00-50-56,
+   00:50:56 or 005056. Returns a pointer past it, or NULL if the line
+   doesn't start with one or it is part of a longer prefix. */
+static char *
+parse_prefix ( char *line, unsigned long *prefix )
+{
+  int digits = 0, value;
+  char *p = line;
+
+  *prefix = 0;
+  while ( digits < 6 )
+    {
+      if ( isxdigit ( ( unsigned char ) *p ) )
+        {
+          value = isdigit ( ( unsigned char ) *p )
+                          ? *p - '0'
+                          : tolower ( ( unsigned char ) *p ) - 'a' + 10;
+          *prefix = *prefix << 4 | value;
+          digits++;
+        }
+      else if ( !( ( *p == ':' || *p == '-' || *p == '.' ) && digits &&
+                   digits % 2 == 0 ) )
+        return NULL;
+      p++;
+    }
+  /* 00:50:56:00:00:00/28 and the like are blocks of a shared prefix */
+  if ( *p == ':' || *p == '-' || *p == '/' ||
+       isxdigit ( ( unsigned char ) *p ) )
+    return NULL;
+  return p;
+}
+
+/* Strip blanks at both ends */
+static char *
+trim ( char *s )
+{
+  char *end;
+
+  while ( isspace ( ( unsigned char ) *s ) )
+    s++;
+  end = s + strlen ( s );
+  while ( end > s && isspace ( ( unsigned char ) end[-1] ) )
+    end--;
+  *end = 0;
+  return s;
+}
+
+/* vendor_name finds the vendor in the rest of a line: after "(hex)" in
+   oui.txt, the long name if there is one in a manuf file */
+static char *
+vendor_name ( char *rest )
+{
+  char *p, *tab;
+
+  if ( ( p = strstr ( rest, "(hex)" ) ) )
+    return trim ( p + 5 );
+  if ( ( p = strchr ( rest, '#' ) ) )
+    *p = 0;
+  rest = trim ( rest );
+  if ( ( tab = strchr ( rest, '\t' ) ) && *trim ( tab + 1 ) )
+    return trim ( tab + 1 );
+  return rest;
+}
+
+static int
+compare_vendors ( const void *a, const void *b )
+{
+  const struct vendor *va = a, *vb = b;
+
+  if ( va->prefix != vb->prefix )
+    return va->prefix < vb->prefix ? -1 : 1;
+  return 0;
+}
+
+int
+main ( int argc, char *argv[] )
+{
+  struct vendor *vendors = NULL;
+  unsigned long count = 0, allocated = 0, kept, i, names_size = 0;
+  unsigned char header[OUI_HEADER_SIZE], entry[OUI_ENTRY_SIZE];
+  char line[1024], *rest, *name;
+  unsigned long prefix;
+  FILE *in, *out;
+
+  if ( argc != 3 )
+    usage ();
+  in = strcmp ( argv[1], "-" ) == 0 ? stdin : fopen ( argv[1], "r" );
+  if ( !in )
+    die ( "Cannot open file ", argv[1] );
+
+  while ( fgets ( line, sizeof line, in ) )
+    {
+      if ( !( rest = parse_prefix ( line, &prefix ) ) )
+        continue;
+      name = vendor_name ( rest );
+      if ( !*name )
+        continue;
+      if ( count == allocated )
+        {
+          allocated = allocated ? allocated * 2 : 4096;
+          if ( !( vendors = realloc ( vendors,
+                                      allocated * sizeof ( struct vendor ) ) ) )
+            die ( "Malloc failed", "" );
+        }
+      vendors[count].prefix = prefix;
+      if ( !( vendors[count].name = strdup ( name ) ) )
+        die ( "Malloc failed", "" );
+      count++;
+    }
+  if ( ferror ( in ) )
+    die ( "Cannot read file ", argv[1] );
+  if ( count == 0 )
+    die ( "No vendors found in ", argv[1] );
+
+  /* The first name given for a prefix counts */
+  qsort ( vendors, count, sizeof ( struct vendor ), compare_vendors );
+  for ( kept = 0, i = 0; i < count; i++ )
+    if ( kept == 0 || vendors[i].prefix != vendors[kept - 1].prefix )
+      {
+        vendors[kept++] = vendors[i];
+        names_size += strlen ( vendors[i].name ) + 1;
+      }
+
+  if ( !( out = fopen ( argv[2], "wb" ) ) )
+    die ( "Cannot create file ", argv[2] );
+  memset ( header, 0, sizeof header );
+  memcpy ( header, OUI_MAGIC, 8 );
+  put32 ( header + 8, kept );
+  put32 ( header + 12, names_size );
+  fwrite ( header, sizeof header, 1, out );
+  for ( names_size = 0, i = 0; i < kept; i++ )
+    {
+      entry[0] = vendors[i].prefix >> 16;
+      entry[1] = vendors[i].prefix >> 8;
+      entry[2] = vendors[i].prefix;
+      entry[3] = 0;
+      put32 ( entry + 4, names_size );
+      fwrite ( entry, sizeof entry, 1, out );
+      names_size += strlen ( vendors[i].name ) + 1;
+    }
+  for ( i = 0; i < kept; i++ )
+    fwrite ( vendors[i].name, strlen ( vendors[i].name ) + 1, 1, out );
+  if ( fclose ( out ) != 0 )
+    die ( "Cannot write file ", argv[2] );
+
+  printf ( "%lu vendors\n", kept );
+  return 0;
+}
@@ -0,0 +1,136 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "oui.h"
+
+static unsigned long
+get32 ( const unsigned char *p )
+{
+  return ( ( unsigned long ) p[0] << 24 ) | ( p[1] << 16 ) | ( p[2] << 8 ) |
+         p[3];
+}
+
+struct oui_table *
+oui_open ( const char *path )
+{
+  struct oui_table *table;
+  struct stat st;
+  void *map;
+  int fd, saved_errno;
+
+  if ( ( fd = open ( path, O_RDONLY ) ) < 0 )
+    return NULL;
+  if ( fstat ( fd, &st ) < 0 )
+    {
+      saved_errno = errno;
+      close ( fd );
+      errno = saved_errno;
+      return NULL;
+    }
+  if ( st.st_size < OUI_HEADER_SIZE )
+    {
+      close ( fd );
+      errno = EINVAL;
+      return NULL;
+    }
+  map = mmap ( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+  saved_errno = errno;
+  close ( fd );
+  if ( map == MAP_FAILED )
+    {
+      errno = saved_errno;
+      return NULL;
+    }
+
+  if ( !( table = malloc ( sizeof ( struct oui_table ) ) ) )
+    {
+      munmap ( map, st.st_size );
+      errno = ENOMEM;
+      return NULL;
+    }
+  table->map = map;
+  table->size = st.st_size;
+  table->count = get32 ( table->map + 8 );
+  table->names_size = get32 ( table->map + 12 );
+  table->entries = table->map + OUI_HEADER_SIZE;
+  table->names =
+          ( const char * ) table->entries + table->count * OUI_ENTRY_SIZE;
+  table->last_prefix = 0xffffffffUL;
+  table->last_vendor = NULL;
+
+  /* Everything the lookups rely on is checked here, once */
+  if ( memcmp ( table->map, OUI_MAGIC, 8 ) != 0 ||
+       table->count > ( table->size - OUI_HEADER_SIZE ) / OUI_ENTRY_SIZE ||
+       table->names_size != table->size - OUI_HEADER_SIZE -
+                                    table->count * OUI_ENTRY_SIZE ||
+       ( table->names_size && table->names[table->names_size - 1] != 0 ) )
+    {
+      oui_close ( table );
+      errno = EINVAL;
+      return NULL;
+    }
+  return table;
+}
+
+void
+oui_close ( struct oui_table *table )
+{
+  if ( !table )
+    return;
+  munmap ( ( void * ) table->map, table->size );
+  free ( table );
+}
+
+const char *
+oui_lookup ( struct oui_table *table, const unsigned char *mac )
+{
+  unsigned long prefix = ( mac[0] << 16 ) | ( mac[1] << 8 ) | mac[2];
+  unsigned long low = 0, high = table->count, middle, found, offset;
+  const unsigned char *entry;
+
+  if ( prefix == table->last_prefix )
+    return table->last_vendor;
+
+  table->last_prefix = prefix;
+  table->last_vendor = NULL;
+  while ( low < high )
+    {
+      middle = ( low + high ) / 2;
+      entry = table->entries + middle * OUI_ENTRY_SIZE;
+      found = ( entry[0] << 16 ) | ( entry[1] << 8 ) | entry[2];
+      if ( found == prefix )
+        {
+          offset = get32 ( entry + 4 );
+          if ( offset < table->names_size )
+            table->last_vendor = table->names + offset;
+          break;
+        }
+      if ( found < prefix )
+        low = middle + 1;
+      else
+        high = middle;
+    }
+  return table->last_vendor;
+}
@@ -0,0 +1,63 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#if !defined OUI_H
+#define OUI_H
+
+#include <stddef.h>
+
+/* MAC address vendors, from a table compiled offline by nbtscan-oui from
+   the IEEE OUI list or a Wireshark manuf file. The table is mapped into
+   memory as it is and searched by the 24 bit prefix, nothing is parsed or
+   allocated per lookup.
+
+   Layout, numbers big endian:
+     header   "NBTOUI1\0", count (4 bytes), size of the names (4 bytes)
+     entries  count times: prefix (3 bytes), 0, offset of the name (4
+              bytes), sorted by prefix
+     names    NUL terminated vendor names */
+
+#define OUI_MAGIC "NBTOUI1"
+#define OUI_HEADER_SIZE 16
+#define OUI_ENTRY_SIZE 8
+
+struct oui_table
+{
+  const unsigned char *map;
+  size_t size;
+  unsigned long count;
+  const unsigned char *entries;
+  const char *names;
+  size_t names_size;
+  unsigned long last_prefix; /* the last lookup, hosts of a vendor tend to
+                                come together */
+  const char *last_vendor;
+};
+
+/* oui_open maps the table at path. Returns NULL with errno set on failure,
+   EINVAL if it is not a table. */
+struct oui_table *
+oui_open ( const char *path );
+
+void
+oui_close ( struct oui_table *table );
+
+/* oui_lookup returns the vendor of the MAC address mac, or NULL if it is
+   not known. The name stays valid until the table is closed. */
+const char *
+oui_lookup ( struct oui_table *table, const unsigned char *mac );
+
+#endif /* OUI_H */
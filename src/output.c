@@ -0,0 +1,709 @@
+/*
+# Copyright 1999-2003 Alla Bezroutchko <alla@inetcat.org>
+# Copyright 2004      Jochen Friedrich <jochen@scram.de>
+# Copyright 2008      Walter "Wallie" Jakob Doekes <walter@wjd.nu>
+# Copyright 2015      Johan Eidenvall <bugreport@eidenvall.se>
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#if HAVE_STDINT_H
+#include <stdint.h>
+#endif
+#include "statusq.h"
+#include "output.h"
+
+void
+print_header ( FILE *out, int show_rtt )
+{
+  fprintf ( out,
+            "%-17s%-17s%-10s%-17s%-17s",
+            "IP address",
+            "NetBIOS Name",
+            "Server",
+            "User",
+            "MAC address" );
+  if ( show_rtt )
+    fprintf ( out, "  %s", "RTT (ms)" );
+  fprintf ( out, "\n" );
+  fputs ( "-------------------------------------------------------------------"
+          "-----------\n",
+          out );
+}
+
+void
+print_block_header ( FILE *out )
+{
+  fprintf ( out,
+            "%-19s%8s%8s%10s%10s  %s\n",
+            "Block",
+            "Size",
+            "Probed",
+            "Answered",
+            "Estimate",
+            "95% interval" );
+  fputs ( "-------------------------------------------------------------------"
+          "-----------\n",
+          out );
+}
+
+/* estimate_block extrapolates the answer rate of the sample to the block.
+   The interval is the Wilson score interval, narrowed by the finite
+   population correction so that it closes up as the sample grows to the
+   whole block. */
+static void
+estimate_block ( const struct nbt_block *block,
+                 double *estimate,
+                 double *low,
+                 double *high )
+{
+  double n = block->probed, k = block->responded, size = block->size;
+  double z = 1.96, p, center, half, fpc;
+
+  if ( n == 0 )
+    {
+      *estimate = 0;
+      *low = 0;
+      *high = size;
+      return;
+    }
+  if ( k > n )
+    k = n;
+
+  p = k / n;
+  center = ( p + z * z / ( 2 * n ) ) / ( 1 + z * z / n );
+  half = z * sqrt ( p * ( 1 - p ) / n + z * z / ( 4 * n * n ) ) /
+         ( 1 + z * z / n );
+  fpc = size > 1 && n < size ? sqrt ( ( size - n ) / ( size - 1 ) ) : 0;
+  center = p + ( center - p ) * fpc;
+
+  *estimate = p * size;
+  *low = size * ( center - half * fpc );
+  *high = size * ( center + half * fpc );
+  /* What was seen is certain */
+  if ( *low < k )
+    *low = k;
+  if ( *high > size - ( n - k ) )
+    *high = size - ( n - k );
+}
+
+void
+print_block ( FILE *out, const struct nbt_block *block, char *sf )
+{
+  struct in_addr start;
+  char prefix[24];
+  double estimate, low, high;
+
+  start.s_addr = htonl ( block->start );
+  snprintf ( prefix, sizeof prefix, "%s/16", inet_ntoa ( start ) );
+  estimate_block ( block, &estimate, &low, &high );
+
+  if ( sf )
+    fprintf ( out,
+              "%s%s%lu%s%lu%s%lu%s%.0f%s%.0f%s%.0f\n",
+              prefix,
+              sf,
+              block->size,
+              sf,
+              block->probed,
+              sf,
+              block->responded,
+              sf,
+              estimate,
+              sf,
+              low,
+              sf,
+              high );
+  else
+    fprintf ( out,
+              "%-19s%8lu%8lu%10lu%10.0f  %.0f-%.0f\n",
+              prefix,
+              block->size,
+              block->probed,
+              block->responded,
+              estimate,
+              low,
+              high );
+}
+
+void
+print_pruned_header ( FILE *out )
+{
+  fprintf ( out, "%-35s%10s%10s\n", "Pruned range", "Size", "Probed" );
+  fputs ( "-------------------------------------------------------\n", out );
+}
+
+void
+print_pruned ( FILE *out, const struct nbt_block *block, char *sf )
+{
+  struct in_addr addr;
+  char range[36];
+  int len;
+
+  addr.s_addr = htonl ( block->start );
+  len = snprintf ( range, sizeof range, "%s-", inet_ntoa ( addr ) );
+  addr.s_addr = htonl ( block->start + block->size - 1 );
+  snprintf ( range + len, sizeof range - len, "%s", inet_ntoa ( addr ) );
+
+  if ( sf )
+    fprintf ( out,
+              "%s%spruned%s%lu%s%lu\n",
+              range,
+              sf,
+              sf,
+              block->size,
+              sf,
+              block->probed );
+  else
+    fprintf ( out, "%-35s%10lu%10lu\n", range, block->size, block->probed );
+}
+
+#define DUP( code ) code, code
+
+static void
+print_nb_host_info_header ( FILE *out,
+                            const nbname_response_header_t *header )
+{
+  fprintf ( out,
+            "Transaction ID: 0x%04x (%d)\n",
+            DUP ( header->transaction_id ) );
+  fprintf ( out, "Flags: 0x%04x (%d)\n", DUP ( header->flags ) );
+  fprintf ( out,
+            "Question count: 0x%04x (%d)\n",
+            DUP ( header->question_count ) );
+  fprintf ( out, "Answer count: 0x%04x (%d)\n", DUP ( header->answer_count ) );
+  fprintf ( out,
+            "Name service count: 0x%04x (%d)\n",
+            DUP ( header->name_service_count ) );
+  fprintf ( out,
+            "Additional record count: 0x%04x (%d)\n",
+            DUP ( header->additional_record_count ) );
+  fprintf ( out, "Question name: %s\n", header->question_name );
+  fprintf ( out,
+            "Question type: 0x%04x (%d)\n",
+            DUP ( header->question_type ) );
+  fprintf ( out,
+            "Question class: 0x%04x (%d)\n",
+            DUP ( header->question_class ) );
+  fprintf ( out, "Time to live: 0x%08x (%d)\n", DUP ( header->ttl ) );
+  fprintf ( out, "Rdata length: 0x%04x (%d)\n", DUP ( header->rdata_length ) );
+  fprintf ( out,
+            "Number of names: 0x%02x (%d)\n",
+            DUP ( header->number_of_names ) );
+}
+
+static void
+print_nb_host_info_footer ( FILE *out,
+                            const nbname_response_footer_t *footer )
+{
+  fprintf ( out,
+            "Adapter address: %02x:%02x:%02x:%02x:%02x:%02x\n",
+            footer->adapter_address[0],
+            footer->adapter_address[1],
+            footer->adapter_address[2],
+            footer->adapter_address[3],
+            footer->adapter_address[4],
+            footer->adapter_address[5] );
+
+  fprintf ( out,
+            "Version major: 0x%02x (%d)\n",
+            DUP ( footer->version_major ) );
+  fprintf ( out,
+            "Version minor: 0x%02x (%d)\n",
+            DUP ( footer->version_minor ) );
+  fprintf ( out, "Duration: 0x%04x (%d)\n", DUP ( footer->duration ) );
+  fprintf ( out,
+            "FRMRs Received: 0x%04x (%d)\n",
+            DUP ( footer->frmps_received ) );
+
+  fprintf ( out,
+            "FRMRs Transmitted: 0x%04x (%d)\n",
+            DUP ( footer->frmps_transmitted ) );
+
+  fprintf ( out,
+            "IFrame Receive errors: 0x%04x (%d)\n",
+            DUP ( footer->iframe_receive_errors ) );
+
+  fprintf ( out,
+            "Transmit aborts: 0x%04x (%d)\n",
+            DUP ( footer->transmit_aborts ) );
+  fprintf ( out, "Transmitted: 0x%08x (%d)\n", DUP ( footer->transmitted ) );
+  fprintf ( out, "Received: 0x%08x (%d)\n", DUP ( footer->received ) );
+
+  fprintf ( out,
+            "IFrame transmit errors: 0x%04x (%d)\n",
+            DUP ( footer->iframe_transmit_errors ) );
+
+  fprintf ( out,
+            "No receive buffers: 0x%04x (%d)\n",
+            DUP ( footer->no_receive_buffer ) );
+
+  fprintf ( out, "tl timeouts: 0x%04x (%d)\n", DUP ( footer->tl_timeouts ) );
+  fprintf ( out, "ti timeouts: 0x%04x (%d)\n", DUP ( footer->ti_timeouts ) );
+  fprintf ( out, "Free NCBS: 0x%04x (%d)\n", DUP ( footer->free_ncbs ) );
+  fprintf ( out, "NCBS: 0x%04x (%d)\n", DUP ( footer->ncbs ) );
+  fprintf ( out, "Max NCBS: 0x%04x (%d)\n", DUP ( footer->max_ncbs ) );
+
+  fprintf ( out,
+            "No transmit buffers: 0x%04x (%d)\n",
+            DUP ( footer->no_transmit_buffers ) );
+
+  fprintf ( out, "Max datagram: 0x%04x (%d)\n", DUP ( footer->max_datagram ) );
+
+  fprintf ( out,
+            "Pending sessions: 0x%04x (%d)\n",
+            DUP ( footer->pending_sessions ) );
+
+  fprintf ( out, "Max sessions: 0x%04x (%d)\n", DUP ( footer->max_sessions ) );
+  fprintf ( out,
+            "Packet sessions: 0x%04x (%d)\n",
+            DUP ( footer->packet_sessions ) );
+}
+
+void
+d_print_hostinfo ( FILE *out,
+                   struct in_addr addr,
+                   const struct nb_host_info *hostinfo,
+                   double rtt )
+{
+  int i;
+  unsigned char service; /* 16th byte of NetBIOS name */
+  char name[16];
+
+  fprintf ( out, "\nPacket dump for Host %s:\n\n", inet_ntoa ( addr ) );
+  if ( hostinfo->is_broken )
+    fprintf ( out, "Incomplete packet, %d bytes long.\n", hostinfo->is_broken );
+  if ( rtt >= 0 )
+    fprintf ( out, "Round trip time: %.3f ms\n", rtt * 1000 );
+
+  if ( hostinfo->header )
+    print_nb_host_info_header ( out, hostinfo->header );
+
+  if ( hostinfo->names )
+    {
+      fprintf ( out, "Names received:\n" );
+      for ( i = 0; i < hostinfo->header->number_of_names; i++ )
+        {
+          service = hostinfo->names[i].ascii_name[15];
+          strncpy ( name, hostinfo->names[i].ascii_name, 15 );
+          name[15] = 0;
+          fprintf ( out,
+                    "%-17s Service: 0x%02x Flags: 0x%04x\n",
+                    name,
+                    service,
+                    hostinfo->names[i].rr_flags );
+        }
+    }
+
+  if ( hostinfo->footer )
+    print_nb_host_info_footer ( out, hostinfo->footer );
+}
+
+int
+v_print_hostinfo ( FILE *out,
+                   struct in_addr addr,
+                   const struct nb_host_info *hostinfo,
+                   char *sf,
+                   int hr )
+{
+  int i, unique;
+  my_uint8_t service; /* 16th byte of NetBIOS name */
+  char name[16];
+
+  if ( !sf )
+    {
+      fprintf ( out,
+                "\nNetBIOS Name Table for Host %s:\n\n",
+                inet_ntoa ( addr ) );
+      if ( hostinfo->is_broken )
+        fprintf ( out,
+                  "Incomplete packet, %d bytes long.\n",
+                  hostinfo->is_broken );
+
+      fprintf ( out, "%-17s%-17s%-17s\n", "Name", "Service", "Type" );
+      fprintf ( out, "----------------------------------------\n" );
+    }
+  if ( hostinfo->header && hostinfo->names )
+    {
+      for ( i = 0; i < hostinfo->header->number_of_names; i++ )
+        {
+          service = hostinfo->names[i].ascii_name[15];
+          strncpy ( name, hostinfo->names[i].ascii_name, 15 );
+          name[15] = 0;
+          unique = !( hostinfo->names[i].rr_flags & 0x0080 );
+          if ( sf )
+            {
+              fprintf ( out, "%s%s%s%s", inet_ntoa ( addr ), sf, name, sf );
+              if ( hr )
+                fprintf ( out,
+                          "%s\n",
+                          getnbservicename ( service, unique, name ) );
+              else
+                {
+                  fprintf ( out, "%02x", service );
+                  if ( unique )
+                    fprintf ( out, "U\n" );
+                  else
+                    fprintf ( out, "G\n" );
+                }
+            }
+          else
+            {
+              fprintf ( out, "%-17s", name );
+              if ( hr )
+                fprintf ( out,
+                          "%s\n",
+                          getnbservicename ( service, unique, name ) );
+              else
+                {
+                  fprintf ( out, "<%02x>", service );
+                  if ( unique )
+                    fprintf ( out, "             UNIQUE\n" );
+                  else
+                    fprintf ( out, "              GROUP\n" );
+                }
+            }
+        }
+    }
+
+  if ( hostinfo->footer )
+    {
+      if ( sf )
+        fprintf ( out, "%s%sMAC%s", inet_ntoa ( addr ), sf, sf );
+      else
+        fprintf ( out, "\nAdapter address: " );
+      fprintf ( out,
+                "%02x:%02x:%02x:%02x:%02x:%02x\n",
+                hostinfo->footer->adapter_address[0],
+                hostinfo->footer->adapter_address[1],
+                hostinfo->footer->adapter_address[2],
+                hostinfo->footer->adapter_address[3],
+                hostinfo->footer->adapter_address[4],
+                hostinfo->footer->adapter_address[5] );
+    }
+  if ( !sf )
+    fprintf ( out, "----------------------------------------\n" );
+  return 1;
+}
+
+/* What pick_names is to look for */
+#define PICK_NAME 0x01
+#define PICK_SERVER 0x02
+#define PICK_USER 0x04
+
+/* pick_names finds the computer name, the user name and whether the host
+   is a server in the name table, looking no further than needed for the
+   ones in wanted */
+static void
+pick_names ( const struct nb_host_info *hostinfo,
+             int wanted,
+             char *comp_name,
+             char *user_name,
+             int *is_server )
+{
+  int i;
+  unsigned char service; /* 16th byte of NetBIOS name */
+  int unique;
+  int first_name = 1;
+
+  strncpy ( comp_name, "<unknown>", 15 );
+  strncpy ( user_name, "<unknown>", 15 );
+  *is_server = 0;
+  if ( hostinfo->header && hostinfo->names )
+    {
+      for ( i = 0; i < hostinfo->header->number_of_names; i++ )
+        {
+          service = hostinfo->names[i].ascii_name[15];
+          unique = !( hostinfo->names[i].rr_flags & 0x0080 );
+          if ( service == 0 && unique && first_name )
+            {
+              /* Unique name, workstation service - this is computer name */
+              strncpy ( comp_name, hostinfo->names[i].ascii_name, 15 );
+              comp_name[15] = 0;
+              first_name = 0;
+            }
+          if ( service == 0x20 && unique )
+            {
+              *is_server = 1;
+            }
+          if ( service == 0x03 && unique )
+            {
+              strncpy ( user_name, hostinfo->names[i].ascii_name, 15 );
+              user_name[15] = 0;
+            }
+          /* The last user name counts, anything else the first one */
+          if ( !( wanted & PICK_USER ) &&
+               ( !( wanted & PICK_NAME ) || !first_name ) &&
+               ( !( wanted & PICK_SERVER ) || *is_server ) )
+            break;
+        }
+    }
+}
+
+int
+print_hostinfo ( FILE *out,
+                 struct in_addr addr,
+                 const struct nb_host_info *hostinfo,
+                 char *sf,
+                 double rtt )
+{
+  char comp_name[16], user_name[16];
+  int is_server;
+
+  pick_names ( hostinfo,
+               PICK_NAME | PICK_SERVER | PICK_USER,
+               comp_name,
+               user_name,
+               &is_server );
+
+  if ( sf )
+    {
+      fprintf ( out, "%s%s%s%s", inet_ntoa ( addr ), sf, comp_name, sf );
+      if ( is_server )
+        fprintf ( out, "<server>" );
+      fprintf ( out, "%s%s%s", sf, user_name, sf );
+    }
+  else
+    {
+      fprintf ( out, "%-17s%-17s", inet_ntoa ( addr ), comp_name );
+      if ( is_server )
+        fprintf ( out, "%-10s", "<server>" );
+      else
+        fprintf ( out, "%-10s", "" );
+      fprintf ( out, "%-17s", user_name );
+    }
+  if ( hostinfo->footer )
+    {
+      fprintf ( out,
+                "%02x:%02x:%02x:%02x:%02x:%02x",
+                hostinfo->footer->adapter_address[0],
+                hostinfo->footer->adapter_address[1],
+                hostinfo->footer->adapter_address[2],
+                hostinfo->footer->adapter_address[3],
+                hostinfo->footer->adapter_address[4],
+                hostinfo->footer->adapter_address[5] );
+    }
+  else if ( rtt >= 0 && !sf )
+    {
+      fprintf ( out, "%-17s", "" );
+    }
+  if ( rtt >= 0 )
+    {
+      if ( sf )
+        fprintf ( out, "%s%.3f", sf, rtt * 1000 );
+      else
+        fprintf ( out, "  %.3f", rtt * 1000 );
+    }
+  fprintf ( out, "\n" );
+  return 1;
+}
+
+/* The columns --fields can select, with their headers and widths in the
+   default output, the same as print_hostinfo() has. The MAC address fills
+   its 17 columns, so it gets the two spaces print_hostinfo() puts before
+   the round trip time. */
+static const struct
+{
+  const char *name;
+  const char *header;
+  int width;
+  int parts; /* of the response it needs parsed */
+  int pick;  /* of the name table it needs found */
+} fields[] = {
+        { "ip", "IP address", 17, 0, 0 },
+        { "name", "NetBIOS Name", 17, NB_PARSE_NAMES, PICK_NAME },
+        { "server", "Server", 10, NB_PARSE_NAMES, PICK_SERVER },
+        { "user", "User", 17, NB_PARSE_NAMES, PICK_USER },
+        { "mac", "MAC address", 19, NB_PARSE_MAC, 0 },
+        { "rtt", "RTT (ms)", 10, 0, 0 },
+        { "vendor", "Vendor", 28, NB_PARSE_MAC, 0 },
+        { "dns", "DNS name", 32, 0, 0 },
+};
+
+#define FIELD_COUNT ( int ) ( sizeof fields / sizeof fields[0] )
+
+int
+compile_fields ( const char *list, struct field_plan *plan )
+{
+  const char *p = list, *end;
+  int i;
+
+  memset ( plan, 0, sizeof ( struct field_plan ) );
+  for ( ;; )
+    {
+      end = strchr ( p, ',' );
+      if ( !end )
+        end = p + strlen ( p );
+      for ( i = 0; i < FIELD_COUNT; i++ )
+        if ( strlen ( fields[i].name ) == ( size_t ) ( end - p ) &&
+             strncmp ( fields[i].name, p, end - p ) == 0 )
+          break;
+      if ( i == FIELD_COUNT || plan->count == FIELD_PLAN_MAX )
+        return 0;
+      plan->fields[plan->count++] = i;
+      plan->parts |= fields[i].parts;
+      plan->pick |= fields[i].pick;
+      if ( !*end )
+        return 1;
+      p = end + 1;
+    }
+}
+
+void
+print_fields_header ( FILE *out, const struct field_plan *plan )
+{
+  int i, width = 0;
+
+  for ( i = 0; i < plan->count; i++ )
+    {
+      fprintf ( out,
+                "%-*s",
+                fields[plan->fields[i]].width,
+                fields[plan->fields[i]].header );
+      width += fields[plan->fields[i]].width;
+    }
+  fprintf ( out, "\n" );
+  for ( i = 0; i < width; i++ )
+    fputc ( '-', out );
+  fprintf ( out, "\n" );
+}
+
+int
+f_print_hostinfo ( FILE *out,
+                   struct in_addr addr,
+                   const struct nb_host_info *hostinfo,
+                   const struct field_plan *plan,
+                   char *sf,
+                   double rtt,
+                   const char *dns_name )
+{
+  char comp_name[16], user_name[16], buff[24];
+  const char *value = "";
+  const my_uint8_t *mac;
+  int i, is_server = 0;
+
+  if ( plan->pick )
+    pick_names ( hostinfo, plan->pick, comp_name, user_name, &is_server );
+  for ( i = 0; i < plan->count; i++ )
+    {
+      switch ( plan->fields[i] )
+        {
+          case FIELD_IP:
+            value = inet_ntoa ( addr );
+            break;
+          case FIELD_NAME:
+            value = comp_name;
+            break;
+          case FIELD_SERVER:
+            value = is_server ? "<server>" : "";
+            break;
+          case FIELD_USER:
+            value = user_name;
+            break;
+          case FIELD_MAC:
+            value = "";
+            if ( hostinfo->footer )
+              {
+                mac = hostinfo->footer->adapter_address;
+                snprintf ( buff,
+                           sizeof buff,
+                           "%02x:%02x:%02x:%02x:%02x:%02x",
+                           mac[0],
+                           mac[1],
+                           mac[2],
+                           mac[3],
+                           mac[4],
+                           mac[5] );
+                value = buff;
+              }
+            break;
+          case FIELD_RTT:
+            value = "";
+            if ( rtt >= 0 )
+              {
+                snprintf ( buff, sizeof buff, "%.3f", rtt * 1000 );
+                value = buff;
+              }
+            break;
+          case FIELD_VENDOR:
+            value = "";
+            if ( hostinfo->footer && plan->oui &&
+                 !( value = oui_lookup ( plan->oui,
+                                         hostinfo->footer->adapter_address ) ) )
+              value = "";
+            break;
+          case FIELD_DNS:
+            value = dns_name ? dns_name : "";
+            break;
+        }
+      if ( sf )
+        {
+          if ( i )
+            fputs ( sf, out );
+          fputs ( value, out );
+        }
+      else if ( i < plan->count - 1 )
+        fprintf ( out, "%-*s", fields[plan->fields[i]].width, value );
+      else
+        fputs ( value, out );
+    }
+  fprintf ( out, "\n" );
+  return 1;
+}
+
+/* Print hostinfo in /etc/hosts or lmhosts format */
+/* If l is true adds #PRE to each line of output (for lmhosts) */
+
+void
+l_print_hostinfo ( FILE *out,
+                   struct in_addr addr,
+                   const struct nb_host_info *hostinfo,
+                   int l )
+{
+  int i;
+  unsigned char service; /* 16th byte of NetBIOS name */
+  char comp_name[16];
+  int unique;
+  int first_name = 1;
+
+  strncpy ( comp_name, "<unknown>", 15 );
+
+  if ( hostinfo->header && hostinfo->names )
+    {
+      for ( i = 0; i < hostinfo->header->number_of_names; i++ )
+        {
+          service = hostinfo->names[i].ascii_name[15];
+          unique = !( hostinfo->names[i].rr_flags & 0x0080 );
+          if ( service == 0 && unique && first_name )
+            {
+              /* Unique name, workstation service - this is computer name */
+              strncpy ( comp_name, hostinfo->names[i].ascii_name, 15 );
+              comp_name[15] = 0;
+              first_name = 0;
+            }
+        }
+    }
+  fprintf ( out, "%s\t%s", inet_ntoa ( addr ), comp_name );
+  if ( l )
+    fprintf ( out, "\t#PRE" );
+  fprintf ( out, "\n" );
+}
@@ -0,0 +1,129 @@
+/*
+# Copyright 1999-2003 Alla Bezroutchko <alla@inetcat.org>
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#if !defined OUTPUT_H
+#define OUTPUT_H
+
+#include <stdio.h>
+#include <netinet/in.h>
+#include "statusq.h"
+#include "nbtscan.h"
+#include "oui.h"
+
+/* Column headers of the default output */
+void
+print_header ( FILE *out, int show_rtt );
+
+/* Packet dump (-d) */
+void
+d_print_hostinfo ( FILE *out,
+                   struct in_addr addr,
+                   const struct nb_host_info *hostinfo,
+                   double rtt );
+
+/* Whole name table (-v), script-friendly if sf is not NULL, with service
+   names instead of codes if hr is set */
+int
+v_print_hostinfo ( FILE *out,
+                   struct in_addr addr,
+                   const struct nb_host_info *hostinfo,
+                   char *sf,
+                   int hr );
+
+/* One line per host, the default. rtt is printed as an additional column
+   unless it is negative. */
+int
+print_hostinfo ( FILE *out,
+                 struct in_addr addr,
+                 const struct nb_host_info *hostinfo,
+                 char *sf,
+                 double rtt );
+
+/* Column headers of the per block estimates of a sampling scan */
+void
+print_block_header ( FILE *out );
+
+/* The responding hosts of a /16 extrapolated from a sample, with a 95%
+   confidence interval. Script-friendly if sf is not NULL. */
+void
+print_block ( FILE *out, const struct nbt_block *block, char *sf );
+
+/* Column headers of the blocks pruning left out */
+void
+print_pruned_header ( FILE *out );
+
+/* A run of blocks pruning left out, as a range of addresses. Marked as
+   pruned in a script-friendly line if sf is not NULL. */
+void
+print_pruned ( FILE *out, const struct nbt_block *block, char *sf );
+
+/* Columns of the output chosen with --fields, in the order of the table
+   in output.c */
+enum field
+{
+  FIELD_IP,
+  FIELD_NAME,
+  FIELD_SERVER,
+  FIELD_USER,
+  FIELD_MAC,
+  FIELD_RTT,
+  FIELD_VENDOR,
+  FIELD_DNS
+};
+
+#define FIELD_PLAN_MAX 16
+
+/* The columns to print and what of each response they take */
+struct field_plan
+{
+  int fields[FIELD_PLAN_MAX]; /* enum field, in output order */
+  int count;
+  int parts; /* NB_PARSE_* parts of the response to parse */
+  int pick;  /* names to look for in the name table */
+  struct oui_table *oui; /* vendors of MAC addresses, for FIELD_VENDOR */
+};
+
+/* compile_fields turns a comma separated list of column names into plan.
+   Returns 0 if a name is unknown or there are too many. plan->oui is left
+   for the caller to set. */
+int
+compile_fields ( const char *list, struct field_plan *plan );
+
+/* Column headers of the columns of plan */
+void
+print_fields_header ( FILE *out, const struct field_plan *plan );
+
+/* The columns of plan, separated by sf if it is not NULL. rtt is left
+   empty if it is negative, and so is the DNS name if dns_name is NULL. */
+int
+f_print_hostinfo ( FILE *out,
+                   struct in_addr addr,
+                   const struct nb_host_info *hostinfo,
+                   const struct field_plan *plan,
+                   char *sf,
+                   double rtt,
+                   const char *dns_name );
+
+/* /etc/hosts format, or lmhosts format (#PRE added) if l is set */
+void
+l_print_hostinfo ( FILE *out,
+                   struct in_addr addr,
+                   const struct nb_host_info *hostinfo,
+                   int l );
+
+#endif /* OUTPUT_H */
@@ -0,0 +1,535 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/* Passive collection: learn hosts from the NetBIOS name service traffic
+   that crosses the segment anyway. Name registrations, refreshes and
+   positive name query responses tell a name and the address it belongs
+   to; node status responses carry a whole name table and are handed to
+   parse_response(). Everything heard about a host is merged and reported
+   as if the host had answered a node status query. */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#if defined HAVE_NETPACKET_PACKET_H && defined HAVE_LINUX_FILTER_H
+#include <net/if.h>
+#include <net/ethernet.h>
+#include <netpacket/packet.h>
+#include <linux/filter.h>
+#define HAVE_CAPTURE 1
+#endif
+#include "nbtscan.h"
+#include "statusq.h"
+
+#define BUFFSIZE 2048
+#define PASSIVE_BATCH 64  /* packets read by one nbt_passive_step() call */
+#define PASSIVE_BUCKETS 1024
+
+#define OPCODE_QUERY 0
+#define OPCODE_REGISTRATION 5
+#define OPCODE_REFRESH 8
+#define OPCODE_REFRESH_ALT 9 /* used for refresh by most implementations */
+#define RR_TYPE_NB 0x0020
+#define RR_TYPE_NBSTAT 0x0021
+#define MAX_NAMES 255 /* number_of_names is one byte */
+
+struct passive_host
+{
+  struct passive_host *hash_next;
+  struct passive_host *next; /* in the order hosts were heard of */
+  unsigned long addr;        /* host byte order */
+  my_uint8_t mac[6];
+  int has_mac;
+  struct nb_host_info *status; /* last node status response, or NULL */
+  int count;                   /* names gathered from other packets */
+  struct nbname *names;
+};
+
+struct nbt_passive
+{
+  int sock;
+  int capture; /* sock is a packet socket */
+  struct passive_host *buckets[PASSIVE_BUCKETS];
+  struct passive_host *first;
+  struct passive_host *last;
+  unsigned long hosts;
+  unsigned char buff[BUFFSIZE];
+};
+
+static unsigned int
+get16 ( const unsigned char *p )
+{
+  return ( p[0] << 8 ) | p[1];
+}
+
+static unsigned long
+get32 ( const unsigned char *p )
+{
+  return ( ( unsigned long ) get16 ( p ) << 16 ) | get16 ( p + 2 );
+}
+
+static unsigned int
+hash_addr ( unsigned long addr )
+{
+  return ( ( addr * 2654435761UL ) >> 12 ) & ( PASSIVE_BUCKETS - 1 );
+}
+
+/* find_host returns the host at addr, new if it was not heard of yet, or
+   NULL if memory ran out */
+static struct passive_host *
+find_host ( struct nbt_passive *passive, unsigned long addr )
+{
+  struct passive_host *host;
+  unsigned int bucket = hash_addr ( addr );
+
+  for ( host = passive->buckets[bucket]; host; host = host->hash_next )
+    if ( host->addr == addr )
+      return host;
+
+  host = malloc ( sizeof ( struct passive_host ) );
+  if ( !host )
+    return NULL;
+  memset ( host, 0, sizeof ( struct passive_host ) );
+  host->addr = addr;
+  host->hash_next = passive->buckets[bucket];
+  passive->buckets[bucket] = host;
+  if ( passive->last )
+    passive->last->next = host;
+  else
+    passive->first = host;
+  passive->last = host;
+  passive->hosts++;
+  return host;
+}
+
+static void
+free_hostinfo ( struct nb_host_info *hostinfo )
+{
+  if ( !hostinfo )
+    return;
+  free ( hostinfo->header );
+  free ( hostinfo->footer );
+  free ( hostinfo->names );
+  free ( hostinfo );
+}
+
+/* add_name records that name (16 bytes, the last one the service) with
+   the NB_FLAGS in flags (wire order) belongs to host. Returns 0, or -1 if
+   memory ran out. */
+static int
+add_name ( struct passive_host *host,
+           const char *name,
+           const unsigned char *flags )
+{
+  struct nbname *names;
+  int i;
+
+  for ( i = 0; i < host->count; i++ )
+    if ( memcmp ( host->names[i].ascii_name, name, 16 ) == 0 )
+      {
+        memcpy ( &host->names[i].rr_flags, flags, 2 );
+        return 0;
+      }
+  if ( host->count == MAX_NAMES )
+    return 0;
+
+  names = realloc ( host->names,
+                    ( host->count + 1 ) * sizeof ( struct nbname ) );
+  if ( !names )
+    return -1;
+  host->names = names;
+  memcpy ( names[host->count].ascii_name, name, 16 );
+  /* Kept in wire order, the way parse_response() leaves rr_flags */
+  memcpy ( &names[host->count].rr_flags, flags, 2 );
+  host->count++;
+  return 0;
+}
+
+/* read_name decodes the first level encoded NetBIOS name at offset into
+   name[16] and stores the offset after it in *next. Compression pointers
+   are followed. Returns 0, or -1 if the name is malformed. */
+static int
+read_name ( const unsigned char *data,
+            int len,
+            int offset,
+            char *name,
+            int *next )
+{
+  int i, label, target;
+
+  if ( offset + 2 <= len && ( data[offset] & 0xc0 ) == 0xc0 )
+    {
+      target = ( ( data[offset] & 0x3f ) << 8 ) | data[offset + 1];
+      *next = offset + 2;
+      /* Pointers may only go backwards, which also rules out loops */
+      if ( target >= offset )
+        return -1;
+      return read_name ( data, len, target, name, &i );
+    }
+
+  if ( offset + 33 > len || data[offset] != 32 )
+    return -1;
+  for ( i = 0; i < 16; i++ )
+    {
+      if ( data[offset + 1 + i * 2] < 'A' || data[offset + 1 + i * 2] > 'P' ||
+           data[offset + 2 + i * 2] < 'A' || data[offset + 2 + i * 2] > 'P' )
+        return -1;
+      name[i] = ( ( data[offset + 1 + i * 2] - 'A' ) << 4 ) |
+                ( data[offset + 2 + i * 2] - 'A' );
+    }
+
+  /* Skip the scope, if any */
+  offset += 33;
+  while ( offset < len && ( label = data[offset] ) != 0 )
+    {
+      if ( ( label & 0xc0 ) == 0xc0 )
+        {
+          offset++;
+          break;
+        }
+      offset += label + 1;
+    }
+  if ( offset >= len )
+    return -1;
+  *next = offset + 1;
+  return 0;
+}
+
+/* Take whatever a name service packet from src (mac, if not NULL) tells
+   about hosts. Returns 0, or -1 if memory ran out. */
+static int
+passive_packet ( struct nbt_passive *passive,
+                 unsigned char *data,
+                 int len,
+                 unsigned long src,
+                 const my_uint8_t *mac )
+{
+  struct passive_host *host;
+  struct nb_host_info *hostinfo;
+  unsigned int flags, opcode, records, type;
+  char name[16];
+  int offset, i, response, rdlength;
+
+  if ( len < 12 )
+    return 0;
+  flags = get16 ( data + 2 );
+  response = flags & FL_REQUEST;
+  opcode = ( flags >> 11 ) & 0x0f;
+  if ( response && ( flags & 0x000f ) != 0 )
+    return 0; /* negative response */
+  if ( opcode != OPCODE_QUERY && opcode != OPCODE_REGISTRATION &&
+       opcode != OPCODE_REFRESH && opcode != OPCODE_REFRESH_ALT )
+    return 0;
+
+  /* Skip the questions */
+  offset = 12;
+  for ( i = get16 ( data + 4 ); i > 0; i-- )
+    {
+      if ( read_name ( data, len, offset, name, &offset ) < 0 )
+        return 0;
+      offset += 4;
+    }
+
+  records = get16 ( data + 6 ) + get16 ( data + 8 ) + get16 ( data + 10 );
+  for ( ; records > 0; records-- )
+    {
+      if ( read_name ( data, len, offset, name, &offset ) < 0 ||
+           offset + 10 > len )
+        return 0;
+      type = get16 ( data + offset );
+      rdlength = get16 ( data + offset + 8 );
+      offset += 10;
+      if ( offset + rdlength > len )
+        return 0;
+
+      if ( type == RR_TYPE_NBSTAT && response )
+        {
+          /* A node status response, the full name table of src */
+          if ( !( hostinfo = parse_response ( ( char * ) data, len ) ) )
+            return 0;
+          if ( !( host = find_host ( passive, src ) ) )
+            {
+              free_hostinfo ( hostinfo );
+              return -1;
+            }
+          free_hostinfo ( host->status );
+          host->status = hostinfo;
+          if ( mac )
+            {
+              memcpy ( host->mac, mac, 6 );
+              host->has_mac = 1;
+            }
+          return 0;
+        }
+
+      if ( type == RR_TYPE_NB )
+        for ( i = 0; i + 6 <= rdlength; i += 6 )
+          {
+            host = find_host ( passive, get32 ( data + offset + i + 2 ) );
+            if ( !host || add_name ( host, name, data + offset + i ) < 0 )
+              return -1;
+            /* The MAC only belongs to the host if it sent the packet */
+            if ( mac && host->addr == src )
+              {
+                memcpy ( host->mac, mac, 6 );
+                host->has_mac = 1;
+              }
+          }
+      offset += rdlength;
+    }
+  return 0;
+}
+
+#if defined HAVE_CAPTURE
+/* Pass IPv4 UDP datagrams from or to port 137, unfragmented */
+static struct sock_filter nbns_filter[] = {
+  BPF_STMT ( BPF_LD | BPF_B | BPF_ABS, 9 ),
+  BPF_JUMP ( BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_UDP, 0, 8 ),
+  BPF_STMT ( BPF_LD | BPF_H | BPF_ABS, 6 ),
+  BPF_JUMP ( BPF_JMP | BPF_JSET | BPF_K, 0x1fff, 6, 0 ),
+  BPF_STMT ( BPF_LDX | BPF_B | BPF_MSH, 0 ),
+  BPF_STMT ( BPF_LD | BPF_H | BPF_IND, 0 ),
+  BPF_JUMP ( BPF_JMP | BPF_JEQ | BPF_K, NB_DGRAM, 2, 0 ),
+  BPF_STMT ( BPF_LD | BPF_H | BPF_IND, 2 ),
+  BPF_JUMP ( BPF_JMP | BPF_JEQ | BPF_K, NB_DGRAM, 0, 1 ),
+  BPF_STMT ( BPF_RET | BPF_K, BUFFSIZE ),
+  BPF_STMT ( BPF_RET | BPF_K, 0 ),
+};
+
+static int
+open_capture ( const char *ifname )
+{
+  struct sock_fprog prog = { sizeof nbns_filter / sizeof nbns_filter[0],
+                             nbns_filter };
+  struct sockaddr_ll sll;
+  int sock, saved_errno;
+
+  memset ( &sll, 0, sizeof sll );
+  sll.sll_family = AF_PACKET;
+  sll.sll_protocol = htons ( ETH_P_IP );
+  if ( !( sll.sll_ifindex = if_nametoindex ( ifname ) ) )
+    return -1;
+
+  if ( ( sock = socket ( AF_PACKET, SOCK_DGRAM, htons ( ETH_P_IP ) ) ) < 0 )
+    return -1;
+  if ( setsockopt ( sock, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof prog ) <
+               0 ||
+       bind ( sock, ( struct sockaddr * ) &sll, sizeof sll ) < 0 )
+    {
+      saved_errno = errno;
+      close ( sock );
+      errno = saved_errno;
+      return -1;
+    }
+  return sock;
+}
+
+/* Strip IP and UDP headers from a captured packet. Returns what
+   passive_packet() does. */
+static int
+capture_packet ( struct nbt_passive *passive,
+                 int size,
+                 const struct sockaddr_ll *sll )
+{
+  unsigned char *ip = passive->buff;
+  int ihl, udp_len;
+
+  if ( size < 20 || ( ip[0] >> 4 ) != 4 )
+    return 0;
+  ihl = ( ip[0] & 0x0f ) * 4;
+  if ( ihl < 20 || size < ihl + 8 )
+    return 0;
+  udp_len = get16 ( ip + ihl + 4 );
+  if ( udp_len < 8 || ihl + udp_len > size )
+    return 0;
+  return passive_packet ( passive,
+                          ip + ihl + 8,
+                          udp_len - 8,
+                          get32 ( ip + 12 ),
+                          sll->sll_halen == 6 ? sll->sll_addr : NULL );
+}
+#endif
+
+struct nbt_passive *
+nbt_passive_new ( const char *ifname, int share137 )
+{
+  struct nbt_passive *passive;
+  struct sockaddr_in addr;
+  int saved_errno, on = 1;
+
+  passive = malloc ( sizeof ( struct nbt_passive ) );
+  if ( !passive )
+    return NULL;
+  memset ( passive, 0, sizeof ( struct nbt_passive ) );
+
+  if ( ifname )
+    {
+#if defined HAVE_CAPTURE
+      passive->capture = 1;
+      passive->sock = open_capture ( ifname );
+#else
+      errno = ENOSYS;
+      passive->sock = -1;
+#endif
+    }
+  else if ( ( passive->sock = socket ( AF_INET, SOCK_DGRAM, IPPROTO_UDP ) ) >=
+            0 )
+    {
+      memset ( &addr, 0, sizeof addr );
+      addr.sin_family = AF_INET;
+      addr.sin_port = htons ( NB_DGRAM );
+      /* Like the scan socket, or a name server on the host could lose its
+         traffic to us */
+      if ( share137 )
+        setsockopt ( passive->sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on );
+      if ( bind ( passive->sock, ( struct sockaddr * ) &addr, sizeof addr ) <
+           0 )
+        {
+          saved_errno = errno;
+          close ( passive->sock );
+          passive->sock = -1;
+          errno = saved_errno;
+        }
+    }
+
+  if ( passive->sock < 0 )
+    {
+      saved_errno = errno;
+      free ( passive );
+      errno = saved_errno;
+      return NULL;
+    }
+  return passive;
+}
+
+int
+nbt_passive_fd ( const struct nbt_passive *passive )
+{
+  return passive->sock;
+}
+
+int
+nbt_passive_step ( struct nbt_passive *passive )
+{
+  struct sockaddr_in from;
+#if defined HAVE_CAPTURE
+  struct sockaddr_ll sll;
+#endif
+  socklen_t fromlen;
+  int size, i;
+
+  for ( i = 0; i < PASSIVE_BATCH; i++ )
+    {
+#if defined HAVE_CAPTURE
+      if ( passive->capture )
+        {
+          fromlen = sizeof sll;
+          size = recvfrom ( passive->sock,
+                            passive->buff,
+                            BUFFSIZE,
+                            MSG_DONTWAIT,
+                            ( struct sockaddr * ) &sll,
+                            &fromlen );
+          if ( size < 0 )
+            break;
+          if ( capture_packet ( passive, size, &sll ) < 0 )
+            return -1;
+          continue;
+        }
+#endif
+      fromlen = sizeof from;
+      size = recvfrom ( passive->sock,
+                        passive->buff,
+                        BUFFSIZE,
+                        MSG_DONTWAIT,
+                        ( struct sockaddr * ) &from,
+                        &fromlen );
+      if ( size < 0 )
+        break;
+      if ( passive_packet ( passive,
+                            passive->buff,
+                            size,
+                            ntohl ( from.sin_addr.s_addr ),
+                            NULL ) < 0 )
+        return -1;
+    }
+  return i;
+}
+
+unsigned long
+nbt_passive_hosts ( const struct nbt_passive *passive )
+{
+  return passive->hosts;
+}
+
+void
+nbt_passive_report ( const struct nbt_passive *passive,
+                     nbt_result_cb callback,
+                     void *arg )
+{
+  const struct passive_host *host;
+  struct nb_host_info hostinfo;
+  nbname_response_header_t header;
+  nbname_response_footer_t footer;
+  struct in_addr addr;
+
+  for ( host = passive->first; host; host = host->next )
+    {
+      addr.s_addr = htonl ( host->addr );
+      if ( host->status )
+        {
+          callback ( addr, host->status, -1, arg );
+          continue;
+        }
+
+      memset ( &hostinfo, 0, sizeof hostinfo );
+      memset ( &header, 0, sizeof header );
+      header.number_of_names = host->count;
+      hostinfo.header = &header;
+      hostinfo.names = host->names;
+      if ( host->has_mac )
+        {
+          memset ( &footer, 0, sizeof footer );
+          memcpy ( footer.adapter_address, host->mac, 6 );
+          hostinfo.footer = &footer;
+        }
+      callback ( addr, &hostinfo, -1, arg );
+    }
+}
+
+void
+nbt_passive_free ( struct nbt_passive *passive )
+{
+  struct passive_host *host, *next;
+
+  if ( !passive )
+    return;
+  for ( host = passive->first; host; host = next )
+    {
+      next = host->next;
+      free_hostinfo ( host->status );
+      free ( host->names );
+      free ( host );
+    }
+  close ( passive->sock );
+  free ( passive );
+}
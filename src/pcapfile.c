@@ -0,0 +1,278 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <netinet/in.h>
+#include "pcapfile.h"
+
+#define PCAP_MAGIC 0xa1b2c3d4UL
+#define PCAP_MAGIC_NS 0xa1b23c4dUL
+#define LINKTYPE_ETHERNET 1
+#define LINKTYPE_RAW 101
+#define ETHER_HEADER_SIZE 14
+#define ETHERTYPE_IP 0x0800
+#define PCAP_FILE_HEADER_SIZE 24
+#define PCAP_RECORD_HEADER_SIZE 16
+#define IPV4_HEADER_SIZE 20
+#define UDP_HEADER_SIZE 8
+
+/* The file and record headers are in the byte order of the host that
+   wrote them, packets in network byte order */
+
+static void
+put32 ( unsigned char *p, unsigned long v )
+{
+  my_uint32_t v32 = v;
+
+  memcpy ( p, &v32, 4 );
+}
+
+static void
+put16 ( unsigned char *p, unsigned int v )
+{
+  my_uint16_t v16 = v;
+
+  memcpy ( p, &v16, 2 );
+}
+
+static unsigned long
+get32 ( const struct pcap_reader *reader, const unsigned char *p )
+{
+  my_uint32_t v;
+
+  memcpy ( &v, p, 4 );
+  if ( reader->swapped )
+    v = ( v >> 24 ) | ( ( v >> 8 ) & 0xff00 ) | ( ( v << 8 ) & 0xff0000 ) |
+        ( v << 24 );
+  return v;
+}
+
+static unsigned int
+net16 ( const unsigned char *p )
+{
+  return ( p[0] << 8 ) | p[1];
+}
+
+static unsigned int
+ip_checksum ( const unsigned char *p, int size )
+{
+  unsigned long sum = 0;
+  int i;
+
+  for ( i = 0; i < size; i += 2 )
+    sum += net16 ( p + i );
+  while ( sum >> 16 )
+    sum = ( sum & 0xffff ) + ( sum >> 16 );
+  return ~sum & 0xffff;
+}
+
+FILE *
+pcap_create ( const char *path )
+{
+  unsigned char header[PCAP_FILE_HEADER_SIZE];
+  FILE *out;
+  int saved_errno;
+
+  if ( !( out = fopen ( path, "wb" ) ) )
+    return NULL;
+  put32 ( header, PCAP_MAGIC );
+  put16 ( header + 4, 2 ); /* version 2.4 */
+  put16 ( header + 6, 4 );
+  put32 ( header + 8, 0 );  /* GMT offset */
+  put32 ( header + 12, 0 ); /* timestamp accuracy */
+  put32 ( header + 16, PCAP_SNAPLEN );
+  put32 ( header + 20, LINKTYPE_RAW );
+  if ( fwrite ( header, sizeof header, 1, out ) != 1 )
+    {
+      saved_errno = errno;
+      fclose ( out );
+      errno = saved_errno;
+      return NULL;
+    }
+  return out;
+}
+
+int
+pcap_write ( FILE *out,
+             const struct sockaddr_in *src,
+             const struct sockaddr_in *dst,
+             const void *data,
+             unsigned int size,
+             const struct timeval *ts )
+{
+  unsigned char header[PCAP_RECORD_HEADER_SIZE + IPV4_HEADER_SIZE +
+                       UDP_HEADER_SIZE];
+  unsigned char *ip = header + PCAP_RECORD_HEADER_SIZE;
+  unsigned char *udp = ip + IPV4_HEADER_SIZE;
+  unsigned int length = IPV4_HEADER_SIZE + UDP_HEADER_SIZE + size;
+
+  if ( length > PCAP_SNAPLEN )
+    {
+      size = PCAP_SNAPLEN - IPV4_HEADER_SIZE - UDP_HEADER_SIZE;
+      length = PCAP_SNAPLEN;
+    }
+
+  put32 ( header, ts->tv_sec );
+  put32 ( header + 4, ts->tv_usec );
+  put32 ( header + 8, length );
+  put32 ( header + 12, length );
+
+  memset ( ip, 0, IPV4_HEADER_SIZE );
+  ip[0] = 0x45; /* version 4, 5 words of header */
+  ip[2] = length >> 8;
+  ip[3] = length & 0xff;
+  ip[8] = 64; /* TTL */
+  ip[9] = IPPROTO_UDP;
+  memcpy ( ip + 12, &src->sin_addr.s_addr, 4 );
+  memcpy ( ip + 16, &dst->sin_addr.s_addr, 4 );
+  put16 ( ip + 10, htons ( ip_checksum ( ip, IPV4_HEADER_SIZE ) ) );
+
+  /* No UDP checksum, which is allowed over IPv4 */
+  memcpy ( udp, &src->sin_port, 2 );
+  memcpy ( udp + 2, &dst->sin_port, 2 );
+  udp[4] = ( UDP_HEADER_SIZE + size ) >> 8;
+  udp[5] = ( UDP_HEADER_SIZE + size ) & 0xff;
+  udp[6] = udp[7] = 0;
+
+  if ( fwrite ( header, sizeof header, 1, out ) != 1 ||
+       ( size && fwrite ( data, size, 1, out ) != 1 ) )
+    return -1;
+  return 0;
+}
+
+struct pcap_reader *
+pcap_open ( const char *path )
+{
+  struct pcap_reader *reader;
+  unsigned char header[PCAP_FILE_HEADER_SIZE];
+  unsigned long magic;
+  int saved_errno;
+
+  reader = malloc ( sizeof ( struct pcap_reader ) );
+  if ( !reader )
+    return NULL;
+  memset ( reader, 0, sizeof ( struct pcap_reader ) );
+
+  if ( !( reader->file = fopen ( path, "rb" ) ) )
+    {
+      free ( reader );
+      return NULL;
+    }
+  if ( fread ( header, sizeof header, 1, reader->file ) != 1 )
+    {
+      saved_errno = ferror ( reader->file ) ? errno : EINVAL;
+      pcap_close ( reader );
+      errno = saved_errno;
+      return NULL;
+    }
+
+  magic = get32 ( reader, header );
+  if ( magic != PCAP_MAGIC && magic != PCAP_MAGIC_NS )
+    {
+      reader->swapped = 1;
+      magic = get32 ( reader, header );
+    }
+  reader->nanoseconds = magic == PCAP_MAGIC_NS;
+  reader->linktype = get32 ( reader, header + 20 );
+  if ( ( magic != PCAP_MAGIC && magic != PCAP_MAGIC_NS ) ||
+       ( reader->linktype != LINKTYPE_RAW &&
+         reader->linktype != LINKTYPE_ETHERNET ) )
+    {
+      pcap_close ( reader );
+      errno = EINVAL;
+      return NULL;
+    }
+  return reader;
+}
+
+void
+pcap_close ( struct pcap_reader *reader )
+{
+  if ( !reader )
+    return;
+  fclose ( reader->file );
+  free ( reader );
+}
+
+int
+pcap_next_udp ( struct pcap_reader *reader,
+                struct sockaddr_in *src,
+                struct sockaddr_in *dst,
+                const unsigned char **data,
+                struct timeval *ts )
+{
+  unsigned char header[PCAP_RECORD_HEADER_SIZE];
+  const unsigned char *ip, *udp;
+  unsigned long caplen;
+  unsigned int ip_size, udp_size, header_size;
+
+  for ( ;; )
+    {
+      if ( fread ( header, sizeof header, 1, reader->file ) != 1 )
+        return ferror ( reader->file ) ? -1 : 0;
+      caplen = get32 ( reader, header + 8 );
+      if ( caplen > PCAP_SNAPLEN ||
+           fread ( reader->packet, 1, caplen, reader->file ) != caplen )
+        {
+          errno = EINVAL;
+          return -1;
+        }
+
+      ip = reader->packet;
+      if ( reader->linktype == LINKTYPE_ETHERNET )
+        {
+          if ( caplen < ETHER_HEADER_SIZE ||
+               net16 ( ip + 12 ) != ETHERTYPE_IP )
+            continue;
+          ip += ETHER_HEADER_SIZE;
+          caplen -= ETHER_HEADER_SIZE;
+        }
+
+      if ( caplen < IPV4_HEADER_SIZE || ( ip[0] >> 4 ) != 4 ||
+           ip[9] != IPPROTO_UDP || ( net16 ( ip + 6 ) & 0x3fff ) )
+        continue; /* not UDP over IPv4, or a fragment */
+      header_size = ( ip[0] & 0x0f ) * 4;
+      ip_size = net16 ( ip + 2 );
+      if ( ip_size > caplen )
+        ip_size = caplen;
+      if ( ip_size < header_size + UDP_HEADER_SIZE )
+        continue;
+      udp = ip + header_size;
+      udp_size = net16 ( udp + 4 );
+      if ( udp_size < UDP_HEADER_SIZE || udp_size > ip_size - header_size )
+        udp_size = ip_size - header_size;
+      if ( udp_size == UDP_HEADER_SIZE )
+        continue;
+
+      memset ( src, 0, sizeof ( struct sockaddr_in ) );
+      memset ( dst, 0, sizeof ( struct sockaddr_in ) );
+      src->sin_family = dst->sin_family = AF_INET;
+      memcpy ( &src->sin_addr.s_addr, ip + 12, 4 );
+      memcpy ( &dst->sin_addr.s_addr, ip + 16, 4 );
+      memcpy ( &src->sin_port, udp, 2 );
+      memcpy ( &dst->sin_port, udp + 2, 2 );
+      ts->tv_sec = get32 ( reader, header );
+      ts->tv_usec = get32 ( reader, header + 4 );
+      if ( reader->nanoseconds )
+        ts->tv_usec /= 1000;
+      *data = udp + UDP_HEADER_SIZE;
+      return udp_size - UDP_HEADER_SIZE;
+    }
+}
@@ -0,0 +1,74 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#if !defined PCAPFILE_H
+#define PCAPFILE_H
+
+#include <stdio.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+
+/* Scan traffic in the classic pcap file format. Datagrams are written as
+   raw IPv4 packets with made up IP and UDP headers. Captures of raw IPv4
+   and of Ethernet can be read back. */
+
+#define PCAP_SNAPLEN 65535
+
+/* pcap_create writes the file header to a new file at path. Returns NULL
+   with errno set on failure. */
+FILE *
+pcap_create ( const char *path );
+
+/* pcap_write appends a datagram of size bytes sent from src to dst at *ts.
+   Returns 0, or -1 with errno set if the write failed. */
+int
+pcap_write ( FILE *out,
+             const struct sockaddr_in *src,
+             const struct sockaddr_in *dst,
+             const void *data,
+             unsigned int size,
+             const struct timeval *ts );
+
+struct pcap_reader
+{
+  FILE *file;
+  int swapped;          /* written on a host of the other byte order */
+  int nanoseconds;      /* timestamps are in nanoseconds */
+  unsigned long linktype;
+  unsigned char packet[PCAP_SNAPLEN];
+};
+
+/* pcap_open reads the file header of the capture at path. Returns NULL
+   with errno set on failure, EINVAL if it is not a capture of a link type
+   we can read. */
+struct pcap_reader *
+pcap_open ( const char *path );
+
+void
+pcap_close ( struct pcap_reader *reader );
+
+/* pcap_next_udp finds the next UDP datagram over IPv4 in the capture and
+   points *data at its payload, which stays valid until the next call.
+   Returns the payload size, 0 at the end of the capture and -1 with errno
+   set if it can't be read. Other packets are skipped. */
+int
+pcap_next_udp ( struct pcap_reader *reader,
+                struct sockaddr_in *src,
+                struct sockaddr_in *dst,
+                const unsigned char **data,
+                struct timeval *ts );
+
+#endif /* PCAPFILE_H */
@@ -0,0 +1,295 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include "prefix.h"
+#include "time.h"
+
+#define INITIAL_BUCKETS 256
+#define INITIAL_SLOTS 16
+
+static unsigned int
+hash_prefix ( unsigned long prefix, unsigned int size )
+{
+  return ( ( prefix & 0xffffffff ) * 2654435761u ) & ( size - 1 );
+}
+
+static void
+unlink_queue ( struct prefix_list *list, struct prefix_queue *queue )
+{
+  if ( queue->prev )
+    queue->prev->next = queue->next;
+  else
+    list->first = queue->next;
+  if ( queue->next )
+    queue->next->prev = queue->prev;
+  else
+    list->last = queue->prev;
+}
+
+/* link_turn puts queue into list behind the queues whose turn comes no
+   later. A turn just taken is the latest, so the walk is short. */
+static void
+link_turn ( struct prefix_list *list, struct prefix_queue *queue )
+{
+  struct prefix_queue *prev = list->last;
+
+  while ( prev && timercmp ( &queue->turn, &prev->turn, < ) )
+    prev = prev->prev;
+  queue->prev = prev;
+  queue->next = prev ? prev->next : list->first;
+  if ( queue->next )
+    queue->next->prev = queue;
+  else
+    list->last = queue;
+  if ( prev )
+    prev->next = queue;
+  else
+    list->first = queue;
+}
+
+/* A table that can't grow just gets slower */
+static void
+grow ( struct prefix_table *table )
+{
+  struct prefix_queue **buckets;
+  struct prefix_queue *queue;
+  const struct prefix_list *lists[2] = { &table->waiting, &table->idle };
+  unsigned int bucket, i;
+
+  buckets = calloc ( table->size * 2, sizeof ( struct prefix_queue * ) );
+  if ( !buckets )
+    return;
+  free ( table->buckets );
+  table->buckets = buckets;
+  table->size *= 2;
+
+  for ( i = 0; i < 2; i++ )
+    for ( queue = lists[i]->first; queue; queue = queue->next )
+      {
+        bucket = hash_prefix ( queue->prefix, table->size );
+        queue->hash_next = table->buckets[bucket];
+        table->buckets[bucket] = queue;
+      }
+}
+
+struct prefix_table *
+new_prefix_table ( const struct timeval *interval )
+{
+  struct prefix_table *table;
+
+  if ( ( table = calloc ( 1, sizeof ( struct prefix_table ) ) ) == NULL )
+    return NULL;
+  table->buckets = calloc ( INITIAL_BUCKETS, sizeof ( struct prefix_queue * ) );
+  if ( !table->buckets )
+    {
+      free ( table );
+      return NULL;
+    }
+  table->size = INITIAL_BUCKETS;
+  table->interval = *interval;
+  return table;
+}
+
+static void
+free_queues ( struct prefix_queue *queue )
+{
+  struct prefix_queue *next;
+
+  for ( ; queue; queue = next )
+    {
+      next = queue->next;
+      free ( queue->addrs );
+      free ( queue );
+    }
+}
+
+void
+delete_prefix_table ( struct prefix_table *table )
+{
+  if ( !table )
+    return;
+  free_queues ( table->waiting.first );
+  free_queues ( table->idle.first );
+  free_queues ( table->free );
+  free ( table->buckets );
+  free ( table );
+}
+
+static struct prefix_queue *
+find_queue ( const struct prefix_table *table, unsigned long prefix )
+{
+  struct prefix_queue *queue;
+
+  for ( queue = table->buckets[hash_prefix ( prefix, table->size )]; queue;
+        queue = queue->hash_next )
+    if ( queue->prefix == prefix )
+      return queue;
+  return NULL;
+}
+
+int
+prefix_hold ( struct prefix_table *table,
+              unsigned long prefix,
+              unsigned long addr,
+              const struct timeval *now )
+{
+  struct prefix_queue *queue;
+  unsigned long *addrs;
+  unsigned int size, i;
+
+  if ( !( queue = find_queue ( table, prefix ) ) )
+    return 0;
+  if ( !queue->count && !timercmp ( now, &queue->turn, < ) )
+    return 0;
+
+  if ( queue->count == queue->size )
+    {
+      size = queue->size ? queue->size * 2 : INITIAL_SLOTS;
+      if ( !( addrs = malloc ( size * sizeof ( unsigned long ) ) ) )
+        return -1;
+      for ( i = 0; i < queue->count; i++ )
+        addrs[i] = queue->addrs[( queue->first + i ) % queue->size];
+      free ( queue->addrs );
+      queue->addrs = addrs;
+      queue->first = 0;
+      queue->size = size;
+    }
+  queue->addrs[( queue->first + queue->count ) % queue->size] = addr;
+  if ( queue->count++ == 0 )
+    {
+      unlink_queue ( &table->idle, queue );
+      link_turn ( &table->waiting, queue );
+    }
+  table->held++;
+  return 1;
+}
+
+int
+prefix_next ( struct prefix_table *table,
+              const struct timeval *now,
+              unsigned long *addr )
+{
+  struct prefix_queue *queue = table->waiting.first;
+
+  if ( !queue || timercmp ( now, &queue->turn, < ) )
+    return 0;
+  *addr = queue->addrs[queue->first];
+  queue->first = ( queue->first + 1 ) % queue->size;
+  table->held--;
+  if ( --queue->count == 0 )
+    {
+      /* Its turn has come, it goes first */
+      unlink_queue ( &table->waiting, queue );
+      queue->prev = NULL;
+      queue->next = table->idle.first;
+      if ( queue->next )
+        queue->next->prev = queue;
+      else
+        table->idle.last = queue;
+      table->idle.first = queue;
+    }
+  return 1;
+}
+
+int
+prefix_sent ( struct prefix_table *table,
+              unsigned long prefix,
+              const struct timeval *now )
+{
+  struct prefix_queue *queue;
+  unsigned int bucket;
+
+  if ( ( queue = find_queue ( table, prefix ) ) )
+    unlink_queue ( queue->count ? &table->waiting : &table->idle, queue );
+  else
+    {
+      if ( table->count >= table->size * 2 )
+        grow ( table );
+      if ( ( queue = table->free ) )
+        table->free = queue->next;
+      else if ( ( queue = calloc ( 1, sizeof ( struct prefix_queue ) ) ) ==
+                NULL )
+        return -1;
+      queue->prefix = prefix;
+      queue->first = 0;
+      queue->count = 0;
+      bucket = hash_prefix ( prefix, table->size );
+      queue->hash_next = table->buckets[bucket];
+      table->buckets[bucket] = queue;
+      table->count++;
+    }
+
+  timeradd ( now, &table->interval, &queue->turn );
+  link_turn ( queue->count ? &table->waiting : &table->idle, queue );
+  return 0;
+}
+
+const struct timeval *
+prefix_soonest ( const struct prefix_table *table )
+{
+  return table->waiting.first ? &table->waiting.first->turn : NULL;
+}
+
+unsigned long long
+prefix_lowest ( const struct prefix_table *table )
+{
+  const struct prefix_queue *queue;
+  unsigned long long lowest = 1ULL << 32;
+  unsigned int i;
+
+  for ( queue = table->waiting.first; queue; queue = queue->next )
+    for ( i = 0; i < queue->count; i++ )
+      if ( queue->addrs[( queue->first + i ) % queue->size] < lowest )
+        lowest = queue->addrs[( queue->first + i ) % queue->size];
+  return lowest;
+}
+
+void
+prefix_expire ( struct prefix_table *table, const struct timeval *now )
+{
+  struct prefix_queue *queue, **link;
+
+  while ( ( queue = table->idle.first ) &&
+          !timercmp ( now, &queue->turn, < ) )
+    {
+      link = &table->buckets[hash_prefix ( queue->prefix, table->size )];
+      while ( *link != queue )
+        link = &( *link )->hash_next;
+      *link = queue->hash_next;
+
+      unlink_queue ( &table->idle, queue );
+      table->count--;
+      queue->next = table->free;
+      table->free = queue;
+    }
+}
+
+void
+prefix_clear ( struct prefix_table *table )
+{
+  struct prefix_queue *queue;
+
+  while ( ( queue = table->waiting.first ) )
+    {
+      unlink_queue ( &table->waiting, queue );
+      queue->count = 0;
+      link_turn ( &table->idle, queue );
+    }
+  table->held = 0;
+}
@@ -0,0 +1,109 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#if !defined PREFIX_H
+#define PREFIX_H
+
+#include <sys/time.h>
+
+/* A prefix that was queried within the last interval, with the queries
+   into it that wait for its next turn */
+struct prefix_queue
+{
+  struct prefix_queue *hash_next;
+  struct prefix_queue *prev; /* in the order of the turns */
+  struct prefix_queue *next;
+  unsigned long prefix;
+  struct timeval turn;  /* earliest time for its next query */
+  unsigned long *addrs; /* held addresses, a ring starting at first */
+  unsigned int first;
+  unsigned int count;
+  unsigned int size; /* slots of addrs */
+};
+
+struct prefix_list
+{
+  struct prefix_queue *first;
+  struct prefix_queue *last;
+};
+
+/* The per prefix rate. Prefixes with queries held take turns in the
+   order their turns come, the others are forgotten once their turn has
+   come. */
+struct prefix_table
+{
+  struct prefix_queue **buckets;
+  unsigned int size; /* number of buckets, a power of two */
+  unsigned int count;
+  struct timeval interval;    /* between queries into one prefix */
+  struct prefix_list waiting; /* prefixes with queries held, soonest turn
+                                 first */
+  struct prefix_list idle;    /* the others, soonest turn first */
+  struct prefix_queue *free;  /* unused queues kept for reuse */
+  unsigned long held;         /* addresses in all queues */
+};
+
+/* new_prefix_table returns NULL if memory runs out */
+struct prefix_table *
+new_prefix_table ( const struct timeval *interval );
+
+void
+delete_prefix_table ( struct prefix_table *table );
+
+/* prefix_hold tells if a query to addr, in prefix, has to wait for the
+   turn of the prefix. It then joins the queue of the prefix, behind the
+   ones held before it. Returns 1 if it was held, 0 if it may go now and
+   -1 if it has to wait but memory ran out. */
+int
+prefix_hold ( struct prefix_table *table,
+              unsigned long prefix,
+              unsigned long addr,
+              const struct timeval *now );
+
+/* prefix_next takes the oldest address held for the prefix whose turn is
+   soonest, if that has come by *now. Returns 1 with it in *addr, 0 if no
+   held query may go yet. */
+int
+prefix_next ( struct prefix_table *table,
+              const struct timeval *now,
+              unsigned long *addr );
+
+/* prefix_sent records that a query went into prefix at *now, its next
+   turn is an interval later. Returns 0, or -1 if memory ran out. */
+int
+prefix_sent ( struct prefix_table *table,
+              unsigned long prefix,
+              const struct timeval *now );
+
+/* prefix_soonest returns the time the next held query may go, NULL if
+   none is held */
+const struct timeval *
+prefix_soonest ( const struct prefix_table *table );
+
+/* prefix_lowest returns the lowest address held, 2^32 if none is */
+unsigned long long
+prefix_lowest ( const struct prefix_table *table );
+
+/* prefix_expire forgets the prefixes with nothing held whose turn has
+   come by *now */
+void
+prefix_expire ( struct prefix_table *table, const struct timeval *now );
+
+/* prefix_clear drops every held address. The turns are kept. */
+void
+prefix_clear ( struct prefix_table *table );
+
+#endif /* PREFIX_H */
@@ -0,0 +1,187 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include "probe.h"
+#include "time.h"
+
+#define INITIAL_BUCKETS 1024
+
+static unsigned int
+hash_addr ( unsigned long addr, unsigned int size )
+{
+  /* Multiplicative hashing spreads consecutive addresses of a range over
+     the whole table */
+  return ( ( addr & 0xffffffff ) * 2654435761u ) & ( size - 1 );
+}
+
+/* A table that can't grow just gets slower */
+static void
+grow ( struct probe_table *table )
+{
+  struct probe **buckets;
+  struct probe *probe;
+  unsigned int bucket;
+
+  if ( !( buckets = calloc ( table->size * 2, sizeof ( struct probe * ) ) ) )
+    return;
+  free ( table->buckets );
+  table->buckets = buckets;
+  table->size *= 2;
+
+  for ( probe = table->oldest; probe; probe = probe->next )
+    {
+      bucket = hash_addr ( probe->addr, table->size );
+      probe->hash_next = table->buckets[bucket];
+      table->buckets[bucket] = probe;
+    }
+}
+
+struct probe_table *
+new_probe_table ( void )
+{
+  struct probe_table *table;
+
+  if ( ( table = calloc ( 1, sizeof ( struct probe_table ) ) ) == NULL )
+    return NULL;
+  table->buckets = calloc ( INITIAL_BUCKETS, sizeof ( struct probe * ) );
+  if ( !table->buckets )
+    {
+      free ( table );
+      return NULL;
+    }
+  table->size = INITIAL_BUCKETS;
+  return table;
+}
+
+void
+delete_probe_table ( struct probe_table *table )
+{
+  struct probe *probe, *next;
+
+  if ( !table )
+    return;
+  for ( probe = table->oldest; probe; probe = next )
+    {
+      next = probe->next;
+      free ( probe );
+    }
+  for ( probe = table->free; probe; probe = next )
+    {
+      next = probe->next;
+      free ( probe );
+    }
+  free ( table->buckets );
+  free ( table );
+}
+
+struct probe *
+probe_find ( const struct probe_table *table, unsigned long addr )
+{
+  struct probe *probe;
+
+  for ( probe = table->buckets[hash_addr ( addr, table->size )]; probe;
+        probe = probe->hash_next )
+    if ( probe->addr == addr )
+      return probe;
+  return NULL;
+}
+
+static void
+unlink_order ( struct probe_table *table, struct probe *probe )
+{
+  if ( probe->prev )
+    probe->prev->next = probe->next;
+  else
+    table->oldest = probe->next;
+  if ( probe->next )
+    probe->next->prev = probe->prev;
+  else
+    table->newest = probe->prev;
+}
+
+static void
+link_newest ( struct probe_table *table, struct probe *probe )
+{
+  probe->next = NULL;
+  probe->prev = table->newest;
+  if ( table->newest )
+    table->newest->next = probe;
+  else
+    table->oldest = probe;
+  table->newest = probe;
+}
+
+struct probe *
+probe_add ( struct probe_table *table,
+            unsigned long addr,
+            const struct timeval *sent )
+{
+  struct probe *probe;
+  unsigned int bucket;
+
+  if ( ( probe = probe_find ( table, addr ) ) )
+    {
+      /* Retransmission: keep the entry, just move it in send order */
+      unlink_order ( table, probe );
+      probe->sent = *sent;
+      link_newest ( table, probe );
+      return probe;
+    }
+
+  if ( table->count >= table->size * 2 )
+    grow ( table );
+
+  if ( ( probe = table->free ) )
+    table->free = probe->next;
+  else if ( ( probe = malloc ( sizeof ( struct probe ) ) ) == NULL )
+    return NULL;
+
+  probe->addr = addr;
+  probe->sent = *sent;
+  bucket = hash_addr ( addr, table->size );
+  probe->hash_next = table->buckets[bucket];
+  table->buckets[bucket] = probe;
+  link_newest ( table, probe );
+  table->count++;
+  return probe;
+}
+
+void
+probe_remove ( struct probe_table *table, struct probe *probe )
+{
+  struct probe **link;
+
+  link = &table->buckets[hash_addr ( probe->addr, table->size )];
+  while ( *link != probe )
+    link = &( *link )->hash_next;
+  *link = probe->hash_next;
+
+  unlink_order ( table, probe );
+  table->count--;
+
+  probe->next = table->free;
+  table->free = probe;
+}
+
+void
+probe_expire ( struct probe_table *table, const struct timeval *limit )
+{
+  while ( table->oldest && timercmp ( &table->oldest->sent, limit, < ) )
+    probe_remove ( table, table->oldest );
+}
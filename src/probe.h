@@ -0,0 +1,70 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#if !defined PROBE_H
+#define PROBE_H
+
+#include <sys/time.h>
+
+/* A query that was sent and not answered yet */
+struct probe
+{
+  struct probe *hash_next; /* next probe in the same hash bucket */
+  struct probe *prev;      /* previous (older) probe in send order */
+  struct probe *next;      /* next (newer) probe in send order */
+  unsigned long addr;      /* destination, host byte order */
+  struct timeval sent;     /* when the query left */
+};
+
+/* Outstanding probes, looked up by address and kept in send order so the
+   oldest ones can be expired cheaply */
+struct probe_table
+{
+  struct probe **buckets;
+  unsigned int size; /* number of buckets, a power of two */
+  unsigned int count;
+  struct probe *oldest;
+  struct probe *newest;
+  struct probe *free; /* unused probes kept for reuse */
+};
+
+/* new_probe_table returns NULL if memory runs out */
+struct probe_table *
+new_probe_table ( void );
+
+void
+delete_probe_table ( struct probe_table *table );
+
+/* probe_add records that a query to addr was sent at *sent. A probe already
+   pending for addr is moved to the end of the send order. Returns NULL if
+   memory runs out. */
+struct probe *
+probe_add ( struct probe_table *table,
+            unsigned long addr,
+            const struct timeval *sent );
+
+/* probe_find returns the probe pending for addr or NULL */
+struct probe *
+probe_find ( const struct probe_table *table, unsigned long addr );
+
+void
+probe_remove ( struct probe_table *table, struct probe *probe );
+
+/* probe_expire forgets about all probes sent before *limit */
+void
+probe_expire ( struct probe_table *table, const struct timeval *limit );
+
+#endif /* PROBE_H */
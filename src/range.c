@@ -26,19 +26,16 @@
 #include "range.h"
 #include <string.h>
 #include <stdlib.h>
-#include "errors.h"
 
 #ifndef INADDR_NONE
 #define INADDR_NONE ( in_addr_t ) - 1
 #endif
 
-extern int quiet;
-
 /* is_ip checks if supplied string is an ip address in dotted-decimal
    notation, and fills both members of range structure with its numerical value
    (host byte order)/ Returns 1 on success, 0 on failure */
 int
-is_ip ( char *string, struct ip_range *range )
+is_ip ( const char *string, struct ip_range *range )
 {
   unsigned long addr;
 
@@ -58,14 +55,11 @@ is_ip ( char *string, struct ip_range *range )
    range structure with start and end ip addresses of the interval.
    Returns 1 on success, 0 on failure */
 int
-is_range1 ( char *string, struct ip_range *range )
+is_range1 ( const char *string, struct ip_range *range )
 {
   char *separator;
   unsigned int mask;
-  char *ip;
-
-  if ( ( ip = malloc ( strlen ( string ) + 1 ) ) == NULL )
-    err_die ( "Malloc failed", quiet );
+  char ip[20];
 
   if ( strlen ( string ) > 19 )
     return 0;
@@ -90,10 +84,8 @@ is_range1 ( char *string, struct ip_range *range )
               ntohl ( range->start_ip );  // We store ips in host byte order
       range->start_ip &= mask;
       range->end_ip = range->start_ip | ( ~mask );
-      free ( ip );
       return 1;
     }
-  free ( ip );
   return 0;
 }
 
@@ -129,15 +121,15 @@ next_address ( const struct ip_range *range,
    range structure with start and end ip addresses of the interval.
    Returns 1 on success, 0 on failure */
 int
-is_range2 ( char *string, struct ip_range *range )
+is_range2 ( const char *string, struct ip_range *range )
 {
   unsigned long last_octet; /*last octet of last ip in range*/
   char *separator;
   unsigned long addr;
-  char *ip;
+  char ip[20];
 
-  if ( ( ip = malloc ( strlen ( string ) + 1 ) ) == NULL )
-    err_die ( "Malloc failed", quiet );
+  if ( strlen ( string ) > 19 )
+    return 0;
   strcpy ( ip, string );
 
   if ( ( separator = ( char * ) strchr ( ip, '-' ) ) )
@@ -146,44 +138,29 @@ is_range2 ( char *string, struct ip_range *range )
       separator++;
       last_octet = atoi ( separator );
       if ( last_octet > 255 )
-        {
-          free ( ip );
-          return 0;
-        }
+        return 0;
       addr = inet_addr ( ip );
       if ( addr == INADDR_NONE )
-        {
-          free ( ip );
-          return 0;
-        }
+        return 0;
       range->start_ip = ntohl ( addr );
       range->end_ip = ( range->start_ip & 0xffffff00 ) | last_octet;
       if ( range->end_ip < range->start_ip )
-        {
-          free ( ip );
-          return 0;
-        }
-      free ( ip );
+        return 0;
       return 1;
     }
-  free ( ip );
   return 0;
 }
 
 void
 print_range ( const struct ip_range *range )
 {
-  struct in_addr *addr;
-
-  if ( ( addr = malloc ( sizeof ( struct in_addr ) ) ) == NULL )
-    err_die ( "Malloc failed", quiet );
+  struct in_addr addr;
 
-  next_address ( range, 0, addr );
-  printf ( "%s\n", inet_ntoa ( *addr ) );
+  next_address ( range, 0, &addr );
+  printf ( "%s\n", inet_ntoa ( addr ) );
 
-  while ( next_address ( range, addr, addr ) )
+  while ( next_address ( range, &addr, &addr ) )
     {
-      printf ( "%s\n", inet_ntoa ( *addr ) );
+      printf ( "%s\n", inet_ntoa ( addr ) );
     }
-  free ( addr );
 }
@@ -37,14 +37,14 @@ struct ip_range
    notation, and fills both members of range structure with its numerical value
    (host byte order)/ Returns 1 on success, 0 on failure */
 int
-is_ip ( char *string, struct ip_range *range );
+is_ip ( const char *string, struct ip_range *range );
 
 /* is_range1 checks if supplied string is an IP address range in
    form xxx.xxx.xxx.xxx/xx (as in 192.168.1.2/24) and fills
    range structure with start and end ip addresses of the interval.
    Returns 1 on success, 0 on failure */
 int
-is_range1 ( char *string, struct ip_range *range );
+is_range1 ( const char *string, struct ip_range *range );
 
 /* next_address function writes next ip address in range after prev_addr to
    structure pointed by next_addr. Returns 1 if next ip found and 0 otherwise */
@@ -58,7 +58,7 @@ next_address ( const struct ip_range *range,
    range structure with start and end ip addresses of the interval.
    Returns 1 on success, 0 on failure */
 int
-is_range2 ( char *string, struct ip_range *range );
+is_range2 ( const char *string, struct ip_range *range );
 
 void
 print_range ( const struct ip_range *range );
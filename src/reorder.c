@@ -0,0 +1,132 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "reorder.h"
+
+struct reorder_buffer *
+new_reorder_buffer ( void )
+{
+  struct reorder_buffer *buffer;
+
+  buffer = calloc ( 1, sizeof ( struct reorder_buffer ) );
+  return buffer;
+}
+
+static void
+free_hostinfo ( struct nb_host_info *hostinfo )
+{
+  free ( hostinfo->header );
+  free ( hostinfo->footer );
+  free ( hostinfo->names );
+  free ( hostinfo );
+}
+
+void
+delete_reorder_buffer ( struct reorder_buffer *buffer )
+{
+  unsigned int i;
+
+  if ( !buffer )
+    return;
+  for ( i = 0; i < buffer->count; i++ )
+    free_hostinfo ( buffer->heap[i].hostinfo );
+  free ( buffer->heap );
+  free ( buffer );
+}
+
+int
+reorder_add ( struct reorder_buffer *buffer,
+              unsigned long addr,
+              struct nb_host_info *hostinfo,
+              double rtt )
+{
+  struct held_result held, *heap;
+  unsigned int i, parent;
+
+  if ( buffer->count == buffer->allocated )
+    {
+      heap = realloc ( buffer->heap,
+                       ( buffer->allocated ? buffer->allocated * 2 : 256 ) *
+                               sizeof ( struct held_result ) );
+      if ( !heap )
+        return -1;
+      buffer->heap = heap;
+      buffer->allocated = buffer->allocated ? buffer->allocated * 2 : 256;
+    }
+  held.addr = addr;
+  held.rtt = rtt;
+  held.hostinfo = hostinfo;
+
+  /* Sift up. Answers mostly come in the order the queries went out, so
+     this seldom goes far. */
+  for ( i = buffer->count++; i > 0; i = parent )
+    {
+      parent = ( i - 1 ) / 2;
+      if ( buffer->heap[parent].addr <= addr )
+        break;
+      buffer->heap[i] = buffer->heap[parent];
+    }
+  buffer->heap[i] = held;
+  return 0;
+}
+
+/* Take the lowest result off the heap */
+static struct held_result
+reorder_pop ( struct reorder_buffer *buffer )
+{
+  struct held_result lowest = buffer->heap[0];
+  struct held_result last = buffer->heap[--buffer->count];
+  unsigned int i = 0, child;
+
+  /* Sift the last one down from the top */
+  while ( ( child = 2 * i + 1 ) < buffer->count )
+    {
+      if ( child + 1 < buffer->count &&
+           buffer->heap[child + 1].addr < buffer->heap[child].addr )
+        child++;
+      if ( last.addr <= buffer->heap[child].addr )
+        break;
+      buffer->heap[i] = buffer->heap[child];
+      i = child;
+    }
+  if ( buffer->count )
+    buffer->heap[i] = last;
+  return lowest;
+}
+
+unsigned long
+reorder_flush ( struct reorder_buffer *buffer,
+                unsigned long long limit,
+                nbt_result_cb callback,
+                void *arg )
+{
+  struct held_result held;
+  struct in_addr addr;
+  unsigned long flushed = 0;
+
+  while ( buffer->count && buffer->heap[0].addr < limit )
+    {
+      held = reorder_pop ( buffer );
+      addr.s_addr = htonl ( held.addr );
+      if ( callback )
+        callback ( addr, held.hostinfo, held.rtt, arg );
+      free_hostinfo ( held.hostinfo );
+      flushed++;
+    }
+  return flushed;
+}
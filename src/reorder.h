@@ -0,0 +1,65 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#if !defined REORDER_H
+#define REORDER_H
+
+#include "nbtscan.h"
+
+/* Results held back to be handed on in ascending address order, as a
+   binary min-heap by address. It only ever holds the results that arrived
+   ahead of a query still outstanding. */
+
+struct held_result
+{
+  unsigned long addr; /* host byte order */
+  double rtt;
+  struct nb_host_info *hostinfo;
+};
+
+struct reorder_buffer
+{
+  struct held_result *heap;
+  unsigned int count;
+  unsigned int allocated;
+};
+
+/* new_reorder_buffer returns NULL if memory runs out */
+struct reorder_buffer *
+new_reorder_buffer ( void );
+
+/* delete_reorder_buffer frees the buffer and the results still in it */
+void
+delete_reorder_buffer ( struct reorder_buffer *buffer );
+
+/* reorder_add holds the result for addr. The buffer takes over hostinfo,
+   which must come from parse_response(). Returns 0, or -1 if memory ran
+   out and hostinfo was not taken. */
+int
+reorder_add ( struct reorder_buffer *buffer,
+              unsigned long addr,
+              struct nb_host_info *hostinfo,
+              double rtt );
+
+/* reorder_flush hands the results for addresses below limit to callback,
+   lowest first, and frees them. Returns how many there were. */
+unsigned long
+reorder_flush ( struct reorder_buffer *buffer,
+                unsigned long long limit,
+                nbt_result_cb callback,
+                void *arg );
+
+#endif /* REORDER_H */
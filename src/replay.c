@@ -0,0 +1,130 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "nbtscan.h"
+#include "statusq.h"
+#include "probe.h"
+#include "pcapfile.h"
+#include "time.h"
+
+/* Replay goes by the NetBIOS header alone: queries are remembered for the
+   round trip times, answers to node status queries are parsed */
+
+static unsigned int
+get16 ( const unsigned char *p )
+{
+  return ( p[0] << 8 ) | p[1];
+}
+
+static void
+free_hostinfo ( struct nb_host_info *hostinfo )
+{
+  free ( hostinfo->header );
+  free ( hostinfo->footer );
+  free ( hostinfo->names );
+  free ( hostinfo );
+}
+
+long
+nbt_replay ( const char *path, nbt_result_cb callback, void *arg )
+{
+  struct pcap_reader *reader;
+  struct probe_table *queries, *answered;
+  struct nb_host_info *hostinfo;
+  struct sockaddr_in src, dst;
+  struct timeval ts, diff_time;
+  struct probe *probe;
+  const unsigned char *data;
+  unsigned long addr;
+  long hosts = 0;
+  double rtt;
+  int size, saved_errno;
+
+  if ( !( reader = pcap_open ( path ) ) )
+    return -1;
+  queries = new_probe_table ();
+  answered = new_probe_table ();
+  if ( !queries || !answered )
+    {
+      delete_probe_table ( queries );
+      delete_probe_table ( answered );
+      pcap_close ( reader );
+      errno = ENOMEM;
+      return -1;
+    }
+
+  while ( ( size = pcap_next_udp ( reader, &src, &dst, &data, &ts ) ) > 0 )
+    {
+      if ( size >= 4 && !( get16 ( data + 2 ) & FL_REQUEST ) )
+        {
+          /* A query, the answer's round trip time counts from here */
+          if ( dst.sin_port == htons ( NB_DGRAM ) &&
+               !probe_add ( queries, ntohl ( dst.sin_addr.s_addr ), &ts ) )
+            {
+              size = -1;
+              errno = ENOMEM;
+              break;
+            }
+          continue;
+        }
+      /* Truncated answers are parsed as far as they go, like in a scan */
+      if ( size >= NBNAME_REQUEST_SIZE &&
+           get16 ( data + 46 ) == QT_NAME_QUERY )
+        continue;
+
+      addr = ntohl ( src.sin_addr.s_addr );
+      if ( probe_find ( answered, addr ) )
+        continue;
+      if ( !( hostinfo = parse_response ( ( char * ) data, size ) ) )
+        continue;
+      if ( !probe_add ( answered, addr, &ts ) )
+        {
+          free_hostinfo ( hostinfo );
+          size = -1;
+          errno = ENOMEM;
+          break;
+        }
+
+      rtt = -1;
+      if ( ( probe = probe_find ( queries, addr ) ) )
+        {
+          timersub ( &ts, &probe->sent, &diff_time );
+          rtt = diff_time.tv_sec + diff_time.tv_usec / 1000000.0;
+        }
+      hosts++;
+      if ( callback )
+        callback ( src.sin_addr, hostinfo, rtt, arg );
+      free_hostinfo ( hostinfo );
+    }
+
+  saved_errno = errno;
+  delete_probe_table ( queries );
+  delete_probe_table ( answered );
+  pcap_close ( reader );
+  if ( size < 0 )
+    {
+      errno = saved_errno;
+      return -1;
+    }
+  return hosts;
+}
@@ -0,0 +1,757 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "resolve.h"
+#include "errors.h"
+#include "time.h"
+
+extern int quiet;
+
+#define RESOLV_CONF "/etc/resolv.conf"
+#define DNS_PORT 53
+#define DNS_HEADER_SIZE 12
+#define DNS_MAX_PACKET 512
+#define DNS_TYPE_SOA 6
+#define DNS_TYPE_PTR 12
+#define DNS_CLASS_IN 1
+#define DNS_RCODE_NXDOMAIN 3
+#define DNS_MAX_TTL ( 7 * 24 * 3600L ) /* longer TTLs are cut to this */
+#define INITIAL_BUCKETS 1024
+
+static unsigned int
+hash_addr ( unsigned long addr, unsigned int size )
+{
+  return ( ( addr & 0xffffffff ) * 2654435761u ) & ( size - 1 );
+}
+
+static long
+now_seconds ( void )
+{
+  struct timeval now;
+
+  gettimeofday ( &now, NULL );
+  return now.tv_sec;
+}
+
+static unsigned int
+get16 ( const unsigned char *p )
+{
+  return ( p[0] << 8 ) | p[1];
+}
+
+static unsigned long
+get32 ( const unsigned char *p )
+{
+  return ( ( unsigned long ) p[0] << 24 ) | ( p[1] << 16 ) | ( p[2] << 8 ) |
+         p[3];
+}
+
+static void
+alloc_buckets ( struct resolver *resolver, unsigned int size )
+{
+  if ( ( resolver->buckets = calloc ( size, sizeof ( struct dns_entry * ) ) ) ==
+       NULL )
+    err_die ( "Malloc failed", quiet );
+  resolver->size = size;
+}
+
+static void
+grow ( struct resolver *resolver )
+{
+  struct dns_entry **old = resolver->buckets, *entry, *next;
+  unsigned int i, old_size = resolver->size, bucket;
+
+  alloc_buckets ( resolver, old_size * 2 );
+  for ( i = 0; i < old_size; i++ )
+    for ( entry = old[i]; entry; entry = next )
+      {
+        next = entry->hash_next;
+        bucket = hash_addr ( entry->addr, resolver->size );
+        entry->hash_next = resolver->buckets[bucket];
+        resolver->buckets[bucket] = entry;
+      }
+  free ( old );
+}
+
+static struct dns_entry *
+find_entry ( const struct resolver *resolver, unsigned long addr )
+{
+  struct dns_entry *entry;
+
+  for ( entry = resolver->buckets[hash_addr ( addr, resolver->size )]; entry;
+        entry = entry->hash_next )
+    if ( entry->addr == addr )
+      return entry;
+  return NULL;
+}
+
+static struct dns_entry *
+add_entry ( struct resolver *resolver, unsigned long addr )
+{
+  struct dns_entry *entry;
+  unsigned int bucket;
+
+  if ( resolver->count >= resolver->size * 2 )
+    grow ( resolver );
+  if ( ( entry = calloc ( 1, sizeof ( struct dns_entry ) ) ) == NULL )
+    err_die ( "Malloc failed", quiet );
+  entry->addr = addr;
+  entry->state = DNS_CACHED;
+  bucket = hash_addr ( addr, resolver->size );
+  entry->hash_next = resolver->buckets[bucket];
+  resolver->buckets[bucket] = entry;
+  resolver->count++;
+  return entry;
+}
+
+static void
+set_server ( struct sockaddr_in *server, struct in_addr addr, int port )
+{
+  memset ( server, 0, sizeof ( struct sockaddr_in ) );
+  server->sin_family = AF_INET;
+  server->sin_addr = addr;
+  server->sin_port = htons ( port );
+}
+
+/* parse_server reads "address[:port]" */
+static int
+parse_server ( struct sockaddr_in *server, const char *string )
+{
+  char address[16], *colon;
+  struct in_addr addr;
+  int port = DNS_PORT;
+
+  if ( strlen ( string ) >= sizeof address + 6 )
+    return 0;
+  if ( ( colon = strchr ( string, ':' ) ) )
+    {
+      port = atoi ( colon + 1 );
+      if ( port <= 0 || port > 65535 ||
+           ( size_t ) ( colon - string ) >= sizeof address )
+        return 0;
+      memcpy ( address, string, colon - string );
+      address[colon - string] = 0;
+    }
+  else if ( strlen ( string ) < sizeof address )
+    strcpy ( address, string );
+  else
+    return 0;
+  if ( !inet_aton ( address, &addr ) )
+    return 0;
+  set_server ( server, addr, port );
+  return 1;
+}
+
+/* read_resolv_conf takes the IPv4 name servers and the timeout and
+   attempts options from /etc/resolv.conf, with the defaults of the C
+   library resolver for what is not there */
+static void
+read_resolv_conf ( struct resolver *resolver, int want_servers )
+{
+  char line[256], *p;
+  struct in_addr addr;
+  FILE *file;
+
+  resolver->timeout = 5;
+  resolver->attempts = 2;
+  if ( ( file = fopen ( RESOLV_CONF, "r" ) ) )
+    {
+      while ( fgets ( line, sizeof line, file ) )
+        if ( strncmp ( line, "nameserver", 10 ) == 0 &&
+             isspace ( line[10] ) )
+          {
+            for ( p = line + 10; isspace ( *p ); p++ )
+              ;
+            p[strcspn ( p, " \t\r\n" )] = 0;
+            if ( want_servers &&
+                 resolver->server_count < DNS_MAX_SERVERS &&
+                 inet_aton ( p, &addr ) )
+              set_server ( &resolver->servers[resolver->server_count++],
+                           addr,
+                           DNS_PORT );
+          }
+        else if ( strncmp ( line, "options", 7 ) == 0 && isspace ( line[7] ) )
+          {
+            if ( ( p = strstr ( line, "timeout:" ) ) )
+              resolver->timeout = atoi ( p + 8 );
+            if ( ( p = strstr ( line, "attempts:" ) ) )
+              resolver->attempts = atoi ( p + 9 );
+          }
+      fclose ( file );
+    }
+  if ( resolver->timeout < 1 )
+    resolver->timeout = 1;
+  if ( resolver->timeout > 30 )
+    resolver->timeout = 30;
+  if ( resolver->attempts < 1 )
+    resolver->attempts = 1;
+  if ( resolver->attempts > 5 )
+    resolver->attempts = 5;
+  if ( want_servers && !resolver->server_count )
+    {
+      addr.s_addr = htonl ( INADDR_LOOPBACK );
+      set_server ( &resolver->servers[resolver->server_count++],
+                   addr,
+                   DNS_PORT );
+    }
+}
+
+/* load_cache adds the names in the cache file at path that have not
+   expired, unless a fresher one is known already */
+static void
+load_cache ( struct resolver *resolver, const char *path )
+{
+  char line[DNS_MAX_NAME + 64], address[16], name[DNS_MAX_NAME];
+  long expires, now = now_seconds ();
+  struct dns_entry *entry;
+  struct in_addr addr;
+  FILE *file;
+
+  if ( !( file = fopen ( path, "r" ) ) )
+    return;
+  while ( fgets ( line, sizeof line, file ) )
+    {
+      if ( sscanf ( line, "%15s %ld %255s", address, &expires, name ) != 3 ||
+           !inet_aton ( address, &addr ) || expires <= now )
+        continue;
+      if ( ( entry = find_entry ( resolver, ntohl ( addr.s_addr ) ) ) )
+        {
+          if ( entry->state != DNS_CACHED || entry->expires >= expires )
+            continue;
+          free ( entry->name );
+        }
+      else
+        entry = add_entry ( resolver, ntohl ( addr.s_addr ) );
+      entry->expires = expires;
+      entry->name = NULL;
+      if ( strcmp ( name, "-" ) != 0 &&
+           ( entry->name = strdup ( name ) ) == NULL )
+        err_die ( "Malloc failed", quiet );
+    }
+  fclose ( file );
+}
+
+/* save_cache writes the names that have not expired to the cache file,
+   through a temporary file so that readers never see half of it */
+static void
+save_cache ( struct resolver *resolver )
+{
+  struct dns_entry *entry;
+  struct in_addr addr;
+  long now = now_seconds ();
+  unsigned int i;
+  char *temp;
+  FILE *file;
+
+  /* Keep what other runs saved since this one started */
+  load_cache ( resolver, resolver->cache_path );
+
+  if ( ( temp = malloc ( strlen ( resolver->cache_path ) + 32 ) ) == NULL )
+    err_die ( "Malloc failed", quiet );
+  sprintf ( temp, "%s.%ld", resolver->cache_path, ( long ) getpid () );
+  if ( !( file = fopen ( temp, "w" ) ) )
+    {
+      err_print ( "Cannot write DNS cache", quiet );
+      free ( temp );
+      return;
+    }
+  fputs ( "# nbtscan reverse DNS cache: address, expiry time, name\n", file );
+  for ( i = 0; i < resolver->size; i++ )
+    for ( entry = resolver->buckets[i]; entry; entry = entry->hash_next )
+      if ( entry->state == DNS_CACHED && entry->expires > now )
+        {
+          addr.s_addr = htonl ( entry->addr );
+          fprintf ( file,
+                    "%s %ld %s\n",
+                    inet_ntoa ( addr ),
+                    entry->expires,
+                    entry->name ? entry->name : "-" );
+        }
+  if ( fclose ( file ) != 0 || rename ( temp, resolver->cache_path ) < 0 )
+    {
+      err_print ( "Cannot write DNS cache", quiet );
+      unlink ( temp );
+    }
+  free ( temp );
+}
+
+struct resolver *
+new_resolver ( const char *server, const char *cache_path )
+{
+  struct resolver *resolver;
+
+  if ( ( resolver = calloc ( 1, sizeof ( struct resolver ) ) ) == NULL )
+    err_die ( "Malloc failed", quiet );
+  if ( server )
+    {
+      if ( !parse_server ( &resolver->servers[0], server ) )
+        {
+          free ( resolver );
+          errno = EINVAL;
+          return NULL;
+        }
+      resolver->server_count = 1;
+    }
+  read_resolv_conf ( resolver, !server );
+
+  if ( ( resolver->sock = socket ( AF_INET, SOCK_DGRAM, IPPROTO_UDP ) ) < 0 )
+    {
+      free ( resolver );
+      return NULL;
+    }
+  fcntl ( resolver->sock,
+          F_SETFL,
+          fcntl ( resolver->sock, F_GETFL ) | O_NONBLOCK );
+  cookie_secret ( &resolver->key );
+  alloc_buckets ( resolver, INITIAL_BUCKETS );
+
+  if ( cache_path )
+    {
+      if ( ( resolver->cache_path = strdup ( cache_path ) ) == NULL )
+        err_die ( "Malloc failed", quiet );
+      load_cache ( resolver, cache_path );
+    }
+  return resolver;
+}
+
+void
+delete_resolver ( struct resolver *resolver )
+{
+  struct dns_entry *entry, *next;
+  struct dns_waiter *waiter;
+  unsigned int i;
+
+  if ( resolver->cache_path )
+    save_cache ( resolver );
+  for ( i = 0; i < resolver->size; i++ )
+    for ( entry = resolver->buckets[i]; entry; entry = next )
+      {
+        next = entry->hash_next;
+        while ( ( waiter = entry->waiters ) )
+          {
+            entry->waiters = waiter->next;
+            free ( waiter );
+          }
+        free ( entry->name );
+        free ( entry );
+      }
+  free ( resolver->buckets );
+  free ( resolver->cache_path );
+  close ( resolver->sock );
+  free ( resolver );
+}
+
+int
+resolver_fd ( const struct resolver *resolver )
+{
+  return resolver->sock;
+}
+
+/* build_query writes a PTR query for addr to packet and returns its
+   length: at most 12 bytes of header and 46 of question */
+static int
+build_query ( unsigned char *packet, unsigned long addr, unsigned short id )
+{
+  unsigned char *p = packet + DNS_HEADER_SIZE;
+  int i, length;
+
+  memset ( packet, 0, DNS_HEADER_SIZE );
+  packet[0] = id >> 8;
+  packet[1] = id & 0xff;
+  packet[2] = 0x01; /* recursion desired */
+  packet[5] = 1;    /* one question */
+  for ( i = 0; i < 4; i++ )
+    {
+      length = sprintf (
+              ( char * ) p + 1, "%lu", ( addr >> ( i * 8 ) ) & 0xff );
+      *p = length;
+      p += length + 1;
+    }
+  memcpy ( p, "\7in-addr\4arpa", 14 );
+  p += 14;
+  *p++ = 0;
+  *p++ = DNS_TYPE_PTR;
+  *p++ = 0;
+  *p++ = DNS_CLASS_IN;
+  return p - packet;
+}
+
+/* read_name reads the possibly compressed domain name at offset of packet
+   into name, if it is not NULL, dotted and with anything unprintable
+   replaced by '?'. Returns the offset after the name, or -1 if it is
+   broken or does not fit. */
+static int
+read_name ( const unsigned char *packet,
+            int size,
+            int offset,
+            char *name,
+            int name_size )
+{
+  int end = -1, jumps = 0, length = 0, label, i;
+
+  while ( offset < size )
+    {
+      label = packet[offset];
+      if ( ( label & 0xc0 ) == 0xc0 )
+        {
+          if ( offset + 1 >= size || ++jumps > 32 )
+            return -1;
+          if ( end < 0 )
+            end = offset + 2;
+          offset = ( ( label & 0x3f ) << 8 ) | packet[offset + 1];
+          continue;
+        }
+      if ( label & 0xc0 )
+        return -1;
+      offset++;
+      if ( !label )
+        {
+          if ( name )
+            name[length] = 0;
+          return end < 0 ? offset : end;
+        }
+      if ( offset + label > size )
+        return -1;
+      if ( name )
+        {
+          if ( length + label + 2 > name_size )
+            return -1;
+          if ( length )
+            name[length++] = '.';
+          for ( i = 0; i < label; i++ )
+            name[length++] =
+                    isgraph ( packet[offset + i] ) ? packet[offset + i] : '?';
+        }
+      offset += label;
+    }
+  return -1;
+}
+
+static void
+finish ( struct resolver *resolver,
+         struct dns_entry *entry,
+         const char *name,
+         unsigned long ttl )
+{
+  struct dns_waiter *waiter;
+  struct in_addr addr;
+
+  entry->state = DNS_CACHED;
+  free ( entry->name );
+  entry->name = NULL;
+  if ( name && ( entry->name = strdup ( name ) ) == NULL )
+    err_die ( "Malloc failed", quiet );
+  entry->expires = ttl ? now_seconds () + ( ttl < DNS_MAX_TTL ? ( long ) ttl
+                                                              : DNS_MAX_TTL )
+                       : 0;
+  resolver->pending--;
+
+  addr.s_addr = htonl ( entry->addr );
+  while ( ( waiter = entry->waiters ) )
+    {
+      entry->waiters = waiter->next;
+      waiter->callback ( addr, entry->name, waiter->arg );
+      free ( waiter );
+    }
+}
+
+static void
+enqueue ( struct resolver *resolver, struct dns_entry *entry )
+{
+  entry->state = DNS_QUEUED;
+  entry->queue_next = NULL;
+  if ( resolver->queue_last )
+    resolver->queue_last->queue_next = entry;
+  else
+    resolver->queue_first = entry;
+  resolver->queue_last = entry;
+}
+
+/* retry sends the query again, to the next server, or gives up */
+static void
+retry ( struct resolver *resolver, struct dns_entry *entry )
+{
+  if ( entry->tries >= resolver->attempts * resolver->server_count )
+    {
+      resolver->stats.failed++;
+      finish ( resolver, entry, NULL, 0 );
+      return;
+    }
+  /* Ahead of the lookups that have not been tried yet */
+  entry->state = DNS_QUEUED;
+  entry->queue_next = resolver->queue_first;
+  resolver->queue_first = entry;
+  if ( !resolver->queue_last )
+    resolver->queue_last = entry;
+}
+
+static void
+send_queued ( struct resolver *resolver )
+{
+  unsigned char packet[DNS_MAX_PACKET];
+  const struct sockaddr_in *server;
+  struct dns_entry *entry;
+  int size, slot;
+
+  while ( ( entry = resolver->queue_first ) &&
+          resolver->inflight_count < DNS_MAX_INFLIGHT )
+    {
+      entry->id = cookie ( &resolver->key, resolver->stats.queries );
+      size = build_query ( packet, entry->addr, entry->id );
+      server = &resolver->servers[entry->tries % resolver->server_count];
+      if ( sendto ( resolver->sock,
+                    packet,
+                    size,
+                    0,
+                    ( const struct sockaddr * ) server,
+                    sizeof ( struct sockaddr_in ) ) < 0 &&
+           ( errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS ) )
+        break; /* not now */
+
+      /* A query that could not be sent for good counts as a try that got
+         no answer */
+      resolver->queue_first = entry->queue_next;
+      if ( !resolver->queue_first )
+        resolver->queue_last = NULL;
+      resolver->stats.queries++;
+      entry->tries++;
+      gettimeofday ( &entry->sent, NULL );
+      entry->state = DNS_SENT;
+      for ( slot = 0; resolver->inflight[slot]; slot++ )
+        ;
+      resolver->inflight[slot] = entry;
+      resolver->inflight_count++;
+    }
+}
+
+static void
+handle_answer ( struct resolver *resolver,
+                const unsigned char *packet,
+                int size,
+                const struct sockaddr_in *from )
+{
+  unsigned char query[DNS_MAX_PACKET];
+  char name[DNS_MAX_NAME];
+  unsigned long ttl = 0, rr_ttl;
+  unsigned int type, class, length, records, answers;
+  struct dns_entry *entry;
+  int i, slot, query_size, offset, p, found = 0;
+
+  for ( i = 0; i < resolver->server_count; i++ )
+    if ( from->sin_addr.s_addr == resolver->servers[i].sin_addr.s_addr &&
+         from->sin_port == resolver->servers[i].sin_port )
+      break;
+  if ( i == resolver->server_count || size < DNS_HEADER_SIZE )
+    return;
+  if ( !( packet[2] & 0x80 ) || get16 ( packet + 4 ) != 1 )
+    return;
+
+  /* The query with this ID, which the answer has to repeat the question
+     of. Names compare without case. */
+  for ( slot = 0; slot < DNS_MAX_INFLIGHT; slot++ )
+    {
+      if ( !( entry = resolver->inflight[slot] ) ||
+           entry->id != get16 ( packet ) )
+        continue;
+      query_size = build_query ( query, entry->addr, entry->id );
+      if ( size < query_size )
+        continue;
+      for ( i = DNS_HEADER_SIZE; i < query_size; i++ )
+        if ( tolower ( packet[i] ) != tolower ( query[i] ) )
+          break;
+      if ( i == query_size )
+        break;
+    }
+  if ( slot == DNS_MAX_INFLIGHT )
+    return;
+
+  resolver->inflight[slot] = NULL;
+  resolver->inflight_count--;
+  if ( ( packet[3] & 0x0f ) != 0 &&
+       ( packet[3] & 0x0f ) != DNS_RCODE_NXDOMAIN )
+    {
+      /* Server failure, refused and the like: ask the next server */
+      retry ( resolver, entry );
+      return;
+    }
+
+  /* The first PTR record among the answers, or for a negative answer the
+     TTL of the SOA record in the authority section (RFC 2308) */
+  answers = get16 ( packet + 6 );
+  records = answers + get16 ( packet + 8 );
+  offset = query_size;
+  for ( i = 0; i < ( int ) records && !found; i++ )
+    {
+      if ( ( offset = read_name ( packet, size, offset, NULL, 0 ) ) < 0 ||
+           offset + 10 > size )
+        break;
+      type = get16 ( packet + offset );
+      class = get16 ( packet + offset + 2 );
+      rr_ttl = get32 ( packet + offset + 4 );
+      length = get16 ( packet + offset + 8 );
+      offset += 10;
+      if ( offset + ( int ) length > size )
+        break;
+      if ( i < ( int ) answers && type == DNS_TYPE_PTR &&
+           class == DNS_CLASS_IN &&
+           read_name ( packet, size, offset, name, sizeof name ) > 0 &&
+           *name )
+        {
+          found = 1;
+          ttl = rr_ttl;
+        }
+      else if ( i >= ( int ) answers && type == DNS_TYPE_SOA &&
+                ( p = read_name ( packet, size, offset, NULL, 0 ) ) > 0 &&
+                ( p = read_name ( packet, size, p, NULL, 0 ) ) > 0 &&
+                p + 20 <= offset + ( int ) length )
+        ttl = get32 ( packet + p + 16 ) < rr_ttl ? get32 ( packet + p + 16 )
+                                                 : rr_ttl;
+      offset += length;
+    }
+  if ( !found && ( packet[2] & 0x02 ) )
+    {
+      /* Truncated without the record, which would need TCP */
+      resolver->stats.failed++;
+      finish ( resolver, entry, NULL, 0 );
+      return;
+    }
+  finish ( resolver, entry, found ? name : NULL, ttl );
+}
+
+void
+resolve_addr ( struct resolver *resolver,
+               struct in_addr addr,
+               resolve_cb callback,
+               void *arg )
+{
+  unsigned long host = ntohl ( addr.s_addr );
+  struct dns_entry *entry;
+  struct dns_waiter *waiter;
+
+  resolver->stats.lookups++;
+  entry = find_entry ( resolver, host );
+  if ( entry && entry->state == DNS_CACHED &&
+       entry->expires > now_seconds () )
+    {
+      resolver->stats.cached++;
+      callback ( addr, entry->name, arg );
+      return;
+    }
+
+  if ( !entry )
+    entry = add_entry ( resolver, host );
+  if ( ( waiter = malloc ( sizeof ( struct dns_waiter ) ) ) == NULL )
+    err_die ( "Malloc failed", quiet );
+  waiter->callback = callback;
+  waiter->arg = arg;
+  waiter->next = entry->waiters;
+  entry->waiters = waiter;
+  if ( entry->state == DNS_CACHED )
+    {
+      /* Not known, or expired: no other lookup of it is under way */
+      entry->tries = 0;
+      enqueue ( resolver, entry );
+      resolver->pending++;
+      send_queued ( resolver );
+    }
+}
+
+void
+resolver_step ( struct resolver *resolver )
+{
+  unsigned char packet[DNS_MAX_PACKET];
+  struct sockaddr_in from;
+  socklen_t fromlen;
+  struct timeval now, limit;
+  struct dns_entry *entry;
+  int size, slot;
+
+  for ( ;; )
+    {
+      fromlen = sizeof from;
+      size = recvfrom ( resolver->sock,
+                        packet,
+                        sizeof packet,
+                        0,
+                        ( struct sockaddr * ) &from,
+                        &fromlen );
+      if ( size < 0 )
+        break;
+      handle_answer ( resolver, packet, size, &from );
+    }
+
+  gettimeofday ( &now, NULL );
+  limit.tv_sec = now.tv_sec - resolver->timeout;
+  limit.tv_usec = now.tv_usec;
+  for ( slot = 0; slot < DNS_MAX_INFLIGHT; slot++ )
+    if ( ( entry = resolver->inflight[slot] ) &&
+         !timercmp ( &limit, &entry->sent, < ) )
+      {
+        resolver->inflight[slot] = NULL;
+        resolver->inflight_count--;
+        retry ( resolver, entry );
+      }
+  send_queued ( resolver );
+}
+
+void
+resolver_timeout ( const struct resolver *resolver, struct timeval *tv )
+{
+  struct timeval now, due, first;
+  int slot;
+
+  tv->tv_sec = 1;
+  tv->tv_usec = 0;
+  if ( resolver->queue_first &&
+       resolver->inflight_count < DNS_MAX_INFLIGHT )
+    {
+      timerclear ( tv );
+      return;
+    }
+  if ( !resolver->inflight_count )
+    return;
+
+  timerclear ( &first );
+  for ( slot = 0; slot < DNS_MAX_INFLIGHT; slot++ )
+    if ( resolver->inflight[slot] &&
+         ( !timerisset ( &first ) ||
+           timercmp ( &resolver->inflight[slot]->sent, &first, < ) ) )
+      first = resolver->inflight[slot]->sent;
+  due = first;
+  due.tv_sec += resolver->timeout;
+  gettimeofday ( &now, NULL );
+  if ( timercmp ( &due, &now, < ) )
+    timerclear ( tv );
+  else
+    timersub ( &due, &now, tv );
+}
+
+unsigned int
+resolver_pending ( const struct resolver *resolver )
+{
+  return resolver->pending;
+}
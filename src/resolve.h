@@ -0,0 +1,139 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#if !defined RESOLVE_H
+#define RESOLVE_H
+
+#include <sys/time.h>
+#include <netinet/in.h>
+#include "cookie.h"
+
+/* Reverse DNS lookups of the hosts that answer, done alongside the scan.
+   PTR queries go out over one non-blocking UDP socket to the name servers
+   of /etc/resolv.conf, many at a time, and are retried with its timeout
+   and attempts options. Names, and the lack of one, are cached for the
+   TTL of the answer, in memory and optionally in a file that later runs,
+   or several at once, share. */
+
+#define DNS_MAX_SERVERS 3   /* as many as the C library resolver uses */
+#define DNS_MAX_INFLIGHT 64 /* queries sent and not answered yet */
+#define DNS_MAX_NAME 256
+
+/* Called once for each lookup with the name of addr, or NULL if it has
+   none or the lookup failed. name is only valid during the call. */
+typedef void ( *resolve_cb ) ( struct in_addr addr,
+                               const char *name,
+                               void *arg );
+
+/* A lookup waiting for its entry */
+struct dns_waiter
+{
+  struct dns_waiter *next;
+  resolve_cb callback;
+  void *arg;
+};
+
+enum dns_state
+{
+  DNS_CACHED, /* name, or the lack of one, good until expires */
+  DNS_QUEUED, /* waiting for a free query slot */
+  DNS_SENT    /* query in flight */
+};
+
+struct dns_entry
+{
+  struct dns_entry *hash_next; /* next entry in the same hash bucket */
+  struct dns_entry *queue_next;
+  unsigned long addr;    /* host byte order */
+  enum dns_state state;
+  long expires;          /* seconds since the epoch, 0 for not cached */
+  char *name;            /* NULL for no name */
+  unsigned short id;     /* of the query in flight */
+  int tries;             /* queries sent so far */
+  struct timeval sent;   /* when the last one left */
+  struct dns_waiter *waiters;
+};
+
+struct resolver_stats
+{
+  unsigned long lookups;  /* addresses looked up */
+  unsigned long cached;   /* of those, answered from the cache */
+  unsigned long queries;  /* queries sent, retries included */
+  unsigned long failed;   /* lookups that got no answer or an error */
+};
+
+struct resolver
+{
+  int sock;
+  struct sockaddr_in servers[DNS_MAX_SERVERS];
+  int server_count;
+  int timeout;  /* seconds to wait for each answer */
+  int attempts; /* rounds through the servers */
+  char *cache_path;
+  struct dns_entry **buckets;
+  unsigned int size; /* number of buckets, a power of two */
+  unsigned int count;
+  struct dns_entry *queue_first; /* lookups waiting for a free slot */
+  struct dns_entry *queue_last;
+  struct dns_entry *inflight[DNS_MAX_INFLIGHT];
+  int inflight_count;
+  unsigned int pending; /* entries queued or sent */
+  struct cookie_key key; /* query IDs are a keyed hash of a counter */
+  struct resolver_stats stats;
+};
+
+/* new_resolver opens the query socket. server, "address[:port]", replaces
+   the name servers of /etc/resolv.conf if it is not NULL. If cache_path is
+   not NULL the names cached there are loaded, and the cache is written
+   back by delete_resolver(). Returns NULL with errno set on failure,
+   EINVAL if server is not an address. */
+struct resolver *
+new_resolver ( const char *server, const char *cache_path );
+
+/* delete_resolver saves the cache, merged with what other runs saved in
+   the meantime, and frees the resolver. Lookups still pending are dropped
+   without their callback. */
+void
+delete_resolver ( struct resolver *resolver );
+
+/* The descriptor to wait on for readability */
+int
+resolver_fd ( const struct resolver *resolver );
+
+/* resolve_addr looks up the name of addr and calls callback with it. If
+   the name is cached this happens before resolve_addr returns, otherwise
+   from resolver_step(). */
+void
+resolve_addr ( struct resolver *resolver,
+               struct in_addr addr,
+               resolve_cb callback,
+               void *arg );
+
+/* resolver_step takes in the answers that have arrived and sends the
+   queries that are due, without blocking */
+void
+resolver_step ( struct resolver *resolver );
+
+/* resolver_timeout stores in *tv how long the caller may wait for the
+   descriptor before calling resolver_step() anyway */
+void
+resolver_timeout ( const struct resolver *resolver, struct timeval *tv );
+
+/* Number of lookups whose callback has not been called yet */
+unsigned int
+resolver_pending ( const struct resolver *resolver );
+
+#endif /* RESOLVE_H */
@@ -0,0 +1,112 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "rtt.h"
+
+#define RTT_BUCKETS 4096
+
+static unsigned int
+hash_prefix ( unsigned long prefix, unsigned int size )
+{
+  return ( ( prefix & 0xffffffff ) * 2654435761u ) & ( size - 1 );
+}
+
+static unsigned long
+prefix_of ( unsigned long addr )
+{
+  return ( addr & 0xffffffff ) >> ( 32 - RTT_PREFIX_BITS );
+}
+
+struct rtt_table *
+new_rtt_table ( void )
+{
+  struct rtt_table *table;
+
+  if ( ( table = malloc ( sizeof ( struct rtt_table ) ) ) == NULL )
+    return NULL;
+  table->buckets = calloc ( RTT_BUCKETS, sizeof ( struct rtt_estimator * ) );
+  if ( !table->buckets )
+    {
+      free ( table );
+      return NULL;
+    }
+  table->size = RTT_BUCKETS;
+  return table;
+}
+
+void
+delete_rtt_table ( struct rtt_table *table )
+{
+  struct rtt_estimator *est, *next;
+  unsigned int i;
+
+  for ( i = 0; i < table->size; i++ )
+    for ( est = table->buckets[i]; est; est = next )
+      {
+        next = est->hash_next;
+        free ( est );
+      }
+  free ( table->buckets );
+  free ( table );
+}
+
+const struct rtt_estimator *
+rtt_find ( const struct rtt_table *table, unsigned long addr )
+{
+  struct rtt_estimator *est;
+  unsigned long prefix = prefix_of ( addr );
+
+  for ( est = table->buckets[hash_prefix ( prefix, table->size )]; est;
+        est = est->hash_next )
+    if ( est->prefix == prefix )
+      return est;
+  return NULL;
+}
+
+void
+rtt_update ( struct rtt_table *table, unsigned long addr, float rtt )
+{
+  struct rtt_estimator *est;
+  unsigned int bucket;
+  float delta;
+
+  if ( !( est = ( struct rtt_estimator * ) rtt_find ( table, addr ) ) )
+    {
+      /* Without memory the prefix keeps the default timeout */
+      if ( ( est = malloc ( sizeof ( struct rtt_estimator ) ) ) == NULL )
+        return;
+      est->prefix = prefix_of ( addr );
+      est->samples = 0;
+      bucket = hash_prefix ( est->prefix, table->size );
+      est->hash_next = table->buckets[bucket];
+      table->buckets[bucket] = est;
+    }
+
+  if ( est->samples++ == 0 )
+    {
+      /* RFC 6298: start from the first measurement */
+      est->srtt = rtt;
+      est->rttvar = rtt / 2;
+      return;
+    }
+  delta = rtt - est->srtt;
+  est->srtt += delta / 8;
+  if ( delta < 0.0 )
+    delta = -delta;
+  est->rttvar += ( delta - est->rttvar ) / 4;
+}
@@ -0,0 +1,59 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#if !defined RTT_H
+#define RTT_H
+
+/* Round trip times are tracked per block of 2^(32 - RTT_PREFIX_BITS)
+   addresses, so that near and far networks in one scan each get the
+   timeout they need */
+#define RTT_PREFIX_BITS 24
+
+/* A smoothed round trip time estimator, times in seconds */
+struct rtt_estimator
+{
+  struct rtt_estimator *hash_next;
+  unsigned long prefix; /* address >> ( 32 - RTT_PREFIX_BITS ) */
+  float srtt;           /* smoothed rtt */
+  float rttvar;         /* smoothed mean deviation */
+  unsigned long samples;
+};
+
+struct rtt_table
+{
+  struct rtt_estimator **buckets;
+  unsigned int size; /* number of buckets, a power of two */
+};
+
+/* new_rtt_table returns NULL if memory runs out */
+struct rtt_table *
+new_rtt_table ( void );
+
+void
+delete_rtt_table ( struct rtt_table *table );
+
+/* rtt_update adds a measured round trip time of addr (host byte order) to
+   the estimator of its prefix. Without memory for a new estimator it is
+   dropped. */
+void
+rtt_update ( struct rtt_table *table, unsigned long addr, float rtt );
+
+/* rtt_find returns the estimator of the prefix of addr, NULL if nothing
+   from there has been measured yet */
+const struct rtt_estimator *
+rtt_find ( const struct rtt_table *table, unsigned long addr );
+
+#endif /* RTT_H */
@@ -0,0 +1,181 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sample.h"
+
+#define BLOCK_BITS 16
+#define BLOCKS ( 1UL << ( 32 - BLOCK_BITS ) )
+#define FEISTEL_ROUNDS 4
+
+/* mix is a 32 bit integer hash, keyed */
+static unsigned long
+mix ( unsigned long v, unsigned long key )
+{
+  v = ( v ^ key ) & 0xffffffff;
+  v = ( ( v >> 16 ) ^ v ) * 0x45d9f3b & 0xffffffff;
+  v = ( ( v >> 16 ) ^ v ) * 0x45d9f3b & 0xffffffff;
+  return ( v >> 16 ) ^ v;
+}
+
+/* A balanced Feistel network is a permutation of [0, 2^(2 * half_bits))
+   whatever its round function */
+static unsigned long long
+feistel ( unsigned long long x, int half_bits, unsigned long key )
+{
+  unsigned long long mask = ( 1ULL << half_bits ) - 1;
+  unsigned long long left = x >> half_bits, right = x & mask, t;
+  int round;
+
+  for ( round = 0; round < FEISTEL_ROUNDS; round++ )
+    {
+      t = left ^ ( mix ( right, key + round ) & mask );
+      left = right;
+      right = t;
+    }
+  return ( left << half_bits ) | right;
+}
+
+unsigned long
+sample_permute ( unsigned long i, unsigned long size, unsigned long key )
+{
+  unsigned long long x = i;
+  int bits = 0;
+
+  while ( ( 1ULL << bits ) < size )
+    bits++;
+  if ( bits == 0 )
+    return 0;
+  bits += bits & 1;
+
+  /* Walk the cycle until we are back inside [0, size). The domain is less
+     than four times size, so that takes few steps. */
+  do
+    x = feistel ( x, bits / 2, key );
+  while ( x >= size );
+  return x;
+}
+
+int
+sample_keep ( unsigned long addr, double fraction, unsigned long key )
+{
+  return mix ( addr, key ) < fraction * 4294967296.0;
+}
+
+struct sample_table *
+new_sample_table ( void )
+{
+  struct sample_table *table;
+
+  if ( ( table = calloc ( 1, sizeof ( struct sample_table ) ) ) == NULL )
+    return NULL;
+  if ( ( table->index = calloc ( BLOCKS, sizeof ( unsigned int ) ) ) == NULL )
+    {
+      free ( table );
+      return NULL;
+    }
+  return table;
+}
+
+void
+delete_sample_table ( struct sample_table *table )
+{
+  free ( table->index );
+  free ( table->blocks );
+  free ( table );
+}
+
+static struct nbt_block *
+find_block ( struct sample_table *table, unsigned long addr, int create )
+{
+  unsigned long top = ( addr & 0xffffffff ) >> BLOCK_BITS;
+  struct nbt_block *block, *blocks;
+
+  if ( table->index[top] )
+    return &table->blocks[table->index[top] - 1];
+  if ( !create )
+    return NULL;
+
+  if ( table->count == table->allocated )
+    {
+      blocks = realloc ( table->blocks,
+                         ( table->allocated ? table->allocated * 2 : 16 ) *
+                                 sizeof ( struct nbt_block ) );
+      if ( !blocks )
+        return NULL;
+      table->blocks = blocks;
+      table->allocated = table->allocated ? table->allocated * 2 : 16;
+    }
+  block = &table->blocks[table->count++];
+  memset ( block, 0, sizeof ( struct nbt_block ) );
+  block->start = top << BLOCK_BITS;
+  table->index[top] = table->count;
+  return block;
+}
+
+int
+sample_add_range ( struct sample_table *table,
+                   unsigned long start,
+                   unsigned long end )
+{
+  struct nbt_block *block;
+  unsigned long block_end;
+
+  for ( ;; )
+    {
+      block_end = start | ( ( 1UL << BLOCK_BITS ) - 1 );
+      if ( block_end > end )
+        block_end = end;
+      if ( !( block = find_block ( table, start, 1 ) ) )
+        return -1;
+      block->size += block_end - start + 1;
+      if ( block_end >= end )
+        return 0;
+      start = block_end + 1;
+    }
+}
+
+void
+sample_probed ( struct sample_table *table, unsigned long addr )
+{
+  struct nbt_block *block;
+
+  if ( ( block = find_block ( table, addr, 0 ) ) )
+    block->probed++;
+}
+
+void
+sample_responded ( struct sample_table *table, unsigned long addr )
+{
+  struct nbt_block *block;
+
+  if ( ( block = find_block ( table, addr, 0 ) ) )
+    block->responded++;
+}
+
+void
+sample_report ( struct sample_table *table,
+                nbt_block_cb callback,
+                void *arg )
+{
+  unsigned long top;
+
+  for ( top = 0; top < BLOCKS; top++ )
+    if ( table->index[top] )
+      callback ( &table->blocks[table->index[top] - 1], arg );
+}
@@ -0,0 +1,71 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#if !defined SAMPLE_H
+#define SAMPLE_H
+
+#include "nbtscan.h"
+
+/* Sampling draws its addresses through a keyed pseudo random permutation
+   of each range, so that no list of them has to be kept */
+
+/* sample_permute maps i in [0, size) to a position in [0, size), a
+   different one for each i. key picks the permutation. */
+unsigned long
+sample_permute ( unsigned long i, unsigned long size, unsigned long key );
+
+/* sample_keep tells if addr, read from a file, falls into a sample of
+   fraction of all addresses */
+int
+sample_keep ( unsigned long addr, double fraction, unsigned long key );
+
+/* Per /16 counts of what a sampling scan covered */
+struct sample_table
+{
+  unsigned int *index; /* by the top 16 bits of an address, 1 + the number
+                          of its block in blocks, 0 if there is none */
+  struct nbt_block *blocks;
+  unsigned int count;
+  unsigned int allocated;
+};
+
+/* new_sample_table returns NULL if memory runs out */
+struct sample_table *
+new_sample_table ( void );
+
+void
+delete_sample_table ( struct sample_table *table );
+
+/* sample_add_range counts the addresses from start to end into their /16
+   blocks. Returns 0, or -1 if memory ran out. */
+int
+sample_add_range ( struct sample_table *table,
+                   unsigned long start,
+                   unsigned long end );
+
+void
+sample_probed ( struct sample_table *table, unsigned long addr );
+
+void
+sample_responded ( struct sample_table *table, unsigned long addr );
+
+/* sample_report calls callback for every block, lowest address first */
+void
+sample_report ( struct sample_table *table,
+                nbt_block_cb callback,
+                void *arg );
+
+#endif /* SAMPLE_H */
@@ -0,0 +1,1884 @@
+/*
+# Copyright 1999-2003 Alla Bezroutchko <alla@inetcat.org>
+# Copyright 2004      Jochen Friedrich <jochen@scram.de>
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/* The scan engine: sends queries to the targets, collects the answers and
+   retransmits to hosts that did not answer */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <net/if.h>
+#include <ifaddrs.h>
+#include "nbtscan.h"
+#include "statusq.h"
+#include "range.h"
+#include "list.h"
+#include "errors.h"
+#include "time.h"
+#include "probe.h"
+#include "tstamp.h"
+#include "arp.h"
+#include "rtt.h"
+#include "sample.h"
+#include "cookie.h"
+#include "pcapfile.h"
+#include "bitmap.h"
+#include "exclude.h"
+#include "reorder.h"
+#include "prefix.h"
+
+#define BUFFSIZE 1024
+
+/* Work done by one nbt_scan_step() call, so that a large scan doesn't
+   starve the rest of the caller's event loop */
+#define RECV_BATCH 64
+#define SEND_BATCH 64
+
+/* The ARP replies arrive on a descriptor of their own, which callers don't
+   wait on. Poll it this often while a sweep is under way. */
+#define ARP_POLL_MS 10
+
+/* Extra delay between queries after the socket buffer or the device queue
+   ran full. It doubles on every such send and wears off as sends go
+   through again. */
+#define BACKOFF_MIN_US 1000
+#define BACKOFF_MAX_US 100000
+
+/* Shortest time to wait for an answer before a retransmit round, however
+   fast a network looks */
+#define RTO_MIN 0.05
+
+/* While draining, the wait is worked out again after answers arrive, but
+   not more often than this, it walks all outstanding queries. The answers
+   in by then are the fast ones, so only a round with another after it
+   takes its wait from them; the last one keeps every query out for the
+   whole -t timeout. */
+#define DRAIN_RECHECK_MS 10
+
+/* A stateless scan sends as fast as it is let, ask for a receive buffer
+   that holds the answers of a few thousand queries */
+#define STATELESS_RCVBUF ( 4 * 1024 * 1024 )
+
+/* Results held for sorted output are looked at this often, it walks all
+   outstanding queries */
+#define SORTED_FLUSH_MS 10
+
+/* Queries held back by the per prefix rate, over all prefixes. No more
+   targets are taken while this many wait. */
+#define PREFIX_HOLD_MAX 4096
+
+enum scan_phase
+{
+  SCAN_ARPING,      /* sweeping the local subnets with ARP requests */
+  SCAN_DISCOVERING, /* broadcast name queries out, collecting responders */
+  SCAN_SENDING,  /* going through the targets */
+  SCAN_DRAINING, /* all sent, waiting timeout for the last answers */
+  SCAN_WAITING,  /* waiting for the retransmit timeout to expire */
+  SCAN_DONE
+};
+
+/* An address range or a file of addresses to scan */
+struct nbt_target
+{
+  struct nbt_target *next;
+  struct ip_range range;
+  FILE *file;      /* NULL for a range */
+  long file_start; /* where to rewind the file to, -1 if it can't be */
+};
+
+struct nbt_scan
+{
+  struct nbt_options options;
+  nbt_result_cb callback;
+  void *arg;
+  int sock;
+
+  struct nbt_target *targets;
+  struct nbt_target *last_target;
+  struct nbt_target *current; /* target being sent to */
+  int started;                /* prev is valid for the current range */
+  struct in_addr prev;        /* last address sent to in the current range */
+  int resumed;                /* prev was jumped to, past excluded ones */
+  unsigned long long fair_index; /* position in the interleaved range */
+  struct addr_bitmap *read;   /* addresses read from files this round */
+  struct exclude_list *exclude; /* addresses never to query, or NULL */
+
+  struct arp_sweep *arp; /* NULL without an ARP sweep */
+  struct list *alive;     /* hosts that answered ARP requests */
+  struct timeval arp_interval;
+
+  struct ip_range *subnets; /* local subnets the name queries went to */
+  int subnet_count;
+  struct list *responders; /* hosts that answered the name queries */
+
+  int sample_ready;               /* the fields below are set up */
+  double sample;                  /* fraction queried, 0 for all */
+  unsigned long sample_key;       /* picks the permutation */
+  unsigned long sample_index;     /* addresses drawn from the range */
+  struct sample_table *samples;   /* NULL unless sampling */
+
+  int scouting;             /* probing a few addresses of each block first */
+  int scouted;              /* that is over, live_blocks can be trusted */
+  unsigned long scout_block; /* first address of the block being probed */
+  unsigned long scout_index; /* addresses of it drawn so far */
+  struct list *live_blocks;  /* blocks with a host that answered or refused */
+
+  struct list *scanned; /* hosts that answered or are known not to */
+  struct probe_table *probes;
+  my_uint32_t rtt_base; /* Base time (seconds) for round trip times */
+  float srtt;           /* smoothed rtt estimator, seconds */
+  float rttvar;         /* smoothed mean deviation, seconds */
+  unsigned long rtt_samples;
+  struct rtt_table *rtts; /* estimators per prefix */
+  struct cookie_key cookie_key; /* of a stateless scan */
+  FILE *pcap;                   /* traffic is recorded here, or NULL */
+  struct sockaddr_in local;     /* our end, for the recording */
+
+  enum scan_phase phase;
+  int round;                    /* 0 for the first pass, then retransmits */
+  long unsettled; /* queries of this round not answered or refused yet */
+  struct timeval round_started; /* when the current round began */
+  struct timeval send_interval;
+  struct prefix_table *prefixes; /* queries held for their prefix's turn,
+                                    with a per prefix rate */
+  struct timeval next_send; /* earliest time for the next query */
+  long backoff_us;          /* added to send_interval while under pressure */
+  int have_retry;           /* retry_addr is to be sent before the others */
+  struct in_addr retry_addr;
+  struct timeval deadline;  /* end of SCAN_DRAINING or SCAN_WAITING */
+  int drain_dirty;             /* answers arrived since the last check */
+  struct timeval drain_check;  /* earliest time for the next check */
+  struct reorder_buffer *held; /* results waiting for sorted output, or
+                                  NULL */
+  unsigned long long flushed;  /* results below this address went out */
+  struct timeval flush_check;  /* earliest time to look at them again */
+
+  int failed; /* memory ran out, the scan can't go on */
+  struct nbt_stats stats;
+  char buff[BUFFSIZE];
+};
+
+void
+nbt_default_options ( struct nbt_options *options )
+{
+  options->timeout = 1000;
+  options->bandwidth = 0;
+  options->retransmits = 0;
+  options->use137 = 0;
+  options->share137 = 0;
+  options->discover = 0;
+  options->arp_sweep = 0;
+  options->sample = 0;
+  options->sample_count = 0;
+  options->prune = 0;
+  options->prune_bits = 24;
+  options->stateless = 0;
+  options->fair = 0;
+  options->fair_bits = 24;
+  options->prefix_rate = 0;
+  options->sorted = 0;
+  options->parts = NB_PARSE_ALL;
+  options->quiet = 0;
+}
+
+static void
+ms_to_timeval ( long ms, struct timeval *tv )
+{
+  tv->tv_sec = ms / 1000;
+  tv->tv_usec = ( ms % 1000 ) * 1000;
+}
+
+/* bandwidth_interval works out how far apart packets of size bytes have to
+   be sent to stay within bandwidth bits per second */
+static void
+bandwidth_interval ( int bandwidth, int size, struct timeval *interval )
+{
+  timerclear ( interval );
+  if ( bandwidth > 0 )
+    {
+      interval->tv_usec = size * 8 * 1000000 / bandwidth;
+      if ( interval->tv_usec >= 1000000 )
+        {
+          interval->tv_sec = interval->tv_usec / 1000000;
+          interval->tv_usec = interval->tv_usec % 1000000;
+        }
+    }
+  else /* Assuming 10baseT bandwidth */
+    interval->tv_usec = 1;
+}
+
+static enum scan_phase
+first_phase ( const struct nbt_scan *scan )
+{
+  if ( scan->arp )
+    return SCAN_ARPING;
+  if ( scan->options.discover )
+    return SCAN_DISCOVERING;
+  return SCAN_SENDING;
+}
+
+struct nbt_scan *
+nbt_scan_new ( const struct nbt_options *options,
+               nbt_result_cb callback,
+               void *arg )
+{
+  struct nbt_scan *scan;
+  struct sockaddr_in src_sockaddr;
+  struct timeval interval;
+  int saved_errno, on = 1, rcvbuf;
+
+  scan = malloc ( sizeof ( struct nbt_scan ) );
+  if ( !scan )
+    return NULL;
+  memset ( scan, 0, sizeof ( struct nbt_scan ) );
+
+  if ( options )
+    scan->options = *options;
+  else
+    nbt_default_options ( &scan->options );
+  scan->callback = callback;
+  scan->arg = arg;
+
+  scan->sock = socket ( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
+  if ( scan->sock < 0 )
+    {
+      free ( scan );
+      return NULL;
+    }
+
+  memset ( &src_sockaddr, 0, sizeof src_sockaddr );
+  src_sockaddr.sin_family = AF_INET;
+  if ( scan->options.use137 )
+    src_sockaddr.sin_port = htons ( NB_DGRAM );
+  if ( bind ( scan->sock,
+              ( struct sockaddr * ) &src_sockaddr,
+              sizeof ( src_sockaddr ) ) == -1 )
+    {
+      saved_errno = errno;
+      close ( scan->sock );
+      free ( scan );
+      errno = saved_errno;
+      return NULL;
+    }
+
+  /* Port 137 is ours alone until it is bound: only then is a passive
+     listener (nbt_passive_new) let in, if asked for. A name server running
+     on the host made the bind fail instead of losing its traffic to us. */
+  if ( scan->options.use137 && scan->options.share137 )
+    setsockopt ( scan->sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on );
+
+  /* Sends that would block are put off, see send_some() */
+  fcntl ( scan->sock, F_SETFL, fcntl ( scan->sock, F_GETFL ) | O_NONBLOCK );
+
+  /* Let the kernel stamp queries and responses, so that round trip times
+     don't include the time we spend in our own loop */
+  tstamp_enable ( scan->sock );
+
+  /* Hosts without a name service answer with ICMP port unreachable, which
+     spares us waiting for them and querying them again */
+  tstamp_enable_errors ( scan->sock );
+
+  if ( scan->options.discover )
+    setsockopt ( scan->sock, SOL_SOCKET, SO_BROADCAST, &on, sizeof on );
+
+  if ( scan->options.stateless )
+    {
+      cookie_secret ( &scan->cookie_key );
+      rcvbuf = STATELESS_RCVBUF;
+      setsockopt ( scan->sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof rcvbuf );
+    }
+
+  if ( scan->options.arp_sweep && !( scan->arp = new_arp_sweep () ) )
+    {
+      saved_errno = errno;
+      close ( scan->sock );
+      free ( scan );
+      errno = saved_errno;
+      return NULL;
+    }
+
+  /* Calculate interval between subsequent sends */
+  bandwidth_interval ( scan->options.bandwidth,
+                       NBNAME_REQUEST_SIZE + UDP_HEADER_SIZE + IP_HEADER_SIZE,
+                       &scan->send_interval );
+  bandwidth_interval (
+          scan->options.bandwidth, ARP_FRAME_SIZE, &scan->arp_interval );
+  if ( scan->options.prefix_rate > 0 )
+    {
+      interval.tv_sec = 1 / scan->options.prefix_rate;
+      interval.tv_usec = ( 1000000 / scan->options.prefix_rate ) % 1000000;
+      scan->prefixes = new_prefix_table ( &interval );
+    }
+
+  scan->scanned = new_list ();
+  scan->probes = new_probe_table ();
+  scan->rtts = new_rtt_table ();
+  scan->responders = new_list ();
+  scan->alive = new_list ();
+  scan->live_blocks = new_list ();
+  if ( scan->options.sorted )
+    scan->held = new_reorder_buffer ();
+  if ( !scan->scanned || !scan->probes || !scan->rtts || !scan->responders ||
+       !scan->alive || !scan->live_blocks ||
+       ( scan->options.prefix_rate > 0 && !scan->prefixes ) ||
+       ( scan->options.sorted && !scan->held ) )
+    {
+      nbt_scan_free ( scan );
+      errno = ENOMEM;
+      return NULL;
+    }
+  scan->rttvar = 0.75;
+  scan->phase = first_phase ( scan );
+
+  gettimeofday ( &scan->round_started, NULL );
+  scan->rtt_base = scan->round_started.tv_sec;
+  scan->next_send = scan->round_started;
+
+  return scan;
+}
+
+void
+nbt_scan_free ( struct nbt_scan *scan )
+{
+  struct nbt_target *target, *next;
+
+  if ( !scan )
+    return;
+  for ( target = scan->targets; target; target = next )
+    {
+      next = target->next;
+      free ( target );
+    }
+  delete_arp_sweep ( scan->arp );
+  delete_list ( scan->alive );
+  free ( scan->subnets );
+  delete_list ( scan->responders );
+  delete_list ( scan->scanned );
+  delete_list ( scan->live_blocks );
+  delete_addr_bitmap ( scan->read );
+  delete_exclude_list ( scan->exclude );
+  delete_reorder_buffer ( scan->held );
+  if ( scan->samples )
+    delete_sample_table ( scan->samples );
+  if ( scan->probes )
+    delete_probe_table ( scan->probes );
+  delete_prefix_table ( scan->prefixes );
+  if ( scan->rtts )
+    delete_rtt_table ( scan->rtts );
+  if ( scan->pcap )
+    fclose ( scan->pcap );
+  close ( scan->sock );
+  free ( scan );
+}
+
+/* add_target appends an empty target, or returns NULL if memory ran out */
+static struct nbt_target *
+add_target ( struct nbt_scan *scan )
+{
+  struct nbt_target *target;
+
+  target = malloc ( sizeof ( struct nbt_target ) );
+  if ( !target )
+    return NULL;
+  memset ( target, 0, sizeof ( struct nbt_target ) );
+
+  if ( scan->last_target )
+    scan->last_target->next = target;
+  else
+    scan->targets = target;
+  scan->last_target = target;
+
+  /* A scan that had run out of targets picks up the new ones */
+  if ( !scan->current )
+    {
+      scan->current = target;
+      scan->started = 0;
+    }
+  if ( scan->phase == SCAN_DRAINING )
+    scan->phase = SCAN_SENDING;
+
+  return target;
+}
+
+int
+nbt_scan_add_target ( struct nbt_scan *scan, const char *target )
+{
+  struct ip_range range;
+
+  if ( !is_ip ( target, &range ) && !is_range1 ( target, &range ) &&
+       !is_range2 ( target, &range ) )
+    return 0;
+  if ( nbt_scan_add_range ( scan, range.start_ip, range.end_ip ) < 0 )
+    return -1;
+  return 1;
+}
+
+int
+nbt_scan_add_range ( struct nbt_scan *scan,
+                     unsigned long start_ip,
+                     unsigned long end_ip )
+{
+  struct nbt_target *target;
+
+  if ( !( target = add_target ( scan ) ) )
+    return -1;
+  target->range.start_ip = start_ip;
+  target->range.end_ip = end_ip;
+  return 0;
+}
+
+int
+nbt_scan_add_file ( struct nbt_scan *scan, FILE *file )
+{
+  struct nbt_target *target;
+
+  if ( !( target = add_target ( scan ) ) )
+    return -1;
+  target->file = file;
+  target->file_start = ftell ( file );
+  return 0;
+}
+
+int
+nbt_scan_exclude ( struct nbt_scan *scan, const char *target )
+{
+  struct ip_range range;
+
+  if ( !is_ip ( target, &range ) && !is_range1 ( target, &range ) &&
+       !is_range2 ( target, &range ) )
+    return 0;
+  if ( nbt_scan_exclude_range ( scan, range.start_ip, range.end_ip ) < 0 )
+    return -1;
+  return 1;
+}
+
+int
+nbt_scan_exclude_range ( struct nbt_scan *scan,
+                         unsigned long start_ip,
+                         unsigned long end_ip )
+{
+  if ( !scan->exclude && !( scan->exclude = new_exclude_list () ) )
+    return -1;
+  return exclude_add ( scan->exclude, start_ip, end_ip );
+}
+
+int
+nbt_scan_fd ( const struct nbt_scan *scan )
+{
+  return scan->sock;
+}
+
+const struct nbt_stats *
+nbt_scan_stats ( const struct nbt_scan *scan )
+{
+  return &scan->stats;
+}
+
+int
+nbt_scan_record ( struct nbt_scan *scan, const char *path )
+{
+  socklen_t len = sizeof scan->local;
+
+  if ( scan->pcap )
+    fclose ( scan->pcap );
+  if ( !( scan->pcap = pcap_create ( path ) ) )
+    return -1;
+  getsockname ( scan->sock, ( struct sockaddr * ) &scan->local, &len );
+  return 0;
+}
+
+/* record writes a datagram to the recording. Recording stops at the first
+   failed write. */
+static void
+record ( struct nbt_scan *scan,
+         const struct sockaddr_in *src,
+         const struct sockaddr_in *dst,
+         const void *data,
+         int size,
+         const struct timeval *ts )
+{
+  if ( pcap_write ( scan->pcap, src, dst, data, size, ts ) < 0 )
+    {
+      err_print ( "Write failed to capture file", scan->options.quiet );
+      scan->stats.errors++;
+      fclose ( scan->pcap );
+      scan->pcap = NULL;
+    }
+}
+
+/* send_recorded sends request to addr and records it if it went out */
+static int
+send_recorded ( struct nbt_scan *scan,
+                struct in_addr addr,
+                const struct nbname_request *request,
+                const struct timeval *now )
+{
+  struct sockaddr_in dest;
+  char errmsg[80];
+  int saved_errno;
+
+  if ( send_request ( scan->sock, addr, request ) < 0 )
+    {
+      /* A full socket buffer or device queue is for the caller to handle */
+      if ( errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS )
+        return -1;
+      saved_errno = errno;
+      snprintf ( errmsg,
+                 sizeof errmsg,
+                 "%s\tSendto failed",
+                 inet_ntoa ( addr ) );
+      err_print ( errmsg, scan->options.quiet );
+      errno = saved_errno;
+      return -1;
+    }
+  if ( scan->pcap )
+    {
+      memset ( &dest, 0, sizeof dest );
+      dest.sin_family = AF_INET;
+      dest.sin_port = htons ( NB_DGRAM );
+      dest.sin_addr = addr;
+      record ( scan, &scan->local, &dest, request, sizeof *request, now );
+    }
+  return 0;
+}
+
+void
+nbt_scan_blocks ( const struct nbt_scan *scan,
+                  nbt_block_cb callback,
+                  void *arg )
+{
+  if ( scan->samples )
+    sample_report ( scan->samples, callback, arg );
+}
+
+int
+nbt_scan_skip ( struct nbt_scan *scan, struct in_addr addr )
+{
+  return insert ( scan->scanned, ntohl ( addr.s_addr ) ) < 0 ? -1 : 0;
+}
+
+/* setup_sample works out the fraction to sample once all targets are in,
+   and counts the addresses of the ranges per block. Pruning is left out
+   of a sampling scan. */
+static void
+setup_sample ( struct nbt_scan *scan )
+{
+  struct nbt_target *target;
+  struct timeval now;
+  double total = 0;
+
+  scan->sample_ready = 1;
+  gettimeofday ( &now, NULL );
+  scan->sample_key = now.tv_usec ^ ( now.tv_sec << 20 ) ^ getpid ();
+  if ( scan->options.sample <= 0 && scan->options.sample_count == 0 )
+    {
+      scan->scouting = scan->options.prune > 0;
+      return;
+    }
+
+  if ( !( scan->samples = new_sample_table () ) )
+    {
+      scan->failed = 1;
+      return;
+    }
+  for ( target = scan->targets; target; target = target->next )
+    if ( !target->file )
+      {
+        total += target->range.end_ip - target->range.start_ip + 1;
+        if ( sample_add_range ( scan->samples,
+                                target->range.start_ip,
+                                target->range.end_ip ) < 0 )
+          scan->failed = 1;
+      }
+
+  scan->sample = scan->options.sample;
+  if ( scan->options.sample_count && total > 0 )
+    scan->sample = scan->options.sample_count / total;
+  if ( scan->sample <= 0 || scan->sample > 1 )
+    scan->sample = 1;
+}
+
+/* next_sample draws the next address of the current range from its
+   permutation */
+static int
+next_sample ( struct nbt_scan *scan,
+              const struct ip_range *range,
+              struct in_addr *addr )
+{
+  unsigned long size = range->end_ip - range->start_ip + 1;
+  unsigned long wanted = scan->sample * size + 0.5;
+
+  if ( wanted == 0 )
+    wanted = 1;
+  if ( !scan->started )
+    {
+      scan->sample_index = 0;
+      scan->started = 1;
+    }
+  if ( scan->sample_index >= wanted )
+    return 0;
+  addr->s_addr = htonl (
+          range->start_ip +
+          sample_permute ( scan->sample_index++, size, scan->sample_key ) );
+  return 1;
+}
+
+/* The blocks pruning goes by, as a mask of their first address */
+static unsigned long
+block_mask ( const struct nbt_scan *scan )
+{
+  int bits = scan->options.prune_bits;
+
+  if ( bits < 1 || bits > 32 )
+    bits = 24;
+  return ( 0xffffffffUL << ( 32 - bits ) ) & 0xffffffffUL;
+}
+
+/* next_scout draws the addresses of the current range to probe first:
+   prune of them from each block, spread over it by the sampling
+   permutation */
+static int
+next_scout ( struct nbt_scan *scan,
+             const struct ip_range *range,
+             struct in_addr *addr )
+{
+  unsigned long mask = block_mask ( scan ), end, size;
+
+  if ( !scan->started )
+    {
+      scan->scout_block = range->start_ip;
+      scan->scout_index = 0;
+      scan->started = 1;
+    }
+  for ( ;; )
+    {
+      end = scan->scout_block | ( ~mask & 0xffffffffUL );
+      if ( end > range->end_ip )
+        end = range->end_ip;
+      size = end - scan->scout_block + 1;
+      if ( scan->scout_index < ( unsigned long ) scan->options.prune &&
+           scan->scout_index < size )
+        {
+          addr->s_addr = htonl (
+                  scan->scout_block +
+                  sample_permute ( scan->scout_index++,
+                                   size,
+                                   scan->sample_key ^ scan->scout_block ) );
+          return 1;
+        }
+      if ( end >= range->end_ip )
+        return 0;
+      scan->scout_block = end + 1;
+      scan->scout_index = 0;
+    }
+}
+
+/* block_pruned tells if the block of addr is to be left out: no host in
+   it answered or refused the first probes. Subnets the ARP sweep or the
+   name queries reached are never pruned, those sweeps know better. */
+static int
+block_pruned ( const struct nbt_scan *scan, unsigned long addr )
+{
+  int i;
+
+  if ( !scan->scouted ||
+       in_list ( scan->live_blocks, addr & block_mask ( scan ) ) )
+    return 0;
+  if ( scan->arp && arp_covers ( scan->arp, addr ) )
+    return 0;
+  for ( i = 0; i < scan->subnet_count; i++ )
+    if ( addr >= scan->subnets[i].start_ip && addr <= scan->subnets[i].end_ip )
+      return 0;
+  return 1;
+}
+
+/* A host answered or refused, its block is worth going through */
+static void
+block_alive ( struct nbt_scan *scan, unsigned long addr )
+{
+  if ( scan->options.prune > 0 &&
+       insert ( scan->live_blocks, addr & block_mask ( scan ) ) < 0 )
+    scan->failed = 1;
+}
+
+void
+nbt_scan_pruned ( const struct nbt_scan *scan,
+                  nbt_block_cb callback,
+                  void *arg )
+{
+  const struct nbt_target *target;
+  struct nbt_block run;
+  unsigned long start, end, size, mask = block_mask ( scan );
+
+  if ( !scan->scouted )
+    return;
+  for ( target = scan->targets; target; target = target->next )
+    {
+      if ( target->file )
+        continue;
+      memset ( &run, 0, sizeof run );
+      for ( start = target->range.start_ip;; start = end + 1 )
+        {
+          end = start | ( ~mask & 0xffffffffUL );
+          if ( end > target->range.end_ip )
+            end = target->range.end_ip;
+          if ( block_pruned ( scan, start ) )
+            {
+              if ( !run.size )
+                run.start = start;
+              size = end - start + 1;
+              run.size += size;
+              run.probed += size < ( unsigned long ) scan->options.prune
+                                    ? size
+                                    : ( unsigned long ) scan->options.prune;
+            }
+          else if ( run.size )
+            {
+              callback ( &run, arg );
+              run.size = run.probed = 0;
+            }
+          if ( end >= target->range.end_ip )
+            break;
+        }
+      if ( run.size )
+        callback ( &run, arg );
+    }
+}
+
+/* The prefixes the per prefix rate and the interleaving go by, as a mask
+   of their first address */
+static unsigned long
+fair_mask ( const struct nbt_scan *scan )
+{
+  int bits = scan->options.fair_bits;
+
+  if ( bits < 1 || bits > 32 )
+    bits = 24;
+  return ( 0xffffffffUL << ( 32 - bits ) ) & 0xffffffffUL;
+}
+
+/* The prefix addr is in, numbered from 0, to key the per prefix rate by */
+static unsigned long
+fair_prefix ( const struct nbt_scan *scan, struct in_addr addr )
+{
+  unsigned long mask = fair_mask ( scan );
+
+  return ( ntohl ( addr.s_addr ) & mask ) / ( ( ~mask & 0xffffffffUL ) + 1 );
+}
+
+/* next_fair walks the current range taking one address from each prefix
+   in turn, so that consecutive queries go to different subnets and no
+   single gateway gets them all in a burst */
+static int
+next_fair ( struct nbt_scan *scan,
+            const struct ip_range *range,
+            struct in_addr *addr )
+{
+  unsigned long long size = ( ~fair_mask ( scan ) & 0xffffffffUL ) + 1;
+  unsigned long long base = range->start_ip & fair_mask ( scan );
+  unsigned long long blocks = ( range->end_ip - base ) / size + 1;
+  unsigned long long a;
+
+  if ( !scan->started )
+    {
+      scan->fair_index = 0;
+      scan->started = 1;
+    }
+  while ( scan->fair_index < blocks * size )
+    {
+      a = base + ( scan->fair_index % blocks ) * size +
+          scan->fair_index / blocks;
+      scan->fair_index++;
+      if ( a >= range->start_ip && a <= range->end_ip )
+        {
+          addr->s_addr = htonl ( a );
+          return 1;
+        }
+    }
+  return 0;
+}
+
+/* skip_excluded tells if addr is not to be queried. Excluded addresses
+   are counted once, on the first pass over the targets. */
+static int
+skip_excluded ( struct nbt_scan *scan, const struct in_addr *addr )
+{
+  if ( !scan->exclude ||
+       !exclude_find ( scan->exclude, ntohl ( addr->s_addr ) ) )
+    return 0;
+  if ( scan->round == 0 && !scan->scouting && scan->phase != SCAN_ARPING )
+    scan->stats.excluded++;
+  return 1;
+}
+
+/* next_target writes the next address to scan to *addr. Returns 1 if there
+   is one and 0 when all targets are done. */
+static int
+next_target ( struct nbt_scan *scan, struct in_addr *addr )
+{
+  struct nbt_target *target;
+  const struct ip_range *excluded;
+  unsigned long end;
+  char str[80];
+  int added;
+
+  while ( ( target = scan->current ) )
+    {
+      if ( target->file )
+        {
+          /* Files are left alone by the ARP sweep and the first probes of
+             pruning, they may not rewind */
+          if ( scan->phase != SCAN_ARPING && !scan->scouting &&
+               fgets ( str, sizeof str, target->file ) )
+            {
+              if ( inet_aton ( str, addr ) )
+                {
+                  /* Lists merged from several sources repeat addresses */
+                  if ( !scan->read && !( scan->read = new_addr_bitmap () ) )
+                    {
+                      scan->failed = 1;
+                      return 0;
+                    }
+                  added = bitmap_add ( scan->read, ntohl ( addr->s_addr ) );
+                  if ( added < 0 )
+                    {
+                      scan->failed = 1;
+                      return 0;
+                    }
+                  if ( !added )
+                    {
+                      if ( scan->round == 0 )
+                        scan->stats.repeated++;
+                      continue;
+                    }
+                  if ( skip_excluded ( scan, addr ) )
+                    continue;
+                  if ( !scan->samples )
+                    return 1;
+                  if ( scan->round == 0 &&
+                       sample_add_range ( scan->samples,
+                                          ntohl ( addr->s_addr ),
+                                          ntohl ( addr->s_addr ) ) < 0 )
+                    {
+                      scan->failed = 1;
+                      return 0;
+                    }
+                  if ( sample_keep ( ntohl ( addr->s_addr ),
+                                     scan->sample,
+                                     scan->sample_key ) )
+                    return 1;
+                  continue;
+                }
+              fprintf ( stderr, "%s - bad IP address\n", str );
+              continue;
+            }
+          if ( ferror ( target->file ) )
+            {
+              err_print ( "Read failed from target file", scan->options.quiet );
+              scan->stats.errors++;
+            }
+        }
+      else if ( scan->scouting && scan->phase != SCAN_ARPING )
+        {
+          if ( next_scout ( scan, &target->range, addr ) )
+            {
+              if ( skip_excluded ( scan, addr ) )
+                continue;
+              return 1;
+            }
+        }
+      else if ( scan->samples )
+        {
+          if ( next_sample ( scan, &target->range, addr ) )
+            {
+              if ( skip_excluded ( scan, addr ) )
+                continue;
+              return 1;
+            }
+        }
+      else if ( scan->options.fair )
+        {
+          if ( next_fair ( scan, &target->range, addr ) )
+            {
+              if ( skip_excluded ( scan, addr ) )
+                continue;
+              if ( scan->scouted &&
+                   block_pruned ( scan, ntohl ( addr->s_addr ) ) )
+                {
+                  if ( scan->round == 0 )
+                    scan->stats.pruned++;
+                  continue;
+                }
+              return 1;
+            }
+        }
+      else if ( next_address ( &target->range,
+                               scan->started ? &scan->prev : NULL,
+                               addr ) )
+        {
+          scan->prev = *addr;
+          scan->started = 1;
+          /* An excluded range is skipped in one step */
+          if ( scan->exclude &&
+               ( excluded = exclude_find ( scan->exclude,
+                                           ntohl ( addr->s_addr ) ) ) )
+            {
+              end = excluded->end_ip < target->range.end_ip
+                            ? excluded->end_ip
+                            : target->range.end_ip;
+              if ( scan->round == 0 && scan->phase != SCAN_ARPING )
+                scan->stats.excluded += end - ntohl ( addr->s_addr ) + 1;
+              scan->prev.s_addr = htonl ( end );
+              scan->resumed = 1;
+              continue;
+            }
+          /* Blocks are decided on as they are entered, a pruned one is
+             skipped to its end */
+          if ( scan->scouted &&
+               ( !( ntohl ( addr->s_addr ) & ~block_mask ( scan ) ) ||
+                 ntohl ( addr->s_addr ) == target->range.start_ip ||
+                 scan->resumed ) &&
+               block_pruned ( scan, ntohl ( addr->s_addr ) ) )
+            {
+              end = ntohl ( addr->s_addr ) |
+                    ( ~block_mask ( scan ) & 0xffffffffUL );
+              if ( end > target->range.end_ip )
+                end = target->range.end_ip;
+              if ( scan->round == 0 )
+                scan->stats.pruned += end - ntohl ( addr->s_addr ) + 1;
+              scan->prev.s_addr = htonl ( end );
+              scan->resumed = 0;
+              continue;
+            }
+          scan->resumed = 0;
+          return 1;
+        }
+      scan->current = target->next;
+      scan->started = 0;
+    }
+  return 0;
+}
+
+/* Go back to the first target for a retransmit round */
+static void
+rewind_targets ( struct nbt_scan *scan )
+{
+  struct nbt_target *target;
+
+  for ( target = scan->targets; target; target = target->next )
+    if ( target->file && target->file_start >= 0 )
+      {
+        clearerr ( target->file );
+        fseek ( target->file, target->file_start, SEEK_SET );
+      }
+  scan->current = scan->targets;
+  scan->started = 0;
+  if ( scan->read )
+    bitmap_clear ( scan->read );
+}
+
+/* Send ARP requests for the addresses of the target ranges that are on a
+   directly attached subnet, then wait timeout for the last replies */
+static void
+arp_send_some ( struct nbt_scan *scan, struct timeval *now )
+{
+  struct in_addr addr;
+  int i;
+
+  for ( i = 0; i < SEND_BATCH && !timercmp ( now, &scan->next_send, < ); i++ )
+    {
+      if ( !next_target ( scan, &addr ) )
+        {
+          rewind_targets ( scan );
+          ms_to_timeval ( scan->options.timeout, &scan->deadline );
+          timeradd ( now, &scan->deadline, &scan->deadline );
+          return;
+        }
+      if ( !arp_covers ( scan->arp, ntohl ( addr.s_addr ) ) )
+        continue;
+      if ( arp_request ( scan->arp, ntohl ( addr.s_addr ), scan->alive ) < 0 )
+        {
+          if ( errno == ENOMEM )
+            {
+              scan->failed = 1;
+              return;
+            }
+          err_print ( "ARP request failed", scan->options.quiet );
+          scan->stats.errors++;
+        }
+      gettimeofday ( now, NULL );
+      timeradd ( now, &scan->arp_interval, &scan->next_send );
+    }
+}
+
+/* discover_start sends a name query to the broadcast address of each
+   locally attached subnet that overlaps a target range. The discovery
+   phase is over at once if there is none. */
+static void
+discover_start ( struct nbt_scan *scan, struct timeval *now )
+{
+  struct ifaddrs *ifaddrs, *ifa;
+  struct nbt_target *target;
+  struct ip_range subnet;
+  struct in_addr broadcast;
+  struct nbname_request request;
+  struct ip_range *subnets;
+  struct list *responders;
+  unsigned long mask;
+
+  if ( !( responders = new_list () ) )
+    {
+      scan->failed = 1;
+      return;
+    }
+  delete_list ( scan->responders );
+  scan->responders = responders;
+  free ( scan->subnets );
+  scan->subnets = NULL;
+  scan->subnet_count = 0;
+
+  if ( getifaddrs ( &ifaddrs ) < 0 )
+    {
+      err_print ( "Can't list network interfaces", scan->options.quiet );
+      scan->stats.errors++;
+      ifaddrs = NULL;
+    }
+
+  for ( ifa = ifaddrs; ifa; ifa = ifa->ifa_next )
+    {
+      if ( !ifa->ifa_addr || ifa->ifa_addr->sa_family != AF_INET ||
+           !ifa->ifa_netmask || !( ifa->ifa_flags & IFF_UP ) ||
+           !( ifa->ifa_flags & IFF_BROADCAST ) ||
+           ( ifa->ifa_flags & IFF_LOOPBACK ) )
+        continue;
+
+      mask = ntohl (
+              ( ( struct sockaddr_in * ) ifa->ifa_netmask )->sin_addr.s_addr );
+      subnet.start_ip =
+              ntohl ( ( ( struct sockaddr_in * ) ifa->ifa_addr )
+                              ->sin_addr.s_addr ) &
+              mask;
+      subnet.end_ip = subnet.start_ip | ~mask;
+      if ( subnet.start_ip == subnet.end_ip )
+        continue;
+
+      for ( target = scan->targets; target; target = target->next )
+        if ( !target->file && target->range.start_ip <= subnet.end_ip &&
+             target->range.end_ip >= subnet.start_ip )
+          break;
+      if ( !target )
+        continue;
+      /* Not even a broadcast may reach excluded hosts, their subnet is
+         scanned address by address */
+      if ( scan->exclude &&
+           exclude_overlaps ( scan->exclude, subnet.start_ip, subnet.end_ip ) )
+        continue;
+
+      subnets = realloc ( scan->subnets,
+                          ( scan->subnet_count + 1 ) *
+                                  sizeof ( struct ip_range ) );
+      if ( !subnets )
+        {
+          scan->failed = 1;
+          break;
+        }
+      scan->subnets = subnets;
+      scan->subnets[scan->subnet_count++] = subnet;
+
+      broadcast.s_addr = htonl ( subnet.end_ip );
+      build_request ( &request, QT_NAME_QUERY, query_clock ( scan->rtt_base ) );
+      if ( send_recorded ( scan, broadcast, &request, now ) == 0 )
+        scan->stats.sent++;
+      else
+        scan->stats.errors++;
+    }
+  if ( ifaddrs )
+    freeifaddrs ( ifaddrs );
+
+  if ( scan->subnet_count == 0 )
+    timerclear ( &scan->deadline );
+  else
+    {
+      ms_to_timeval ( scan->options.timeout, &scan->deadline );
+      timeradd ( now, &scan->deadline, &scan->deadline );
+    }
+}
+
+/* Addresses on a subnet the name queries went to are only worth a node
+   status query if they answered */
+static int
+discover_skips ( struct nbt_scan *scan, unsigned long addr )
+{
+  int i;
+
+  for ( i = 0; i < scan->subnet_count; i++ )
+    if ( addr >= scan->subnets[i].start_ip && addr <= scan->subnets[i].end_ip )
+      return !in_list ( scan->responders, addr );
+  return 0;
+}
+
+/* Addresses the ARP sweep reached are only queried if they answered */
+static int
+arp_skips ( struct nbt_scan *scan, unsigned long addr )
+{
+  return scan->arp && arp_covers ( scan->arp, addr ) &&
+         !in_list ( scan->alive, addr );
+}
+
+/* cookie_matches tells if an answer from addr carries the transaction ID
+   a stateless scan sent it, before it is parsed */
+static int
+cookie_matches ( const struct nbt_scan *scan,
+                 const char *buff,
+                 int size,
+                 unsigned long addr )
+{
+  my_uint16_t transaction_id;
+
+  if ( size < 2 )
+    return 0;
+  memcpy ( &transaction_id, buff, 2 );
+  return ntohs ( transaction_id ) == cookie ( &scan->cookie_key, addr );
+}
+
+/* is_name_query_response tells answers to the broadcast name queries from
+   node status responses */
+static int
+is_name_query_response ( const char *buff, int size )
+{
+  my_uint16_t flags, type;
+
+  if ( size < NBNAME_REQUEST_SIZE )
+    return 0;
+  memcpy ( &flags, buff + 2, 2 );
+  memcpy ( &type, buff + 46, 2 );
+  return ( ntohs ( flags ) & FL_REQUEST ) && ntohs ( type ) == QT_NAME_QUERY;
+}
+
+/* settles tells if an answer or refusal settles a query of this round,
+   which is then no longer counted as unsettled. probe is the query found
+   outstanding for the address, if any: it has to have been sent since the
+   round began, a host that answers unasked or for another address of its
+   own settles nothing. A stateless scan keeps no queries, only its first
+   pass knows that any answer it takes is to one of that pass. */
+static int
+settles ( const struct nbt_scan *scan, const struct probe *probe )
+{
+  if ( scan->options.stateless )
+    return scan->round == 0 && !scan->scouted;
+  return probe && !timercmp ( &probe->sent, &scan->round_started, < );
+}
+
+static void
+handle_response ( struct nbt_scan *scan,
+                  struct sockaddr_in *from,
+                  int size,
+                  struct timeval *recv_time )
+{
+  struct nb_host_info *hostinfo;
+  struct probe *probe;
+  struct timeval diff_time;
+  unsigned long addr = ntohl ( from->sin_addr.s_addr );
+  float rtt;     /* most recent measured RTT, seconds */
+  double delta;  /* used in retransmit timeout calculations */
+  int settled, first;
+
+  hostinfo = parse_response_parts ( scan->buff, size, scan->options.parts );
+  if ( !hostinfo )
+    {
+      err_print ( "parse_response returned NULL", scan->options.quiet );
+      scan->stats.errors++;
+      return;
+    }
+
+  /* If this packet isn't a duplicate */
+  if ( ( first = insert ( scan->scanned, addr ) ) < 0 )
+    scan->failed = 1;
+  else if ( first )
+    {
+      probe = probe_find ( scan->probes, addr );
+      settled = settles ( scan, probe );
+      if ( probe )
+        {
+          timersub ( recv_time, &probe->sent, &diff_time );
+          rtt = diff_time.tv_sec + diff_time.tv_usec / 1000000.0;
+          probe_remove ( scan->probes, probe );
+        }
+      else if ( hostinfo->header && !scan->options.stateless )
+        {
+          /* No longer tracked, fall back to the millisecond clock we put in
+             the transaction ID */
+          rtt = ( ( ( recv_time->tv_sec - scan->rtt_base ) * 1000 +
+                    recv_time->tv_usec / 1000 -
+                    hostinfo->header->transaction_id ) &
+                  0xffff ) /
+                1000.0;
+        }
+      else
+        rtt = -1;
+
+      if ( rtt >= 0 )
+        {
+          /* Using algorithm described in Stevens'
+             Unix Network Programming */
+          delta = rtt - scan->srtt;
+          scan->srtt += delta / 8;
+          if ( delta < 0.0 )
+            delta = -delta;
+          scan->rttvar += ( delta - scan->rttvar ) / 4;
+          scan->rtt_samples++;
+          rtt_update ( scan->rtts, addr, rtt );
+        }
+
+      scan->stats.responded++;
+      if ( settled )
+        scan->unsettled--;
+      if ( scan->samples )
+        sample_responded ( scan->samples, addr );
+      block_alive ( scan, addr );
+      scan->drain_dirty = 1;
+      if ( scan->held && addr >= scan->flushed )
+        {
+          if ( reorder_add ( scan->held, addr, hostinfo, rtt ) == 0 )
+            return;
+          scan->failed = 1;
+        }
+      else if ( scan->held )
+        scan->stats.late++;
+      else if ( scan->callback )
+        scan->callback ( from->sin_addr, hostinfo, rtt, scan->arg );
+    }
+  else
+    scan->stats.duplicates++;
+
+  free ( hostinfo->header );
+  free ( hostinfo->footer );
+  free ( hostinfo->names );
+  free ( hostinfo );
+}
+
+/* A query to addr got an ICMP port or host unreachable: there is no
+   answer to wait for */
+static void
+handle_unreachable ( struct nbt_scan *scan, struct in_addr addr )
+{
+  struct probe *probe;
+  int settled, first;
+
+  probe = probe_find ( scan->probes, ntohl ( addr.s_addr ) );
+  settled = settles ( scan, probe );
+  if ( probe )
+    probe_remove ( scan->probes, probe );
+  /* Even a host unreachable means the block is in use */
+  block_alive ( scan, ntohl ( addr.s_addr ) );
+  if ( ( first = insert ( scan->scanned, ntohl ( addr.s_addr ) ) ) < 0 )
+    scan->failed = 1;
+  else if ( first )
+    {
+      scan->stats.unreachable++;
+      if ( settled )
+        scan->unsettled--;
+      scan->drain_dirty = 1;
+    }
+}
+
+static void
+receive ( struct nbt_scan *scan )
+{
+  struct sockaddr_in from;
+  struct timeval recv_time, tx_time;
+  struct in_addr tx_addr;
+  struct probe *probe;
+  char errmsg[80];
+  int size, kind, i;
+
+  /* Transmit timestamps and ICMP errors wake us up as well, take them
+     first */
+  while ( ( kind = tstamp_read_errqueue ( scan->sock, &tx_addr, &tx_time ) ) !=
+          ERRQUEUE_EMPTY )
+    if ( kind == ERRQUEUE_UNREACHABLE )
+      handle_unreachable ( scan, tx_addr );
+    else if ( ( probe = probe_find ( scan->probes,
+                                     ntohl ( tx_addr.s_addr ) ) ) )
+      probe->sent = tx_time;
+
+  for ( i = 0; i < RECV_BATCH; i++ )
+    {
+      memset ( &from, 0, sizeof from );
+      size = tstamp_recvfrom (
+              scan->sock, scan->buff, BUFFSIZE, &from, &recv_time );
+      if ( size < 0 && ( errno == EAGAIN || errno == EWOULDBLOCK ) )
+        return;
+      /* An ICMP error that arrived meanwhile, it is read from the error
+         queue on the next step */
+      if ( size < 0 && ( errno == ECONNREFUSED || errno == EHOSTUNREACH ) )
+        continue;
+      if ( size <= 0 )
+        {
+          snprintf ( errmsg,
+                     sizeof errmsg,
+                     "%s\tRecvfrom failed",
+                     inet_ntoa ( from.sin_addr ) );
+          err_print ( errmsg, scan->options.quiet );
+          scan->stats.errors++;
+          continue;
+        }
+      scan->stats.received++;
+      if ( scan->pcap )
+        record ( scan, &from, &scan->local, scan->buff, size, &recv_time );
+      if ( is_name_query_response ( scan->buff, size ) )
+        {
+          if ( scan->options.discover &&
+               insert ( scan->responders,
+                        ntohl ( from.sin_addr.s_addr ) ) < 0 )
+            scan->failed = 1;
+          continue;
+        }
+      if ( scan->options.stateless &&
+           !cookie_matches (
+                   scan, scan->buff, size, ntohl ( from.sin_addr.s_addr ) ) )
+        {
+          scan->stats.rejected++;
+          continue;
+        }
+      handle_response ( scan, &from, size, &recv_time );
+    }
+}
+
+/* probe_timeout is how long to wait for an answer from addr: the
+   retransmit timeout of its prefix, or of the whole scan if nothing from
+   the prefix has been measured, and never more than the -t timeout. Only
+   a round that is followed by another can give up on a host that early,
+   as the host is queried again then; the last round and the probes of a
+   pruning scan wait the whole -t timeout. */
+static double
+probe_timeout ( const struct nbt_scan *scan, unsigned long addr )
+{
+  const struct rtt_estimator *est;
+  double timeout = scan->options.timeout / 1000.0;
+  double rto;
+
+  if ( scan->round >= scan->options.retransmits || scan->scouting )
+    return timeout;
+  if ( ( est = rtt_find ( scan->rtts, addr ) ) )
+    rto = est->srtt + 4 * est->rttvar;
+  else if ( scan->rtt_samples )
+    rto = scan->srtt + 4 * scan->rttvar;
+  else
+    return timeout;
+
+  if ( rto < RTO_MIN )
+    rto = RTO_MIN;
+  return rto < timeout ? rto : timeout;
+}
+
+/* check_drain works out how long to wait for the answers to the queries
+   still outstanding, which is as long as the slowest of them needs by
+   probe_timeout(). Once all have been answered or refused, that is not at
+   all; until then, the last round never ends before -t has passed since
+   each query still unanswered went out. */
+static void
+check_drain ( struct nbt_scan *scan, const struct timeval *now )
+{
+  struct probe *probe;
+  struct timeval until;
+
+  scan->drain_dirty = 0;
+  ms_to_timeval ( DRAIN_RECHECK_MS, &until );
+  timeradd ( now, &until, &scan->drain_check );
+
+  scan->deadline = *now;
+  if ( scan->options.stateless && scan->unsettled > 0 )
+    {
+      /* Nothing is known of the queries out, give the last one timeout */
+      ms_to_timeval ( scan->options.timeout, &until );
+      timeradd ( &scan->next_send, &until, &scan->deadline );
+    }
+  for ( probe = scan->probes->oldest; probe; probe = probe->next )
+    {
+      ms_to_timeval ( probe_timeout ( scan, probe->addr ) * 1000, &until );
+      timeradd ( &probe->sent, &until, &until );
+      if ( timercmp ( &until, &scan->deadline, > ) )
+        scan->deadline = until;
+    }
+}
+
+/* schedule_send sets the earliest time for the next query, now being when
+   the last one left */
+static void
+schedule_send ( struct nbt_scan *scan, const struct timeval *now )
+{
+  struct timeval interval;
+
+  interval.tv_sec = scan->backoff_us / 1000000;
+  interval.tv_usec = scan->backoff_us % 1000000;
+  timeradd ( &interval, &scan->send_interval, &interval );
+  timeradd ( now, &interval, &scan->next_send );
+}
+
+static void
+count_send_error ( struct nbt_scan *scan, int err )
+{
+  scan->stats.errors++;
+  if ( err < 0 || err >= NBT_ERRNO_SLOTS )
+    err = NBT_ERRNO_SLOTS - 1;
+  scan->stats.send_errno[err]++;
+}
+
+/* prefix_held tells if a query to addr has to wait for the per prefix
+   rate. It then waits in the queue of its prefix while the other prefixes
+   go on. */
+static int
+prefix_held ( struct nbt_scan *scan,
+              struct in_addr addr,
+              const struct timeval *now )
+{
+  int held;
+
+  if ( !scan->prefixes )
+    return 0;
+  held = prefix_hold ( scan->prefixes,
+                       fair_prefix ( scan, addr ),
+                       ntohl ( addr.s_addr ),
+                       now );
+  if ( held < 0 )
+    scan->failed = 1;
+  else if ( held )
+    scan->stats.held++;
+  return held != 0;
+}
+
+/* prefix_wait tells if nothing may go before the turn of a prefix that
+   has queries held, and holds off the next query until then. That is so
+   once as many queries are held as may be, or when there are no new
+   targets left. */
+static int
+prefix_wait ( struct nbt_scan *scan, int no_targets )
+{
+  const struct timeval *turn;
+
+  if ( !scan->prefixes || !( turn = prefix_soonest ( scan->prefixes ) ) ||
+       ( !no_targets && scan->prefixes->held < PREFIX_HOLD_MAX ) )
+    return 0;
+  scan->next_send = *turn;
+  return 1;
+}
+
+/* Send queries while the bandwidth limit allows */
+static void
+send_some ( struct nbt_scan *scan, struct timeval *now )
+{
+  struct in_addr addr;
+  struct probe *probe = NULL;
+  struct nbname_request request;
+  unsigned long held;
+  int i;
+
+  for ( i = 0; i < SEND_BATCH && !timercmp ( now, &scan->next_send, < ); i++ )
+    {
+      if ( scan->have_retry )
+        {
+          addr = scan->retry_addr;
+          scan->have_retry = 0;
+        }
+      else if ( scan->prefixes && prefix_next ( scan->prefixes, now, &held ) )
+        addr.s_addr = htonl ( held );
+      else
+        {
+          if ( prefix_wait ( scan, 0 ) )
+            return;
+          if ( !next_target ( scan, &addr ) )
+            {
+              if ( prefix_wait ( scan, 1 ) )
+                return;
+              /* No more queries to send, wait for the answers */
+              scan->phase = SCAN_DRAINING;
+              check_drain ( scan, now );
+              return;
+            }
+          /* A stateless scan doesn't look back */
+          if ( !scan->options.stateless &&
+               in_list ( scan->scanned, ntohl ( addr.s_addr ) ) )
+            continue;
+          /* Addresses the sweeps found dead count as probed */
+          if ( scan->samples && scan->round == 0 )
+            sample_probed ( scan->samples, ntohl ( addr.s_addr ) );
+          if ( !scan->current->file &&
+               ( discover_skips ( scan, ntohl ( addr.s_addr ) ) ||
+                 arp_skips ( scan, ntohl ( addr.s_addr ) ) ) )
+            continue;
+          if ( prefix_held ( scan, addr, now ) )
+            {
+              if ( scan->failed )
+                return;
+              continue;
+            }
+        }
+
+      gettimeofday ( now, NULL );
+      if ( scan->options.stateless )
+        build_request ( &request,
+                        QT_NODE_STATUS_REQUEST,
+                        cookie ( &scan->cookie_key, ntohl ( addr.s_addr ) ) );
+      else
+        {
+          /* Remember when the query left */
+          probe = probe_add ( scan->probes, ntohl ( addr.s_addr ), now );
+          if ( !probe )
+            {
+              scan->failed = 1;
+              return;
+            }
+          build_request ( &request,
+                          QT_NODE_STATUS_REQUEST,
+                          query_clock ( scan->rtt_base ) );
+        }
+      if ( send_recorded ( scan, addr, &request, now ) == 0 )
+        {
+          scan->stats.sent++;
+          scan->unsettled++;
+          if ( scan->prefixes && prefix_sent ( scan->prefixes,
+                                               fair_prefix ( scan, addr ),
+                                               now ) < 0 )
+            scan->failed = 1;
+          scan->backoff_us -= scan->backoff_us / 16;
+          if ( scan->backoff_us < BACKOFF_MIN_US )
+            scan->backoff_us = 0;
+        }
+      else if ( errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS )
+        {
+          /* The socket buffer or the device queue is full: keep the query
+             for later and slow down */
+          if ( probe )
+            probe_remove ( scan->probes, probe );
+          scan->retry_addr = addr;
+          scan->have_retry = 1;
+          scan->stats.deferred++;
+          scan->backoff_us *= 2;
+          if ( scan->backoff_us < BACKOFF_MIN_US )
+            scan->backoff_us = BACKOFF_MIN_US;
+          if ( scan->backoff_us > BACKOFF_MAX_US )
+            scan->backoff_us = BACKOFF_MAX_US;
+          schedule_send ( scan, now );
+          return;
+        }
+      else
+        count_send_error ( scan, errno );
+      schedule_send ( scan, now );
+    }
+}
+
+static void
+end_round ( struct nbt_scan *scan )
+{
+  double rto;
+
+  if ( scan->scouting )
+    {
+      /* The first probes are in, go through the blocks that showed life */
+      scan->scouting = 0;
+      scan->scouted = 1;
+      scan->unsettled = 0;
+      gettimeofday ( &scan->round_started, NULL );
+      scan->next_send = scan->round_started;
+      rewind_targets ( scan );
+      scan->phase = SCAN_SENDING;
+      return;
+    }
+
+  if ( scan->round >= scan->options.retransmits || scan->unsettled <= 0 )
+    {
+      /* If we are not going to retransmit, or every host has answered or
+         refused, we can finish right now without waiting */
+      scan->phase = SCAN_DONE;
+      return;
+    }
+
+  rto = ( scan->srtt + 4 * scan->rttvar ) * ( scan->round + 1 );
+  if ( rto < 2.0 )
+    rto = 2.0;
+  if ( rto > 60.0 )
+    rto = 60.0;
+
+  ms_to_timeval ( rto * 1000, &scan->deadline );
+  timeradd ( &scan->round_started, &scan->deadline, &scan->deadline );
+  scan->phase = SCAN_WAITING;
+}
+
+/* sorted_floor is the lowest address that may still be reported. Only a
+   walk through the ranges in order, in the last round, gets anywhere
+   before the end: the floor is then the lowest of the queries still
+   outstanding and the addresses still to be sent to. */
+static unsigned long long
+sorted_floor ( const struct nbt_scan *scan )
+{
+  const struct nbt_target *target;
+  const struct probe *probe;
+  unsigned long long floor = 1ULL << 32, start;
+
+  if ( scan->phase == SCAN_DONE )
+    return floor;
+  if ( ( scan->phase != SCAN_SENDING && scan->phase != SCAN_DRAINING ) ||
+       scan->round < scan->options.retransmits || scan->options.stateless ||
+       scan->options.fair || scan->sample || scan->scouting )
+    return 0;
+
+  if ( scan->have_retry )
+    floor = ntohl ( scan->retry_addr.s_addr );
+  if ( scan->prefixes && prefix_lowest ( scan->prefixes ) < floor )
+    floor = prefix_lowest ( scan->prefixes );
+  for ( target = scan->current; target; target = target->next )
+    {
+      if ( target->file )
+        return 0;
+      start = target->range.start_ip;
+      if ( target == scan->current && scan->started )
+        start = ( unsigned long long ) ntohl ( scan->prev.s_addr ) + 1;
+      if ( start < floor )
+        floor = start;
+    }
+  for ( probe = scan->probes->oldest; probe; probe = probe->next )
+    if ( probe->addr < floor )
+      floor = probe->addr;
+  return floor;
+}
+
+/* Hand on the held results no lower address can come before any more */
+static void
+flush_sorted ( struct nbt_scan *scan, const struct timeval *now )
+{
+  struct timeval interval;
+  unsigned long long floor;
+
+  if ( scan->phase != SCAN_DONE &&
+       ( !scan->held->count || timercmp ( now, &scan->flush_check, < ) ) )
+    return;
+  ms_to_timeval ( SORTED_FLUSH_MS, &interval );
+  timeradd ( now, &interval, &scan->flush_check );
+
+  floor = sorted_floor ( scan );
+  if ( floor > scan->flushed )
+    scan->flushed = floor;
+  reorder_flush ( scan->held, scan->flushed, scan->callback, scan->arg );
+}
+
+int
+nbt_scan_restart ( struct nbt_scan *scan )
+{
+  struct list *scanned, *alive, *live_blocks;
+
+  scanned = new_list ();
+  alive = new_list ();
+  live_blocks = new_list ();
+  if ( !scanned || !alive || !live_blocks )
+    {
+      delete_list ( scanned );
+      delete_list ( alive );
+      delete_list ( live_blocks );
+      errno = ENOMEM;
+      return -1;
+    }
+
+  /* What the scan found so far goes out first */
+  if ( scan->held )
+    {
+      reorder_flush ( scan->held, 1ULL << 32, scan->callback, scan->arg );
+      scan->flushed = 0;
+    }
+  delete_list ( scan->scanned );
+  scan->scanned = scanned;
+  delete_list ( scan->alive );
+  scan->alive = alive;
+  delete_list ( scan->live_blocks );
+  scan->live_blocks = live_blocks;
+  scan->scouting = scan->options.prune > 0 && !scan->samples;
+  scan->scouted = 0;
+  scan->round = 0;
+  scan->unsettled = 0;
+  scan->have_retry = 0;
+  if ( scan->prefixes )
+    prefix_clear ( scan->prefixes );
+  gettimeofday ( &scan->round_started, NULL );
+  rewind_targets ( scan );
+  timerclear ( &scan->deadline );
+  scan->next_send = scan->round_started;
+  scan->phase = first_phase ( scan );
+  scan->failed = 0;
+  return 0;
+}
+
+int
+nbt_scan_step ( struct nbt_scan *scan )
+{
+  struct timeval now, expire_time;
+
+  if ( scan->failed )
+    {
+      errno = ENOMEM;
+      return -1;
+    }
+  if ( scan->phase == SCAN_DONE )
+    return 0;
+  if ( !scan->sample_ready )
+    setup_sample ( scan );
+
+  receive ( scan );
+  if ( scan->arp && arp_receive ( scan->arp, scan->alive ) < 0 )
+    scan->failed = 1;
+
+  gettimeofday ( &now, NULL );
+
+  /* Stop tracking queries older than the response timeout */
+  ms_to_timeval ( scan->options.timeout, &expire_time );
+  timersub ( &now, &expire_time, &expire_time );
+  probe_expire ( scan->probes, &expire_time );
+  if ( scan->prefixes )
+    prefix_expire ( scan->prefixes, &now );
+
+  if ( scan->phase == SCAN_ARPING )
+    {
+      if ( !timerisset ( &scan->deadline ) )
+        arp_send_some ( scan, &now );
+      if ( timerisset ( &scan->deadline ) &&
+           !timercmp ( &now, &scan->deadline, < ) )
+        {
+          timerclear ( &scan->deadline );
+          scan->next_send = now;
+          scan->phase =
+                  scan->options.discover ? SCAN_DISCOVERING : SCAN_SENDING;
+        }
+    }
+
+  if ( scan->phase == SCAN_DISCOVERING )
+    {
+      if ( !timerisset ( &scan->deadline ) )
+        discover_start ( scan, &now );
+      if ( !timercmp ( &now, &scan->deadline, < ) )
+        {
+          scan->round_started = now;
+          scan->next_send = now;
+          scan->phase = SCAN_SENDING;
+        }
+    }
+
+  if ( scan->phase == SCAN_SENDING )
+    send_some ( scan, &now );
+
+  if ( scan->phase == SCAN_DRAINING && scan->drain_dirty &&
+       !timercmp ( &now, &scan->drain_check, < ) )
+    check_drain ( scan, &now );
+
+  if ( scan->phase == SCAN_DRAINING && !timercmp ( &now, &scan->deadline, < ) )
+    end_round ( scan );
+
+  if ( scan->phase == SCAN_WAITING && !timercmp ( &now, &scan->deadline, < ) )
+    {
+      scan->round++;
+      scan->unsettled = 0;
+      scan->round_started = now;
+      rewind_targets ( scan );
+      scan->phase = SCAN_SENDING;
+    }
+
+  if ( scan->held )
+    flush_sorted ( scan, &now );
+
+  if ( scan->failed )
+    {
+      errno = ENOMEM;
+      return -1;
+    }
+  return scan->phase != SCAN_DONE;
+}
+
+void
+nbt_scan_timeout ( const struct nbt_scan *scan, struct timeval *tv )
+{
+  struct timeval now;
+  const struct timeval *until;
+
+  timerclear ( tv );
+  switch ( scan->phase )
+    {
+      case SCAN_SENDING:
+        until = &scan->next_send;
+        break;
+      case SCAN_ARPING:
+        until = timerisset ( &scan->deadline ) ? &scan->deadline
+                                                : &scan->next_send;
+        break;
+      case SCAN_DRAINING:
+        until = &scan->deadline;
+        if ( scan->drain_dirty &&
+             timercmp ( &scan->drain_check, &scan->deadline, < ) )
+          until = &scan->drain_check;
+        break;
+      case SCAN_DISCOVERING:
+      case SCAN_WAITING:
+        until = &scan->deadline;
+        break;
+      default:
+        return;
+    }
+
+  gettimeofday ( &now, NULL );
+  if ( timercmp ( &now, until, < ) )
+    timersub ( until, &now, tv );
+
+  if ( scan->phase == SCAN_ARPING &&
+       tv->tv_sec * 1000 + tv->tv_usec / 1000 >= ARP_POLL_MS )
+    ms_to_timeval ( ARP_POLL_MS, tv );
+  /* Held results go out as the queries below them time out */
+  if ( scan->held && scan->held->count &&
+       tv->tv_sec * 1000 + tv->tv_usec / 1000 >= SORTED_FLUSH_MS )
+    ms_to_timeval ( SORTED_FLUSH_MS, tv );
+}
+
+int
+nbt_scan_run ( struct nbt_scan *scan )
+{
+  struct timeval tv;
+  fd_set fdsr;
+  int running;
+
+  while ( ( running = nbt_scan_step ( scan ) ) > 0 )
+    {
+      nbt_scan_timeout ( scan, &tv );
+      if ( !timerisset ( &tv ) )
+        continue;
+      FD_ZERO ( &fdsr );
+      FD_SET ( scan->sock, &fdsr );
+      if ( select ( scan->sock + 1, &fdsr, NULL, NULL, &tv ) < 0 &&
+           errno != EINTR )
+        {
+          err_print ( "Select failed", scan->options.quiet );
+          scan->stats.errors++;
+          return -1;
+        }
+    }
+  return running;
+}
@@ -33,12 +33,10 @@
 #include <stdio.h>
 #include <stddef.h>
 #include <ctype.h>
-#include "errors.h"
-
-extern int quiet;
+#include <errno.h>
 
 /* Start of code from Samba */
-static int
+int
 name_mangle ( char *In, char *Out, char name_type )
 {
   int i;
@@ -98,47 +96,58 @@ name_mangle ( char *In, char *Out, char name_type )
 /* end of code from Samba */
 
 void
-send_query ( int sock, struct in_addr dest_addr, my_uint32_t rtt_base )
+build_request ( struct nbname_request *request,
+                my_uint16_t question_type,
+                my_uint16_t transaction_id )
+{
+  request->transaction_id = htons ( transaction_id );
+  request->flags = htons ( FL_BROADCAST );
+  request->question_count = htons ( 1 );
+  request->answer_count = 0;
+  request->name_service_count = 0;
+  request->additional_record_count = 0;
+  name_mangle ( "*", request->question_name, 0 );
+  request->question_type = htons ( question_type );
+  request->question_class = htons ( 0x01 );
+}
+
+int
+send_request ( int sock,
+               struct in_addr dest_addr,
+               const struct nbname_request *request )
 {
-  struct nbname_request request;
   int status;
-  struct timeval tv;
-  char errmsg[80];
 
   struct sockaddr_in dest_sockaddr = { .sin_family = AF_INET,
                                        .sin_port = htons ( NB_DGRAM ),
                                        .sin_addr = dest_addr };
 
-  request.flags = htons ( FL_BROADCAST );
-  request.question_count = htons ( 1 );
-  request.answer_count = 0;
-  request.name_service_count = 0;
-  request.additional_record_count = 0;
-  name_mangle ( "*", request.question_name, 0 );
-  request.question_type = htons ( 0x21 );
-  request.question_class = htons ( 0x01 );
-
-  gettimeofday ( &tv, NULL );
-  /* Use transaction ID as a timestamp */
-  request.transaction_id =
-          htons ( ( tv.tv_sec - rtt_base ) * 1000 + tv.tv_usec / 1000 );
-  // printf("%s: timestamp: %d\n", inet_ntoa(dest_addr),
-  // request.transaction_id);
-
   status = sendto ( sock,
-                    ( char * ) &request,
-                    sizeof ( request ),
+                    ( const char * ) request,
+                    sizeof ( struct nbname_request ),
                     0,
                     ( struct sockaddr * ) &dest_sockaddr,
                     sizeof ( dest_sockaddr ) );
-  if ( status == -1 )
-    {
-      snprintf ( errmsg,
-                 sizeof errmsg,
-                 "%s\tSendto failed",
-                 inet_ntoa ( dest_addr ) );
-      err_print ( errmsg, quiet );
-    }
+  /* With IP_RECVERR on, an ICMP error for an earlier query fails this send
+     instead. The error is on the error queue already, just send again. */
+  if ( status == -1 && ( errno == ECONNREFUSED || errno == EHOSTUNREACH ) )
+    status = sendto ( sock,
+                      ( const char * ) request,
+                      sizeof ( struct nbname_request ),
+                      0,
+                      ( struct sockaddr * ) &dest_sockaddr,
+                      sizeof ( dest_sockaddr ) );
+  return status == -1 ? -1 : 0;
+}
+
+/* Use transaction ID as a timestamp */
+my_uint16_t
+query_clock ( my_uint32_t rtt_base )
+{
+  struct timeval tv;
+
+  gettimeofday ( &tv, NULL );
+  return ( tv.tv_sec - rtt_base ) * 1000 + tv.tv_usec / 1000;
 }
 
 static my_uint32_t
@@ -169,6 +178,12 @@ get16 ( void *data )
 
 struct nb_host_info *
 parse_response ( char *buff, unsigned int buffsize )
+{
+  return parse_response_parts ( buff, buffsize, NB_PARSE_ALL );
+}
+
+struct nb_host_info *
+parse_response_parts ( char *buff, unsigned int buffsize, int parts )
 {
   struct nb_host_info *hostinfo;
   nbname_response_footer_t *response_footer;
@@ -191,6 +206,7 @@ parse_response ( char *buff, unsigned int buffsize )
   hostinfo->header = NULL;
   hostinfo->names = NULL;
   hostinfo->footer = NULL;
+  hostinfo->is_broken = 0;
 
   /* Parsing received packet */
   /* Start with header */
@@ -201,6 +217,17 @@ parse_response ( char *buff, unsigned int buffsize )
   offset += sizeof ( response_header->transaction_id );
   hostinfo->header = response_header;
 
+  if ( !( parts & NB_PARSE_HEADER ) )
+    {
+      /* Only the number of names is wanted of the rest */
+      offset = NBNAME_RESPONSE_HEADER_SIZE - 1;
+      if ( offset + sizeof ( response_header->number_of_names ) >= buffsize )
+        goto broken_packet;
+      response_header->number_of_names = buff[offset];
+      offset += sizeof ( response_header->number_of_names );
+      goto name_table;
+    }
+
   // Check if there is room for next field in buffer
   if ( offset + sizeof ( response_header->flags ) >= buffsize )
     goto broken_packet;
@@ -263,25 +290,35 @@ parse_response ( char *buff, unsigned int buffsize )
 
   /* Done with packet header - it is okay */
 
+name_table:
   name_table_size =
           ( response_header->number_of_names ) * ( sizeof ( struct nbname ) );
   if ( offset + name_table_size >= buffsize )
     goto broken_packet;
 
-  if ( ( hostinfo->names = malloc ( name_table_size ) ) == NULL )
+  if ( parts & NB_PARSE_NAMES )
     {
-      free ( response_header );
-      free ( response_footer );
-      free ( hostinfo );
-      return NULL;
-    }
+      if ( ( hostinfo->names = malloc ( name_table_size ) ) == NULL )
+        {
+          free ( response_header );
+          free ( response_footer );
+          free ( hostinfo );
+          return NULL;
+        }
 
-  memcpy ( hostinfo->names, buff + offset, name_table_size );
+      memcpy ( hostinfo->names, buff + offset, name_table_size );
+    }
 
   offset += name_table_size;
 
   /* Done with name table - it is okay */
 
+  if ( !( parts & ( NB_PARSE_MAC | NB_PARSE_FOOTER ) ) )
+    {
+      free ( response_footer );
+      return hostinfo;
+    }
+
   /* Now parse response footer */
 
   if ( offset + sizeof ( response_footer->adapter_address ) >= buffsize )
@@ -295,6 +332,9 @@ parse_response ( char *buff, unsigned int buffsize )
 
   hostinfo->footer = response_footer;
 
+  if ( !( parts & NB_PARSE_FOOTER ) )
+    return hostinfo;
+
   if ( offset + sizeof ( response_footer->version_major ) >= buffsize )
     goto broken_packet;
   response_footer->version_major =
@@ -408,6 +448,10 @@ parse_response ( char *buff, unsigned int buffsize )
 
 broken_packet:
   hostinfo->is_broken = offset;
+  if ( !hostinfo->header )
+    free ( response_header );
+  if ( !hostinfo->footer )
+    free ( response_footer );
 
   return hostinfo;
 }
@@ -453,12 +497,7 @@ char *
 getnbservicename ( my_uint8_t service, int unique, char *name )
 {
   unsigned int i;
-  char *unknown;
-
-  unknown = malloc ( 100 );
-
-  if ( !unknown )
-    err_die ( "Malloc failed.\n", 0 );
+  static char unknown[100];
 
   for ( i = 0; i < sizeof services / sizeof services[0]; i++ )
     {
@@ -468,6 +507,6 @@ getnbservicename ( my_uint8_t service, int unique, char *name )
         return services[i].service_name;
     }
 
-  snprintf ( unknown, 100, "Unknown service (code %x)", service );
+  snprintf ( unknown, sizeof unknown, "Unknown service (code %x)", service );
   return ( unknown );
 }
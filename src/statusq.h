@@ -5,6 +5,16 @@
 #include <stdint.h>
 #endif
 #include <sys/types.h>
+#include <netinet/in.h>
+
+/* configure defines these; programs using the installed headers get them
+   from stdint.h */
+#if !defined my_uint8_t
+#include <stdint.h>
+#define my_uint8_t uint8_t
+#define my_uint16_t uint16_t
+#define my_uint32_t uint32_t
+#endif
 
 #define FL_REQUEST 0x8000
 #define FL_QUERY 0x7800
@@ -17,6 +27,7 @@
 #define FL_BROADCAST 0x0010
 #define FL_SUCCESS 0x000F
 
+#define QT_NAME_QUERY 0x0020
 #define QT_NODE_STATUS_REQUEST 0x0021
 #define QC_INTERNET 0x0001
 
@@ -112,10 +123,44 @@ typedef struct nb_service
 char *
 getnbservicename ( my_uint8_t service, int unique, char *name );
 
+/* name_mangle encodes In as a first level NetBIOS name (RFC 1001/1002),
+   with name_type as the 16th character, into Out. Returns its length. */
+int
+name_mangle ( char *In, char *Out, char name_type );
+
 struct nb_host_info *
 parse_response ( char *buff, unsigned int buffsize );
 
+/* Parts of a node status response parse_response_parts() fills in. The
+   transaction ID and the number of names are always there. */
+#define NB_PARSE_HEADER 0x01 /* the other header fields */
+#define NB_PARSE_NAMES 0x02  /* the name table */
+#define NB_PARSE_MAC 0x04    /* the adapter address of the footer */
+#define NB_PARSE_FOOTER 0x08 /* the whole footer, adapter address included */
+#define NB_PARSE_ALL 0x0f
+
+/* parse_response_parts is parse_response() that skips the parts of the
+   packet not in parts, leaving their pointers NULL or fields zero. The
+   rest is checked just the same. */
+struct nb_host_info *
+parse_response_parts ( char *buff, unsigned int buffsize, int parts );
+
+/* build_request fills request with a query of question_type for "*" */
 void
-send_query ( int sock, struct in_addr dest_addr, my_uint32_t rtt_base );
+build_request ( struct nbname_request *request,
+                my_uint16_t question_type,
+                my_uint16_t transaction_id );
+
+/* send_request sends request to port 137 of dest_addr. Returns 0 on
+   success and -1 with errno set if sendto failed. */
+int
+send_request ( int sock,
+               struct in_addr dest_addr,
+               const struct nbname_request *request );
+
+/* query_clock is a transaction ID that tells when a query went: the
+   milliseconds since rtt_base, wrapping around */
+my_uint16_t
+query_clock ( my_uint32_t rtt_base );
 
 #endif /* STATUSQ_H */
@@ -41,3 +41,22 @@
     }                                                         \
   while ( 0 )
 #endif
+
+#ifndef timeradd
+#define timeradd( tvp, uvp, vvp )                             \
+  do                                                          \
+    {                                                         \
+      ( vvp )->tv_sec = ( tvp )->tv_sec + ( uvp )->tv_sec;    \
+      ( vvp )->tv_usec = ( tvp )->tv_usec + ( uvp )->tv_usec; \
+      if ( ( vvp )->tv_usec >= 1000000 )                      \
+        {                                                     \
+          ( vvp )->tv_sec++;                                  \
+          ( vvp )->tv_usec -= 1000000;                        \
+        }                                                     \
+    }                                                         \
+  while ( 0 )
+#endif
+
+#ifndef timerisset
+#define timerisset( tvp ) ( ( tvp )->tv_sec || ( tvp )->tv_usec )
+#endif
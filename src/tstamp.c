@@ -0,0 +1,230 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/time.h>
+#include <string.h>
+#include <errno.h>
+#if defined HAVE_LINUX_NET_TSTAMP_H
+#include <linux/net_tstamp.h>
+#endif
+#if defined HAVE_LINUX_ERRQUEUE_H && defined IP_RECVERR
+#include <linux/errqueue.h>
+#define HAVE_RECVERR 1
+#endif
+#if ( defined HAVE_LINUX_NET_TSTAMP_H && defined SO_TIMESTAMPING ) || \
+        HAVE_RECVERR
+#define HAVE_ERRQUEUE 1
+#endif
+#include "statusq.h"
+#include "tstamp.h"
+
+#define CONTROL_SIZE 256
+#define LOOPED_SIZE 256 /* room for a looped back query with headers */
+
+int
+tstamp_enable ( int sock )
+{
+  int mask = 0;
+  int on = 1;
+#if defined HAVE_LINUX_NET_TSTAMP_H && defined SO_TIMESTAMPING
+  int flags;
+#endif
+
+#if defined SO_TIMESTAMPNS
+  if ( setsockopt ( sock, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof on ) == 0 )
+    mask |= TSTAMP_RX;
+#else
+  ( void ) on;
+#endif
+
+#if defined HAVE_LINUX_NET_TSTAMP_H && defined SO_TIMESTAMPING
+  /* Software timestamps only: we want the time the query left the stack,
+     not the hardware clock of whatever NIC happens to be in use. */
+  flags = SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+  if ( setsockopt ( sock, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof flags ) ==
+       0 )
+    mask |= TSTAMP_TX;
+#endif
+
+  return mask;
+}
+
+int
+tstamp_enable_errors ( int sock )
+{
+#if HAVE_RECVERR
+  int on = 1;
+
+  return setsockopt ( sock, IPPROTO_IP, IP_RECVERR, &on, sizeof on );
+#else
+  ( void ) sock;
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+int
+tstamp_recvfrom ( int sock,
+                  void *buff,
+                  size_t len,
+                  struct sockaddr_in *from,
+                  struct timeval *ts )
+{
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  char control[CONTROL_SIZE];
+  int size;
+
+  iov.iov_base = buff;
+  iov.iov_len = len;
+
+  memset ( &msg, 0, sizeof msg );
+  msg.msg_name = from;
+  msg.msg_namelen = sizeof ( struct sockaddr_in );
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof control;
+
+  if ( ( size = recvmsg ( sock, &msg, MSG_DONTWAIT ) ) < 0 )
+    return size;
+
+  for ( cmsg = CMSG_FIRSTHDR ( &msg ); cmsg; cmsg = CMSG_NXTHDR ( &msg, cmsg ) )
+    {
+#if defined SO_TIMESTAMPNS
+      if ( cmsg->cmsg_level == SOL_SOCKET &&
+           cmsg->cmsg_type == SCM_TIMESTAMPNS )
+        {
+          struct timespec kernel_ts;
+
+          memcpy ( &kernel_ts, CMSG_DATA ( cmsg ), sizeof kernel_ts );
+          ts->tv_sec = kernel_ts.tv_sec;
+          ts->tv_usec = kernel_ts.tv_nsec / 1000;
+          return size;
+        }
+#endif
+    }
+
+  gettimeofday ( ts, NULL );
+  return size;
+}
+
+#if HAVE_RECVERR
+/* is_unreachable tells if an error queue entry is an ICMP port or host
+   unreachable for one of our queries */
+static int
+is_unreachable ( struct msghdr *msg )
+{
+  struct cmsghdr *cmsg;
+  struct sock_extended_err ee;
+
+  for ( cmsg = CMSG_FIRSTHDR ( msg ); cmsg; cmsg = CMSG_NXTHDR ( msg, cmsg ) )
+    if ( cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_RECVERR )
+      {
+        memcpy ( &ee, CMSG_DATA ( cmsg ), sizeof ee );
+        return ( ee.ee_origin == SO_EE_ORIGIN_ICMP ||
+                 ee.ee_origin == SO_EE_ORIGIN_LOCAL ) &&
+               ( ee.ee_errno == ECONNREFUSED || ee.ee_errno == EHOSTUNREACH );
+      }
+  return 0;
+}
+#endif
+
+int
+tstamp_read_errqueue ( int sock, struct in_addr *to, struct timeval *ts )
+{
+#if HAVE_ERRQUEUE
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  struct sockaddr_in dest;
+  char control[CONTROL_SIZE];
+  unsigned char packet[LOOPED_SIZE];
+  int size;
+#if defined HAVE_LINUX_NET_TSTAMP_H && defined SO_TIMESTAMPING
+  struct timespec kernel_ts[3];
+  int dest_offset;
+#endif
+
+  for ( ;; )
+    {
+      iov.iov_base = packet;
+      iov.iov_len = sizeof packet;
+
+      memset ( &msg, 0, sizeof msg );
+      msg.msg_name = &dest;
+      msg.msg_namelen = sizeof dest;
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof control;
+
+      if ( ( size = recvmsg ( sock, &msg, MSG_ERRQUEUE | MSG_DONTWAIT ) ) <
+           0 )
+        return ERRQUEUE_EMPTY;
+
+#if HAVE_RECVERR
+      /* msg_name holds the address the failed query was sent to */
+      if ( is_unreachable ( &msg ) )
+        {
+          *to = dest.sin_addr;
+          return ERRQUEUE_UNREACHABLE;
+        }
+#endif
+      if ( msg.msg_flags & MSG_TRUNC )
+        continue;
+
+#if defined HAVE_LINUX_NET_TSTAMP_H && defined SO_TIMESTAMPING
+      for ( cmsg = CMSG_FIRSTHDR ( &msg ); cmsg;
+            cmsg = CMSG_NXTHDR ( &msg, cmsg ) )
+        {
+          if ( cmsg->cmsg_level != SOL_SOCKET ||
+               cmsg->cmsg_type != SCM_TIMESTAMPING )
+            continue;
+
+          /* The looped back packet starts with whatever link layer header
+             the device uses, so find the destination address counting
+             back from the end of our fixed size query. */
+          dest_offset = size - NBNAME_REQUEST_SIZE - UDP_HEADER_SIZE -
+                        ( int ) sizeof ( struct in_addr );
+          if ( dest_offset < 0 )
+            break;
+
+          memcpy ( kernel_ts, CMSG_DATA ( cmsg ), sizeof kernel_ts );
+          memcpy ( to, packet + dest_offset, sizeof ( struct in_addr ) );
+          ts->tv_sec = kernel_ts[0].tv_sec;
+          ts->tv_usec = kernel_ts[0].tv_nsec / 1000;
+          return ERRQUEUE_TX;
+        }
+#else
+      ( void ) cmsg;
+      ( void ) size;
+      ( void ) ts;
+#endif
+    }
+#else
+  ( void ) sock;
+  ( void ) to;
+  ( void ) ts;
+  return ERRQUEUE_EMPTY;
+#endif
+}
@@ -0,0 +1,61 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#if !defined TSTAMP_H
+#define TSTAMP_H
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+
+#define TSTAMP_RX 1 /* kernel receive timestamps (SO_TIMESTAMPNS) */
+#define TSTAMP_TX 2 /* software transmit timestamps (SO_TIMESTAMPING) */
+
+/* tstamp_enable asks the kernel to timestamp datagrams sent and received
+   on sock. Returns a mask of TSTAMP_RX and TSTAMP_TX telling which kinds
+   of timestamps the system agreed to provide. */
+int
+tstamp_enable ( int sock );
+
+/* tstamp_recvfrom works like a non-blocking recvfrom(), additionally
+   storing the time the datagram arrived in *ts. The kernel timestamp is
+   used when there is one, the current time otherwise. */
+int
+tstamp_recvfrom ( int sock,
+                  void *buff,
+                  size_t len,
+                  struct sockaddr_in *from,
+                  struct timeval *ts );
+
+/* tstamp_enable_errors asks the kernel to queue ICMP errors for datagrams
+   sent on sock (IP_RECVERR). While it is on, such an error also makes the
+   next send or receive on sock fail once. Returns 0 on success. */
+int
+tstamp_enable_errors ( int sock );
+
+/* What tstamp_read_errqueue found */
+#define ERRQUEUE_EMPTY 0
+#define ERRQUEUE_TX 1          /* a transmit timestamp */
+#define ERRQUEUE_UNREACHABLE 2 /* ICMP port or host unreachable */
+
+/* tstamp_read_errqueue takes one entry from the socket error queue. For a
+   transmit timestamp it stores the destination of the query in *to and
+   the time the kernel handed it to the device in *ts; for an unreachable
+   error it stores the address the query went to in *to. */
+int
+tstamp_read_errqueue ( int sock, struct in_addr *to, struct timeval *ts );
+
+#endif /* TSTAMP_H */
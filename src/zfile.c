@@ -0,0 +1,432 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#if HAVE_FOPENCOOKIE
+#define _GNU_SOURCE /* for fopencookie() */
+#endif
+#include <sys/types.h>
+#include <sys/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "zfile.h"
+
+#if HAVE_FOPENCOOKIE && HAVE_LIBPTHREAD
+#include <pthread.h>
+#define ZFILE_THREAD 1
+#if HAVE_ZLIB_H && HAVE_LIBZ
+#include <zlib.h>
+#define ZFILE_GZIP 1
+#endif
+#if HAVE_ZSTD_H && HAVE_LIBZSTD
+#include <zstd.h>
+#define ZFILE_ZSTD 1
+#define ZFILE_ZSTD_LEVEL 3
+#endif
+#endif
+
+enum zfile_format
+{
+  ZFILE_PLAIN,
+  ZFILE_GZ,
+  ZFILE_ZST
+};
+
+static int
+has_suffix ( const char *path, const char *suffix )
+{
+  size_t length = strlen ( path ), suffix_length = strlen ( suffix );
+
+  return length > suffix_length &&
+         strcmp ( path + length - suffix_length, suffix ) == 0;
+}
+
+#if ZFILE_THREAD
+
+struct chunk
+{
+  struct chunk *next;
+  size_t size;
+  char data[ZFILE_CHUNK];
+};
+
+struct zfile
+{
+  int fd;
+  enum zfile_format format;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t ready;   /* a chunk to compress, or the stream closed */
+  pthread_cond_t room;    /* the queue is no longer full */
+  struct chunk *current;  /* being filled by the writer */
+  struct timeval started; /* when current got its first byte */
+  struct chunk *first;    /* full chunks, oldest first */
+  struct chunk *last;
+  int queued;
+  int closing;
+  int error;              /* errno of the first failure, 0 if none */
+  unsigned long frames;   /* written so far */
+  unsigned char *out;     /* compressed frame */
+  size_t out_size;
+#if ZFILE_GZIP
+  z_stream z;
+#endif
+#if ZFILE_ZSTD
+  ZSTD_CCtx *zstd;
+#endif
+};
+
+static int
+write_all ( int fd, const unsigned char *data, size_t size )
+{
+  ssize_t done;
+
+  while ( size )
+    {
+      if ( ( done = write ( fd, data, size ) ) < 0 )
+        {
+          if ( errno == EINTR )
+            continue;
+          return errno;
+        }
+      data += done;
+      size -= done;
+    }
+  return 0;
+}
+
+/* write_frame compresses the size bytes at data into one frame and writes
+   it. Returns 0 or an errno value. */
+static int
+write_frame ( struct zfile *zfile, const char *data, size_t size )
+{
+  const unsigned char *frame = ( const unsigned char * ) data;
+
+  switch ( zfile->format )
+    {
+#if ZFILE_GZIP
+      case ZFILE_GZ:
+        zfile->z.next_in = ( Bytef * ) data;
+        zfile->z.avail_in = size;
+        zfile->z.next_out = zfile->out;
+        zfile->z.avail_out = zfile->out_size;
+        if ( deflate ( &zfile->z, Z_FINISH ) != Z_STREAM_END )
+          return EIO;
+        size = zfile->out_size - zfile->z.avail_out;
+        deflateReset ( &zfile->z ); /* the next member gets a header */
+        frame = zfile->out;
+        break;
+#endif
+#if ZFILE_ZSTD
+      case ZFILE_ZST:
+        size = ZSTD_compressCCtx ( zfile->zstd,
+                                   zfile->out,
+                                   zfile->out_size,
+                                   data,
+                                   size,
+                                   ZFILE_ZSTD_LEVEL );
+        if ( ZSTD_isError ( size ) )
+          return EIO;
+        frame = zfile->out;
+        break;
+#endif
+      default:
+        break;
+    }
+  zfile->frames++;
+  return write_all ( zfile->fd, frame, size );
+}
+
+/* Whether the chunk being filled has waited long enough, and if not, the
+   time it may wait until in *deadline */
+static int
+partial_due ( const struct zfile *zfile, struct timespec *deadline )
+{
+  struct timeval now, due;
+
+  due.tv_sec = ZFILE_FLUSH_MS / 1000;
+  due.tv_usec = ( ZFILE_FLUSH_MS % 1000 ) * 1000;
+  timeradd ( &zfile->started, &due, &due );
+  gettimeofday ( &now, NULL );
+  deadline->tv_sec = due.tv_sec;
+  deadline->tv_nsec = due.tv_usec * 1000;
+  return !timercmp ( &now, &due, < );
+}
+
+static void *
+compress_thread ( void *arg )
+{
+  struct zfile *zfile = arg;
+  struct timespec deadline;
+  struct chunk *chunk;
+  int error;
+
+  pthread_mutex_lock ( &zfile->lock );
+  for ( ;; )
+    {
+      /* A partial chunk goes out after a while, and the last one when the
+         stream is closed */
+      if ( !zfile->first && zfile->current &&
+           ( zfile->closing || partial_due ( zfile, &deadline ) ) )
+        {
+          zfile->first = zfile->last = zfile->current;
+          zfile->current = NULL;
+          zfile->queued++;
+        }
+      if ( ( chunk = zfile->first ) )
+        {
+          if ( !( zfile->first = chunk->next ) )
+            zfile->last = NULL;
+          zfile->queued--;
+          pthread_cond_signal ( &zfile->room );
+          pthread_mutex_unlock ( &zfile->lock );
+
+          error = write_frame ( zfile, chunk->data, chunk->size );
+          free ( chunk );
+
+          pthread_mutex_lock ( &zfile->lock );
+          if ( error && !zfile->error )
+            zfile->error = error;
+          continue;
+        }
+      if ( zfile->closing )
+        break;
+      if ( zfile->current )
+        pthread_cond_timedwait ( &zfile->ready, &zfile->lock, &deadline );
+      else
+        pthread_cond_wait ( &zfile->ready, &zfile->lock );
+    }
+  pthread_mutex_unlock ( &zfile->lock );
+
+  /* An empty stream still makes a file that decompresses */
+  if ( !zfile->frames && zfile->format != ZFILE_PLAIN &&
+       ( error = write_frame ( zfile, "", 0 ) ) && !zfile->error )
+    zfile->error = error;
+  return NULL;
+}
+
+static ssize_t
+zfile_write ( void *cookie, const char *buf, size_t size )
+{
+  struct zfile *zfile = cookie;
+  size_t done = 0, length;
+
+  pthread_mutex_lock ( &zfile->lock );
+  while ( done < size && !zfile->error )
+    {
+      if ( !zfile->current )
+        {
+          if ( ( zfile->current = malloc ( sizeof ( struct chunk ) ) ) ==
+               NULL )
+            {
+              zfile->error = ENOMEM;
+              break;
+            }
+          zfile->current->next = NULL;
+          zfile->current->size = 0;
+          gettimeofday ( &zfile->started, NULL );
+          pthread_cond_signal ( &zfile->ready ); /* to start the clock */
+        }
+      length = ZFILE_CHUNK - zfile->current->size;
+      if ( length > size - done )
+        length = size - done;
+      memcpy ( zfile->current->data + zfile->current->size,
+               buf + done,
+               length );
+      zfile->current->size += length;
+      done += length;
+      if ( zfile->current->size < ZFILE_CHUNK )
+        continue;
+
+      /* Full: hand it to the thread, waiting if it is far behind */
+      while ( zfile->queued >= ZFILE_QUEUE && !zfile->error )
+        pthread_cond_wait ( &zfile->room, &zfile->lock );
+      if ( zfile->last )
+        zfile->last->next = zfile->current;
+      else
+        zfile->first = zfile->current;
+      zfile->last = zfile->current;
+      zfile->current = NULL;
+      zfile->queued++;
+      pthread_cond_signal ( &zfile->ready );
+    }
+  if ( zfile->error )
+    {
+      errno = zfile->error;
+      done = 0;
+    }
+  pthread_mutex_unlock ( &zfile->lock );
+  return done;
+}
+
+static void
+free_zfile ( struct zfile *zfile )
+{
+#if ZFILE_GZIP
+  if ( zfile->format == ZFILE_GZ )
+    deflateEnd ( &zfile->z );
+#endif
+#if ZFILE_ZSTD
+  if ( zfile->format == ZFILE_ZST )
+    ZSTD_freeCCtx ( zfile->zstd );
+#endif
+  pthread_mutex_destroy ( &zfile->lock );
+  pthread_cond_destroy ( &zfile->ready );
+  pthread_cond_destroy ( &zfile->room );
+  free ( zfile->out );
+  free ( zfile );
+}
+
+static int
+zfile_close ( void *cookie )
+{
+  struct zfile *zfile = cookie;
+  int error;
+
+  pthread_mutex_lock ( &zfile->lock );
+  zfile->closing = 1;
+  pthread_cond_signal ( &zfile->ready );
+  pthread_mutex_unlock ( &zfile->lock );
+  pthread_join ( zfile->thread, NULL );
+
+  error = zfile->error;
+  if ( close ( zfile->fd ) < 0 && !error )
+    error = errno;
+  free_zfile ( zfile );
+  if ( error )
+    {
+      errno = error;
+      return -1;
+    }
+  return 0;
+}
+
+/* new_zfile sets up the compressor for format. Returns NULL with errno
+   set on failure. */
+static struct zfile *
+new_zfile ( enum zfile_format format )
+{
+  struct zfile *zfile;
+
+  if ( ( zfile = calloc ( 1, sizeof ( struct zfile ) ) ) == NULL )
+    return NULL;
+  zfile->format = format;
+  pthread_mutex_init ( &zfile->lock, NULL );
+  pthread_cond_init ( &zfile->ready, NULL );
+  pthread_cond_init ( &zfile->room, NULL );
+  switch ( format )
+    {
+#if ZFILE_GZIP
+      case ZFILE_GZ:
+        /* 15 bits of window, plus 16 for a gzip wrapper */
+        if ( deflateInit2 ( &zfile->z,
+                            Z_DEFAULT_COMPRESSION,
+                            Z_DEFLATED,
+                            15 + 16,
+                            8,
+                            Z_DEFAULT_STRATEGY ) != Z_OK )
+          {
+            zfile->format = ZFILE_PLAIN;
+            free_zfile ( zfile );
+            errno = ENOMEM;
+            return NULL;
+          }
+        zfile->out_size = deflateBound ( &zfile->z, ZFILE_CHUNK );
+        break;
+#endif
+#if ZFILE_ZSTD
+      case ZFILE_ZST:
+        if ( ( zfile->zstd = ZSTD_createCCtx () ) == NULL )
+          {
+            zfile->format = ZFILE_PLAIN;
+            free_zfile ( zfile );
+            errno = ENOMEM;
+            return NULL;
+          }
+        zfile->out_size = ZSTD_compressBound ( ZFILE_CHUNK );
+        break;
+#endif
+      default:
+        free_zfile ( zfile );
+        errno = ENOTSUP;
+        return NULL;
+    }
+  if ( ( zfile->out = malloc ( zfile->out_size ) ) == NULL )
+    {
+      free_zfile ( zfile );
+      errno = ENOMEM;
+      return NULL;
+    }
+  return zfile;
+}
+
+#endif /* ZFILE_THREAD */
+
+FILE *
+zfile_create ( const char *path )
+{
+  enum zfile_format format = ZFILE_PLAIN;
+#if ZFILE_THREAD
+  cookie_io_functions_t io = { NULL, zfile_write, NULL, zfile_close };
+  struct zfile *zfile;
+  FILE *stream;
+  int error;
+#endif
+
+  if ( has_suffix ( path, ".gz" ) )
+    format = ZFILE_GZ;
+  else if ( has_suffix ( path, ".zst" ) )
+    format = ZFILE_ZST;
+  if ( format == ZFILE_PLAIN )
+    return fopen ( path, "w" );
+
+#if ZFILE_THREAD
+  if ( !( zfile = new_zfile ( format ) ) )
+    return NULL;
+  if ( ( zfile->fd = open ( path, O_WRONLY | O_CREAT | O_TRUNC, 0666 ) ) < 0 )
+    {
+      error = errno;
+      free_zfile ( zfile );
+      errno = error;
+      return NULL;
+    }
+  if ( ( error = pthread_create (
+                 &zfile->thread, NULL, compress_thread, zfile ) ) != 0 )
+    {
+      close ( zfile->fd );
+      free_zfile ( zfile );
+      errno = error;
+      return NULL;
+    }
+  if ( !( stream = fopencookie ( zfile, "w", io ) ) )
+    {
+      error = errno;
+      zfile_close ( zfile );
+      errno = error;
+      return NULL;
+    }
+  /* Hand each line over as it is done, so that none of it waits in the
+     stream buffer longer than ZFILE_FLUSH_MS */
+  setvbuf ( stream, NULL, _IOLBF, BUFSIZ );
+  return stream;
+#else
+  errno = ENOTSUP;
+  return NULL;
+#endif
+}
@@ -0,0 +1,43 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#if !defined ZFILE_H
+#define ZFILE_H
+
+#include <stdio.h>
+
+/* Output files compressed in the process. What is written to the stream
+   is copied into chunks, and a thread of its own compresses each full
+   chunk into a gzip member or zstd frame and writes it out, so the
+   formatters never wait for the compressor or the disk. A concatenation
+   of members or frames is a valid file, and one cut short by a crash
+   still decompresses up to the last whole one. A chunk that stays
+   partly filled for long is written out all the same. */
+
+#define ZFILE_CHUNK ( 256 * 1024 ) /* bytes of output in each frame */
+#define ZFILE_QUEUE 8              /* full chunks waiting, at most */
+#define ZFILE_FLUSH_MS 1000        /* longest a partial chunk waits */
+
+/* zfile_create creates the file at path and returns a stream for it,
+   compressed with gzip if path ends in .gz and with zstd if it ends in
+   .zst, as it is otherwise. fclose() writes the rest and waits for the
+   thread; it fails if any write did. Returns NULL with errno set on
+   failure, ENOTSUP if nbtscan was built without the compression path
+   asks for. */
+FILE *
+zfile_create ( const char *path );
+
+#endif /* ZFILE_H */
@@ -0,0 +1,45 @@
+#!/bin/sh
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+# Runs arp-test in a network namespace joined to a second one by a veth
+# pair. Skipped (77) without root or network namespaces.
+
+[ "$(id -u)" = 0 ] || exit 77
+command -v ip >/dev/null 2>&1 || exit 77
+
+scanner=nbtscan-test-scanner.$$
+peer=nbtscan-test-peer.$$
+
+cleanup ()
+{
+  ip netns delete $scanner 2>/dev/null
+  ip netns delete $peer 2>/dev/null
+}
+trap cleanup EXIT
+trap 'exit 1' HUP INT TERM
+
+ip netns add $scanner 2>/dev/null || exit 77
+ip netns add $peer 2>/dev/null || exit 77
+ip -n $scanner link add veth0 type veth peer name veth1 netns $peer \
+  2>/dev/null || exit 77
+
+ip -n $scanner link set lo up &&
+ip -n $scanner address add 10.99.0.1/24 dev veth0 &&
+ip -n $scanner link set veth0 up &&
+ip -n $peer link set lo up &&
+ip -n $peer address add 10.99.0.2/24 dev veth1 &&
+ip -n $peer link set veth1 up || exit 1
+
+ip netns exec $scanner ./arp-test
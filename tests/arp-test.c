@@ -0,0 +1,50 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+#include <errno.h>
+#include "nbtscan.h"
+#include "check.h"
+
+/* Run by arp-netns.sh in a network namespace of its own, on one end of a
+   veth pair with 10.99.0.1/24. The other end, 10.99.0.2, is in a second
+   namespace with nothing listening on port 137. Of 10.99.0.0/28 only those
+   two answer ARP, so only they are queried, and both refuse. */
+int
+main ( void )
+{
+  struct nbt_options options;
+  struct nbt_scan *scan;
+  const struct nbt_stats *stats;
+
+  nbt_default_options ( &options );
+  options.arp_sweep = 1;
+  options.timeout = 500;
+  if ( !( scan = nbt_scan_new ( &options, NULL, NULL ) ) )
+    {
+      perror ( "nbt_scan_new" );
+      return errno == EPERM || errno == ENOSYS ? CHECK_SKIP : 1;
+    }
+  CHECK ( nbt_scan_add_target ( scan, "10.99.0.0/28" ) == 1 );
+  CHECK ( nbt_scan_run ( scan ) == 0 );
+  stats = nbt_scan_stats ( scan );
+  CHECK ( stats->sent == 2 );
+  CHECK ( stats->unreachable == 2 );
+  CHECK ( stats->responded == 0 );
+  CHECK ( stats->errors == 0 );
+  nbt_scan_free ( scan );
+  return check_status ();
+}
@@ -0,0 +1,74 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdlib.h>
+#include "bitmap.h"
+#include "check.h"
+
+int
+main ( void )
+{
+  struct addr_bitmap *bitmap;
+  unsigned long addr;
+  int added;
+
+  bitmap = new_addr_bitmap ();
+  CHECK ( bitmap != NULL );
+  CHECK ( bitmap->count == 0 );
+
+  /* An address is only new the first time */
+  CHECK ( bitmap_add ( bitmap, 0x0a000001 ) == 1 );
+  CHECK ( bitmap_add ( bitmap, 0x0a000001 ) == 0 );
+  CHECK ( bitmap->count == 1 );
+
+  /* Its neighbours on the same page are not in the set */
+  CHECK ( bitmap_add ( bitmap, 0x0a000000 ) == 1 );
+  CHECK ( bitmap_add ( bitmap, 0x0a000002 ) == 1 );
+
+  /* Nor are the same low bits on other pages */
+  CHECK ( bitmap_add ( bitmap, 0x0a010001 ) == 1 );
+  CHECK ( bitmap_add ( bitmap, 0xc0a80001 ) == 1 );
+  CHECK ( bitmap->count == 5 );
+
+  /* The ends of the address space */
+  CHECK ( bitmap_add ( bitmap, 0 ) == 1 );
+  CHECK ( bitmap_add ( bitmap, 0xffffffff ) == 1 );
+  CHECK ( bitmap_add ( bitmap, 0xffffffff ) == 0 );
+  CHECK ( bitmap->count == 7 );
+  CHECK ( bitmap->pages[0xffff] != NULL );
+  CHECK ( bitmap->pages[0x0b00] == NULL );
+
+  /* A whole page, every address once */
+  added = 0;
+  for ( addr = 0xac100000; addr <= 0xac10ffff; addr++ )
+    added += bitmap_add ( bitmap, addr );
+  CHECK ( added == 65536 );
+  added = 0;
+  for ( addr = 0xac100000; addr <= 0xac10ffff; addr++ )
+    added += bitmap_add ( bitmap, addr );
+  CHECK ( added == 0 );
+  CHECK ( bitmap->count == 7 + 65536 );
+
+  /* Cleared, everything is new again */
+  bitmap_clear ( bitmap );
+  CHECK ( bitmap->count == 0 );
+  CHECK ( bitmap->pages[0x0a00] == NULL );
+  CHECK ( bitmap_add ( bitmap, 0x0a000001 ) == 1 );
+  CHECK ( bitmap_add ( bitmap, 0xac10ffff ) == 1 );
+
+  delete_addr_bitmap ( bitmap );
+  return check_status ();
+}
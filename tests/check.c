@@ -0,0 +1,102 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "check.h"
+
+static int failures;
+
+void
+check ( int ok, const char *what, const char *file, int line )
+{
+  if ( ok )
+    return;
+  fprintf ( stderr, "%s:%d: check failed: %s\n", file, line, what );
+  failures++;
+}
+
+int
+check_status ( void )
+{
+  return failures ? 1 : 0;
+}
+
+static void
+put16 ( unsigned char *p, unsigned int v )
+{
+  p[0] = v >> 8;
+  p[1] = v;
+}
+
+unsigned int
+check_response ( unsigned char *buff,
+                 const struct check_name *names,
+                 int count,
+                 const unsigned char *mac )
+{
+  unsigned char *p = buff;
+  char question[40];
+  size_t len;
+  int i;
+
+  memset ( p, 0, 1024 );
+  put16 ( p, 0x1234 );
+  put16 ( p + 2, 0x8400 );
+  put16 ( p + 6, 1 );
+  name_mangle ( "*", question, 0 );
+  memcpy ( p + 12, question, 34 );
+  put16 ( p + 46, QT_NODE_STATUS_REQUEST );
+  put16 ( p + 48, QC_INTERNET );
+  put16 ( p + 54, 1 + count * 18 + 46 );
+  p[56] = count;
+  p += NBNAME_RESPONSE_HEADER_SIZE;
+
+  for ( i = 0; i < count; i++ )
+    {
+      len = strlen ( names[i].name );
+      memset ( p, ' ', 15 );
+      memcpy ( p, names[i].name, len < 15 ? len : 15 );
+      p[15] = names[i].service;
+      put16 ( p + 16, names[i].group ? 0x8400 : 0x0400 );
+      p += 18;
+    }
+  memcpy ( p, mac, 6 );
+  p += 46;
+  return p - buff;
+}
+
+struct nb_host_info *
+check_hostinfo ( const struct check_name *names,
+                 int count,
+                 const unsigned char *mac )
+{
+  unsigned char buff[1024];
+  unsigned int size;
+
+  size = check_response ( buff, names, count, mac );
+  return parse_response ( ( char * ) buff, size );
+}
+
+void
+check_free_hostinfo ( struct nb_host_info *hostinfo )
+{
+  free ( hostinfo->header );
+  free ( hostinfo->footer );
+  free ( hostinfo->names );
+  free ( hostinfo );
+}
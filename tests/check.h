@@ -0,0 +1,63 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#if !defined CHECK_H
+#define CHECK_H
+
+#include "statusq.h"
+
+/* CHECK counts cond as failed, and says where, if it is false */
+#define CHECK( cond ) check ( ( cond ) != 0, #cond, __FILE__, __LINE__ )
+
+/* Exit status of a test that can't run here, such as one that needs
+   root */
+#define CHECK_SKIP 77
+
+void
+check ( int ok, const char *what, const char *file, int line );
+
+/* check_status is what the test exits with: 0 if all checks passed, 1 if
+   any failed */
+int
+check_status ( void );
+
+/* An entry of the name table of a made up node status response */
+struct check_name
+{
+  const char *name;
+  unsigned char service;
+  int group;
+};
+
+/* check_response writes a node status response with the count names and
+   the adapter address mac to buff, which has room for 1024 bytes, the way
+   Windows sends it. Returns its size. */
+unsigned int
+check_response ( unsigned char *buff,
+                 const struct check_name *names,
+                 int count,
+                 const unsigned char *mac );
+
+/* check_hostinfo parses such a response */
+struct nb_host_info *
+check_hostinfo ( const struct check_name *names,
+                 int count,
+                 const unsigned char *mac );
+
+void
+check_free_hostinfo ( struct nb_host_info *hostinfo );
+
+#endif /* CHECK_H */
@@ -0,0 +1,195 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "nbtscan.h"
+#include "cookie.h"
+#include "check.h"
+
+#define HOST 0x7f060001   /* answers with its cookie */
+#define FORGER 0x7f060002 /* answers with another transaction ID */
+
+static const struct check_name names[] = { { "COOKIE", 0x00, 0 } };
+static const unsigned char mac[6] = { 0x02, 0, 0, 0, 0, 6 };
+
+/* cookie() with the key and message of the SipHash test vectors, the
+   bytes 00 to 0f and 00 01 02 03 */
+static void
+check_cookie ( void )
+{
+  struct cookie_key key = { 0x0706050403020100ULL, 0x0f0e0d0c0b0a0908ULL };
+  struct cookie_key other;
+  unsigned char seen[65536 / 8];
+  unsigned int value, distinct = 0;
+  unsigned long addr;
+
+  /* SipHash-2-4 gives cf2794e0277187b7 */
+  CHECK ( cookie ( &key, 0x03020100 ) == 0xfb01 );
+  CHECK ( cookie ( &key, 0x03020100 ) == cookie ( &key, 0x03020100 ) );
+
+  /* Neighbours get unrelated IDs */
+  memset ( seen, 0, sizeof seen );
+  for ( addr = 0x0a000000; addr < 0x0a000100; addr++ )
+    {
+      value = cookie ( &key, addr );
+      CHECK ( value <= 0xffff );
+      if ( !( seen[value / 8] & ( 1 << value % 8 ) ) )
+        distinct++;
+      seen[value / 8] |= 1 << value % 8;
+    }
+  CHECK ( distinct >= 250 );
+
+  /* Every scan its own key */
+  cookie_secret ( &key );
+  cookie_secret ( &other );
+  CHECK ( key.k0 != other.k0 || key.k1 != other.k1 );
+}
+
+static int
+bind_host ( unsigned long addr )
+{
+  struct sockaddr_in sin;
+  int sock;
+
+  if ( ( sock = socket ( AF_INET, SOCK_DGRAM, 0 ) ) < 0 )
+    return -1;
+  memset ( &sin, 0, sizeof sin );
+  sin.sin_family = AF_INET;
+  sin.sin_addr.s_addr = htonl ( addr );
+  sin.sin_port = htons ( 137 );
+  if ( bind ( sock, ( struct sockaddr * ) &sin, sizeof sin ) < 0 )
+    {
+      close ( sock );
+      return -1;
+    }
+  return sock;
+}
+
+/* answer reads the query waiting on sock and answers it, with its own
+   transaction ID or, if forge, with one that is off by one */
+static void
+answer ( int sock, int forge )
+{
+  unsigned char query[1024], response[1024];
+  struct sockaddr_in from;
+  socklen_t len = sizeof from;
+  unsigned int size, id;
+
+  if ( recvfrom ( sock,
+                  query,
+                  sizeof query,
+                  0,
+                  ( struct sockaddr * ) &from,
+                  &len ) < 2 )
+    return;
+  id = ( query[0] << 8 | query[1] ) ^ ( forge ? 1 : 0 );
+  size = check_response ( response, names, 1, mac );
+  response[0] = id >> 8;
+  response[1] = id;
+  sendto ( sock, response, size, 0, ( struct sockaddr * ) &from, sizeof from );
+}
+
+static void
+count ( struct in_addr addr,
+        const struct nb_host_info *hostinfo,
+        double rtt,
+        void *arg )
+{
+  unsigned long *answered = arg;
+
+  ( void ) hostinfo;
+  ( void ) rtt;
+  CHECK ( ntohl ( addr.s_addr ) == HOST );
+  ( *answered )++;
+}
+
+/* A stateless scan of two hosts on 127.6.0.0, one of which gets the
+   transaction ID wrong. Returns CHECK_SKIP if port 137 can't be had. */
+static int
+check_scan ( void )
+{
+  struct nbt_options options;
+  struct nbt_scan *scan;
+  struct timeval tv;
+  fd_set fdsr;
+  unsigned long answered = 0;
+  int host, forger, fd, maxfd, running;
+
+  if ( ( host = bind_host ( HOST ) ) < 0 )
+    return CHECK_SKIP;
+  if ( ( forger = bind_host ( FORGER ) ) < 0 )
+    {
+      close ( host );
+      return CHECK_SKIP;
+    }
+
+  nbt_default_options ( &options );
+  options.timeout = 300;
+  options.stateless = 1;
+  options.quiet = 1;
+  if ( !( scan = nbt_scan_new ( &options, count, &answered ) ) )
+    {
+      perror ( "nbt_scan_new" );
+      CHECK ( scan != NULL );
+      return 0;
+    }
+  CHECK ( nbt_scan_add_target ( scan, "127.6.0.1-2" ) == 1 );
+
+  fd = nbt_scan_fd ( scan );
+  maxfd = fd > host ? fd : host;
+  maxfd = maxfd > forger ? maxfd : forger;
+  while ( ( running = nbt_scan_step ( scan ) ) > 0 )
+    {
+      nbt_scan_timeout ( scan, &tv );
+      FD_ZERO ( &fdsr );
+      FD_SET ( fd, &fdsr );
+      FD_SET ( host, &fdsr );
+      FD_SET ( forger, &fdsr );
+      if ( select ( maxfd + 1, &fdsr, NULL, NULL, &tv ) <= 0 )
+        continue;
+      if ( FD_ISSET ( host, &fdsr ) )
+        answer ( host, 0 );
+      if ( FD_ISSET ( forger, &fdsr ) )
+        answer ( forger, 1 );
+    }
+  CHECK ( running == 0 );
+  CHECK ( answered == 1 );
+  CHECK ( nbt_scan_stats ( scan )->responded == 1 );
+  CHECK ( nbt_scan_stats ( scan )->rejected >= 1 );
+
+  nbt_scan_free ( scan );
+  close ( host );
+  close ( forger );
+  return 0;
+}
+
+int
+main ( void )
+{
+  check_cookie ();
+  if ( check_scan () == CHECK_SKIP )
+    fprintf ( stderr, "port 137 of 127.6.0.1 is not ours, scan skipped\n" );
+  return check_status ();
+}
@@ -0,0 +1,108 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "nbtscan.h"
+#include "exclude.h"
+#include "check.h"
+
+/* exclude_list on its own: sorting, merging and the lookups */
+static void
+check_list ( void )
+{
+  struct exclude_list *list;
+  const struct ip_range *range;
+
+  list = new_exclude_list ();
+  CHECK ( exclude_find ( list, 0x0a000001 ) == NULL );
+  CHECK ( !exclude_overlaps ( list, 0, 0xffffffff ) );
+
+  /* Out of order, overlapping and touching ranges */
+  exclude_add ( list, 0x0a000010, 0x0a00001f );
+  exclude_add ( list, 0x0a000000, 0x0a000004 );
+  exclude_add ( list, 0x0a000018, 0x0a000027 );
+  exclude_add ( list, 0x0a000005, 0x0a000007 );
+  exclude_add ( list, 0xc0a80101, 0xc0a80101 );
+
+  CHECK ( exclude_find ( list, 0x09ffffff ) == NULL );
+  CHECK ( ( range = exclude_find ( list, 0x0a000000 ) ) != NULL );
+  /* 0.0-0.4 and 0.5-0.7 touch and are one range now */
+  CHECK ( range && range->start_ip == 0x0a000000 &&
+          range->end_ip == 0x0a000007 );
+  CHECK ( exclude_find ( list, 0x0a000008 ) == NULL );
+  CHECK ( exclude_find ( list, 0x0a00000f ) == NULL );
+  /* 0.16-0.31 and 0.24-0.39 overlap */
+  CHECK ( ( range = exclude_find ( list, 0x0a000020 ) ) != NULL );
+  CHECK ( range && range->start_ip == 0x0a000010 &&
+          range->end_ip == 0x0a000027 );
+  CHECK ( exclude_find ( list, 0x0a000028 ) == NULL );
+  CHECK ( exclude_find ( list, 0xc0a80101 ) != NULL );
+  CHECK ( exclude_find ( list, 0xc0a80100 ) == NULL );
+  CHECK ( exclude_find ( list, 0xc0a80102 ) == NULL );
+  CHECK ( list->count == 3 );
+
+  CHECK ( exclude_overlaps ( list, 0x0a000008, 0x0a000010 ) );
+  CHECK ( !exclude_overlaps ( list, 0x0a000008, 0x0a00000f ) );
+  CHECK ( exclude_overlaps ( list, 0x00000000, 0x0a000000 ) );
+  CHECK ( exclude_overlaps ( list, 0xc0a80000, 0xc0a8ffff ) );
+  CHECK ( !exclude_overlaps ( list, 0xc0a80102, 0xffffffff ) );
+
+  /* Adding after a lookup sorts again */
+  exclude_add ( list, 0x0a000008, 0x0a00000f );
+  CHECK ( ( range = exclude_find ( list, 0x0a00000c ) ) != NULL );
+  CHECK ( range && range->start_ip == 0x0a000000 &&
+          range->end_ip == 0x0a000027 );
+  CHECK ( list->count == 2 );
+
+  delete_exclude_list ( list );
+}
+
+/* Excluded targets are counted and never queried. Nothing answers on
+   127.3.0.0/29, the queries only have to leave. */
+static void
+check_scan ( void )
+{
+  struct nbt_options options;
+  struct nbt_scan *scan;
+  const struct nbt_stats *stats;
+
+  nbt_default_options ( &options );
+  options.timeout = 100;
+  if ( !( scan = nbt_scan_new ( &options, NULL, NULL ) ) )
+    {
+      perror ( "nbt_scan_new" );
+      CHECK ( scan != NULL );
+      return;
+    }
+  CHECK ( nbt_scan_add_target ( scan, "127.3.0.0/29" ) == 1 );
+  CHECK ( nbt_scan_exclude ( scan, "127.3.0.2-3" ) == 1 );
+  CHECK ( nbt_scan_exclude ( scan, "127.3.0.6" ) == 1 );
+  CHECK ( nbt_scan_exclude ( scan, "127.3.0.x" ) == 0 );
+  CHECK ( nbt_scan_run ( scan ) == 0 );
+  stats = nbt_scan_stats ( scan );
+  CHECK ( stats->excluded == 3 );
+  CHECK ( stats->sent == 5 );
+  nbt_scan_free ( scan );
+}
+
+int
+main ( void )
+{
+  check_list ();
+  check_scan ();
+  return check_status ();
+}
@@ -0,0 +1,201 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include "filter.h"
+#include "check.h"
+
+/* nbtscan's, which the filter reports through */
+int quiet = 0;
+
+static const struct check_name workstation[] = {
+  { "DESKTOP-4TQ2K1", 0x00, 0 },
+  { "WORKGROUP", 0x00, 1 },
+  { "DESKTOP-4TQ2K1", 0x20, 0 },
+  { "JDOE", 0x03, 0 } };
+
+static const unsigned char mac[6] = { 0x00, 0x50, 0x56, 0x12, 0x34, 0x56 };
+
+static struct nb_host_info *host;
+static struct nb_host_info *host_without_mac;
+
+/* matches tells if the host at 10.0.0.5 satisfies expression, -1 if the
+   expression does not compile */
+static int
+matches_host ( const char *expression, const struct nb_host_info *hostinfo )
+{
+  struct filter *filter;
+  struct in_addr addr;
+  char errmsg[80];
+  int result;
+
+  if ( !( filter = new_filter ( expression, errmsg, sizeof errmsg ) ) )
+    {
+      fprintf ( stderr, "%s: %s\n", expression, errmsg );
+      return -1;
+    }
+  addr.s_addr = htonl ( 0x0a000005 );
+  result = filter_match ( filter, addr, hostinfo );
+  delete_filter ( filter );
+  return result;
+}
+
+static int
+matches ( const char *expression )
+{
+  return matches_host ( expression, host );
+}
+
+/* rejected tells if expression does not compile, with a reason */
+static int
+rejected ( const char *expression )
+{
+  struct filter *filter;
+  char errmsg[80] = "";
+
+  if ( ( filter = new_filter ( expression, errmsg, sizeof errmsg ) ) )
+    {
+      delete_filter ( filter );
+      return 0;
+    }
+  return errmsg[0] != 0;
+}
+
+static int
+parts ( const char *expression )
+{
+  struct filter *filter;
+  char errmsg[80];
+  int result;
+
+  if ( !( filter = new_filter ( expression, errmsg, sizeof errmsg ) ) )
+    return -1;
+  result = filter->parts;
+  delete_filter ( filter );
+  return result;
+}
+
+static void
+check_syntax ( void )
+{
+  CHECK ( rejected ( "" ) );
+  CHECK ( rejected ( "name" ) );
+  CHECK ( rejected ( "name==" ) );
+  CHECK ( rejected ( "hostname==X" ) );
+  CHECK ( rejected ( "unique==1" ) );
+  CHECK ( rejected ( "service~0x20" ) );
+  CHECK ( rejected ( "service==0x100" ) );
+  CHECK ( rejected ( "service==twenty" ) );
+  CHECK ( rejected ( "name==X &&" ) );
+  CHECK ( rejected ( "name==X ||| name==Y" ) );
+  CHECK ( rejected ( "(name==X" ) );
+  CHECK ( rejected ( "name==X)" ) );
+  CHECK ( rejected ( "name==\"X" ) );
+  CHECK ( rejected ( "name~[" ) );
+  CHECK ( rejected ( "ip==10.0.0.300" ) );
+  CHECK ( rejected ( "mac==00:50:56" ) );
+  CHECK ( rejected ( "mac_prefix==00:50:5g" ) );
+  CHECK ( rejected ( "mac_prefix==00:50:56:12:34:56:78" ) );
+
+  CHECK ( !rejected ( "unique" ) );
+  CHECK ( !rejected ( " ( name==X ) " ) );
+  CHECK ( !rejected ( "!!unique" ) );
+  CHECK ( !rejected ( "name==\"A B\" || name=='C|D'" ) );
+
+  /* Only the parts of the answer the terms look at are parsed */
+  CHECK ( parts ( "ip==10.0.0.0/8" ) == 0 );
+  CHECK ( parts ( "name==X" ) == NB_PARSE_NAMES );
+  CHECK ( parts ( "mac_prefix==00:50:56" ) == NB_PARSE_MAC );
+  CHECK ( parts ( "unique || mac==00:50:56:12:34:56" ) ==
+          ( NB_PARSE_NAMES | NB_PARSE_MAC ) );
+}
+
+static void
+check_matching ( void )
+{
+  /* Names, without padding and regardless of case */
+  CHECK ( matches ( "name==DESKTOP-4TQ2K1" ) == 1 );
+  CHECK ( matches ( "name==desktop-4tq2k1" ) == 1 );
+  CHECK ( matches ( "name==DESKTOP" ) == 0 );
+  CHECK ( matches ( "name~^desk" ) == 1 );
+  CHECK ( matches ( "name~^SRV-" ) == 0 );
+  CHECK ( matches ( "name!~^SRV-" ) == 1 );
+  CHECK ( matches ( "name=='JDOE'" ) == 1 );
+
+  /* Terms on names hold together for one entry of the table */
+  CHECK ( matches ( "service==0x20 && unique" ) == 1 );
+  CHECK ( matches ( "service==0x20 && !unique" ) == 0 );
+  CHECK ( matches ( "name==WORKGROUP && unique" ) == 0 );
+  CHECK ( matches ( "name==WORKGROUP && !unique" ) == 1 );
+  CHECK ( matches ( "name==JDOE && service==3" ) == 1 );
+  CHECK ( matches ( "name==JDOE && service==0x20" ) == 0 );
+  CHECK ( matches ( "service!=0" ) == 1 );
+  CHECK ( matches ( "service==0x1c" ) == 0 );
+
+  /* The workgroup is the same for every entry */
+  CHECK ( matches ( "group==workgroup" ) == 1 );
+  CHECK ( matches ( "group!=WORKGROUP" ) == 0 );
+  CHECK ( matches ( "group~^WORK && service==0x20" ) == 1 );
+
+  CHECK ( matches ( "ip==10.0.0.5" ) == 1 );
+  CHECK ( matches ( "ip==10.0.0.0/24" ) == 1 );
+  CHECK ( matches ( "ip==10.0.0.6-20" ) == 0 );
+  CHECK ( matches ( "ip!=10.0.0.6-20" ) == 1 );
+
+  CHECK ( matches ( "mac==00:50:56:12:34:56" ) == 1 );
+  CHECK ( matches ( "mac==00-50-56-12-34-57" ) == 0 );
+  CHECK ( matches ( "mac_prefix==00:50:56" ) == 1 );
+  CHECK ( matches ( "mac_prefix!=00:50:56" ) == 0 );
+  CHECK ( matches ( "mac_prefix==00:0c:29" ) == 0 );
+
+  /* && binds tighter than ||, ! tighter than both */
+  CHECK ( matches ( "name==JDOE || name==NOPE && service==0x20" ) == 1 );
+  CHECK ( matches ( "(name==JDOE || name==NOPE) && service==0x20" ) == 0 );
+  CHECK ( matches ( "!name==NOPE && ip==10.0.0.5" ) == 1 );
+  CHECK ( matches ( "!(name==NOPE || ip==10.0.0.5)" ) == 0 );
+
+  /* Nothing holds of a MAC address the host did not send */
+  CHECK ( matches_host ( "mac_prefix==00:50:56", host_without_mac ) == 0 );
+  CHECK ( matches_host ( "mac_prefix!=00:50:56", host_without_mac ) == 0 );
+  CHECK ( matches_host ( "name==JDOE", host_without_mac ) == 1 );
+}
+
+int
+main ( void )
+{
+  unsigned char buff[1024];
+  unsigned int size;
+
+  host = check_hostinfo ( workstation, 4, mac );
+  size = check_response ( buff, workstation, 4, mac );
+  host_without_mac =
+          parse_response_parts ( ( char * ) buff, size, NB_PARSE_NAMES );
+  if ( !host || !host_without_mac )
+    {
+      fprintf ( stderr, "Cannot parse the test response\n" );
+      return 1;
+    }
+
+  check_syntax ();
+  check_matching ();
+
+  check_free_hostinfo ( host );
+  check_free_hostinfo ( host_without_mac );
+  return check_status ();
+}
@@ -0,0 +1,169 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <arpa/inet.h>
+#include "nbtscan.h"
+#include "prefix.h"
+#include "pcapfile.h"
+#include "time.h"
+#include "check.h"
+
+#define CAPTURE "prefix-test.pcap"
+
+static struct timeval
+at_ms ( long ms )
+{
+  struct timeval tv = { 1000 + ms / 1000, ( ms % 1000 ) * 1000 };
+
+  return tv;
+}
+
+/* prefix_table on its own, with made up times: queries are held per
+   prefix and the prefixes take turns */
+static void
+check_table ( void )
+{
+  struct prefix_table *table;
+  struct timeval interval = { 0, 100000 }, now;
+  unsigned long addr;
+
+  table = new_prefix_table ( &interval );
+  CHECK ( table != NULL );
+  if ( !table )
+    return;
+
+  /* Nothing went into prefix 1 yet */
+  now = at_ms ( 0 );
+  CHECK ( prefix_hold ( table, 1, 0x0a000101, &now ) == 0 );
+  CHECK ( prefix_sent ( table, 1, &now ) == 0 );
+  CHECK ( prefix_hold ( table, 1, 0x0a000102, &now ) == 1 );
+  now = at_ms ( 10 );
+  CHECK ( prefix_hold ( table, 2, 0x0a000201, &now ) == 0 );
+  CHECK ( prefix_sent ( table, 2, &now ) == 0 );
+  CHECK ( prefix_hold ( table, 2, 0x0a000202, &now ) == 1 );
+  CHECK ( prefix_hold ( table, 1, 0x0a000103, &now ) == 1 );
+  CHECK ( table->held == 3 );
+  CHECK ( prefix_lowest ( table ) == 0x0a000102 );
+
+  /* Prefix 1 comes first, its turn is sooner */
+  now = at_ms ( 50 );
+  CHECK ( !prefix_next ( table, &now, &addr ) );
+  CHECK ( prefix_soonest ( table ) != NULL &&
+          prefix_soonest ( table )->tv_usec == 100000 );
+  now = at_ms ( 100 );
+  CHECK ( prefix_next ( table, &now, &addr ) && addr == 0x0a000102 );
+  CHECK ( prefix_sent ( table, 1, &now ) == 0 );
+  CHECK ( !prefix_next ( table, &now, &addr ) );
+
+  /* Then prefix 2, before the second query held for prefix 1 */
+  now = at_ms ( 110 );
+  CHECK ( prefix_next ( table, &now, &addr ) && addr == 0x0a000202 );
+  CHECK ( prefix_sent ( table, 2, &now ) == 0 );
+  now = at_ms ( 150 );
+  CHECK ( !prefix_next ( table, &now, &addr ) );
+  now = at_ms ( 200 );
+  CHECK ( prefix_next ( table, &now, &addr ) && addr == 0x0a000103 );
+  CHECK ( prefix_sent ( table, 1, &now ) == 0 );
+  CHECK ( table->held == 0 );
+  CHECK ( prefix_soonest ( table ) == NULL );
+  CHECK ( prefix_lowest ( table ) == 1ULL << 32 );
+
+  /* Once its turn has come a prefix is forgotten, until then a query
+     into it still waits */
+  now = at_ms ( 250 );
+  prefix_expire ( table, &now );
+  CHECK ( table->count == 1 );
+  CHECK ( prefix_hold ( table, 1, 0x0a000104, &now ) == 1 );
+  prefix_clear ( table );
+  CHECK ( table->held == 0 );
+  now = at_ms ( 300 );
+  prefix_expire ( table, &now );
+  CHECK ( table->count == 0 );
+  CHECK ( prefix_hold ( table, 1, 0x0a000104, &now ) == 0 );
+
+  delete_prefix_table ( table );
+}
+
+/* A scan of two /28 prefixes at 50 queries per second into each. The
+   queries into one prefix are 20 ms apart, and while one prefix waits
+   the other is queried, so the 32 queries take about as long as the 16
+   into one prefix. Nothing answers on 127.4.0.0/27. */
+static void
+check_scan ( void )
+{
+  struct nbt_options options;
+  struct nbt_scan *scan;
+  struct pcap_reader *reader;
+  struct sockaddr_in src, dst;
+  struct timeval ts, last[2], first, end, gap;
+  const unsigned char *data;
+  int sent[2] = { 0, 0 }, p;
+
+  nbt_default_options ( &options );
+  options.timeout = 100;
+  options.prefix_rate = 50;
+  options.fair_bits = 28;
+  if ( !( scan = nbt_scan_new ( &options, NULL, NULL ) ) )
+    {
+      perror ( "nbt_scan_new" );
+      CHECK ( scan != NULL );
+      return;
+    }
+  CHECK ( nbt_scan_add_target ( scan, "127.4.0.0/27" ) == 1 );
+  CHECK ( nbt_scan_record ( scan, CAPTURE ) == 0 );
+  CHECK ( nbt_scan_run ( scan ) == 0 );
+  CHECK ( nbt_scan_stats ( scan )->sent == 32 );
+  CHECK ( nbt_scan_stats ( scan )->held >= 30 );
+  nbt_scan_free ( scan );
+
+  if ( !( reader = pcap_open ( CAPTURE ) ) )
+    {
+      perror ( CAPTURE );
+      CHECK ( reader != NULL );
+      return;
+    }
+  while ( pcap_next_udp ( reader, &src, &dst, &data, &ts ) > 0 )
+    {
+      if ( dst.sin_port != htons ( 137 ) )
+        continue;
+      p = ( ntohl ( dst.sin_addr.s_addr ) & 0xff ) >= 16;
+      if ( !sent[0] && !sent[1] )
+        first = ts;
+      if ( sent[p] )
+        {
+          timersub ( &ts, &last[p], &gap );
+          CHECK ( gap.tv_sec > 0 || gap.tv_usec >= 20000 );
+        }
+      last[p] = end = ts;
+      sent[p]++;
+    }
+  pcap_close ( reader );
+  CHECK ( sent[0] == 16 && sent[1] == 16 );
+
+  /* Prefix by prefix it would take 620 ms */
+  timersub ( &end, &first, &gap );
+  CHECK ( gap.tv_sec == 0 && gap.tv_usec < 450000 );
+}
+
+int
+main ( void )
+{
+  check_table ();
+  check_scan ();
+  return check_status ();
+}
@@ -0,0 +1,119 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <arpa/inet.h>
+#include "reorder.h"
+#include "check.h"
+
+#define RESULTS 1000
+
+static const struct check_name names[] = { { "HOST", 0x00, 0 } };
+static const unsigned char mac[6] = { 0x02, 0, 0, 0, 0, 1 };
+
+/* What the callback was handed, in order */
+struct flushed
+{
+  unsigned long addr[RESULTS];
+  double rtt[RESULTS];
+  int count;
+  int no_names;
+};
+
+static void
+record ( struct in_addr addr,
+         const struct nb_host_info *hostinfo,
+         double rtt,
+         void *arg )
+{
+  struct flushed *flushed = arg;
+
+  if ( !hostinfo || !hostinfo->names )
+    flushed->no_names++;
+  if ( flushed->count < RESULTS )
+    {
+      flushed->addr[flushed->count] = ntohl ( addr.s_addr );
+      flushed->rtt[flushed->count] = rtt;
+    }
+  flushed->count++;
+}
+
+static void
+add ( struct reorder_buffer *buffer, unsigned long addr )
+{
+  reorder_add ( buffer,
+                addr,
+                check_hostinfo ( names, 1, mac ),
+                ( addr & 0xff ) / 1000.0 );
+}
+
+int
+main ( void )
+{
+  struct reorder_buffer *buffer;
+  struct flushed flushed = { { 0 }, { 0 }, 0, 0 };
+  unsigned long addr;
+  int i, ordered;
+
+  buffer = new_reorder_buffer ();
+  CHECK ( reorder_flush ( buffer, 1ULL << 32, record, &flushed ) == 0 );
+
+  /* A few out of order; only those below the limit go, lowest first */
+  add ( buffer, 0x0a000005 );
+  add ( buffer, 0x0a000002 );
+  add ( buffer, 0x0a000009 );
+  add ( buffer, 0x0a000001 );
+  add ( buffer, 0x0a000007 );
+  CHECK ( reorder_flush ( buffer, 0x0a000005, record, &flushed ) == 2 );
+  CHECK ( flushed.count == 2 );
+  CHECK ( flushed.addr[0] == 0x0a000001 && flushed.addr[1] == 0x0a000002 );
+  CHECK ( flushed.rtt[0] == 0.001 && flushed.rtt[1] == 0.002 );
+  CHECK ( buffer->count == 3 );
+
+  /* The limit is exclusive */
+  CHECK ( reorder_flush ( buffer, 0x0a000005, record, &flushed ) == 0 );
+  CHECK ( reorder_flush ( buffer, 0x0a000006, record, &flushed ) == 1 );
+  CHECK ( flushed.addr[2] == 0x0a000005 );
+
+  /* The top of the address space flushes at 1 << 32 */
+  add ( buffer, 0xffffffff );
+  CHECK ( reorder_flush ( buffer, 0xffffffff, record, &flushed ) == 2 );
+  CHECK ( reorder_flush ( buffer, 1ULL << 32, record, &flushed ) == 1 );
+  CHECK ( flushed.count == 6 );
+  CHECK ( flushed.addr[3] == 0x0a000007 && flushed.addr[4] == 0x0a000009 &&
+          flushed.addr[5] == 0xffffffff );
+  CHECK ( buffer->count == 0 );
+
+  /* Many, past the first allocation, in a scrambled order */
+  flushed.count = 0;
+  for ( i = 0; i < RESULTS; i++ )
+    add ( buffer, 0xc0a80000 + ( i * 7919UL ) % RESULTS );
+  CHECK ( buffer->count == RESULTS );
+  CHECK ( reorder_flush ( buffer, 1ULL << 32, record, &flushed ) == RESULTS );
+  ordered = 1;
+  for ( i = 0, addr = 0xc0a80000; i < RESULTS; i++, addr++ )
+    if ( flushed.addr[i] != addr )
+      ordered = 0;
+  CHECK ( ordered );
+  CHECK ( flushed.no_names == 0 );
+
+  /* Results still held are freed with the buffer */
+  add ( buffer, 0x0a000001 );
+  add ( buffer, 0x0a000002 );
+  delete_reorder_buffer ( buffer );
+  return check_status ();
+}
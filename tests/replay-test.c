@@ -0,0 +1,182 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include "nbtscan.h"
+#include "statusq.h"
+#include "pcapfile.h"
+#include "check.h"
+
+#define CAPTURE "replay-test.pcap"
+#define HOSTS 4
+
+static const struct check_name workstation[] = {
+  { "DESKTOP-4TQ2K1", 0x00, 0 },
+  { "WORKGROUP", 0x00, 1 },
+  { "DESKTOP-4TQ2K1", 0x20, 0 } };
+static const struct check_name server[] = { { "FILESRV", 0x20, 0 } };
+
+static const unsigned char mac[6] = { 0x02, 0, 0, 0, 0, 1 };
+
+/* What the callback was handed, in order */
+struct replayed
+{
+  unsigned long addr[HOSTS];
+  double rtt[HOSTS];
+  int names[HOSTS];
+  char first_name[HOSTS][16];
+  int count;
+};
+
+static void
+record ( struct in_addr addr,
+         const struct nb_host_info *hostinfo,
+         double rtt,
+         void *arg )
+{
+  struct replayed *replayed = arg;
+  int i = replayed->count++;
+
+  if ( i >= HOSTS )
+    return;
+  replayed->addr[i] = ntohl ( addr.s_addr );
+  replayed->rtt[i] = rtt;
+  if ( hostinfo->names )
+    {
+      replayed->names[i] = hostinfo->header->number_of_names;
+      memcpy ( replayed->first_name[i], hostinfo->names[0].ascii_name, 16 );
+    }
+}
+
+static void
+set_addr ( struct sockaddr_in *sin, unsigned long addr, unsigned int port )
+{
+  memset ( sin, 0, sizeof *sin );
+  sin->sin_family = AF_INET;
+  sin->sin_addr.s_addr = htonl ( addr );
+  sin->sin_port = htons ( port );
+}
+
+/* write_datagram appends one datagram between the scanner at 10.0.0.1 and
+   host, at sec seconds into the capture */
+static void
+write_datagram ( FILE *out,
+                 int to_host,
+                 unsigned long host,
+                 const void *data,
+                 unsigned int size,
+                 double sec )
+{
+  struct sockaddr_in scanner, peer;
+  struct timeval ts;
+
+  set_addr ( &scanner, 0x0a000001, 40000 );
+  set_addr ( &peer, host, NB_DGRAM );
+  ts.tv_sec = 1000 + ( long ) sec;
+  ts.tv_usec = ( long ) ( ( sec - ( long ) sec ) * 1000000 + 0.5 );
+  if ( to_host )
+    CHECK ( pcap_write ( out, &scanner, &peer, data, size, &ts ) == 0 );
+  else
+    CHECK ( pcap_write ( out, &peer, &scanner, data, size, &ts ) == 0 );
+}
+
+static void
+write_capture ( void )
+{
+  unsigned char query[NBNAME_REQUEST_SIZE] = { 0x12, 0x34 };
+  unsigned char answer[1024];
+  unsigned char name_answer[62] = { 0x12, 0x34, 0x85, 0x00 };
+  unsigned int size;
+  FILE *out;
+
+  CHECK ( ( out = pcap_create ( CAPTURE ) ) != NULL );
+  if ( !out )
+    exit ( check_status () );
+
+  write_datagram ( out, 1, 0x0a000005, query, sizeof query, 0.5 );
+  write_datagram ( out, 1, 0x0a000006, query, sizeof query, 0.5 );
+  write_datagram ( out, 1, 0x0a000007, query, sizeof query, 0.5 );
+  size = check_response ( answer, workstation, 3, mac );
+  write_datagram ( out, 0, 0x0a000005, answer, size, 0.75 );
+  /* Answers to a retransmission count once, the first one */
+  write_datagram ( out, 0, 0x0a000005, answer, size, 1.0 );
+  /* Answers to name queries are no node status */
+  name_answer[46] = QT_NAME_QUERY >> 8;
+  name_answer[47] = QT_NAME_QUERY & 0xff;
+  write_datagram ( out, 0, 0x0a000007, name_answer, sizeof name_answer, 1.0 );
+  /* Answered a query the capture started after */
+  size = check_response ( answer, server, 1, mac );
+  write_datagram ( out, 0, 0x0a000009, answer, size, 1.5 );
+  /* The answer from .6 lost its footer, its names are still there */
+  write_datagram ( out, 0, 0x0a000006, answer, size - 10, 2.0 );
+
+  CHECK ( fclose ( out ) == 0 );
+}
+
+int
+main ( void )
+{
+  struct replayed replayed;
+  FILE *out;
+
+  memset ( &replayed, 0, sizeof replayed );
+  write_capture ();
+  CHECK ( nbt_replay ( CAPTURE, record, &replayed ) == 3 );
+  CHECK ( replayed.count == 3 );
+
+  CHECK ( replayed.addr[0] == 0x0a000005 );
+  CHECK ( replayed.names[0] == 3 );
+  CHECK ( !memcmp ( replayed.first_name[0], "DESKTOP-4TQ2K1 ", 15 ) );
+  CHECK ( replayed.rtt[0] > 0.2499 && replayed.rtt[0] < 0.2501 );
+
+  CHECK ( replayed.addr[1] == 0x0a000009 );
+  CHECK ( replayed.names[1] == 1 );
+  CHECK ( !memcmp ( replayed.first_name[1], "FILESRV        ", 15 ) );
+  CHECK ( replayed.rtt[1] < 0 );
+
+  CHECK ( replayed.addr[2] == 0x0a000006 );
+  CHECK ( replayed.names[2] == 1 );
+  CHECK ( replayed.rtt[2] > 1.4999 && replayed.rtt[2] < 1.5001 );
+
+  /* No callback needed to count */
+  CHECK ( nbt_replay ( CAPTURE, NULL, NULL ) == 3 );
+
+  /* Errors */
+  unlink ( CAPTURE );
+  errno = 0;
+  CHECK ( nbt_replay ( CAPTURE, record, &replayed ) == -1 );
+  CHECK ( errno == ENOENT );
+
+  out = fopen ( CAPTURE, "w" );
+  CHECK ( out != NULL );
+  if ( out )
+    {
+      fputs ( "This is not a capture, but it is long enough to be one\n",
+              out );
+      fclose ( out );
+    }
+  errno = 0;
+  CHECK ( nbt_replay ( CAPTURE, record, &replayed ) == -1 );
+  CHECK ( errno == EINVAL );
+  unlink ( CAPTURE );
+
+  return check_status ();
+}
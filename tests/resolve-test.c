@@ -0,0 +1,296 @@
+/*
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "resolve.h"
+#include "check.h"
+
+/* nbtscan's, which the resolver reports through */
+int quiet = 0;
+
+/* How the made up name server answers */
+enum reply
+{
+  REPLY_PTR,        /* host.example, TTL 3600 */
+  REPLY_LONG_TTL,   /* host.example, TTL 30 days */
+  REPLY_SOA,        /* NXDOMAIN, SOA TTL 900 with minimum 300 */
+  REPLY_SOA_SHORT,  /* NXDOMAIN, SOA TTL 60 with minimum 600 */
+  REPLY_NXDOMAIN,   /* NXDOMAIN without an SOA */
+  REPLY_FORGED      /* ghost.example with a wrong ID first, then
+                       host.example with the question in upper case */
+};
+
+struct lookup
+{
+  int done;
+  int named;
+  char name[DNS_MAX_NAME];
+};
+
+static unsigned int
+put16 ( unsigned char *p, unsigned int v )
+{
+  p[0] = v >> 8;
+  p[1] = v;
+  return 2;
+}
+
+static unsigned int
+put32 ( unsigned char *p, unsigned long v )
+{
+  put16 ( p, v >> 16 );
+  put16 ( p + 2, v );
+  return 4;
+}
+
+/* put_record writes a resource record owned by the question name, with
+   type, ttl and the rdata of length */
+static unsigned int
+put_record ( unsigned char *p,
+             unsigned int type,
+             unsigned long ttl,
+             const unsigned char *rdata,
+             unsigned int length )
+{
+  unsigned char *start = p;
+
+  p += put16 ( p, 0xc00c );
+  p += put16 ( p, type );
+  p += put16 ( p, 1 );
+  p += put32 ( p, ttl );
+  p += put16 ( p, length );
+  memcpy ( p, rdata, length );
+  return p + length - start;
+}
+
+static unsigned int
+put_ptr ( unsigned char *p, unsigned long ttl )
+{
+  static const unsigned char host[] = "\4host\7example";
+
+  return put_record ( p, 12, ttl, host, sizeof host );
+}
+
+/* put_soa writes an SOA record whose responsible mailbox points back at
+   the question */
+static unsigned int
+put_soa ( unsigned char *p, unsigned long ttl, unsigned long minimum )
+{
+  unsigned char soa[64], *q = soa;
+
+  memcpy ( q, "\2ns\7example", 12 );
+  q += 12;
+  q += put16 ( q, 0xc00c );
+  q += put32 ( q, 2024010101 ); /* serial */
+  q += put32 ( q, 7200 );       /* refresh */
+  q += put32 ( q, 900 );        /* retry */
+  q += put32 ( q, 1209600 );    /* expire */
+  q += put32 ( q, minimum );
+  return put_record ( p, 6, ttl, soa, q - soa );
+}
+
+/* serve answers the query waiting on sock the way reply says */
+static void
+serve ( int sock, enum reply reply )
+{
+  unsigned char packet[512];
+  struct sockaddr_in from;
+  socklen_t len = sizeof from;
+  unsigned int size, i;
+  int got;
+
+  got = recvfrom (
+          sock, packet, sizeof packet, 0, ( struct sockaddr * ) &from, &len );
+  if ( got < 12 )
+    return;
+  size = got;
+  packet[2] = 0x81;
+  packet[3] = 0x80;
+  switch ( reply )
+    {
+    case REPLY_PTR:
+    case REPLY_LONG_TTL:
+    case REPLY_FORGED:
+      put16 ( packet + 6, 1 );
+      size += put_ptr ( packet + size,
+                        reply == REPLY_LONG_TTL ? 30 * 24 * 3600L : 3600 );
+      break;
+    case REPLY_SOA:
+    case REPLY_SOA_SHORT:
+      packet[3] |= 3;
+      put16 ( packet + 8, 1 );
+      size += reply == REPLY_SOA ? put_soa ( packet + size, 900, 300 )
+                                 : put_soa ( packet + size, 60, 600 );
+      break;
+    case REPLY_NXDOMAIN:
+      packet[3] |= 3;
+      break;
+    }
+
+  if ( reply == REPLY_FORGED )
+    {
+      /* Spoofed, then genuine with the name in another case */
+      packet[1] ^= 1;
+      packet[size - 13] = 'g';
+      sendto ( sock, packet, size, 0, ( struct sockaddr * ) &from, len );
+      packet[1] ^= 1;
+      packet[size - 13] = 'h';
+      for ( i = 12; i < ( unsigned int ) got; i++ )
+        packet[i] = toupper ( packet[i] );
+    }
+  sendto ( sock, packet, size, 0, ( struct sockaddr * ) &from, len );
+}
+
+static void
+found ( struct in_addr addr, const char *name, void *arg )
+{
+  struct lookup *lookup = arg;
+
+  ( void ) addr;
+  lookup->done = 1;
+  lookup->named = name != NULL;
+  if ( name )
+    snprintf ( lookup->name, sizeof lookup->name, "%s", name );
+}
+
+/* lookup resolves addr with the server answering as reply. Returns the
+   seconds its answer is cached for, -1 if it never came. */
+static long
+lookup ( struct resolver *resolver,
+         int server,
+         unsigned long addr,
+         enum reply reply,
+         struct lookup *result )
+{
+  struct timeval tv, now;
+  struct dns_entry *entry;
+  struct in_addr in;
+  fd_set fdsr;
+  unsigned int i;
+  int fd = resolver_fd ( resolver ), rounds;
+
+  memset ( result, 0, sizeof *result );
+  in.s_addr = htonl ( addr );
+  resolve_addr ( resolver, in, found, result );
+  for ( rounds = 0; !result->done && rounds < 100; rounds++ )
+    {
+      resolver_timeout ( resolver, &tv );
+      if ( tv.tv_sec || tv.tv_usec > 20000 )
+        {
+          tv.tv_sec = 0;
+          tv.tv_usec = 20000;
+        }
+      FD_ZERO ( &fdsr );
+      FD_SET ( fd, &fdsr );
+      FD_SET ( server, &fdsr );
+      if ( select ( ( fd > server ? fd : server ) + 1,
+                    &fdsr,
+                    NULL,
+                    NULL,
+                    &tv ) > 0 &&
+           FD_ISSET ( server, &fdsr ) )
+        serve ( server, reply );
+      resolver_step ( resolver );
+    }
+  if ( !result->done )
+    return -1;
+
+  gettimeofday ( &now, NULL );
+  for ( i = 0; i < resolver->size; i++ )
+    for ( entry = resolver->buckets[i]; entry; entry = entry->hash_next )
+      if ( entry->addr == addr )
+        return entry->expires ? entry->expires - now.tv_sec : 0;
+  return -1;
+}
+
+int
+main ( void )
+{
+  struct resolver *resolver;
+  struct sockaddr_in sin;
+  struct lookup result;
+  socklen_t len = sizeof sin;
+  char server_name[32];
+  long ttl;
+  int server;
+
+  server = socket ( AF_INET, SOCK_DGRAM, 0 );
+  memset ( &sin, 0, sizeof sin );
+  sin.sin_family = AF_INET;
+  sin.sin_addr.s_addr = htonl ( INADDR_LOOPBACK );
+  if ( server < 0 || bind ( server, ( struct sockaddr * ) &sin, len ) < 0 ||
+       getsockname ( server, ( struct sockaddr * ) &sin, &len ) < 0 )
+    {
+      perror ( "name server socket" );
+      return CHECK_SKIP;
+    }
+  snprintf ( server_name,
+             sizeof server_name,
+             "127.0.0.1:%u",
+             ntohs ( sin.sin_port ) );
+  if ( !( resolver = new_resolver ( server_name, NULL ) ) )
+    {
+      perror ( "new_resolver" );
+      return 1;
+    }
+
+  /* A name, cached for its TTL and then answered from the cache */
+  ttl = lookup ( resolver, server, 0x0a010001, REPLY_PTR, &result );
+  CHECK ( result.named && !strcmp ( result.name, "host.example" ) );
+  CHECK ( ttl >= 3599 && ttl <= 3600 );
+  lookup ( resolver, server, 0x0a010001, REPLY_NXDOMAIN, &result );
+  CHECK ( result.named && !strcmp ( result.name, "host.example" ) );
+  CHECK ( resolver->stats.cached == 1 );
+
+  /* No more than a week */
+  ttl = lookup ( resolver, server, 0x0a010002, REPLY_LONG_TTL, &result );
+  CHECK ( result.named );
+  CHECK ( ttl >= 7 * 24 * 3600L - 1 && ttl <= 7 * 24 * 3600L );
+
+  /* No name, for the SOA minimum or the SOA TTL, whichever is lower */
+  ttl = lookup ( resolver, server, 0x0a010003, REPLY_SOA, &result );
+  CHECK ( result.done && !result.named );
+  CHECK ( ttl >= 299 && ttl <= 300 );
+  ttl = lookup ( resolver, server, 0x0a010004, REPLY_SOA_SHORT, &result );
+  CHECK ( result.done && !result.named );
+  CHECK ( ttl >= 59 && ttl <= 60 );
+
+  /* Without an SOA the lack of a name is not cached */
+  ttl = lookup ( resolver, server, 0x0a010005, REPLY_NXDOMAIN, &result );
+  CHECK ( result.done && !result.named );
+  CHECK ( ttl == 0 );
+
+  /* An answer with another ID is not taken, one that repeats the
+     question in another case is */
+  ttl = lookup ( resolver, server, 0x0a010006, REPLY_FORGED, &result );
+  CHECK ( result.named && !strcmp ( result.name, "host.example" ) );
+  CHECK ( ttl >= 3599 && ttl <= 3600 );
+  CHECK ( resolver->stats.failed == 0 );
+
+  delete_resolver ( resolver );
+  close ( server );
+  return check_status ();
+}